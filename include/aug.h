@@ -170,6 +170,16 @@ struct aug_plugin_cb {
 	/* called when the primary terminal dimensions change. */
 	void (*primary_term_dims_change)(int rows, int cols, void *user);
 
+	/* called when the user pastes text into the outer terminal.
+	 * @data points to the @len bytes of the paste (utf-8 encoded,
+	 * not null terminated) and is only valid for the duration of
+	 * the callback. a paste does not go through the input_char
+	 * callback or the key bindings: it is written to the primary
+	 * terminal all at once. setting @*action to AUG_ACT_CANCEL 
+	 * drops the paste and prevents the paste callback from being
+	 * invoked for plugins after this one. */
+	void (*paste)(const char *data, size_t len, aug_action *action, void *user);
+
 	void *user;
 };
 
@@ -208,6 +218,37 @@ struct aug_plugin {
 	void *so_handle;
 };
 
+/* performance counters of the core. every counter starts at
+ * zero when aug starts and only ever increases. */
+struct aug_counters {
+	/* microseconds since aug started, as of the read */
+	uint64_t uptime_usec;
+	/* bytes read from the ptys of all terminals */
+	uint64_t pty_bytes;
+	/* bytes read from the pty of the primary terminal */
+	uint64_t primary_pty_bytes;
+	/* chunks of pty output fed to the terminal emulator */
+	uint64_t vterm_pushes;
+	/* cells drawn into terminal windows */
+	uint64_t cells_painted;
+	/* frames flushed to the outer terminal */
+	uint64_t frames_rendered;
+	/* frame requests folded into a frame which was already pending */
+	uint64_t frames_skipped;
+	/* keys read from the outer terminal */
+	uint64_t input_keys;
+	/* plugin callback and key binding invocations */
+	uint64_t callbacks;
+	/* lock acquisitions which had to wait for another thread */
+	uint64_t lock_waits;
+	/* frames held back because the outer terminal was congested */
+	uint64_t frames_deferred;
+	/* how congested the outer terminal is right now: 0 when 
+	 * frames go out as soon as they are ready, and each level 
+	 * above that doubles the time between frames */
+	uint64_t congestion;
+};
+
 /* function pointer type for callbacks on key extensions */
 typedef void (*aug_on_key_fn)(uint32_t chr, void *user);
 
@@ -221,9 +262,13 @@ struct aug_terminal_win {
  */
 struct aug_api {
 
-	/* log a message to the debug log file. 
-	 * returns the number of characters printed or
-	 * a negative value on error.
+	/* log a message to the debug log file. the message is
+	 * written out by a background thread, so this doesnt block.
+	 * messages longer than a couple hundred characters are cut
+	 * short. returns the number of characters logged, which is
+	 * 0 if the log-level of the plugin filters out info messages
+	 * or if the plugin has logged too many messages in the last
+	 * second.
 	 */
 	int (*log)(struct aug_plugin *plugin, const char *format, ...);
 	
@@ -287,6 +332,41 @@ struct aug_api {
 	int (*key_bind)(const struct aug_plugin *plugin, uint32_t ch, aug_on_key_fn on_key, void *user );
 	int (*key_unbind)(const struct aug_plugin *plugin, uint32_t ch);
 
+	/* bind or unbind a sequence of @len keys following the
+	 * command key. for example, binding {0x77, 0x6e} to ^A w n.
+	 * at most AUG_MAX_KEY_SEQ keys can be bound. when a sequence
+	 * is a prefix of other bound sequences, aug waits a while for
+	 * the rest of the longer sequence before giving up and 
+	 * invoking the shorter one (or passing the keys through 
+	 * if the prefix isnt bound). the on_key callback is passed 
+	 * the last key of the sequence. */
+#define AUG_MAX_KEY_SEQ 8
+	int (*key_bind_seq)(const struct aug_plugin *plugin, const uint32_t *seq, 
+							size_t len, aug_on_key_fn on_key, void *user);
+	int (*key_unbind_seq)(const struct aug_plugin *plugin, const uint32_t *seq, 
+							size_t len);
+
+	/* set how many milliseconds aug waits for the key after 
+	 * @seq (zero means forever). the timeout for the key after the 
+	 * command key itself is set by passing a @len of zero. if the 
+	 * return value is non-zero, no bound sequence starts with @seq. */
+	int (*key_seq_timeout)(const struct aug_plugin *plugin, const uint32_t *seq, 
+							size_t len, int msecs);
+
+	/* by default the on_key function of a binding runs on a 
+	 * separate thread with no aug resources locked, so it can 
+	 * take as long as it likes and may call any api function. 
+	 * aug keeps draining and rendering the terminals while it runs,
+	 * but holds back further user input until it returns. 
+	 * setting AUG_KEY_SYNC in @flags for a bound sequence makes
+	 * its on_key function run on the main I/O thread with all
+	 * resources locked instead (the same restrictions as the
+	 * callbacks in aug_plugin_cb apply). if the return value
+	 * is non-zero, @seq is not bound. */
+#define AUG_KEY_SYNC 0x01
+	int (*key_seq_flags)(const struct aug_plugin *plugin, const uint32_t *seq, 
+							size_t len, int flags);
+
 	/* ======== screen windows/panels ======================== 
 	 * there are two types of screen real estate a plugin can 
 	 * request the aug core to allocate: panels and windows. 
@@ -390,11 +470,17 @@ struct aug_api {
 	 * calling update_panels() from the panels library. */
 	void (*screen_panel_update)(struct aug_plugin *plugin);
 
-	/* call this instead of calling doupdate() */
+	/* call this instead of calling doupdate(). 
+	 * neither this nor screen_panel_update write to the screen 
+	 * right away: they ask for a frame, and the main loop 
+	 * composites the panels and flushes everything that was 
+	 * drawn since the last frame in one go. so they are cheap
+	 * to call after every change. */
 	void (*screen_doupdate)(struct aug_plugin *plugin);
 
 	/* mark for redrawing the areas of the screen described by the rectangle
-	 * given by @col_start, @col_end, @row_start and @row_end. */
+	 * given by @col_start, @col_end, @row_start and @row_end. the area is
+	 * redrawn the next time the primary terminal is refreshed. */
 	void (*primary_term_damage)(const struct aug_plugin *plugin, 
 			size_t col_start, size_t col_end, size_t row_start, size_t row_end);
 
@@ -404,7 +490,11 @@ struct aug_api {
 	 * a terminal attached to the child. @twin must point to
 	 * the window associated with the terminal. @terminal will
 	 * be assigned to the result and must be passed to other
-	 * terminal_* api calls. */
+	 * terminal_* api calls. 
+	 * if @twin is NULL the terminal is headless: it has the size
+	 * of the primary terminal, its output is parsed but never
+	 * rendered. use terminal_snapshot to read its screen or 
+	 * terminal_attach to give it a window later. */
 	void (*terminal_new)(struct aug_plugin *plugin, struct aug_terminal_win *twin,
 							char *const *argv, void **terminal);
 
@@ -413,12 +503,14 @@ struct aug_api {
 	 * process, it will simply deallocate memory resources. if the child
 	 * should be killed, use terminal_pid to get the PID of the process and
 	 * send it a signal before calling this function.
-	 * obviously, do not call any other api call with @terminal after
-	 * deleting it (for example, one thread deletes the terminal and
-	 * another is still writing into it). */
+	 * this waits for any api calls on @terminal which other threads are
+	 * in the middle of (including terminal_run, so make sure the child 
+	 * has exited). api calls made with @terminal after it has been 
+	 * deleted do nothing. */
 	void (*terminal_delete)(struct aug_plugin *plugin, void *terminal);
 
-	/* return the process id of the child process spawned for @terminal */
+	/* return the process id of the child process spawned for @terminal,
+	 * or -1 if @terminal has been deleted */
 	pid_t (*terminal_pid)(struct aug_plugin *plugin, const void *terminal);
 	
 	/* returns 0 if the process associated with the terminal has not
@@ -452,11 +544,25 @@ struct aug_api {
 	size_t (*terminal_input_chars)(struct aug_plugin *plugin, void *terminal, 
 								const char *data, int n);
 
-	/* refreshes (and flushes the damage) of the terminal to cause output
-	 * to the screen. you probably want to run screen_panel_update and
-	 * screen_doupdate after calling this function. */
+	/* has the terminal refresh (and flush its damage) to cause output
+	 * to the screen. this happens shortly after the call returns, on 
+	 * the thread of the terminal, which then asks for a frame. */
 	void (*terminal_refresh)(struct aug_plugin *plugin, void *terminal);
 
+	/* give @terminal the window @twin (which replaces any window
+	 * it had before). the terminal is resized to fit and painted
+	 * in full. pass NULL for @twin to make the terminal headless. */
+	void (*terminal_attach)(struct aug_plugin *plugin, void *terminal, 
+								struct aug_terminal_win *twin);
+
+	/* copy the characters on the screen of @terminal, row by row,
+	 * into @buf (a blank cell is a space). at most @n characters
+	 * are copied and the number copied is returned. @rows and @cols
+	 * are set to the dimensions of the terminal, so passing 0 for 
+	 * @n just returns the dimensions. */
+	size_t (*terminal_snapshot)(struct aug_plugin *plugin, void *terminal, 
+								uint32_t *buf, size_t n, int *rows, int *cols);
+
 	/* similar to the terminal input api calls, these allow
 	 * a plugin to write input keys/data to the primary terminal. 
 	 * this will be very useful to automate input into the primary
@@ -466,10 +572,19 @@ struct aug_api {
 	size_t (*primary_input_chars)(struct aug_plugin *plugin,
 									const char *data, int n);
 
-	/* refreshes (and flushes the damage) of the primary terminal to 
-	 * cause output to the screen. you probably want to run 
-	 * screen_doupdate after calling this function. */
+	/* has the primary terminal refresh (and flush its damage) to 
+	 * cause output to the screen with the next frame. */
 	void (*primary_refresh)(struct aug_plugin *plugin);
+
+	/* copy the performance counters into @counters. each counter
+	 * is read atomically, so rates (bytes per second for example)
+	 * are the difference between two reads divided by the 
+	 * difference of their uptime_usec. */
+	void (*counters)(struct aug_plugin *plugin, struct aug_counters *counters);
+
+	/* the number of bytes read from the pty of @terminal so far,
+	 * or 0 if @terminal has been deleted */
+	uint64_t (*terminal_pty_bytes)(struct aug_plugin *plugin, const void *terminal);
 };
 
 #endif /* AUG_AUG_H */
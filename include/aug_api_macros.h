@@ -47,6 +47,14 @@
 	AUG_API_CALL(key_bind, (AUG_PLUGIN_HANDLE), __VA_ARGS__ )
 #define aug_key_unbind(...) \
 	AUG_API_CALL(key_unbind, (AUG_PLUGIN_HANDLE), __VA_ARGS__ )
+#define aug_key_bind_seq(...) \
+	AUG_API_CALL(key_bind_seq, (AUG_PLUGIN_HANDLE), __VA_ARGS__ )
+#define aug_key_unbind_seq(...) \
+	AUG_API_CALL(key_unbind_seq, (AUG_PLUGIN_HANDLE), __VA_ARGS__ )
+#define aug_key_seq_timeout(...) \
+	AUG_API_CALL(key_seq_timeout, (AUG_PLUGIN_HANDLE), __VA_ARGS__ )
+#define aug_key_seq_flags(...) \
+	AUG_API_CALL(key_seq_flags, (AUG_PLUGIN_HANDLE), __VA_ARGS__ )
 #define aug_lock_screen() \
 	AUG_API_CALL(lock_screen, (AUG_PLUGIN_HANDLE))
 #define aug_unlock_screen() \
@@ -87,6 +95,10 @@
 	AUG_API_CALL(terminal_input, (AUG_PLUGIN_HANDLE), __VA_ARGS__ )
 #define aug_terminal_input_chars(...) \
 	AUG_API_CALL(terminal_input_chars, (AUG_PLUGIN_HANDLE), __VA_ARGS__ )
+#define aug_terminal_attach(...) \
+	AUG_API_CALL(terminal_attach, (AUG_PLUGIN_HANDLE), __VA_ARGS__ )
+#define aug_terminal_snapshot(...) \
+	AUG_API_CALL(terminal_snapshot, (AUG_PLUGIN_HANDLE), __VA_ARGS__ )
 #define aug_primary_input(...) \
 	AUG_API_CALL(primary_input, (AUG_PLUGIN_HANDLE), __VA_ARGS__ )
 #define aug_primary_input_chars(...) \
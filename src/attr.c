@@ -19,6 +19,7 @@
 #include <assert.h>
 #include "vterm_util.h"
 #include "vterm_ansi_colors.h"
+#include "log.h"
 
 /* this is a hack. libvterm doesnt tell us
  * if a cell is using the default color or if 
@@ -74,6 +75,15 @@ void attr_curses_colors_to_curses_pair(int fg, int bg, int *pair) {
 	assert(*pair >= 0);
 }
 
+/* the inverse of attr_curses_colors_to_curses_pair */
+void attr_curses_pair_to_curses_colors(int pair, int *fg, int *bg) {
+	assert(pair < AUG_REQ_PAIRS);
+	assert(pair >= 0);
+
+	*fg = pair/AUG_REQ_COLORS - 1;
+	*bg = pair%AUG_REQ_COLORS - 1;
+}
+
 /* *vterm_index* is a index into the table of 
  * libvterm ansi color definitions. *curses_index*
  * is an output parameter that will hold the 
@@ -167,11 +177,11 @@ void attr_vterm_pair_to_curses_pair(VTermColor fg, VTermColor bg, attr_t *attr,
 	
 	if(attr_vterm_color_to_curses_color(fg, &curs_fg, &bright_fg) != 0) {
 		attr_vterm_color_to_nearest_curses_color(fg, &curs_fg, &bright_fg);
-		fprintf(stderr, "attr_vterm_pair_to_curses_pair: mapped fg color %d,%d,%d to color %d\n", fg.red, fg.green, fg.blue, curs_fg);
+		AUG_LOG(AUG_LOG_DEBUG, "attr", "mapped fg color %d,%d,%d to color %d\n", fg.red, fg.green, fg.blue, curs_fg);
 	}
 	if(attr_vterm_color_to_curses_color(bg, &curs_bg, &bright_bg) != 0) {
 		attr_vterm_color_to_nearest_curses_color(bg, &curs_bg, &bright_bg);
-		fprintf(stderr, "attr_vterm_pair_to_curses_pair: mapped bg color %d,%d,%d to color %d\n", bg.red, bg.green, bg.blue, curs_bg);
+		AUG_LOG(AUG_LOG_DEBUG, "attr", "mapped bg color %d,%d,%d to color %d\n", bg.red, bg.green, bg.blue, curs_bg);
 	}
 	
 	attr_curses_colors_to_curses_pair(curs_fg, curs_bg, pair);
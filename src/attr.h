@@ -34,6 +34,7 @@ const VTermColor VTERM_DEFAULT_COLOR; /* placeholder for default color */
 #endif
 
 void attr_curses_colors_to_curses_pair(int fg, int bg, int *pair);
+void attr_curses_pair_to_curses_colors(int pair, int *fg, int *bg);
 void attr_vterm_index_to_curses_index(int vterm_index, int *curses_index, int *bright);
 int attr_vterm_color_to_curses_color(VTermColor color, int *curses_color, int *bright);
 void attr_vterm_color_to_nearest_curses_color(VTermColor color, int *curses_color, int *bright);
@@ -42,7 +42,6 @@
 
 #include "vterm.h"
 
-#include <ccan/objset/objset.h>
 #include <ccan/build_assert/build_assert.h>
 #include <ccan/array_size/array_size.h>
 
@@ -60,10 +59,28 @@
 #include "region_map.h"
 #include "child.h"
 #include "term_win.h"
+#include "paste.h"
+#include "worker_pool.h"
+#include "lock_prof.h"
+#include "trace.h"
+#include "log.h"
+#include "handle_table.h"
+#include "slab.h"
+#include "proc_events.h"
+#include "frame.h"
+#include "counters.h"
+#include "stats_sock.h"
+#include "session.h"
+#include "mirror.h"
+#include "record.h"
 
 static void resize_and_redraw_screen();
 static void child_setup();
+static void watch_child(pid_t pid);
 static void to_refresh_after_io();
+static void to_request_frame();
+static void request_frame();
+static void commit_frame();
 
 static struct aug_conf g_conf; /* structure of configuration variables */
 static struct aug_plugin_list g_plugin_list;
@@ -72,8 +89,31 @@ static struct aug_term g_term;
 static dictionary *g_ini;	
 static struct aug_keymap g_keymap;
 static struct aug_child g_child;
+static struct aug_paste g_paste;
+static struct aug_keymap_state g_key_state;
+/* runs the on_key functions of bound commands */
+static struct aug_worker_pool g_cmd_pool;
+
+/* the command which was last handed to g_cmd_pool. the key
+ * fields are only written by the I/O thread while no command 
+ * is pending. */
+static struct {
+	int pending;
+	aug_on_key_fn on_key;
+	void *user;
+	uint32_t ch;
+	uint32_t keys[AUG_KEYMAP_MAX_SEQ];
+	size_t len;
+	/* a key which arrived along with the command, to be
+	 * handled once the command has finished. */
+	int has_next;
+	uint32_t next;
+	AUG_LOCK_MEMBERS;
+} g_cmd;
 
 static struct {
+	/* only the main loop flushes to the outer terminal */
+	struct aug_frame frame;
 	AUG_LOCK_MEMBERS;
 } g_screen;
 static struct {
@@ -83,12 +123,6 @@ static struct {
 	AUG_LOCK_MEMBERS;
 } g_free_plugin_lock;
 
-struct plugin_callback_pair {
-	struct aug_plugin *plugin;
-	void (*window_fn)(WINDOW *, void *user);
-	void (*free_fn)(WINDOW *, void *user);
-};
-
 struct sigthread_desc {
 	pthread_t tid;
 	int signum;
@@ -97,17 +131,41 @@ struct sigthread_desc {
 	AUG_LOCK_MEMBERS;
 };
 
-struct sigthread_desc g_chld_thread, g_winch_thread;
-
-static struct {
-	OBJSET_MEMBERS(struct plugin_callback_pair *);
-} g_edgewin_set;
-
+struct sigthread_desc g_chld_thread, g_winch_thread, g_usr1_thread;
+
+/* where the signal threads arent needed, signals and child 
+ * exits are handled by the main event loop through this */
+static struct aug_proc_events g_proc_events;
+static int g_proc_events_on = 0;
+
+/* serves the performance counters if --stats-socket was given */
+static struct aug_stats_sock g_stats_sock;
+/* serves the primary terminal if --session-socket was given */
+static struct aug_session g_session;
+/* only in the server process (see --session-socket) */
+static struct aug_session_server g_server;
+/* publishes the primary terminal if --mirror was given */
+static struct aug_mirror g_mirror;
+/* records the primary terminal if --record was given. the
+ * path with the strftime conversions filled in. */
+static struct aug_recorder g_recorder;
+static char g_record_path[1024];
+/* g_recorder was started. protected by g_term */
+static int g_recording = 0;
+
+/* maps the pids of sub-terminal children to their 
+ * aug_term_child for the SIGCHLD handler */
 static struct {
 	AVL *tree;
 	AUG_LOCK_MEMBERS;
 } g_tchild_table;
 
+/* the void *terminal handles given to plugins */
+static struct aug_handle_table g_terminals;
+/* the aug_term_child structs */
+static struct aug_slab g_tchild_slab;
+#define AUG_TCHILD_SLAB_PAGE 16
+
 static struct sigaction g_prev_winch_act;
 
 struct aug_term_child {
@@ -138,37 +196,53 @@ struct aug_term_child {
 
 #define lock_all() \
 	do { \
-		AUG_LOCK(&g_keymap); \
-		AUG_LOCK(&g_plugin_list); \
-		lock_screen(); \
+		AUG_WRLOCK(&g_keymap); \
+		AUG_LOCK(&g_term); \
+		AUG_WRLOCK(&g_plugin_list); \
+		AUG_LOCK(&g_screen); \
 	} while(0)
 
 #define unlock_all() \
 	do { \
-		unlock_screen(); \
-		AUG_UNLOCK(&g_plugin_list); \
-		AUG_UNLOCK(&g_keymap); \
+		AUG_UNLOCK(&g_screen); \
+		AUG_RWUNLOCK(&g_plugin_list); \
+		AUG_UNLOCK(&g_term); \
+		AUG_RWUNLOCK(&g_keymap); \
+	} while(0)
+
+/* everything locked, but keymap and plugin list are only
+ * read. this is what the callbacks and AUG_KEY_SYNC commands
+ * run under. */
+#define lock_all_read() \
+	do { \
+		AUG_RDLOCK(&g_keymap); \
+		AUG_LOCK(&g_term); \
+		AUG_RDLOCK(&g_plugin_list); \
+		AUG_LOCK(&g_screen); \
+	} while(0)
+
+#define unlock_all_read() \
+	do { \
+		AUG_UNLOCK(&g_screen); \
+		AUG_RWUNLOCK(&g_plugin_list); \
+		AUG_UNLOCK(&g_term); \
+		AUG_RWUNLOCK(&g_keymap); \
 	} while(0)
 
 /* ================= API FUNCTIONS ==================================== */
 
 static int api_log(struct aug_plugin *plugin, const char *format, ...) {
+	struct aug_log_site *site;
 	va_list args;
 	int result;
-	char s[64];
-	time_t t;
-	const struct tm *tm;
 
-	s[0] = '\0';
-	t = time(NULL);
-	if( (tm = localtime(&t)) != NULL)
-	strftime(s, ARRAY_SIZE(s), "%m.%d %H:%M:%S", tm);
+	site = &plugin_list_item(plugin)->log_site;
+	if(!log_site_enabled(site))
+		return 0;
 
-	fprintf(stderr, "%s(%s): ", plugin->name, s);
 	va_start(args, format);
-	result = vfprintf(stderr, format, args);
+	result = log_site_vwrite(site, format, args);
 	va_end(args);
-	fflush(stderr);
 
 	return result;
 }
@@ -196,7 +270,7 @@ static void *do_unload(void *user) {
 	 * freed by this call as well as the terminating
 	 * free_plugins() call. */
 	AUG_LOCK(&g_free_plugin_lock); 
-	AUG_LOCK(&g_plugin_list);
+	AUG_RDLOCK(&g_plugin_list);
 	found = 0;
 	PLUGIN_LIST_FOREACH(&g_plugin_list, i) {
 		if( &i->plugin == plugin ) {
@@ -204,15 +278,15 @@ static void *do_unload(void *user) {
 			break;
 		}
 	}
-	AUG_UNLOCK(&g_plugin_list);
+	AUG_RWUNLOCK(&g_plugin_list);
 	if(found == 0)
 		goto unlock;
 
 	fprintf(stderr, "unload plugin %s\n", i->plugin.name);
 	(*i->plugin.free)();
-	AUG_LOCK(&g_plugin_list);
+	AUG_WRLOCK(&g_plugin_list);
 	plugin_list_del(&g_plugin_list, i);
-	AUG_UNLOCK(&g_plugin_list);
+	AUG_RWUNLOCK(&g_plugin_list);
 
 	AUG_UNLOCK(&g_free_plugin_lock);
 	return NULL;
@@ -275,14 +349,14 @@ static void api_callbacks(struct aug_plugin *plugin, const struct aug_plugin_cb
 		*prev = plugin->callbacks;
 
 	if(callbacks != NULL) {
-		AUG_LOCK(&g_plugin_list);
+		AUG_WRLOCK(&g_plugin_list);
 		plugin->callbacks = callbacks;
-		AUG_UNLOCK(&g_plugin_list);
+		AUG_RWUNLOCK(&g_plugin_list);
 	}
 }
 
-static int api_key_bind(const struct aug_plugin *plugin, uint32_t ch, 
-							aug_on_key_fn on_key, void *user) {
+static int api_key_bind_seq(const struct aug_plugin *plugin, const uint32_t *seq,
+							size_t len, aug_on_key_fn on_key, void *user) {
 	aug_on_key_fn ok;
 	int result = 0;
 	(void)(plugin);
@@ -290,27 +364,61 @@ static int api_key_bind(const struct aug_plugin *plugin, uint32_t ch,
 	assert(on_key != NULL);
 	ok = NULL;
 	
-	AUG_LOCK(&g_keymap);
-	keymap_binding(&g_keymap, ch, &ok, NULL);
-	if(ok != NULL) { /* this key is already bound */
+	AUG_WRLOCK(&g_keymap);
+	keymap_binding_seq(&g_keymap, seq, len, &ok, NULL);
+	if(ok != NULL) { /* this sequence is already bound */
 		result = -1;
 		goto unlock;
 	}
 	
-	keymap_bind(&g_keymap, ch, on_key, user);
+	result = keymap_bind_seq(&g_keymap, seq, len, on_key, user);
 
 unlock:
-	AUG_UNLOCK(&g_keymap);
+	AUG_RWUNLOCK(&g_keymap);
+	return result;
+}
+
+static int api_key_bind(const struct aug_plugin *plugin, uint32_t ch, 
+							aug_on_key_fn on_key, void *user) {
+	return api_key_bind_seq(plugin, &ch, 1, on_key, user);
+}
+
+static int api_key_unbind_seq(const struct aug_plugin *plugin, const uint32_t *seq,
+							size_t len) {
+	int result;
+	(void)(plugin);
+	
+	AUG_WRLOCK(&g_keymap);
+	result = keymap_unbind_seq(&g_keymap, seq, len);
+	AUG_RWUNLOCK(&g_keymap);
+
 	return result;
 }
 
 static int api_key_unbind(const struct aug_plugin *plugin, uint32_t ch) {
+	return api_key_unbind_seq(plugin, &ch, 1);
+}
+
+static int api_key_seq_timeout(const struct aug_plugin *plugin, const uint32_t *seq,
+							size_t len, int msecs) {
+	int result;
+	(void)(plugin);
+	
+	AUG_WRLOCK(&g_keymap);
+	result = keymap_set_timeout(&g_keymap, seq, len, msecs);
+	AUG_RWUNLOCK(&g_keymap);
+
+	return result;
+}
+
+static int api_key_seq_flags(const struct aug_plugin *plugin, const uint32_t *seq,
+							size_t len, int flags) {
 	int result;
 	(void)(plugin);
 	
-	AUG_LOCK(&g_keymap);
-	result = keymap_unbind(&g_keymap, ch);
-	AUG_UNLOCK(&g_keymap);
+	AUG_WRLOCK(&g_keymap);
+	result = keymap_set_flags(&g_keymap, seq, len, flags);
+	AUG_RWUNLOCK(&g_keymap);
 
 	return result;
 }
@@ -331,53 +439,46 @@ static void api_unlock_screen(const struct aug_plugin *plugin) {
  * resources it allocated for this window.
  * screen, term, region_map will be locked when this is called.
  */
-void make_win_alloc_cb_free(void *cb_pair, WINDOW *win) {
-	struct plugin_callback_pair *pair;
+void make_win_alloc_cb_free(const struct aug_edgewin *ew, WINDOW *win) {
+	const struct aug_plugin *plugin;
 	
-	pair = (struct plugin_callback_pair *) cb_pair;
-	if(pair->free_fn != NULL)
-		(*pair->free_fn)(win, pair->plugin->callbacks->user);
+	plugin = ew->owner;
+	if(ew->free_fn != NULL)
+		(*ew->free_fn)(win, plugin->callbacks->user);
 }
 
 /* called by screen module from within screen_resize when a new
  * window has been created for an allocated plugin window.
  * screen, term, region_map will be locked when this is called.
  */
-void make_win_alloc_cb_new(void *cb_pair, WINDOW *win) {
-	struct plugin_callback_pair *pair;
+void make_win_alloc_cb_new(const struct aug_edgewin *ew, WINDOW *win) {
+	const struct aug_plugin *plugin;
 	
-	pair = (struct plugin_callback_pair *) cb_pair;
-	(*pair->window_fn)(win, pair->plugin->callbacks->user);
+	plugin = ew->owner;
+	(*ew->window_fn)(win, plugin->callbacks->user);
 }
 
 static inline void api_screen_win_alloc(int loc, struct aug_plugin *plugin, int size, 
 		void (*window_cb)(WINDOW *, void *),
 		void (*free_cb)(WINDOW *, void *) ) {
-	struct plugin_callback_pair *pair;
-	
-	pair = aug_malloc( sizeof(struct plugin_callback_pair) );
-	pair->plugin = plugin;
-	pair->window_fn = window_cb;
-	pair->free_fn = free_cb;
-	
 	/* need locks on screen, term, and region_map */
 	AUG_LOCK(&g_region_map);
 	lock_all();
 
-	objset_add(&g_edgewin_set, pair);
-	
+	/* the region map keeps the edge window by plugin and 
+	 * window_cb, along with its region and WINDOW */
 	switch(loc) {
 	case 0:
-		region_map_push_top((void *) pair, size);
+		region_map_push_top(plugin, window_cb, free_cb, size);
 		break;
 	case 1:
-		region_map_push_bot((void *) pair, size);
+		region_map_push_bot(plugin, window_cb, free_cb, size);
 		break;
 	case 2:
-		region_map_push_left((void *) pair, size);
+		region_map_push_left(plugin, window_cb, free_cb, size);
 		break;
 	case 3:
-		region_map_push_right((void *) pair, size);
+		region_map_push_right(plugin, window_cb, free_cb, size);
 		break;
 	default:
 		err_exit(0, "invalid value for loc");
@@ -414,8 +515,7 @@ static void api_screen_win_alloc_right(struct aug_plugin *plugin, int ncols,
 
 static int api_screen_win_dealloc(struct aug_plugin *plugin, \
 				void (*window_cb)(WINDOW *, void *)) {
-	struct objset_iter i;
-	struct plugin_callback_pair *pair;
+	struct aug_edgewin *ew;
 	int status;
 
 	status = -1;
@@ -423,30 +523,19 @@ static int api_screen_win_dealloc(struct aug_plugin *plugin, \
 	AUG_LOCK(&g_region_map);
 	lock_all();
 
-	/* find the edgewin */
-	for(pair = objset_first(&g_edgewin_set, &i); pair != NULL; 
-			pair = objset_next(&g_edgewin_set, &i) ) {
-		if(plugin == pair->plugin && window_cb == pair->window_fn)
-			break;
+	/* free its window (calling the _free callback) and remove
+	 * it from the region map, for each time it was allocated. 
+	 * the other windows get a new WINDOW when the screen is 
+	 * re-assessed only if their region changed. */
+	while( (ew = region_map_lookup(plugin, window_cb) ) != NULL) {
+		screen_release_edgewin(ew);
+		region_map_remove(ew);
+		status = 0;
 	}
 
-	if(pair != NULL) {
-		/* delete it from the region map. the next time
-		 * the screen is re-assessed all window regions will be
-		 * freed (with provided _free callbacks being called) 
-		 * and then reallocated. since this particular region
-		 * will have been deleted from the region map it will
-		 * not be reallocated space and thus will have been freed
-		 * for good. */
-		if(region_map_delete( (void *) pair) != 0)
-			err_exit(0, "expected pair to exist in region map!");
-
-		objset_del(&g_edgewin_set, pair);
-		/* re-assess what the screen should look like */
+	/* re-assess what the screen should look like */
+	if(status == 0)
 		resize_and_redraw_screen();
-		free(pair);
-		status = 0;
-	}
 
 	unlock_all();
 	AUG_UNLOCK(&g_region_map);
@@ -486,13 +575,13 @@ static void api_screen_panel_size(struct aug_plugin *plugin, int *size) {
 static void api_screen_panel_update(struct aug_plugin *plugin) {
 	(void)(plugin);
 
-	panel_stack_update();
+	request_frame();
 }
 
 static void api_screen_doupdate(struct aug_plugin *plugin) {
 	(void)(plugin);
 
-	screen_doupdate();
+	request_frame();
 }
 
 /* no locks engaged here because this API call is meant to be used
@@ -508,7 +597,7 @@ static int terminal_cb_damage(VTermRect rect, void *user) {
 	struct aug_term_child *tchild;
 
 	tchild = (struct aug_term_child *) user;
-	return term_win_damage(&tchild->term_win, rect, screen_color_on());
+	return term_win_damage(&tchild->term_win, rect);
 }
 
 static int terminal_cb_movecursor(VTermPos pos, VTermPos oldpos, int visible, void *user) {
@@ -517,7 +606,28 @@ static int terminal_cb_movecursor(VTermPos pos, VTermPos oldpos, int visible, vo
 
 	tchild = (struct aug_term_child *) user;
 
-	return term_win_movecursor(&tchild->term_win, pos, oldpos, screen_color_on());
+	return term_win_movecursor(&tchild->term_win, pos, oldpos);
+}
+
+static int terminal_cb_bell(void *user) {
+	struct aug_term_child *tchild;
+
+	tchild = (struct aug_term_child *) user;
+	return term_win_bell(&tchild->term_win);
+}
+
+static int terminal_cb_settermprop(VTermProp prop, VTermValue *val, void *user) {
+	struct aug_term_child *tchild;
+
+	tchild = (struct aug_term_child *) user;
+	return term_win_settermprop(&tchild->term_win, prop, val);
+}
+
+static void terminal_cb_stage(void *user) {
+	struct aug_term_child *tchild;
+
+	tchild = (struct aug_term_child *) user;
+	term_win_stage(&tchild->term_win, screen_color_on());
 }
 
 static void terminal_cb_refresh(void *user) {
@@ -527,11 +637,15 @@ static void terminal_cb_refresh(void *user) {
 	term_win_refresh(&tchild->term_win, screen_color_on());
 }
 
-static void terminal_run_lock(void *user) {
+/* a terminal is only parsed by the thread that runs it, so 
+ * the child lock is all that parsing needs. rendering needs 
+ * the plugin list for the callbacks and the screen for ncurses. */
+static void terminal_render_lock(void *user) {
 	struct aug_term_child *tchild;
 
 	tchild = (struct aug_term_child *) user;
-	lock_all();	
+	AUG_RDLOCK(&g_plugin_list);
+	AUG_LOCK(&g_screen);
 	
 	/* update terminal window with new curses window
 	 * if it has changed */
@@ -540,37 +654,48 @@ static void terminal_run_lock(void *user) {
 	}
 }
 
-static void terminal_run_unlock(void *user) {
+static void terminal_render_unlock(void *user) {
 	(void)(user);
-	unlock_all();	
+
+	AUG_UNLOCK(&g_screen);
+	AUG_RWUNLOCK(&g_plugin_list);
 }
 
 static void api_terminal_new(struct aug_plugin *plugin, struct aug_terminal_win *twin,
 								char *const *argv, void **terminal) {
 	struct aug_term_child *tchild, *old_tchild;
-	int fd;
+	int fd, rows, cols;
 	(void)(plugin);
 
 	AUG_LOCK(&g_tchild_table);
 	lock_all();
 	
-	tchild = aug_malloc( sizeof(struct aug_term_child) );
+	tchild = slab_alloc(&g_tchild_slab);
 	tchild->twin = twin;
 
 	term_init(&tchild->term, 1, 1);
 	tchild->terminated = 0;
 	
-	term_win_init(&tchild->term_win, twin->win);
+	term_win_init(&tchild->term_win, (twin != NULL)? twin->win : NULL);
 	term_win_set_term(&tchild->term_win, &tchild->term);
+	if(twin == NULL) {
+		/* headless terminals get the size of the primary terminal */
+		screen_term_win_dims(&rows, &cols);
+		if(term_resize(&tchild->term, rows, cols) != 0)
+			err_exit(errno, "error resizing terminal!");
+	}
 
 	memset(&tchild->cb_screen, 0, sizeof(VTermScreenCallbacks) );
 	tchild->cb_screen.damage 		= terminal_cb_damage;
 	tchild->cb_screen.movecursor 	= terminal_cb_movecursor;
-	tchild->cb_screen.bell 			= screen_bell;
-	tchild->cb_screen.settermprop	= screen_settermprop;
+	tchild->cb_screen.bell 			= terminal_cb_bell;
+	tchild->cb_screen.settermprop	= terminal_cb_settermprop;
 	
+	tchild->cb_term_io.stage		= terminal_cb_stage;
 	tchild->cb_term_io.refresh		= terminal_cb_refresh;
-	term_set_callbacks(&tchild->term, &tchild->cb_screen, &tchild->cb_term_io, tchild);
+	/* without callbacks vterm just keeps the screen state */
+	if(twin != NULL)
+		term_set_callbacks(&tchild->term, &tchild->cb_screen, &tchild->cb_term_io, tchild);
 
 	/* very strange bug: for some reason the select call
 	 * during child_io_loop will not receive an EOF
@@ -587,18 +712,22 @@ static void api_terminal_new(struct aug_plugin *plugin, struct aug_terminal_win
 		&tchild->term,
 		argv,
 		child_setup,
-		to_refresh_after_io,
-		terminal_run_lock,
-		terminal_run_unlock,
+		to_request_frame,
+		NULL,
+		NULL,
+		(twin != NULL)? terminal_render_lock : NULL,
+		(twin != NULL)? terminal_render_unlock : NULL,
 		NULL,
 		tchild
 	);
 	if(close(fd) != 0)
 		err_exit(errno, "failed to close file descriptor");
 
-	fprintf(stderr, "started child at pid %d\n", tchild->child.pid);
+	fprintf(stderr, "started child at pid %d (terminal overhead: %zu bytes)\n", 
+		tchild->child.pid, sizeof(*tchild) + term_win_mem(&tchild->term_win));
 
-	*terminal = (void *) tchild;
+	if( (*terminal = handle_table_add(&g_terminals, tchild) ) == NULL)
+		err_exit(0, "too many terminals");
 
 	/* disregard the warning, void * is bigger or equal to pid_t */
 	BUILD_ASSERT( sizeof(void *) >= sizeof(pid_t) );
@@ -617,6 +746,8 @@ static void api_terminal_new(struct aug_plugin *plugin, struct aug_terminal_win
 
 	BUILD_ASSERT( sizeof(void *) >= sizeof(pid_t) );
 	avl_insert(g_tchild_table.tree, (void *) tchild->child.pid, tchild);
+	/* the exit cant be handled before we unlock the table */
+	watch_child(tchild->child.pid);
 
 	unlock_all();
 	AUG_UNLOCK(&g_tchild_table);
@@ -626,43 +757,111 @@ static void api_terminal_delete(struct aug_plugin *plugin, void *terminal) {
 	struct aug_term_child *tchild;
 	(void)(plugin);
 	
-	AUG_LOCK(&g_tchild_table);
-	lock_all();
-
-	tchild = (struct aug_term_child *) terminal;
-	BUILD_ASSERT( sizeof(void *) >= sizeof(pid_t) );
-	if(avl_remove(g_tchild_table.tree, (void *) tchild->child.pid) != true) {
+	/* after this returns no other thread is using 
+	 * the terminal and none can start using it. */
+	tchild = handle_table_remove(&g_terminals, terminal);
+	if(tchild == NULL) {
 #ifdef AUG_DEBUG
-		err_exit(
-			0, 
-			"error: could not locate terminal child at pid %d", 
-			tchild->child.pid
-		);
+		err_exit(0, "error: terminal %p was already deleted", terminal);
 #else
-		fprintf(
-			stderr, 
-			"warning: could not locate terminal child at pid %d", 
-			tchild->child.pid
-		);
+		fprintf(stderr, "warning: terminal %p was already deleted\n", terminal);
+		return;
 #endif
 	}
+
+	AUG_LOCK(&g_tchild_table);
+	lock_all();
+
+	/* the pid may have been reused by a newer terminal */
+	BUILD_ASSERT( sizeof(void *) >= sizeof(pid_t) );
+	if(avl_lookup(g_tchild_table.tree, (void *) tchild->child.pid) == tchild)
+		avl_remove(g_tchild_table.tree, (void *) tchild->child.pid);
 	
 	child_free(&tchild->child);	
 	term_win_free(&tchild->term_win);
 	term_free(&tchild->term);
-	free(tchild);
+	slab_release(&g_tchild_slab, tchild);
 
 	unlock_all();
 	AUG_UNLOCK(&g_tchild_table);
 }
 
+static void api_terminal_attach(struct aug_plugin *plugin, void *terminal, 
+		struct aug_terminal_win *twin) {
+	struct aug_term_child *tchild;
+	(void)(plugin);
+
+	if( (tchild = handle_table_get(&g_terminals, terminal) ) == NULL)
+		return;
+
+	child_lock(&tchild->child);
+	AUG_RDLOCK(&g_plugin_list);
+	AUG_LOCK(&g_screen);
+
+	tchild->twin = twin;
+	/* resizes the terminal to the window and damages all 
+	 * of it, so the next refresh paints it from scratch */
+	term_win_resize(&tchild->term_win, (twin != NULL)? twin->win : NULL);
+	if(twin != NULL) {
+		term_set_callbacks(&tchild->term, &tchild->cb_screen, &tchild->cb_term_io, tchild);
+		child_set_render(&tchild->child, terminal_render_lock, terminal_render_unlock);
+	}
+	else {
+		term_clear_callbacks(&tchild->term);
+		child_set_render(&tchild->child, NULL, NULL);
+	}
+
+	AUG_UNLOCK(&g_screen);
+	AUG_RWUNLOCK(&g_plugin_list);
+
+	child_refresh(&tchild->child);
+	child_unlock(&tchild->child);
+
+	handle_table_put(&g_terminals, terminal);
+}
+
+static size_t api_terminal_snapshot(struct aug_plugin *plugin, void *terminal, 
+		uint32_t *buf, size_t n, int *rows, int *cols) {
+	struct aug_term_child *tchild;
+	VTermScreen *vts;
+	VTermScreenCell cell;
+	VTermPos pos;
+	size_t i;
+	(void)(plugin);
+
+	*rows = 0;
+	*cols = 0;
+	if( (tchild = handle_table_get(&g_terminals, terminal) ) == NULL)
+		return 0;
+
+	child_lock(&tchild->child);
+	term_dims(&tchild->term, rows, cols);
+	vts = vterm_obtain_screen(tchild->term.vt);
+	i = 0;
+	for(pos.row = 0; pos.row < *rows; pos.row++) {
+		for(pos.col = 0; pos.col < *cols && i < n; pos.col++, i++) {
+			if( !vterm_screen_get_cell(vts, pos, &cell) )
+				err_exit(0, "get_cell returned false status\n");
+			buf[i] = (cell.chars[0] == 0)? ' ' : cell.chars[0];
+		}
+	}
+	child_unlock(&tchild->child);
+
+	handle_table_put(&g_terminals, terminal);
+	return i;
+}
+
 static pid_t api_terminal_pid(struct aug_plugin *plugin, const void *terminal) {
 	const struct aug_term_child *tchild;
+	pid_t pid;
 	(void)(plugin);
 
-	tchild = (const struct aug_term_child *) terminal;
+	if( (tchild = handle_table_get(&g_terminals, terminal) ) == NULL)
+		return -1;
+	pid = tchild->child.pid;
+	handle_table_put(&g_terminals, terminal);
 	
-	return tchild->child.pid;
+	return pid;
 }
 
 static void api_terminal_run(struct aug_plugin *plugin, void *terminal) {
@@ -670,25 +869,32 @@ static void api_terminal_run(struct aug_plugin *plugin, void *terminal) {
 
 	(void)(plugin);
 
-	tchild = (struct aug_term_child *) terminal;
+	if( (tchild = handle_table_get(&g_terminals, terminal) ) == NULL)
+		return;
 
+	trace_thread_name("terminal");
 	child_lock(&tchild->child);
-	/* resources will be unlocked in the function */
+	/* the child will be unlocked in the function */
 	child_io_loop(
 		&tchild->child,
 		-1,
 		NULL /* input to terminal is written asynchronously */
 	);
 	/* resources are unlocked at this point */
+	handle_table_put(&g_terminals, terminal);
 }
 
 static int api_terminal_terminated(struct aug_plugin *plugin, const void *terminal) {
 	const struct aug_term_child *tchild;
+	int terminated;
 	(void)(plugin);
 
-	tchild = (const struct aug_term_child *) terminal;
+	if( (tchild = handle_table_get(&g_terminals, terminal) ) == NULL)
+		return 1;
+	terminated = (tchild->terminated != 0);
+	handle_table_put(&g_terminals, terminal);
 	
-	return (tchild->terminated != 0);
+	return terminated;
 }
 
 static int terminal_push_data(struct aug_term *term, 
@@ -719,55 +925,33 @@ static size_t terminal_push_char_data(struct aug_term *term,
 	return i;
 }
 
-#define DO_IF_TCHILD_EXISTS_VAR() \
-	pid_t pid
-
-#define DO_IF_TCHILD_EXISTS_PRE(tchild_ptr) \
-	child_lock(&(tchild_ptr)->child); \
-	pid = (tchild_ptr)->child.pid; \
-	child_unlock(&(tchild_ptr)->child); \
-	/* lock the table to prevent this child from \
-	 * being deleted while we are using it */ \
-	AUG_LOCK(&g_tchild_table); \
-	/* its possible this child got deleted while we  \
-	 * were waiting for tchild_table to unlock. test whether \
-	 * we can find the child in the table */ \
-	if(avl_lookup(g_tchild_table.tree, (void *) pid) == NULL) \
-		goto table_unlock; \
-	child_lock(&(tchild_ptr)->child)
-
-
-#define DO_IF_TCHILD_EXISTS_SUF(tchild_ptr, result) \
-	child_unlock(&(tchild_ptr)->child); \
-table_unlock: \
-	AUG_UNLOCK(&g_tchild_table); \
-	return result
-
 static size_t terminal_input(struct aug_plugin *plugin, void *terminal, 
 		const void *data, int is_char_data, int n) {
 	size_t amt;	
 	struct aug_term_child *tchild;
-	DO_IF_TCHILD_EXISTS_VAR();
 
 	(void)(plugin);
 
-	tchild = (struct aug_term_child *) terminal;
-	amt = 0;
+	/* the terminal may have been deleted already */
+	if( (tchild = handle_table_get(&g_terminals, terminal) ) == NULL)
+		return 0;
 
-	DO_IF_TCHILD_EXISTS_PRE(tchild);
-	/* only if tchild still exists after locking */
-		if(is_char_data != 0)
-			amt = terminal_push_char_data(tchild->child.term, data, n);
-		else
-			amt = terminal_push_data(tchild->child.term, data, n);
-	
-		if(amt > 0) {
-			child_process_term_output(&tchild->child);
-			child_refresh(&tchild->child);
-			child_got_input(&tchild->child);
-		}
-	/* end */
-	DO_IF_TCHILD_EXISTS_SUF(tchild, amt); /* returns amt */
+	child_lock(&tchild->child);
+	if(is_char_data != 0)
+		amt = terminal_push_char_data(tchild->child.term, data, n);
+	else
+		amt = terminal_push_data(tchild->child.term, data, n);
+
+	if(amt > 0) {
+		child_process_term_output(&tchild->child);
+		child_got_input(&tchild->child);
+		/* the terminal thread refreshes when it wakes up */
+		child_wakeup(&tchild->child);
+	}
+	child_unlock(&tchild->child);
+
+	handle_table_put(&g_terminals, terminal);
+	return amt;
 }
 
 static size_t api_terminal_input(struct aug_plugin *plugin, void *terminal, 
@@ -782,16 +966,14 @@ static size_t api_terminal_input_chars(struct aug_plugin *plugin, void *terminal
 
 static void api_terminal_refresh(struct aug_plugin *plugin, void *terminal) {
 	struct aug_term_child *tchild;
-	DO_IF_TCHILD_EXISTS_VAR();
 	(void)(plugin);
 
-	tchild = (struct aug_term_child *) terminal;
+	if( (tchild = handle_table_get(&g_terminals, terminal) ) == NULL)
+		return;
+
+	child_wakeup(&tchild->child);
 
-	DO_IF_TCHILD_EXISTS_PRE(tchild);
-	/* only executes if tchild still exists after locking */
-		child_refresh(&tchild->child);
-	/* end */
-	DO_IF_TCHILD_EXISTS_SUF(tchild,); /* returns nothing */
+	handle_table_put(&g_terminals, terminal);
 }
 
 static size_t primary_input(struct aug_plugin *plugin, const void *data, 
@@ -801,7 +983,7 @@ static size_t primary_input(struct aug_plugin *plugin, const void *data,
 
 	/* this will invoke the configured lock callback,
 	 * so theres no need to explicity lock anything else here.
-	 * (see main() ). */
+	 * the main loop refreshes once it wakes up (see main() ). */
 	child_lock(&g_child);
 
 	if(is_char_data != 0)
@@ -811,8 +993,8 @@ static size_t primary_input(struct aug_plugin *plugin, const void *data,
 
 	if(amt > 0) {
 		child_process_term_output(&g_child);
-		child_refresh(&g_child);
 		child_got_input(&g_child);
+		child_wakeup(&g_child);
 	}
 
 	child_unlock(&g_child);
@@ -832,9 +1014,31 @@ static size_t api_primary_input_chars(struct aug_plugin *plugin,
 static void api_primary_refresh(struct aug_plugin *plugin) {
 	(void)(plugin);
 
-	child_lock(&g_child);
-	child_refresh(&g_child);
-	child_unlock(&g_child);
+	child_wakeup(&g_child);
+}
+
+static void read_counters(struct aug_counters *counters) {
+	counters_read(counters);
+	counters->primary_pty_bytes = child_bytes_read(&g_child);
+}
+
+static void api_counters(struct aug_plugin *plugin, struct aug_counters *counters) {
+	(void)(plugin);
+
+	read_counters(counters);
+}
+
+static uint64_t api_terminal_pty_bytes(struct aug_plugin *plugin, const void *terminal) {
+	const struct aug_term_child *tchild;
+	uint64_t n;
+	(void)(plugin);
+
+	if( (tchild = handle_table_get(&g_terminals, terminal) ) == NULL)
+		return 0;
+	n = child_bytes_read(&tchild->child);
+	handle_table_put(&g_terminals, terminal);
+
+	return n;
 }
 
 /* =================== end API functions ==================== */
@@ -845,6 +1049,7 @@ int aug_cell_update(int rows, int cols, int *row, int *col,
 		wchar_t *wch, attr_t *attr, int *color_pair) {
 	struct aug_plugin_item *i;
 	aug_action action;
+	uint64_t trace;
 
 	if(g_plugins_initialized != true)
 		return 0;
@@ -854,11 +1059,14 @@ int aug_cell_update(int rows, int cols, int *row, int *col,
 			continue;
 
 		action = AUG_ACT_OK;
+		counters_add(AUG_COUNTER_CALLBACKS, 1);
+		trace = trace_begin();
 		(*(i->plugin.callbacks->cell_update))(
 			rows, cols, row, col, 
 			wch, attr, color_pair,
 			&action, i->plugin.callbacks->user
 		);
+		trace_end(AUG_TRACE_PLUGIN_CB, "cell_update", trace, 0);
 
 		if(action == AUG_ACT_CANCEL) /* plugin wants to filter this cell update */
 			return -1;
@@ -870,6 +1078,7 @@ int aug_cell_update(int rows, int cols, int *row, int *col,
 int aug_pre_scroll(int rows, int cols, int direction) {
 	struct aug_plugin_item *i;
 	aug_action action;
+	uint64_t trace;
 
 	if(g_plugins_initialized != true)
 		return 0;
@@ -879,10 +1088,13 @@ int aug_pre_scroll(int rows, int cols, int direction) {
 			continue;
 
 		action = AUG_ACT_OK;
+		counters_add(AUG_COUNTER_CALLBACKS, 1);
+		trace = trace_begin();
 		(*(i->plugin.callbacks->pre_scroll))(
 			rows, cols, direction,
 			&action, i->plugin.callbacks->user
 		);
+		trace_end(AUG_TRACE_PLUGIN_CB, "pre_scroll", trace, 0);
 
 		/* plugin wants to prevent scrolling, and cause a complete redraw of the screen */
 		if(action == AUG_ACT_CANCEL) 
@@ -895,6 +1107,7 @@ int aug_pre_scroll(int rows, int cols, int direction) {
 int aug_post_scroll(int rows, int cols, int direction) {
 	struct aug_plugin_item *i;
 	aug_action action;
+	uint64_t trace;
 
 	if(g_plugins_initialized != true)
 		return 0;
@@ -904,10 +1117,13 @@ int aug_post_scroll(int rows, int cols, int direction) {
 			continue;
 
 		action = AUG_ACT_OK;
+		counters_add(AUG_COUNTER_CALLBACKS, 1);
+		trace = trace_begin();
 		(*(i->plugin.callbacks->post_scroll))(
 			rows, cols, direction,
 			&action, i->plugin.callbacks->user
 		);
+		trace_end(AUG_TRACE_PLUGIN_CB, "post_scroll", trace, 0);
 
 		if(action == AUG_ACT_CANCEL) /* plugin wants to filter this post scroll event */
 			return -1;
@@ -920,6 +1136,7 @@ int aug_cursor_move(int rows, int cols, int old_row, int old_col,
 		int *new_row, int *new_col) {
 	struct aug_plugin_item *i;
 	aug_action action;
+	uint64_t trace;
 
 	if(g_plugins_initialized != true)
 		return 0;
@@ -929,11 +1146,14 @@ int aug_cursor_move(int rows, int cols, int old_row, int old_col,
 			continue;
 
 		action = AUG_ACT_OK;	
+		counters_add(AUG_COUNTER_CALLBACKS, 1);
+		trace = trace_begin();
 		(*(i->plugin.callbacks->cursor_move))(
 			rows, cols, old_row, 
 			old_col, new_row, new_col,
 			&action, i->plugin.callbacks->user
 		);
+		trace_end(AUG_TRACE_PLUGIN_CB, "cursor_move", trace, 0);
 
 		if(action == AUG_ACT_CANCEL) /* plugin wants to filter this cursor move */
 			return -1;
@@ -945,6 +1165,7 @@ int aug_cursor_move(int rows, int cols, int old_row, int old_col,
 /* this function isnt used outside this file, unlike the other callbacks */
 static void aug_screen_dims_change(int rows, int cols) {
 	struct aug_plugin_item *i;
+	uint64_t trace;
 
 	if(g_plugins_initialized != true)
 		return;
@@ -953,12 +1174,23 @@ static void aug_screen_dims_change(int rows, int cols) {
 		if(i->plugin.callbacks == NULL || i->plugin.callbacks->screen_dims_change == NULL)
 			continue;
 		
+		counters_add(AUG_COUNTER_CALLBACKS, 1);
+		trace = trace_begin();
 		(*(i->plugin.callbacks->screen_dims_change))(rows, cols, i->plugin.callbacks->user);
+		trace_end(AUG_TRACE_PLUGIN_CB, "screen_dims_change", trace, 0);
 	}
 }
 
-void aug_primary_term_dims_change(int rows, int cols) {
+/* @term is the terminal which was resized. if it is g_term, 
+ * g_term is locked. */
+void aug_primary_term_dims_change(const struct aug_term *term, int rows, int cols) {
 	struct aug_plugin_item *i;
+	uint64_t trace;
+
+	/* recorded right away rather than along with whatever the
+	 * child writes next, which may be a long time coming */
+	if(term == &g_term && g_recording != 0)
+		record_resize(&g_recorder, rows, cols);
 
 	if(g_plugins_initialized != true) {
 		fprintf(stderr, "primary dims change cb: plugins not initialized\n");
@@ -969,30 +1201,38 @@ void aug_primary_term_dims_change(int rows, int cols) {
 		if(i->plugin.callbacks == NULL || i->plugin.callbacks->primary_term_dims_change == NULL)
 			continue;
 		
+		counters_add(AUG_COUNTER_CALLBACKS, 1);
+		trace = trace_begin();
 		(*(i->plugin.callbacks->primary_term_dims_change))(rows, cols, i->plugin.callbacks->user);
+		trace_end(AUG_TRACE_PLUGIN_CB, "primary_term_dims_change", trace, 0);
 	}
 }
 
 /* == end callbacks == */
 
+/* the layout of the windows changed, but not the screen size */
 static void resize_and_redraw_screen() {
-	screen_clear();
-	screen_resize();
+	screen_relayout();
 	screen_redraw_term_win();
-	panel_stack_update();
-	screen_doupdate();
+	request_frame();
+}
+
+static void fill_sigs(sigset_t *sigset, int chld) {
+	if(sigemptyset(sigset) != 0) 
+		err_exit(errno, "sigemptyset failed"); 
+	if(sigaddset(sigset, SIGWINCH) != 0) 
+		err_exit(errno, "sigaddset failed");
+	if(chld != 0 && sigaddset(sigset, SIGCHLD) != 0) 
+		err_exit(errno, "sigaddset failed");
+	if(sigaddset(sigset, SIGUSR1) != 0) 
+		err_exit(errno, "sigaddset failed");
 }
 
 static void change_sigs(int how) {
 	sigset_t sigset;
 	int s;
 
-	if(sigemptyset(&sigset) != 0) 
-		err_exit(errno, "sigemptyset failed"); 
-	if(sigaddset(&sigset, SIGWINCH) != 0) 
-		err_exit(errno, "sigaddset failed");
-	if(sigaddset(&sigset, SIGCHLD) != 0) 
-		err_exit(errno, "sigaddset failed");
+	fill_sigs(&sigset, 1);
 
 	/* im pretty sure we arent supposed to touch
 	 * sigprocmask in multithreaded context.
@@ -1014,26 +1254,26 @@ static inline void unblock_sigs() {
 
 /* signal strategy: as is generally recommended, all threads 
  * (including the main thread) will block all relevant signals
- * (in our case just CHLD and WINCH) and the signal handling 
- * shall be done with a dedicated thread which invokes the
- * sigwait function. thus plugins should never unblock 
- * CHLD or WINCH and handling other signals may be a bad idea
- * too.
+ * (in our case CHLD, WINCH and USR1). where signalfd is available
+ * the main event loop reads them from g_proc_events along with 
+ * the exits of child processes (through pidfds, so SIGCHLD is 
+ * left pending). otherwise the signal handling shall be done 
+ * with a dedicated thread per signal which invokes the
+ * sigwait function. either way the handlers run with nothing
+ * locked. plugins should never unblock CHLD, WINCH or USR1 and 
+ * handling other signals may be a bad idea too.
  */
-static void handler_winch() {
+static void resize_for_winch() {
 	int rows, cols;
 
-	fprintf(stderr, "handler_winch: enter\n");
 	AUG_LOCK(&g_region_map);
 	lock_all(); /* need locks on screen, term, and region_map */
-	
-	fprintf(stderr, "handler_winch: locked all\n");
 
 	vterm_screen_flush_damage(vterm_obtain_screen(g_term.vt) );
 
 	/* in case curses installed a winch handler */
 	if(g_prev_winch_act.sa_handler != NULL) {
-		fprintf(stderr, "call previous winch handler\n");
+		AUG_LOG(AUG_LOG_DEBUG, "winch", "call previous winch handler\n");
 		(*g_prev_winch_act.sa_handler)(SIGWINCH);
 	}
 
@@ -1048,16 +1288,109 @@ static void handler_winch() {
 
 	unlock_all();
 	AUG_UNLOCK(&g_region_map);
-	fprintf(stderr, "handler_winch: unlocked all\n");
+	/* the terminal window was only damaged, have the
+	 * main loop paint it. */
+	child_wakeup(&g_child);
+}
+
+/* a drag on the edge of the outer terminal produces a burst
+ * of SIGWINCH. the resize waits until there hasnt been another
+ * one for AUG_WINCH_SETTLE usecs (but not longer than AUG_WINCH_MAX
+ * after the first one) and then goes straight to whatever the 
+ * size is by then. only the thread handling signals uses this. */
+#define AUG_WINCH_SETTLE 30000
+#define AUG_WINCH_MAX 150000
+static struct {
+	int pending;
+	struct timeval first;
+	struct timeval last;
+} g_winch = {0, {0, 0}, {0, 0}};
+
+static void winch_note() {
+	struct timeval now;
+
+	if(gettimeofday(&now, NULL) != 0)
+		err_exit(errno, "gettimeofday failed");
+
+	if(g_winch.pending == 0) {
+		g_winch.pending = 1;
+		g_winch.first = now;
+	}
+	g_winch.last = now;
+}
+
+/* returns 1 if the pending resize should happen now. 
+ * otherwise stores how much longer to wait in @wait. */
+static int winch_due(struct timeval *wait) {
+	struct timeval now, settle, max, due;
+
+	if(gettimeofday(&now, NULL) != 0)
+		err_exit(errno, "gettimeofday failed");
+
+	settle.tv_sec = 0;
+	settle.tv_usec = AUG_WINCH_SETTLE;
+	max.tv_sec = 0;
+	max.tv_usec = AUG_WINCH_MAX;
+	timeradd(&g_winch.last, &settle, &settle);
+	timeradd(&g_winch.first, &max, &max);
+	due = timercmp(&settle, &max, <)? settle : max;
+
+	if(!timercmp(&now, &due, <) )
+		return 1;
+
+	timersub(&due, &now, wait);
+	return 0;
+}
+
+/* handler for SIGWINCH when it comes from a signal thread. */
+static void handler_winch() {
+	struct timeval wait;
+	sigset_t set, pending;
+	int signum;
+
+	if(sigemptyset(&set) != 0 || sigaddset(&set, SIGWINCH) != 0)
+		err_exit(errno, "failed to make signal set");
+
+	winch_note();
+	while(winch_due(&wait) == 0) {
+		usleep(wait.tv_sec*1000000 + wait.tv_usec);
+		if(sigpending(&pending) != 0)
+			err_exit(errno, "sigpending failed");
+		if(sigismember(&pending, SIGWINCH) == 1) {
+			/* wont block */
+			if(sigwait(&set, &signum) == 0)
+				winch_note();
+		}
+	}
+
+	g_winch.pending = 0;
+	resize_for_winch();
+}
+
+/* g_tchild_table must be locked */
+static void reaped_child(pid_t pid) {
+	struct aug_term_child *tchild;
+
+	if(pid == g_child.pid) {
+		fprintf(stderr, "reaped primary child at pid %d\n", pid);
+		return;
+	}
 
-	fprintf(stderr, "handler_winch: exit\n");
+	BUILD_ASSERT( sizeof(void *) >= sizeof(pid_t) );
+	tchild = avl_lookup(g_tchild_table.tree, (void *) pid);
+	if(tchild == NULL) {
+		fprintf(stderr, "warning: reaped unknown child at pid %d\n", pid);
+		return;
+	}
+	fprintf(stderr, "reaped child at pid %d\n", pid);
+	tchild->terminated = 1;	
 }
 
-/* handler for SIGCHLD. */
+/* handler for SIGCHLD. only used if children cant be
+ * watched through g_proc_events. */
 static void handler_chld() {
 	pid_t pid;
 	int status;
-	struct aug_term_child *tchild;
 
 	fprintf(stderr, "handler_chld: enter\n");
 
@@ -1066,19 +1399,7 @@ static void handler_chld() {
 		if(!WIFEXITED(status) && !WIFSIGNALED(status) ) 
 			continue;
 		
-		if(pid == g_child.pid) {
-			fprintf(stderr, "reaped primary child at pid %d\n", pid);
-			continue;
-		}
-
-		BUILD_ASSERT( sizeof(void *) >= sizeof(pid_t) );
-		tchild = avl_lookup(g_tchild_table.tree, (void *) pid);
-		if(tchild == NULL) {
-			fprintf(stderr, "warning: reaped unknown child at pid %d\n", pid);
-			continue;
-		}
-		fprintf(stderr, "reaped child at pid %d\n", pid);
-		tchild->terminated = 1;	
+		reaped_child(pid);
 	}
 	AUG_UNLOCK(&g_tchild_table);
 
@@ -1089,12 +1410,107 @@ static void handler_chld() {
 	fprintf(stderr, "handler_chld: exit\n");
 }
 
+/* handler for SIGUSR1: write out the lock profile */
+static void fprint_mem_report(FILE *f) {
+	struct aug_buf_pool_stats bufs;
+	size_t n, bytes;
+
+	slab_stats(&g_tchild_slab, &n, &bytes);
+	fprintf(f, "terminals: %zu using %zu bytes of slab pages "
+			"(%zu bytes per terminal struct)\n", n, bytes, sizeof(struct aug_term_child));
+	child_bufs_stats(&bufs);
+	fprintf(f, "child I/O buffers: %zu lent (peak %zu), %zu idle, %zu bytes\n",
+		bufs.n_lent, bufs.peak_lent, bufs.n_idle, bufs.bytes);
+}
+
+static void fprint_log_report(FILE *f) {
+	struct aug_log_stats stats;
+
+	log_stats(&stats);
+	fprintf(f, "log: %llu messages written, %llu suppressed, %llu dropped\n",
+		(unsigned long long) stats.written, (unsigned long long) stats.suppressed,
+		(unsigned long long) stats.dropped);
+}
+
+static void fprint_frame_report(FILE *f) {
+	struct aug_frame frame;
+	struct aug_panel_stack_stats panels;
+	struct timeval now;
+
+	if(gettimeofday(&now, NULL) != 0)
+		err_exit(errno, "gettimeofday failed");
+
+	AUG_LOCK(&g_screen);
+	frame = g_screen.frame;
+	panel_stack_stats(&panels);
+	AUG_UNLOCK(&g_screen);
+
+	fprintf(f, "frames: %lu requested, %lu flushed (%lu per second)\n",
+		frame.requests, frame.flushes, frame_rate(&frame, &now) );
+	fprintf(f, "outer terminal: congestion %d, %lu flushes held off\n",
+		frame.congestion, frame.deferrals);
+	fprintf(f, "panels: %lu rows culled, %lu panels redrawn in full\n",
+		panels.culled_rows, panels.redrawn);
+}
+
+/* doesnt lock anything, so it is safe to call from any thread */
+static void fprint_counters(FILE *f) {
+	struct aug_counters counters;
+
+	read_counters(&counters);
+	counters_fprint(f, &counters);
+}
+
+static void write_trace() {
+	struct aug_trace_stats stats;
+
+	trace_stats(&stats);
+	if(trace_dump_path(g_conf.trace) != 0)
+		err_warn(errno, "failed to write trace to %s", g_conf.trace);
+	else
+		fprintf(stderr, "trace: wrote %llu events from %d threads to %s "
+				"(%llu overwritten)\n", 
+			(unsigned long long) (stats.recorded - stats.overwritten), 
+			stats.threads, g_conf.trace, (unsigned long long) stats.overwritten);
+}
+
+/* handler for SIGUSR1: write out the lock profile, 
+ * memory usage, frame and performance counters and the trace */
+static void handler_usr1() {
+	fprint_mem_report(stderr);
+	fprint_frame_report(stderr);
+	fprint_log_report(stderr);
+	fprint_counters(stderr);
+	if(lock_prof_enabled())
+		lock_prof_dump(stderr);
+	else
+		fprintf(stderr, "lock profiling is off (see --" CONF_LOCK_PROF ")\n");
+	if(g_conf.trace != NULL)
+		write_trace();
+}
+
+/* names the signals handled here in the trace */
+static const char *sig_name(int signum) {
+	switch(signum) {
+	case SIGWINCH:
+		return "SIGWINCH";
+	case SIGCHLD:
+		return "SIGCHLD";
+	case SIGUSR1:
+		return "SIGUSR1";
+	default:
+		return NULL;
+	}
+}
+
 static void *sig_thread(void *user) {
 	struct sigthread_desc *desc;
 	int s, signum;
 	sigset_t set;
+	uint64_t trace;
 
 	desc = (struct sigthread_desc *) user;
+	trace_thread_name(sig_name(desc->signum));
 	if(sigemptyset(&set) != 0)
 		err_exit(errno, "sigemptyset failed");
 	if(sigaddset(&set, desc->signum) != 0)
@@ -1124,8 +1540,12 @@ static void *sig_thread(void *user) {
 				err_exit(s, "sigwait on "
 						"signal %d failed", desc->signum);
 		}
-		else
+		else {
+			trace = trace_begin();
 			(*desc->fn)();
+			trace_end(AUG_TRACE_SIGNAL, sig_name(desc->signum), trace, 
+				desc->signum);
+		}
 	}
 
 	return NULL;
@@ -1144,6 +1564,11 @@ static void start_sig_threads() {
 	g_winch_thread.fn = handler_winch;
 	AUG_LOCK_INIT(&g_winch_thread);
 
+	g_usr1_thread.signum = SIGUSR1;
+	g_usr1_thread.waiting = 0;
+	g_usr1_thread.fn = handler_usr1;
+	AUG_LOCK_INIT(&g_usr1_thread);
+
 	s = pthread_create(&g_chld_thread.tid, NULL, sig_thread, &g_chld_thread);
 	if(s != 0)
 		err_exit(s, "failed to create SIGCHLD thread");
@@ -1152,6 +1577,89 @@ static void start_sig_threads() {
 	if(s != 0)
 		err_exit(s, "failed to create SIGWINCH thread");
 
+	s = pthread_create(&g_usr1_thread.tid, NULL, sig_thread, &g_usr1_thread);
+	if(s != 0)
+		err_exit(s, "failed to create SIGUSR1 thread");
+
+}
+
+static void proc_events_on_signal(int signum, void *user) {
+	uint64_t trace;
+	(void)(user);
+
+	trace = trace_begin();
+	switch(signum) {
+	case SIGWINCH:
+		winch_note();
+		break;
+	case SIGCHLD:
+		handler_chld();
+		break;
+	case SIGUSR1:
+		handler_usr1();
+		break;
+	default:
+		err_warn(0, "unexpected signal %d", signum);
+	}
+	trace_end(AUG_TRACE_SIGNAL, sig_name(signum), trace, signum);
+}
+
+static void proc_events_on_exit(pid_t pid, int status, void *user) {
+	(void)(status);
+	(void)(user);
+
+	AUG_LOCK(&g_tchild_table);
+	reaped_child(pid);
+	AUG_UNLOCK(&g_tchild_table);
+}
+
+/* called by child_io_loop with nothing locked */
+static void main_on_events(void *user) {
+	struct timeval wait;
+	(void)(user);
+
+	proc_events_dispatch(&g_proc_events, proc_events_on_signal, 
+		proc_events_on_exit, NULL);
+
+	if(g_winch.pending == 0)
+		return;
+	if(winch_due(&wait) != 0) {
+		g_winch.pending = 0;
+		resize_for_winch();
+	}
+	else /* come back once the burst has settled */
+		child_set_event_timer(&g_child, &wait);
+}
+
+/* signals must be blocked already. if this fails we fall 
+ * back to the signal threads. */
+static void start_proc_events() {
+	sigset_t set;
+
+	/* find out if SIGCHLD is needed first */
+	fill_sigs(&set, 0);
+	if(proc_events_init(&g_proc_events, &set) != 0) {
+		fprintf(stderr, "no signalfd (%s), using signal threads\n", strerror(errno));
+		return;
+	}
+	if(g_proc_events.pidfds == 0) {
+		proc_events_free(&g_proc_events);
+		fill_sigs(&set, 1);
+		if(proc_events_init(&g_proc_events, &set) != 0)
+			err_exit(errno, "failed to set up signalfd");
+		fprintf(stderr, "no pidfds, reaping children on SIGCHLD\n");
+	}
+
+	g_proc_events_on = 1;
+}
+
+/* have the main event loop reap child @pid when it exits */
+static void watch_child(pid_t pid) {
+	if(g_proc_events_on == 0 || g_proc_events.pidfds == 0)
+		return;
+
+	if(proc_events_watch(&g_proc_events, pid) != 0)
+		err_exit(errno, "failed to watch child at pid %d", pid);
 }
 
 #define AUG_STOP_SIG_THREAD(s, desc_ptr) \
@@ -1182,6 +1690,11 @@ void stop_winch_thread() {
 	AUG_STOP_SIG_THREAD(s, &g_winch_thread);
 }
 
+void stop_usr1_thread() {
+	int s;
+	AUG_STOP_SIG_THREAD(s, &g_usr1_thread);
+}
+
 /* all resources should be locked during this function */
 static void push_key(struct aug_term *term, uint32_t ch) {
 	struct aug_plugin_item *i;
@@ -1196,6 +1709,7 @@ static void push_key(struct aug_term *term, uint32_t ch) {
 		action = AUG_ACT_OK;
 		inject.chars = NULL;
 		inject.len = 0;
+		counters_add(AUG_COUNTER_CALLBACKS, 1);
 		(*(i->plugin.callbacks->input_char))(&ch, &action, &inject, i->plugin.callbacks->user);
 
 		/* plugin wants to filter this character. if inject is not
@@ -1210,53 +1724,237 @@ static void push_key(struct aug_term *term, uint32_t ch) {
 	term_push_char(term, ch);
 }
 
+/* hand a completed bracketed paste to the plugins and then
+ * queue the whole thing to be written to the primary child. */
+static void push_paste(const char *data, size_t len) {
+	struct aug_plugin_item *i;
+	aug_action action;
+
+	PLUGIN_LIST_FOREACH(&g_plugin_list, i) {
+		if(i->plugin.callbacks == NULL || i->plugin.callbacks->paste == NULL)
+			continue;
+
+		action = AUG_ACT_OK;
+		counters_add(AUG_COUNTER_CALLBACKS, 1);
+		(*(i->plugin.callbacks->paste))(data, len, &action, i->plugin.callbacks->user);
+		if(action == AUG_ACT_CANCEL)
+			return;
+	}
+
+	/* keys typed before the paste are still sitting in
+	 * the vterm output buffer, they have to go first. 
+	 * note: we dont know whether the child turned on 
+	 * bracketed paste mode, so the markers are not
+	 * passed along. */
+	child_process_term_output(&g_child);
+	child_queue_write(&g_child, data, len);
+}
+
+/* get the next key that isnt part of a bracketed paste. 
+ * pastes are sent off to push_paste as they complete. 
+ * returns non-zero if there is no more input right now. */
+static int next_key(uint32_t *ch) {
+	uint32_t input;
+
+	while(paste_key(&g_paste, ch) != 0) {
+		if(screen_getch(&input) != 0) {
+			/* no more input. if we were in the middle of
+			 * matching a start marker, those were just keys. */
+			if(paste_release(&g_paste) != 0)
+				return -1;
+			continue;
+		}
+
+		if(paste_feed(&g_paste, input) == 1) {
+			push_paste(g_paste.buf, g_paste.len);
+			paste_clear(&g_paste);
+		}
+	}
+
+	return 0;
+}
+
+/* number of bytes of room in the vterm output buffer needed
+ * to pass through the longest key sequence (utf-8 encoded). */
+#define AUG_KEY_ROOM ( (AUG_KEYMAP_MAX_SEQ + 1) * 4 )
+
+static int command_pending() {
+	int pending;
+
+	AUG_LOCK(&g_cmd);
+	pending = g_cmd.pending;
+	AUG_UNLOCK(&g_cmd);
+
+	return pending;
+}
+
+/* runs on g_cmd_pool with no locks held by the caller */
+static void run_command(void *user) {
+	aug_on_key_fn on_key;
+	void *on_key_user;
+	uint64_t trace;
+	(void)(user);
+
+	trace_thread_name("commands");
+	/* keep the plugin from being unloaded underneath us */
+	AUG_LOCK(&g_free_plugin_lock);
+	/* the binding may have been removed since the keys were 
+	 * typed, in which case the plugin may be gone. */
+	on_key = NULL;
+	AUG_RDLOCK(&g_keymap);
+	keymap_binding_seq(&g_keymap, g_cmd.keys, g_cmd.len, &on_key, &on_key_user);
+	AUG_RWUNLOCK(&g_keymap);
+
+	if(on_key == g_cmd.on_key && on_key_user == g_cmd.user) {
+		counters_add(AUG_COUNTER_CALLBACKS, 1);
+		trace = trace_begin();
+		(*on_key)(g_cmd.ch, on_key_user);
+		trace_end(AUG_TRACE_PLUGIN_CB, "on_key", trace, g_cmd.ch);
+	}
+	AUG_UNLOCK(&g_free_plugin_lock);
+
+	AUG_LOCK(&g_cmd);
+	g_cmd.pending = 0;
+	AUG_UNLOCK(&g_cmd);
+	/* let the I/O thread pick up the input it held back */
+	child_wakeup(&g_child);
+}
+
+/* hand the command in g_key_state to g_cmd_pool. */
+static void dispatch_command() {
+	assert(g_key_state.len <= AUG_KEYMAP_MAX_SEQ);
+
+	AUG_LOCK(&g_cmd);
+	assert(g_cmd.pending == 0);
+	g_cmd.pending = 1;
+	AUG_UNLOCK(&g_cmd);
+
+	g_cmd.on_key = g_key_state.on_key;
+	g_cmd.user = g_key_state.user;
+	g_cmd.ch = g_key_state.ch;
+	memcpy(g_cmd.keys, g_key_state.keys, sizeof(uint32_t) * g_key_state.len);
+	g_cmd.len = g_key_state.len;
+	worker_pool_push(&g_cmd_pool, run_command, NULL);
+}
+
+/* act on the result of feeding a key into the key sequence 
+ * state machine */
+static void key_result(struct aug_term *term, enum keymap_result result) {
+	size_t i;
+	uint64_t trace;
+
+	switch(result) {
+	case KEYMAP_COMMAND:
+		if(g_key_state.flags & AUG_KEY_SYNC) {
+			/* note: sigs should still be blocked */
+			counters_add(AUG_COUNTER_CALLBACKS, 1);
+			trace = trace_begin();
+			(*g_key_state.on_key)(g_key_state.ch, g_key_state.user);
+			trace_end(AUG_TRACE_PLUGIN_CB, "on_key", trace, g_key_state.ch);
+		}
+		else
+			dispatch_command();
+		break;
+	case KEYMAP_PASS:
+		/* not a bound sequence, so pass it through. */
+		push_key(term, g_conf.cmd_key);
+		for(i = 0; i < g_key_state.len; i++)
+			push_key(term, g_key_state.keys[i]);
+		break;
+	default:
+		break;
+	}
+}
+
+static void process_key(struct aug_term *term, uint32_t ch, 
+		const struct timeval *now) {
+
+	if(keymap_active(&g_key_state) ) {
+		AUG_LOG(AUG_LOG_DEBUG, "keymap", "check for command extension 0x%02x\n", ch);
+		key_result(term, keymap_feed(&g_keymap, &g_key_state, ch, now) );
+		/* if @ch wasnt part of the sequence we still have to handle it */
+		if(g_key_state.again == 0)
+			return;
+		/* ...but not before the command it ended has run */
+		if(command_pending() ) {
+			g_cmd.has_next = 1;
+			g_cmd.next = ch;
+			return;
+		}
+	}
+
+	if(ch == g_conf.cmd_key)
+		keymap_start(&g_keymap, &g_key_state, now);
+	else
+		push_key(term, ch);
+}
+
+/* called by child_io_loop with only the primary child locked */
 static int process_keys(struct aug_term *term, int fd_input, void *user) {
 	uint32_t ch;
-	int space;
-	static bool command_key = false;
-	aug_on_key_fn command_fn;
-	void *key_user;
+	struct timeval now, left;
+	enum keymap_result result;
 	
 	(void)(fd_input);
 	(void)(user);
 
-	while( (space = term_can_push_chars(term)) > 0) {
+	/* the loop can stop before it reads the clock, and the
+	 * input timer below still needs the time. */
+	if(gettimeofday(&now, NULL) != 0)
+		err_exit(errno, "gettimeofday failed");
+
+	lock_all_read();
+	while(1) {
+		/* input that follows a command has to wait until
+		 * the command is done. */
+		if(command_pending() ) {
+			child_hold_input(&g_child, 1);
+			child_set_input_timer(&g_child, NULL);
+			goto unlock;
+		}
+		child_hold_input(&g_child, 0);
+
+		/* a passed through key sequence is pushed all at once */
+		if(term_can_push_chars(term) < AUG_KEY_ROOM) {
+			/* move what vterm has already encoded into the 
+			 * write queue to make room for more input. */
+			child_process_term_output(&g_child);
+			if(term_can_push_chars(term) < AUG_KEY_ROOM)
+				break;
+		}
 
 		if(!term_inject_empty(term)) {
 			term_inject_push(term);
+			continue;
 		}
-		else if(space > 1 && screen_getch(&ch) == 0 ) {
-			/* we need at least two spots in the buffer because in 'pass through' 
-			 * command prefix mode we will send both the command key and the following
-			 * key at the same time after finding a non-command */
-
-			if(command_key == true) { /* treat *ch* as a command extension */
-				fprintf(stderr, "check for command extension 0x%02x\n", ch);
-				keymap_binding(&g_keymap, ch, &command_fn, &key_user);
-				if(command_fn == NULL) { /* this is not a bound key */
-					push_key(term, g_conf.cmd_key);
-					push_key(term, ch);
-				}
-				else { /* invoke the command */
-					/* note: sigs should still be blocked */
-					(*command_fn)(ch, key_user);
-				}
-				command_key = false;
-			}
-			else if(ch == g_conf.cmd_key) {
-				command_key = true;	
-			}
-			else {
-				push_key(term, ch);
-			}
+
+		if(gettimeofday(&now, NULL) != 0)
+			err_exit(errno, "gettimeofday failed");
+
+		if(g_cmd.has_next != 0) {
+			g_cmd.has_next = 0;
+			process_key(term, g_cmd.next, &now);
 		}
-		else { 
-			/* inject is empty, but we can only push one character 
-			 * or screen_getch has no data to return */
-			break;
+		else if( (result = keymap_expire(&g_keymap, &g_key_state, &now)) != KEYMAP_NONE) 
+			key_result(term, result);
+		else if(next_key(&ch) == 0) {
+			counters_add(AUG_COUNTER_INPUT_KEYS, 1);
+			if(g_conf.record != NULL)
+				record_input(&g_recorder, ch);
+			process_key(term, ch, &now);
 		}
+		else /* there is no more input */
+			break;
 	}
 
+	/* wake up when the pending key sequence times out */
+	if(keymap_time_left(&g_key_state, &now, &left) == 0)
+		child_set_input_timer(&g_child, &left);
+	else
+		child_set_input_timer(&g_child, NULL);
+
+unlock:
+	unlock_all_read();
 	return 0;
 }
 
@@ -1264,6 +1962,7 @@ static void err_exit_cleanup(int error) {
 	(void)(error);
 
 	screen_cleanup();
+	log_flush();
 }
 
 static int init_conf(int argc, char *argv[]) {
@@ -1517,6 +2216,10 @@ static void init_plugins(struct aug_api *api) {
 	api->callbacks = api_callbacks;
 	api->key_bind = api_key_bind;
 	api->key_unbind = api_key_unbind;
+	api->key_bind_seq = api_key_bind_seq;
+	api->key_unbind_seq = api_key_unbind_seq;
+	api->key_seq_timeout = api_key_seq_timeout;
+	api->key_seq_flags = api_key_seq_flags;
 
 	api->lock_screen = api_lock_screen;
 	api->unlock_screen = api_unlock_screen;
@@ -1541,9 +2244,13 @@ static void init_plugins(struct aug_api *api) {
 	api->terminal_input = api_terminal_input;
 	api->terminal_input_chars = api_terminal_input_chars;
 	api->terminal_refresh = api_terminal_refresh;
+	api->terminal_attach = api_terminal_attach;
+	api->terminal_snapshot = api_terminal_snapshot;
 	api->primary_input = api_primary_input;
 	api->primary_input_chars = api_primary_input_chars;
 	api->primary_refresh = api_primary_refresh;
+	api->counters = api_counters;
+	api->terminal_pty_bytes = api_terminal_pty_bytes;
 
 	PLUGIN_LIST_FOREACH_SAFE(&g_plugin_list, i, next) {
 		fprintf(stderr, "initialize %s...\n", i->plugin.name);
@@ -1567,31 +2274,199 @@ static void free_plugins() {
 	plugin_list_free(&g_plugin_list);
 }
 
+/* ============== sessions and mirrors ============== */
+
+/* what attached clients type is typed into our pty, so it goes
+ * through the keymap the same as it would from a terminal. */
+static void session_on_input(const char *data, size_t len, void *user) {
+	(void)(user);
+
+	session_server_input(&g_server, data, len);
+}
+
+/* we pick up the new size from the SIGWINCH that follows */
+static void session_on_resize(int rows, int cols, void *user) {
+	(void)(user);
+
+	session_server_resize(&g_server, rows, cols);
+}
+
+/* the new client gets the screen with the next refresh */
+static void session_on_attach(void *user) {
+	(void)(user);
+
+	child_wakeup(&g_child);
+}
+
+static void on_screen_damage(VTermRect rect, void *user) {
+	(void)(user);
+
+	if(g_conf.session_socket != NULL)
+		session_damage(&g_session, rect);
+	if(g_conf.mirror != NULL)
+		mirror_damage(&g_mirror, rect);
+}
+
+/* the cell as it is on the screen: the terminal's cell, as the
+ * plugins left it when it was drawn. the screen is locked. */
+static void session_screen_cell(int row, int col, 
+		struct aug_session_cell *cell, void *user) {
+	VTermScreenCell vcell;
+	VTermPos pos;
+
+	pos.row = row;
+	pos.col = col;
+	if( !vterm_screen_get_cell( (VTermScreen *) user, pos, &vcell) )
+		err_exit(0, "get_cell returned false status\n");
+	session_cell_from_vterm(&vcell, cell);
+	screen_term_win_cell(row, col, cell);
+}
+
+/* the primary terminal's child wrote @buf. the child and 
+ * g_term are locked. */
+static void record_on_output(const char *buf, size_t n, void *user) {
+	(void)(user);
+
+	record_output(&g_recorder, buf, n);
+}
+
+static void start_recording() {
+	struct tm tm;
+	time_t now;
+	int rows, cols;
+
+	now = time(NULL);
+	if(localtime_r(&now, &tm) == NULL 
+			|| strftime(g_record_path, sizeof(g_record_path), g_conf.record, &tm) == 0)
+		err_exit(0, "invalid recording path: %s", g_conf.record);
+	/* resizes are recorded from here on (see 
+	 * aug_primary_term_dims_change) */
+	AUG_LOCK(&g_term);
+	term_dims(&g_term, &rows, &cols);
+	if(record_start(&g_recorder, g_record_path, rows, cols) != 0)
+		err_exit(errno, "failed to record to %s", g_record_path);
+	g_recording = 1;
+	AUG_UNLOCK(&g_term);
+	child_set_output_hook(&g_child, record_on_output);
+}
+
+/* send the changes to attached clients and the mirror. 
+ * g_term and the screen must be locked */
+static void publish_frame() {
+	VTermScreen *vts;
+	VTermPos cursor;
+	int rows, cols;
+
+	term_dims(&g_term, &rows, &cols);
+	vterm_state_get_cursorpos(vterm_obtain_state(g_term.vt), &cursor);
+	vts = vterm_obtain_screen(g_term.vt);
+	if(g_conf.session_socket != NULL)
+		session_frame(&g_session, rows, cols, cursor.row, cursor.col, 
+			session_screen_cell, vts);
+	if(g_conf.mirror != NULL)
+		mirror_frame(&g_mirror, rows, cols, cursor.row, cursor.col, 
+			session_screen_cell, vts);
+}
+
 /* ============== MAIN ============================== */
 
+/* parsing output from the primary child only touches g_term */
 static void main_to_lock_for_io(void *user) {
 	(void)(user);
 
-	lock_all();
+	AUG_LOCK(&g_term);
 }
 
 static void main_to_unlock_after_io(void *user) {
 	(void)(user);
 
-	unlock_all();
+	AUG_UNLOCK(&g_term);
 }
 
-static void to_refresh_after_io(void *user) {
+static void main_to_lock_render(void *user) {
 	(void)(user);
 
+	AUG_RDLOCK(&g_plugin_list);
+	AUG_LOCK(&g_screen);
+}
+
+static void main_to_unlock_render(void *user) {
+	(void)(user);
+
+	AUG_UNLOCK(&g_screen);
+	AUG_RWUNLOCK(&g_plugin_list);
+}
+
+/* ask the main loop for a frame. the screen must be locked. */
+static void request_frame() {
+	if(frame_request(&g_screen.frame) != 0)
+		child_wakeup(&g_child);
+	else /* folded into the frame which is already pending */
+		counters_add(AUG_COUNTER_FRAMES_SKIPPED, 1);
+}
+
+/* composite and flush to the outer terminal. only the main
+ * loop does this, with the render resources locked. while the 
+ * outer terminal is congested the flush is held off and 
+ * everything drawn in the meantime goes out in the next one, 
+ * so the loop never blocks on a terminal which cant keep up 
+ * (see frame.h). a held off frame is retried when its hold 
+ * runs out; the primary child is locked (see to_refresh). */
+static void commit_frame() {
+	struct timeval start, now, diff;
+	uint64_t trace, trace_doupdate;
+
+	if(gettimeofday(&start, NULL) != 0)
+		err_exit(errno, "gettimeofday failed");
+	if(!frame_due(&g_screen.frame, &start, screen_output_queued(), 
+			screen_output_writable()) ) {
+		frame_hold_left(&g_screen.frame, &start, &diff);
+		child_set_refresh_timer(&g_child, &diff);
+		counters_add(AUG_COUNTER_FRAMES_DEFERRED, 1);
+		counters_set(AUG_COUNTER_CONGESTION, g_screen.frame.congestion);
+		return;
+	}
+
+	trace = trace_begin();
 	panel_stack_update();
+	trace_doupdate = trace_begin();
 	screen_doupdate();
+	trace_end(AUG_TRACE_DOUPDATE, NULL, trace_doupdate, 0);
+
+	if(gettimeofday(&now, NULL) != 0)
+		err_exit(errno, "gettimeofday failed");
+	frame_flushed(&g_screen.frame, &now);
+	timersub(&now, &start, &diff);
+	frame_drained(&g_screen.frame, &now, screen_output_queued(), 
+		diff.tv_sec*1000000L + diff.tv_usec);
+	counters_add(AUG_COUNTER_FRAMES_RENDERED, 1);
+	counters_set(AUG_COUNTER_CONGESTION, g_screen.frame.congestion);
+	trace_end(AUG_TRACE_FRAME, NULL, trace, g_screen.frame.flushes);
+}
+
+/* the main loop refreshes the primary terminal once per 
+ * iteration (at most), which also takes care of any frame
+ * that was asked for in the meantime */
+static void to_refresh_after_io(void *user) {
+	(void)(user);
+
+	if(g_conf.session_socket != NULL || g_conf.mirror != NULL)
+		publish_frame();
+	commit_frame();
+}
+
+/* a terminal other than the primary one was drawn */
+static void to_request_frame(void *user) {
+	(void)(user);
+
+	request_frame();
 }
 
 int aug_main(int argc, char *argv[]) {
 	struct termios child_termios;
 	struct aug_api api;
 	int rows, cols;
+	pid_t pid;
 
 	switch(init_conf(argc, argv)) { /* 1 */
 	case 0:
@@ -1605,8 +2480,34 @@ int aug_main(int argc, char *argv[]) {
 		return 1;
 	}
 
+	if(g_conf.attach != NULL)
+		return session_attach(g_conf.attach);
+	if(g_conf.view != NULL)
+		return mirror_view(g_conf.view);
+	if(g_conf.play != NULL)
+		return record_play(g_conf.play);
+	/* everything from here on happens in a server of its own, 
+	 * so the terminals outlive this one, which just attaches
+	 * to it. nothing else is running yet, so forking is safe. */
+	if(g_conf.session_socket != NULL) {
+		if( (pid = session_server_fork(&g_server) ) < 0)
+			err_exit(errno, "failed to start the session server");
+		if(pid > 0) {
+			if(session_server_wait(&g_server) != 0) {
+				fprintf(stderr, "the session server failed to start\n");
+				return 1;
+			}
+			return session_attach(g_conf.session_socket);
+		}
+	}
+
 	fprintf(stderr, "configuration:\n");
 	conf_fprint(&g_conf, stderr);
+	if(g_conf.lock_prof)
+		lock_prof_enable(1);
+	trace_thread_name("main");
+	if(g_conf.trace != NULL)
+		trace_enable(1);
 	
 	if(tcgetattr(STDIN_FILENO, &child_termios) != 0) {
 		err_exit(errno, "tcgetattr failed");
@@ -1626,6 +2527,14 @@ int aug_main(int argc, char *argv[]) {
 	 * just before we enter the main I/O loop.
 	 */
 	block_sigs();	
+	start_proc_events();
+	/* the writer thread inherits the blocked signals */
+	log_init();
+	counters_start();
+	/* and so does the stats socket thread */
+	if(g_conf.stats_socket != NULL)
+		if(stats_sock_start(&g_stats_sock, g_conf.stats_socket, fprint_counters) != 0)
+			err_exit(errno, "failed to serve stats on %s", g_conf.stats_socket);
 
 	fprintf(stderr, "initialize primary terminal\n");
 	/* screen will resize term to the right size,
@@ -1642,6 +2551,7 @@ int aug_main(int argc, char *argv[]) {
 		}
 
 	fprintf(stderr, "initialize child process\n");
+	child_bufs_init();
 	child_init(
 		&g_child, 
 		&g_term, 
@@ -1650,21 +2560,34 @@ int aug_main(int argc, char *argv[]) {
 		to_refresh_after_io,
 		main_to_lock_for_io,
 		main_to_unlock_after_io,
+		main_to_lock_render,
+		main_to_unlock_render,
 		&child_termios,
 		NULL
 	);
 	fprintf(stderr, "started primary child at pid %d\n", g_child.pid);
+	watch_child(g_child.pid);
 
 	AUG_LOCK_INIT(&g_screen); /* 4 */
+	frame_init(&g_screen.frame);
 	AUG_LOCK_INIT(&g_free_plugin_lock);
 	/* init keymap structure */
 	keymap_init(&g_keymap); /* 5 */
-
-	objset_init(&g_edgewin_set); /* 6 */
-	region_map_init(); 
+	keymap_state_init(&g_key_state);
+	paste_init(&g_paste);
+	/* one thread, so that commands run in the order they
+	 * were typed. the thread inherits our blocked signals. */
+	g_cmd.pending = 0;
+	g_cmd.has_next = 0;
+	AUG_LOCK_INIT(&g_cmd);
+	worker_pool_init(&g_cmd_pool, 1);
+
+	region_map_init(); /* 6 */
 	AUG_LOCK_INIT(&g_region_map);
 	g_tchild_table.tree = avl_new( (AvlCompare) void_compare );
 	AUG_LOCK_INIT(&g_tchild_table);
+	handle_table_init(&g_terminals);
+	slab_init(&g_tchild_slab, sizeof(struct aug_term_child), AUG_TCHILD_SLAB_PAGE);
 		
 	/* this is first point where api functions can be called
 	 * and locks will be utilized */
@@ -1685,10 +2608,26 @@ int aug_main(int argc, char *argv[]) {
 	screen_dims(&rows, &cols);
 	aug_screen_dims_change(rows, cols);
 	screen_term_win_dims(&rows, &cols);
-	aug_primary_term_dims_change(rows, cols);
+	aug_primary_term_dims_change(&g_term, rows, cols);
 	unlock_all();
 
-	fprintf(stderr, "lock screen\n");
+	if(g_conf.session_socket != NULL) {
+		if(session_start(&g_session, g_conf.session_socket, session_on_input,
+				session_on_resize, session_on_attach, NULL) != 0) 
+			err_exit(errno, "failed to serve the session on %s", g_conf.session_socket);
+		session_server_ready(&g_server);
+	}
+	if(g_conf.mirror != NULL)
+		if(mirror_open(&g_mirror, g_conf.mirror) != 0)
+			err_exit(errno, "failed to publish the mirror at %s", g_conf.mirror);
+	if(g_conf.session_socket != NULL || g_conf.mirror != NULL)
+		screen_set_damage_hook(on_screen_damage, NULL);
+	/* nothing has been read from the child yet, so the 
+	 * recording starts with a blank screen */
+	if(g_conf.record != NULL)
+		start_recording();
+
+	fprintf(stderr, "lock primary terminal\n");
 	/* this calls main_to_lock_for_io. resources will be 
 	 * unlocked in child_io_loop by calling main_to_unlock_for_io.
 	 * this will block signals a second time, but that shouldnt
@@ -1698,9 +2637,14 @@ int aug_main(int argc, char *argv[]) {
 	/* get ncurses SIGWINCH handler */
 	if(sigaction(SIGWINCH, NULL, &g_prev_winch_act) != 0)
 		err_exit(errno, "sigaction failed");
-	start_sig_threads();
+	if(g_proc_events_on != 0)
+		child_set_event_fd(&g_child, proc_events_fd(&g_proc_events), main_on_events);
+	else
+		start_sig_threads();
 
+	main_to_lock_render(NULL);
 	screen_redraw_term_win();
+	main_to_unlock_render(NULL);
 	fprintf(stderr, "start main event loop\n");
 	/* main event loop */	
 	child_io_loop(
@@ -1713,26 +2657,61 @@ int aug_main(int argc, char *argv[]) {
 
 	/* cleanup */
 	/* no longer want to explicitly reap children */
-	stop_chld_thread();
-	stop_winch_thread();
+	if(g_proc_events_on != 0)
+		proc_events_free(&g_proc_events);
+	else {
+		stop_chld_thread();
+		stop_winch_thread();
+		stop_usr1_thread();
+	}
+	if(g_conf.stats_socket != NULL)
+		stats_sock_stop(&g_stats_sock);
+	screen_set_damage_hook(NULL, NULL);
+	if(g_conf.session_socket != NULL)
+		session_stop(&g_session);
+	if(g_conf.mirror != NULL)
+		mirror_close(&g_mirror);
+	if(g_conf.record != NULL) {
+		AUG_LOCK(&g_term);
+		g_recording = 0;
+		AUG_UNLOCK(&g_term);
+		record_stop(&g_recorder);
+	}
+	/* let a running command finish before its plugin goes away */
+	worker_pool_free(&g_cmd_pool);
 	free_plugins(); /* 7 */
 
 	/* plugins should have handled cleanup
 	 * of children processes. (maybe put a warning here?) */
 	avl_free(g_tchild_table.tree);
 	AUG_LOCK_FREE(&g_tchild_table);
+	handle_table_free(&g_terminals);
+	slab_free(&g_tchild_slab);
 
+	screen_free_edgewins();
+	panel_stack_free();
 	region_map_free(); /* 6 */
 	AUG_LOCK_FREE(&g_region_map);
-	objset_clear(&g_edgewin_set);
 
+	AUG_LOCK_FREE(&g_cmd);
+	paste_free(&g_paste);
 	keymap_free(&g_keymap); /* 5 */
 	AUG_LOCK_FREE(&g_free_plugin_lock);
 	AUG_LOCK_FREE(&g_screen); /* 4 */
 	child_free(&g_child);
+	child_bufs_free();
 screen_cleanup:
 	screen_free(); /* 3 */
 	term_free(&g_term); /* 2 */
+
+	/* every other thread is gone by now */
+	if(g_conf.lock_prof)
+		lock_prof_dump(stderr);
+	lock_prof_free();
+	if(g_conf.trace != NULL)
+		write_trace();
+	trace_free();
+	log_free();
 	
 	if(g_ini != NULL) 
 		ciniparser_freedict(g_ini); /* 1 */
@@ -0,0 +1,91 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "buf_pool.h"
+
+#include <stdlib.h>
+#include "util.h"
+
+void buf_pool_init(struct aug_buf_pool *pool, size_t buf_size, size_t max_idle) {
+	if(buf_size < sizeof(void *))
+		buf_size = sizeof(void *);
+
+	pool->buf_size = buf_size;
+	pool->max_idle = max_idle;
+	pool->idle = NULL;
+	pool->n_idle = 0;
+	pool->n_lent = 0;
+	pool->peak_lent = 0;
+	AUG_LOCK_INIT(pool);
+}
+
+void buf_pool_free(struct aug_buf_pool *pool) {
+	void *buf;
+
+	if(pool->n_lent != 0)
+		err_exit(0, "%zu buffers are still lent out", pool->n_lent);
+
+	while( (buf = pool->idle) != NULL) {
+		pool->idle = *(void **) buf;
+		free(buf);
+	}
+	pool->n_idle = 0;
+	AUG_LOCK_FREE(pool);
+}
+
+void *buf_pool_get(struct aug_buf_pool *pool) {
+	void *buf;
+
+	AUG_LOCK(pool);
+	if( (buf = pool->idle) != NULL) {
+		pool->idle = *(void **) buf;
+		pool->n_idle--;
+	}
+	pool->n_lent++;
+	if(pool->n_lent > pool->peak_lent)
+		pool->peak_lent = pool->n_lent;
+	AUG_UNLOCK(pool);
+
+	/* allocate outside of the lock */
+	if(buf == NULL)
+		buf = aug_malloc(pool->buf_size);
+
+	return buf;
+}
+
+void buf_pool_put(struct aug_buf_pool *pool, void *buf) {
+	AUG_LOCK(pool);
+	pool->n_lent--;
+	if(pool->n_idle < pool->max_idle) {
+		*(void **) buf = pool->idle;
+		pool->idle = buf;
+		pool->n_idle++;
+		buf = NULL;
+	}
+	AUG_UNLOCK(pool);
+
+	free(buf);
+}
+
+void buf_pool_stats(struct aug_buf_pool *pool, struct aug_buf_pool_stats *stats) {
+	AUG_LOCK(pool);
+	stats->n_idle = pool->n_idle;
+	stats->n_lent = pool->n_lent;
+	stats->peak_lent = pool->peak_lent;
+	stats->bytes = (pool->n_idle + pool->n_lent)*pool->buf_size;
+	AUG_UNLOCK(pool);
+}
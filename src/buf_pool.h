@@ -0,0 +1,56 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUG_BUF_POOL_H
+#define AUG_BUF_POOL_H
+
+#include <stddef.h>
+#include "lock.h"
+
+/* a pool of equally sized buffers which are lent out for
+ * the duration of a single operation (such as draining a pty).
+ * up to @max_idle returned buffers are kept around for the next 
+ * borrower, the rest are freed. so the memory used scales with 
+ * the number of buffers in use at the same time, not with the 
+ * number of potential borrowers. */
+struct aug_buf_pool {
+	size_t buf_size;
+	size_t max_idle;
+	/* idle buffers, linked through their first bytes */
+	void *idle;
+	size_t n_idle;
+	size_t n_lent;
+	size_t peak_lent;
+	AUG_LOCK_MEMBERS;
+};
+
+struct aug_buf_pool_stats {
+	size_t n_idle;
+	size_t n_lent;
+	size_t peak_lent;
+	size_t bytes; /* allocated by the pool right now */
+};
+
+void buf_pool_init(struct aug_buf_pool *pool, size_t buf_size, size_t max_idle);
+/* all buffers must have been returned */
+void buf_pool_free(struct aug_buf_pool *pool);
+
+void *buf_pool_get(struct aug_buf_pool *pool);
+void buf_pool_put(struct aug_buf_pool *pool, void *buf);
+void buf_pool_stats(struct aug_buf_pool *pool, struct aug_buf_pool_stats *stats);
+
+#endif /* AUG_BUF_POOL_H */
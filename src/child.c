@@ -19,10 +19,14 @@
 
 #include <sys/select.h>
 #include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "err.h"
 #include "util.h"
 #include "term.h"
+#include "trace.h"
+#include "counters.h"
 
 #ifdef AUG_DEBUG_IO
 #	define AUG_DEBUG_IO_LOG(...) \
@@ -34,11 +38,28 @@
 #endif
 
 static int process_master_output(struct aug_child *);
+static void lock_resources(struct aug_child *child);
+static void unlock_resources(struct aug_child *child);
+
+static struct aug_buf_pool g_bufs;
+
+void child_bufs_init() {
+	buf_pool_init(&g_bufs, AUG_CHILD_BUF_SIZE, AUG_CHILD_IDLE_BUFS);
+}
+
+void child_bufs_free() {
+	buf_pool_free(&g_bufs);
+}
+
+void child_bufs_stats(struct aug_buf_pool_stats *stats) {
+	buf_pool_stats(&g_bufs, stats);
+}
 
 void child_init(struct aug_child *child, struct aug_term *term, 
 		char *const *cmd_argv, void (*exec_cb)(),
 		void (*to_refresh)(void *), void (*to_lock)(void *), 
-		void (*to_unlock)(void *), struct termios *child_termios,
+		void (*to_unlock)(void *), void (*to_lock_render)(void *),
+		void (*to_unlock_render)(void *), struct termios *child_termios,
 		void *user) {
 	struct winsize size;
 	int master;
@@ -60,27 +81,139 @@ void child_init(struct aug_child *child, struct aug_term *term,
 	child->to_refresh = to_refresh;
 	child->to_lock = to_lock;
 	child->to_unlock = to_unlock;
+	child->to_lock_render = to_lock_render;
+	child->to_unlock_render = to_unlock_render;
 	child->got_input = 0;
+	child->wq.data = NULL;
+	child->wq.off = 0;
+	child->wq.len = 0;
+	child->wq.size = 0;
+	child->input_timer.active = 0;
+	child->refresh_timer.active = 0;
+	child->input_held = 0;
+	child->bytes_read = 0;
+	if(pipe(child->wakeup) != 0)
+		err_exit(errno, "failed to create wakeup pipe");
+	if(set_nonblocking(child->wakeup[0]) != 0
+			|| set_nonblocking(child->wakeup[1]) != 0)
+		err_exit(errno, "failed to set wakeup pipe to non-blocking");
+	child->event_fd = -1;
+	child->on_event = NULL;
+	child->on_output = NULL;
+	child->event_timer.active = 0;
 	child->user = user;
 	AUG_LOCK_INIT(child);
 }
 
 void child_free(struct aug_child *child) {
+	free(child->wq.data);
+	close(child->wakeup[0]);
+	close(child->wakeup[1]);
 	AUG_LOCK_FREE(child);
 }
 
+/* write as much of @buf as the master pty will take
+ * without blocking. returns the amount written. */
+static size_t write_master(struct aug_child *child, const char *buf, size_t n) {
+	ssize_t n_write;
+	size_t total;
+
+	total = 0;
+	while(total < n) {
+		n_write = write(child->term->master, buf + total, n - total);
+		if(n_write < 0) {
+			if(errno == EINTR)
+				continue;
+			else if(errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+
+			err_exit(errno, "error writing to pty master");
+		}
+		total += n_write;
+	}
+
+	return total;
+}
+
+static int write_queue_empty(const struct aug_child *child) {
+	return child->wq.off == child->wq.len;
+}
+
+static void flush_write_queue(struct aug_child *child) {
+	child->wq.off += write_master(child, child->wq.data + child->wq.off, 
+							child->wq.len - child->wq.off);
+
+	if(write_queue_empty(child) ) {
+		child->wq.off = child->wq.len = 0;
+		/* dont hang on to the memory from a big paste */
+		if(child->wq.size > AUG_CHILD_BUF_SIZE) {
+			free(child->wq.data);
+			child->wq.data = NULL;
+			child->wq.size = 0;
+		}
+	}
+}
+
+/* write @n bytes of @data to the master pty after anything 
+ * that is already queued. whatever the pty wont take right now is 
+ * queued and written by child_io_loop once the pty is writable. */
+void child_queue_write(struct aug_child *child, const char *data, size_t n) {
+	size_t written;
+	char *buf;
+
+	written = 0;
+	if(write_queue_empty(child) )
+		written = write_master(child, data, n);
+
+	if(written == n)
+		return;
+
+	data += written;
+	n -= written;
+	if(child->wq.len + n > child->wq.size) {
+		/* move the unwritten data to the front before growing */
+		if(child->wq.off > 0) {
+			memmove(child->wq.data, child->wq.data + child->wq.off, 
+					child->wq.len - child->wq.off);
+			child->wq.len -= child->wq.off;
+			child->wq.off = 0;
+		}
+
+		if(child->wq.len + n > child->wq.size) {
+			if(child->wq.size == 0)
+				child->wq.size = AUG_CHILD_BUF_SIZE;
+			while(child->wq.len + n > child->wq.size)
+				child->wq.size *= 2;
+
+			buf = realloc(child->wq.data, child->wq.size);
+			if(buf == NULL)
+				err_exit(0, "out of memory");
+			child->wq.data = buf;
+		}
+	}
+
+	memcpy(child->wq.data + child->wq.len, data, n);
+	child->wq.len += n;
+}
+
 void child_process_term_output(struct aug_child *child) {
 	size_t buflen;
+	char *buf;
 #ifdef AUG_DEBUG_IO
 	AUG_TIMER_ALLOC();
 	AUG_TIMER_START();
 #endif
 
+	if(vterm_output_get_buffer_current(child->term->vt) == 0)
+		return;
+
+	buf = buf_pool_get(&g_bufs);
 	while( (buflen = vterm_output_get_buffer_current(child->term->vt) ) > 0) {
 		buflen = (buflen < AUG_CHILD_BUF_SIZE)? buflen : AUG_CHILD_BUF_SIZE;
-		buflen = vterm_output_bufferread(child->term->vt, child->buf, buflen);
-		write_n_or_exit(child->term->master, child->buf, buflen);
+		buflen = vterm_output_bufferread(child->term->vt, buf, buflen);
+		child_queue_write(child, buf, buflen);
 	}
+	buf_pool_put(&g_bufs, buf);
 
 #ifdef AUG_DEBUG_IO
 	AUG_TIMER_IF_EXCEEDED(0, AUG_DEBUG_IO_TIME_MIN) {
@@ -91,18 +224,25 @@ void child_process_term_output(struct aug_child *child) {
 
 static int process_master_output(struct aug_child *child) {
 	ssize_t n_read, total_read;
+	char *buf;
+	int result;
+	uint64_t trace;
 #ifdef AUG_DEBUG_IO
 	AUG_TIMER_ALLOC();
 	AUG_TIMER_START();
 #endif
 
+	buf = buf_pool_get(&g_bufs);
+	result = 0;
 	total_read = 0;
+	trace = trace_begin();
 	/*fprintf(stderr, "child: read master pty\n");*/
 	do {
-		n_read = read(child->term->master, child->buf + total_read, AUG_CHILD_READ_SIZE);
+		n_read = read(child->term->master, buf + total_read, AUG_CHILD_READ_SIZE);
 		/*fprintf(stderr, "child: read %zd from master pty\n", n_read);*/
 	} while(n_read > 0 && ( (total_read += n_read) + AUG_CHILD_READ_SIZE <= AUG_CHILD_BUF_SIZE) );
 	/*fprintf(stderr, "child: done reading master pty\n");*/
+	trace_end(AUG_TRACE_PTY_READ, NULL, trace, total_read);
 
 #ifdef AUG_DEBUG_IO
 	AUG_TIMER_IF_EXCEEDED(0, AUG_DEBUG_IO_TIME_MIN) {
@@ -115,7 +255,8 @@ static int process_master_output(struct aug_child *child) {
 		 * bother writing those bytes to the terminal even
 		 * though we are presumably about to close whatever
 		 * was displaying the terminal output? */
-		return -1; /* the master pty is closed, return -1 to signify */
+		result = -1; /* the master pty is closed, return -1 to signify */
+		goto done;
 	}
 	else if(n_read < 0 && errno != EAGAIN) {
 		err_exit(errno, "error reading from pty master (n_read = %d)", n_read);
@@ -128,29 +269,161 @@ static int process_master_output(struct aug_child *child) {
 #ifdef AUG_DEBUG_IO
 		AUG_TIMER_START();
 #endif
-		vterm_push_bytes(child->term->vt, child->buf, total_read);
+		__atomic_fetch_add(&child->bytes_read, total_read, __ATOMIC_RELAXED);
+		counters_add(AUG_COUNTER_PTY_BYTES, total_read);
+		counters_add(AUG_COUNTER_VTERM_PUSHES, 1);
+		if(child->on_output != NULL)
+			(*child->on_output)(buf, total_read, child->user);
+		trace = trace_begin();
+		vterm_push_bytes(child->term->vt, buf, total_read);
+		trace_end(AUG_TRACE_VTERM_PUSH, NULL, trace, total_read);
 #ifdef AUG_DEBUG_IO
 		AUG_TIMER_IF_EXCEEDED(0, AUG_DEBUG_IO_TIME_MIN) {
 			AUG_TIMER_DISPLAY(stderr, "vterm_push_bytes took %d,%d secs\n");
 		}
 #endif
 	}
-	
+
+done:
+	buf_pool_put(&g_bufs, buf);
+	return result;
+}
+
+/* have child_io_loop call to_process_input once @after has
+ * elapsed, whether or not there is any input by then. passing
+ * NULL cancels the timer. */
+static void deadline_set(struct aug_child_deadline *dl, const struct timeval *after) {
+	struct timeval now;
+
+	if(after == NULL) {
+		dl->active = 0;
+		return;
+	}
+
+	if(gettimeofday(&now, NULL) != 0)
+		err_exit(errno, "gettimeofday failed");
+
+	timeradd(&now, after, &dl->deadline);
+	dl->active = 1;
+}
+
+/* returns 1 if @dl has gone off. otherwise returns 0 and, if
+ * @remaining is not NULL, stores the time left in it. */
+static int deadline_expired(const struct aug_child_deadline *dl, 
+		struct timeval *remaining) {
+	struct timeval now;
+
+	if(dl->active == 0)
+		return 0;
+
+	if(gettimeofday(&now, NULL) != 0)
+		err_exit(errno, "gettimeofday failed");
+
+	if(!timercmp(&now, &dl->deadline, <) ) 
+		return 1;
+
+	if(remaining != NULL)
+		timersub(&dl->deadline, &now, remaining);
 	return 0;
 }
 
+/* shortens *@tv_p to the time left until @dl, making
+ * it point to @tv if it was NULL */
+static void deadline_clamp(const struct aug_child_deadline *dl, 
+		struct timeval *tv, struct timeval **tv_p) {
+	struct timeval left;
+
+	if(dl->active == 0)
+		return;
+
+	timerclear(&left);
+	deadline_expired(dl, &left);
+	if(*tv_p == NULL || timercmp(&left, *tv_p, <) ) {
+		*tv = left;
+		*tv_p = tv;
+	}
+}
+
+void child_set_input_timer(struct aug_child *child, const struct timeval *after) {
+	deadline_set(&child->input_timer, after);
+}
+
+/* have child_io_loop call on_event once @after has elapsed, 
+ * even if event_fd isnt readable by then. passing NULL cancels
+ * the timer. must be called from on_event or with the child
+ * locked. */
+void child_set_event_timer(struct aug_child *child, const struct timeval *after) {
+	deadline_set(&child->event_timer, after);
+}
+
+/* have child_io_loop refresh the terminal once @after has
+ * elapsed, regardless of how long ago the last refresh was.
+ * passing NULL cancels the timer. must be called from 
+ * to_refresh or with the child locked. */
+void child_set_refresh_timer(struct aug_child *child, const struct timeval *after) {
+	deadline_set(&child->refresh_timer, after);
+}
+
+/* while @hold is non-zero child_io_loop does not read from the
+ * input fd, so anything typed in the mean time stays queued up 
+ * in order. the input timer and injected input are held as well. */
+void child_hold_input(struct aug_child *child, int hold) {
+	child->input_held = hold;
+}
+
+/* makes child_io_loop call to_process_input as soon as possible.
+ * this does not need the child lock, so it can be called from 
+ * any thread. */
+void child_wakeup(struct aug_child *child) {
+	char b = 0;
+
+	while(write(child->wakeup[1], &b, 1) < 0) {
+		if(errno == EINTR)
+			continue;
+		else if(errno == EAGAIN || errno == EWOULDBLOCK)
+			break; /* the pipe is full, so a wakeup is already pending */
+
+		err_exit(errno, "failed to write to wakeup pipe");
+	}
+}
+
+/* returns non-zero if anything was read from the wakeup pipe */
+static int drain_wakeup(struct aug_child *child) {
+	char buf[64];
+	ssize_t n_read;
+	int woken;
+
+	woken = 0;
+	while( (n_read = read(child->wakeup[0], buf, sizeof(buf)) ) != 0) {
+		if(n_read < 0) {
+			if(errno == EINTR)
+				continue;
+			else if(errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+
+			err_exit(errno, "failed to read from wakeup pipe");
+		}
+		woken = 1;
+	}
+
+	return woken;
+}
+
 void child_got_input(struct aug_child *child) {
 	child->got_input = 1;
 }
 
-/* this function calls the -to_unlock- callback first, thus it 
- * expects all resources to be in a locked state when entering
- * this function.
+/* this function expects the child to be locked (see child_lock)
+ * when entering this function and unlocks it before returning. 
+ * the child's own lock is only released around select. the
+ * -to_lock- resources are released while -to_process_input- 
+ * runs (it locks whatever it needs) and the render resources 
+ * are only held during child_refresh.
  */
 void child_io_loop(struct aug_child *child, int fd_input, 
 		int (*to_process_input)(struct aug_term *term, int fd_input, void *) ) {
-	fd_set in_fds;
-	int status, high_fd, force_refresh, just_refreshed;
+	fd_set in_fds, out_fds;
+	int status, high_fd, force_refresh, just_refreshed, woken;
 	struct timeval tv_select;
 	struct timeval *tv_select_p;
 #ifdef AUG_DEBUG_IO
@@ -171,6 +444,10 @@ void child_io_loop(struct aug_child *child, int fd_input,
 
 	fprintf(stderr, "fd_input = %d\n", fd_input);	
 	high_fd = (child->term->master > fd_input)? child->term->master : fd_input;
+	if(child->wakeup[0] > high_fd)
+		high_fd = child->wakeup[0];
+	if(child->event_fd > high_fd)
+		high_fd = child->event_fd;
 
 	while(1) {
 		/* if master pty is 'bursting' with I/O at a quick rate
@@ -179,9 +456,13 @@ void child_io_loop(struct aug_child *child, int fd_input,
 		 * refreshing the screen with stuff that just gets scrolled off
 		 */
 		if(force_refresh != 0
+				|| deadline_expired(&child->refresh_timer, NULL)
 				|| (status = timer_thresh(&child->refresh_min, 0, 71400) ) == 1 ) {
 			/* refresh at most 14 times per second (assuming there
-			 * is anything at all to refresh). */
+			 * is anything at all to refresh), or when a held off
+			 * frame is due. to_refresh sets the timer again if 
+			 * the frame has to wait some more. */
+			child->refresh_timer.active = 0;
 			child_refresh(child);
 			just_refreshed = 1;
 			force_refresh = 0;
@@ -192,9 +473,15 @@ void child_io_loop(struct aug_child *child, int fd_input,
 			just_refreshed = 0; /* didnt refresh the screen on this iteration */
 
 		FD_ZERO(&in_fds);
-		if(fd_input >= 0)
+		if(fd_input >= 0 && child->input_held == 0)
 			FD_SET(fd_input, &in_fds);
 		FD_SET(child->term->master, &in_fds);
+		FD_SET(child->wakeup[0], &in_fds);
+		if(child->event_fd >= 0)
+			FD_SET(child->event_fd, &in_fds);
+		FD_ZERO(&out_fds);
+		if(!write_queue_empty(child) )
+			FD_SET(child->term->master, &out_fds);
 
 		/* if we just refreshed the screen there
 		 * is no need to timeout the select wait. 
@@ -205,6 +492,11 @@ void child_io_loop(struct aug_child *child, int fd_input,
 		tv_select.tv_sec = 0;
 		tv_select.tv_usec = 15000;
 		tv_select_p = (just_refreshed == 0)? &tv_select : NULL;
+		/* dont sleep past the input, event or refresh timer */
+		if(child->input_held == 0)
+			deadline_clamp(&child->input_timer, &tv_select, &tv_select_p);
+		deadline_clamp(&child->event_timer, &tv_select, &tv_select_p);
+		deadline_clamp(&child->refresh_timer, &tv_select, &tv_select_p);
 
 		child_unlock(child);
 	
@@ -212,7 +504,7 @@ void child_io_loop(struct aug_child *child, int fd_input,
 #ifdef AUG_DEBUG_IO
 		AUG_TIMER_START();
 #endif
-		if(select(high_fd+1, &in_fds, NULL, NULL, tv_select_p) == -1) {
+		if(select(high_fd+1, &in_fds, &out_fds, NULL, tv_select_p) == -1) {
 			if(errno == EINTR) {
 				AUG_DEBUG_IO_LOG("child: select interupted\n");
 #ifdef AUG_DEBUG_IO
@@ -232,8 +524,19 @@ void child_io_loop(struct aug_child *child, int fd_input,
 			AUG_TIMER_DISPLAY(stderr, "select took %d,%d secs\n");
 		}
 #endif				
+		if( (child->event_fd >= 0 && FD_ISSET(child->event_fd, &in_fds) )
+				|| deadline_expired(&child->event_timer, NULL) ) {
+			AUG_DEBUG_IO_LOG("child: handle events\n");
+			child->event_timer.active = 0;
+			(*child->on_event)(child->user);
+		}
 		child_lock(child);
 
+		if(FD_ISSET(child->term->master, &out_fds) ) {
+			AUG_DEBUG_IO_LOG("child: flush write queue\n");
+			flush_write_queue(child);
+		}
+
 		if(FD_ISSET(child->term->master, &in_fds) ) {
 			AUG_DEBUG_IO_LOG("child: process_master_output\n");
 			if(process_master_output(child) != 0) {
@@ -249,14 +552,33 @@ void child_io_loop(struct aug_child *child, int fd_input,
 				force_refresh = 1;
 		}
 
+		woken = 0;
+		if(FD_ISSET(child->wakeup[0], &in_fds) ) {
+			AUG_DEBUG_IO_LOG("child: woken up\n");
+			woken = drain_wakeup(child);
+		}
+
 		child->got_input = 0;
-		if( (fd_input >= 0 && FD_ISSET(fd_input, &in_fds))
-				|| !term_inject_empty(child->term) ) {
+		if(to_process_input == NULL) {
+			/* nothing reads input, so being woken up is just
+			 * a request to refresh */
+			if(woken != 0)
+				force_refresh = 1;
+		}
+		else if( woken != 0
+				|| (child->input_held == 0 
+					&& ( (fd_input >= 0 && FD_ISSET(fd_input, &in_fds))
+						|| !term_inject_empty(child->term) 
+						|| deadline_expired(&child->input_timer, NULL) ) ) ) {
 			AUG_DEBUG_IO_LOG("child: process input\n");
 #ifdef AUG_DEBUG_IO
 			AUG_TIMER_START();
 #endif
-			if( (*to_process_input)(child->term, fd_input, child->user) != 0 ) {
+			/* input processing locks whatever it needs */
+			unlock_resources(child);
+			status = (*to_process_input)(child->term, fd_input, child->user);
+			lock_resources(child);
+			if(status != 0) {
 				/* fd_input is closed or bad in some way */
 				break;
 			}
@@ -275,17 +597,32 @@ void child_io_loop(struct aug_child *child, int fd_input,
 	return;
 }
 
+static void lock_resources(struct aug_child *child) {
+	if(child->to_lock != NULL)
+		(*child->to_lock)(child->user);
+}
+
+static void unlock_resources(struct aug_child *child) {
+	if(child->to_unlock != NULL)
+		(*child->to_unlock)(child->user);
+}
+
+/* locks the child and the resources needed to feed
+ * its terminal (the -to_lock- callback). */
 void child_lock(struct aug_child *child) {
 	AUG_LOCK(child);
-	(*child->to_lock)(child->user);
+	lock_resources(child);
 }
 
 void child_unlock(struct aug_child *child) { 
-	(*child->to_unlock)(child->user);
+	unlock_resources(child);
 	AUG_UNLOCK(child);
 }
 
+/* the child must be locked. the render resources
+ * are locked for the duration of this call. */
 void child_refresh(struct aug_child *child) {
+	uint64_t trace;
 #ifdef AUG_DEBUG_IO
 	AUG_TIMER_ALLOC();
 #endif
@@ -295,13 +632,27 @@ void child_refresh(struct aug_child *child) {
 #ifdef AUG_DEBUG_IO
 	AUG_TIMER_START();
 #endif
+	/* the damage callbacks only record, and staging converts
+	 * cells without touching ncurses, so other terminals can 
+	 * render while we do this. */
+	trace = trace_begin();
 	vterm_screen_flush_damage(vterm_obtain_screen(child->term->vt) );
+	if(child->to_lock_render == NULL) {
+		trace_end(AUG_TRACE_DAMAGE_FLUSH, NULL, trace, 0);
+		goto done;
+	}
+	if(child->term->io_callbacks.stage != NULL)
+		(*child->term->io_callbacks.stage)(child->term->user);
+	trace_end(AUG_TRACE_DAMAGE_FLUSH, NULL, trace, 0);
 #ifdef AUG_DEBUG_IO
 	AUG_TIMER_IF_EXCEEDED(0, AUG_DEBUG_IO_TIME_MIN) {
-		AUG_TIMER_DISPLAY(stderr, "vterm_screen_flush_damage took %d,%d secs\n");
+		AUG_TIMER_DISPLAY(stderr, "flushing and staging damage took %d,%d secs\n");
 	}
 #endif
 
+	(*child->to_lock_render)(child->user);
+
+	trace = trace_begin();
 #ifdef AUG_DEBUG_IO
 	AUG_TIMER_START();
 #endif
@@ -312,6 +663,7 @@ void child_refresh(struct aug_child *child) {
 		AUG_TIMER_DISPLAY(stderr, "child->term->io_callbacks.refresh took %d,%d secs\n");
 	}
 #endif
+	trace_end(AUG_TRACE_REFRESH, NULL, trace, 0);
 
 #ifdef AUG_DEBUG_IO
 	AUG_TIMER_START();
@@ -322,6 +674,31 @@ void child_refresh(struct aug_child *child) {
 		AUG_TIMER_DISPLAY(stderr, "child->to_refresh took %d,%d secs\n");
 	}
 #endif
+	(*child->to_unlock_render)(child->user);
 	
+done:
 	timer_init(&child->refresh_min);
 }
+
+/* the child must be locked */
+void child_set_render(struct aug_child *child, void (*to_lock_render)(void *),
+		void (*to_unlock_render)(void *)) {
+	child->to_lock_render = to_lock_render;
+	child->to_unlock_render = to_unlock_render;
+}
+
+/* have child_io_loop watch @event_fd as well (pass -1 to
+ * stop). must be called before child_io_loop starts. */
+void child_set_event_fd(struct aug_child *child, int event_fd, 
+		void (*on_event)(void *user)) {
+	child->event_fd = event_fd;
+	child->on_event = on_event;
+}
+
+/* have process_master_output pass what it reads from the 
+ * child to @on_output (pass NULL to stop). must be called 
+ * before child_io_loop starts. */
+void child_set_output_hook(struct aug_child *child, 
+		void (*on_output)(const char *buf, size_t n, void *user)) {
+	child->on_output = on_output;
+}
@@ -19,6 +19,7 @@
 #define AUG_CHILD_H
 
 #include <unistd.h>
+#include <stdint.h>
 #if defined(__FreeBSD__)
 #	include <libutil.h>
 #	include <termios.h>
@@ -31,35 +32,107 @@
 
 #include "lock.h"
 #include "timer.h"
+#include "buf_pool.h"
 
 #define AUG_CHILD_READ_SIZE 4096
 #define AUG_CHILD_BUF_SIZE (AUG_CHILD_READ_SIZE*4)
+/* number of I/O buffers kept around when no child is using them */
+#define AUG_CHILD_IDLE_BUFS 4
+
+struct aug_child_deadline {
+	int active;
+	struct timeval deadline;
+};
 
 struct aug_child {
-	char buf[AUG_CHILD_BUF_SIZE];
 	struct aug_term *term;	
 	AUG_LOCK_MEMBERS;
 	pid_t pid;
 	void (*to_refresh)(void *);
+	/* lock the resources needed to parse output from the 
+	 * child into the terminal (may be NULL) */
 	void (*to_lock)(void *);
 	void (*to_unlock)(void *);
+	/* lock the resources needed to render the terminal.
+	 * called with the to_lock resources held. if NULL, the
+	 * terminal has nowhere to render to and child_refresh
+	 * only flushes the vterm damage. */
+	void (*to_lock_render)(void *);
+	void (*to_unlock_render)(void *);
 	struct aug_timer refresh_min;
 	int got_input;
+	/* bytes waiting to be written to the master pty. 
+	 * data[off] to data[len] has not been written yet. */
+	struct {
+		char *data;
+		size_t off;
+		size_t len;
+		size_t size;
+	} wq;
+	/* if set, to_process_input is called at @deadline 
+	 * even if there is no input. */
+	struct aug_child_deadline input_timer;
+	/* if set, the terminal is refreshed at @deadline (for a 
+	 * frame which to_refresh had to hold off) */
+	struct aug_child_deadline refresh_timer;
+	/* while set, child_io_loop leaves the input alone */
+	int input_held;
+	/* self-pipe which lets other threads wake child_io_loop */
+	int wakeup[2];
+	/* if event_fd >= 0, child_io_loop calls on_event with nothing
+	 * locked whenever event_fd is readable */
+	int event_fd;
+	void (*on_event)(void *user);
+	/* if set, called with what is read from the child before 
+	 * it is fed to the terminal (with the child locked) */
+	void (*on_output)(const char *buf, size_t n, void *user);
+	/* if set, on_event is also called at @deadline. only
+	 * touched by on_event or with the child locked. */
+	struct aug_child_deadline event_timer;
 	void *user;
+	/* bytes read from the master pty so far. written by
+	 * child_io_loop with atomic adds so other threads can
+	 * read it with child_bytes_read without the lock. */
+	uint64_t bytes_read;
 };
 
+static inline uint64_t child_bytes_read(const struct aug_child *child) {
+	return __atomic_load_n(&child->bytes_read, __ATOMIC_RELAXED);
+}
+
+/* children borrow an I/O buffer from a shared pool only 
+ * while they drain their pty. these set up and tear down
+ * that pool, which must happen before the first child_init
+ * and after the last child_free. */
+void child_bufs_init();
+void child_bufs_free();
+void child_bufs_stats(struct aug_buf_pool_stats *stats);
+
 void child_init(struct aug_child *child, struct aug_term *term, 
 		char *const *cmd_argv, void (*exec_cb)(),
 		void (*to_refresh)(void *), void (*to_lock)(void *), 
-		void (*to_unlock)(void *), struct termios *child_termios,
+		void (*to_unlock)(void *), void (*to_lock_render)(void *),
+		void (*to_unlock_render)(void *), struct termios *child_termios,
 		void *user);
 void child_free(struct aug_child *child);
 void child_got_input(struct aug_child *child);
 void child_io_loop(struct aug_child *child, int fd_input, 
 		int (*to_process_input)(struct aug_term *term, int fd_input, void *) );
 void child_process_term_output(struct aug_child *child);
+void child_queue_write(struct aug_child *child, const char *data, size_t n);
+void child_set_input_timer(struct aug_child *child, const struct timeval *after);
+void child_hold_input(struct aug_child *child, int hold);
+void child_wakeup(struct aug_child *child);
 void child_lock(struct aug_child *child);
 void child_unlock(struct aug_child *child);
 void child_refresh(struct aug_child *child);
+void child_set_render(struct aug_child *child, void (*to_lock_render)(void *),
+		void (*to_unlock_render)(void *));
+void child_set_event_fd(struct aug_child *child, int event_fd, 
+		void (*on_event)(void *user));
+void child_set_output_hook(struct aug_child *child, 
+		void (*on_output)(const char *buf, size_t n, void *user));
+void child_set_event_timer(struct aug_child *child, const struct timeval *after);
+void child_set_refresh_timer(struct aug_child *child, const struct timeval *after);
 
 #endif /* AUG_CHILD_H */
@@ -20,6 +20,7 @@
 #include <assert.h>
 #include "screen.h"
 #include "err.h"
+#include "log.h"
 
 const char *CONF_DEFAULT_ARGV[] = AUG_DEFAULT_ARGV;
 const int CONF_DEFAULT_ARGC = (sizeof(CONF_DEFAULT_ARGV)/sizeof(char *)) - 1;
@@ -37,6 +38,16 @@ void conf_init(struct aug_conf *conf) {
 	conf->plugin_path = CONF_PLUGIN_PATH_DEFAULT;
 	conf->cmd_prefix = CONF_CMD_PREFIX_DEFAULT;
 	conf->cmd_prefix_escape = CONF_CMD_PREFIX_ESCAPE_DEFAULT;
+	conf->lock_prof = CONF_LOCK_PROF_DEFAULT;
+	conf->trace = CONF_TRACE_DEFAULT;
+	conf->log_level = CONF_LOG_LEVEL_DEFAULT;
+	conf->stats_socket = CONF_STATS_SOCKET_DEFAULT;
+	conf->session_socket = CONF_SESSION_SOCKET_DEFAULT;
+	conf->mirror = CONF_MIRROR_DEFAULT;
+	conf->record = CONF_RECORD_DEFAULT;
+	conf->attach = NULL;
+	conf->view = NULL;
+	conf->play = NULL;
 	conf->pass_through = 0;
 
 	shell = getenv("SHELL");
@@ -89,6 +100,13 @@ void conf_merge_ini(struct aug_conf *conf, dictionary *ini) {
 	MERGE_VAR(plugin_path, string, CONF_PLUGIN_PATH, CONF_PLUGIN_PATH_DEFAULT)
 	MERGE_VAR(cmd_prefix, string, CONF_CMD_PREFIX, CONF_CMD_PREFIX_DEFAULT)
 	MERGE_VAR(cmd_prefix_escape, string, CONF_CMD_PREFIX_ESCAPE, CONF_CMD_PREFIX_ESCAPE_DEFAULT)
+	MERGE_VAR(lock_prof, boolean, CONF_LOCK_PROF, CONF_LOCK_PROF_DEFAULT)
+	MERGE_VAR(trace, string, CONF_TRACE, CONF_TRACE_DEFAULT)
+	MERGE_VAR(log_level, string, CONF_LOG_LEVEL, CONF_LOG_LEVEL_DEFAULT)
+	MERGE_VAR(stats_socket, string, CONF_STATS_SOCKET, CONF_STATS_SOCKET_DEFAULT)
+	MERGE_VAR(session_socket, string, CONF_SESSION_SOCKET, CONF_SESSION_SOCKET_DEFAULT)
+	MERGE_VAR(mirror, string, CONF_MIRROR, CONF_MIRROR_DEFAULT)
+	MERGE_VAR(record, string, CONF_RECORD, CONF_RECORD_DEFAULT)
 
 #undef MERGE_VAR
 }
@@ -108,6 +126,11 @@ int conf_set_derived_vars(struct aug_conf *conf, const char **err_msg) {
 	else 
 		conf->pass_through = 1;
 
+	if(log_set_levels(conf->log_level) != 0) {
+		*err_msg = "could not understand log level.";
+		return -1;
+	}
+
 	return 0;	
 }
 
@@ -121,6 +144,13 @@ void conf_fprint(struct aug_conf *c, FILE *f) {
 	fprintf(f, "conf_file: \t\t'%s'\n", c->conf_file);
 	fprintf(f, "cmd_prefix: \t\t'%s'\n", c->cmd_prefix);
 	fprintf(f, "cmd_prefix_escape: \t'%s'\n", c->cmd_prefix_escape);
+	fprintf(f, "lock_prof: \t\t'%d'\n", c->lock_prof);
+	fprintf(f, "trace: \t\t\t'%s'\n", c->trace);
+	fprintf(f, "log_level: \t\t'%s'\n", c->log_level);
+	fprintf(f, "stats_socket: \t\t'%s'\n", c->stats_socket);
+	fprintf(f, "session_socket: \t'%s'\n", c->session_socket);
+	fprintf(f, "mirror: \t\t'%s'\n", c->mirror);
+	fprintf(f, "record: \t\t'%s'\n", c->record);
 	fprintf(f, "cmd: \t\t\t[");
 	for(i = 0; i < c->cmd_argc; i++) {
 		fprintf(f, "'%s'", c->cmd_argv[i]);
@@ -77,6 +77,44 @@
 #define CONF_CMD_PREFIX_ESCAPE "cmd-prefix-escape"
 #define CONF_CMD_PREFIX_ESCAPE_DEFAULT NULL
 
+/* profile lock contention. the profile is written to
+ * the debug file on SIGUSR1 and when aug exits. */
+#define CONF_LOCK_PROF "lock-prof"
+#define CONF_LOCK_PROF_DEFAULT false
+
+/* record a trace of where the time goes (see trace.h) and 
+ * write it to this file on SIGUSR1 and when aug exits. */
+#define CONF_TRACE "trace"
+#define CONF_TRACE_DEFAULT NULL /* dont trace */
+
+/* the level of messages written to the debug file, optionally
+ * per subsystem or plugin, e.g. "warn,attr=debug,reverse=info".
+ * see log_set_levels in log.h */
+#define CONF_LOG_LEVEL "log-level"
+#define CONF_LOG_LEVEL_DEFAULT "info"
+
+/* serve the performance counters on a unix socket at this
+ * path. each connection gets a dump and is closed. */
+#define CONF_STATS_SOCKET "stats-socket"
+#define CONF_STATS_SOCKET_DEFAULT NULL /* no socket */
+
+/* run aug in a server process and serve the primary terminal
+ * on a unix socket at this path, so that it can be used from 
+ * elsewhere with --attach. see session.h */
+#define CONF_SESSION_SOCKET "session-socket"
+#define CONF_SESSION_SOCKET_DEFAULT NULL /* no sessions */
+
+/* publish the primary terminal's screen in this file, where
+ * any number of --view observers can map it. see mirror.h */
+#define CONF_MIRROR "mirror"
+#define CONF_MIRROR_DEFAULT NULL /* no mirror */
+
+/* record the primary terminal to this file for aug --play. 
+ * strftime conversions (%Y%m%d-%H%M%S etc.) are filled in, so
+ * each run can get a file of its own. see record.h */
+#define CONF_RECORD "record"
+#define CONF_RECORD_DEFAULT NULL /* no recording */
+
 struct aug_conf_opt_set {
 	OBJSET_MEMBERS(const void *);
 };
@@ -90,9 +128,23 @@ struct aug_conf {
 	const char *plugin_path;
 	const char *cmd_prefix;
 	const char *cmd_prefix_escape;
+	bool lock_prof;
+	const char *trace;
+	const char *log_level;
+	const char *stats_socket;
+	const char *session_socket;
+	const char *mirror;
+	const char *record;
 
 	/* option (no config) */
 	const char *conf_file;
+	/* attach to the session served at this path instead of
+	 * starting aug */
+	const char *attach;
+	/* view the mirror at this path instead of starting aug */
+	const char *view;
+	/* play the recording at this path instead of starting aug */
+	const char *play;
 
 	/* args */
 	int cmd_argc;
@@ -0,0 +1,75 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "counters.h"
+
+#include <errno.h>
+#include <sys/time.h>
+
+#include "aug.h"
+#include "util.h"
+
+struct aug_counter_slot g_counters[AUG_COUNTERS];
+
+static struct timeval g_start;
+
+void counters_start() {
+	if(gettimeofday(&g_start, NULL) != 0)
+		err_exit(errno, "gettimeofday failed");
+}
+
+void counters_read(struct aug_counters *counters) {
+	struct timeval now;
+
+	if(gettimeofday(&now, NULL) != 0)
+		err_exit(errno, "gettimeofday failed");
+
+	counters->uptime_usec = (uint64_t) (now.tv_sec - g_start.tv_sec)*1000000
+		+ (now.tv_usec - g_start.tv_usec);
+	counters->pty_bytes = counters_get(AUG_COUNTER_PTY_BYTES);
+	counters->primary_pty_bytes = 0;
+	counters->vterm_pushes = counters_get(AUG_COUNTER_VTERM_PUSHES);
+	counters->cells_painted = counters_get(AUG_COUNTER_CELLS_PAINTED);
+	counters->frames_rendered = counters_get(AUG_COUNTER_FRAMES_RENDERED);
+	counters->frames_skipped = counters_get(AUG_COUNTER_FRAMES_SKIPPED);
+	counters->input_keys = counters_get(AUG_COUNTER_INPUT_KEYS);
+	counters->callbacks = counters_get(AUG_COUNTER_CALLBACKS);
+	counters->lock_waits = counters_get(AUG_COUNTER_LOCK_WAITS);
+	counters->frames_deferred = counters_get(AUG_COUNTER_FRAMES_DEFERRED);
+	counters->congestion = counters_get(AUG_COUNTER_CONGESTION);
+}
+
+void counters_fprint(FILE *f, const struct aug_counters *counters) {
+#define PRINT(_field) \
+	fprintf(f, #_field " %llu\n", (unsigned long long) counters->_field)
+
+	PRINT(uptime_usec);
+	PRINT(pty_bytes);
+	PRINT(primary_pty_bytes);
+	PRINT(vterm_pushes);
+	PRINT(cells_painted);
+	PRINT(frames_rendered);
+	PRINT(frames_skipped);
+	PRINT(input_keys);
+	PRINT(callbacks);
+	PRINT(lock_waits);
+	PRINT(frames_deferred);
+	PRINT(congestion);
+
+#undef PRINT
+	fflush(f);
+}
@@ -0,0 +1,75 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUG_COUNTERS_H
+#define AUG_COUNTERS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* the registry of core performance counters. a counter is bumped
+ * with a relaxed atomic add on a cache line of its own, so threads
+ * which bump different counters dont slow each other down. the
+ * counters are read one by one into a struct aug_counters (see 
+ * aug.h), so a read is not a snapshot of all of them at one 
+ * instant, but each value is read whole. */
+
+enum aug_counter {
+	AUG_COUNTER_PTY_BYTES = 0,
+	AUG_COUNTER_VTERM_PUSHES,
+	AUG_COUNTER_CELLS_PAINTED,
+	AUG_COUNTER_FRAMES_RENDERED,
+	AUG_COUNTER_FRAMES_SKIPPED,
+	AUG_COUNTER_INPUT_KEYS,
+	AUG_COUNTER_CALLBACKS,
+	AUG_COUNTER_LOCK_WAITS,
+	AUG_COUNTER_FRAMES_DEFERRED,
+	/* a level rather than a count (see counters_set) */
+	AUG_COUNTER_CONGESTION,
+	AUG_COUNTERS
+};
+
+struct aug_counter_slot {
+	uint64_t val;
+} __attribute__ ((aligned (64)));
+
+extern struct aug_counter_slot g_counters[AUG_COUNTERS];
+
+static inline void counters_add(enum aug_counter c, uint64_t n) {
+	__atomic_fetch_add(&g_counters[c].val, n, __ATOMIC_RELAXED);
+}
+
+/* for counters which hold a level instead of a running total */
+static inline void counters_set(enum aug_counter c, uint64_t n) {
+	__atomic_store_n(&g_counters[c].val, n, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t counters_get(enum aug_counter c) {
+	return __atomic_load_n(&g_counters[c].val, __ATOMIC_RELAXED);
+}
+
+struct aug_counters;
+
+/* the time uptime_usec counts from */
+void counters_start();
+/* fill in everything but primary_pty_bytes, which only 
+ * the owner of the primary terminal knows */
+void counters_read(struct aug_counters *counters);
+/* one "name value" line per counter */
+void counters_fprint(FILE *f, const struct aug_counters *counters);
+
+#endif /* AUG_COUNTERS_H */
@@ -0,0 +1,134 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "frame.h"
+
+#include <string.h>
+
+/* the rate is recomputed once a window is this old */
+#define AUG_FRAME_WINDOW 1000000
+
+static long usecs_since(const struct timeval *then, const struct timeval *now) {
+	struct timeval diff;
+
+	timersub(now, then, &diff);
+	return diff.tv_sec*1000000L + diff.tv_usec;
+}
+
+void frame_init(struct aug_frame *frame) {
+	memset(frame, 0, sizeof(*frame) );
+}
+
+int frame_request(struct aug_frame *frame) {
+	frame->requests++;
+	if(frame->requested != 0)
+		return 0;
+
+	frame->requested = 1;
+	return 1;
+}
+
+int frame_requested(const struct aug_frame *frame) {
+	return frame->requested;
+}
+
+void frame_flushed(struct aug_frame *frame, const struct timeval *now) {
+	long elapsed;
+
+	frame->requested = 0;
+	frame->flushes++;
+
+	if(frame->window.tv_sec == 0 && frame->window.tv_usec == 0)
+		frame->window = *now;
+
+	elapsed = usecs_since(&frame->window, now);
+	if(elapsed >= AUG_FRAME_WINDOW) {
+		frame->rate = (frame->window_flushes*1000000UL) / (unsigned long) elapsed;
+		frame->window = *now;
+		frame->window_flushes = 0;
+	}
+	frame->window_flushes++;
+}
+
+static void hold(struct aug_frame *frame, const struct timeval *now) {
+	struct timeval len;
+	long usecs;
+
+	if(frame->congestion == 0) {
+		frame->hold_until = *now;
+		return;
+	}
+
+	usecs = (long) AUG_FRAME_HOLD << (frame->congestion - 1);
+	len.tv_sec = usecs / 1000000;
+	len.tv_usec = usecs % 1000000;
+	timeradd(now, &len, &frame->hold_until);
+}
+
+static void congested(struct aug_frame *frame, const struct timeval *now) {
+	if(frame->congestion < AUG_FRAME_MAX_CONGESTION)
+		frame->congestion++;
+	hold(frame, now);
+}
+
+int frame_due(struct aug_frame *frame, const struct timeval *now, long outq,
+		int writable) {
+	if(timercmp(now, &frame->hold_until, <) ) {
+		frame->deferrals++;
+		return 0;
+	}
+
+	/* whatever we flush now would just queue up behind 
+	 * what the outer terminal hasnt taken yet */
+	if(outq > AUG_FRAME_OUTQ_MAX || writable == 0) {
+		congested(frame, now);
+		frame->deferrals++;
+		return 0;
+	}
+
+	return 1;
+}
+
+void frame_hold_left(const struct aug_frame *frame, const struct timeval *now,
+		struct timeval *left) {
+	if(timercmp(now, &frame->hold_until, <) )
+		timersub(&frame->hold_until, now, left);
+	else
+		timerclear(left);
+}
+
+void frame_drained(struct aug_frame *frame, const struct timeval *now, 
+		long outq, long flush_usecs) {
+	if(outq > AUG_FRAME_OUTQ_MAX || flush_usecs > AUG_FRAME_SLOW_FLUSH) {
+		congested(frame, now);
+		return;
+	}
+
+	/* back off one level at a time, so a link which only just
+	 * caught up doesnt get flooded again straight away */
+	if(frame->congestion > 0)
+		frame->congestion--;
+	hold(frame, now);
+}
+
+unsigned long frame_rate(const struct aug_frame *frame, const struct timeval *now) {
+	/* nothing was flushed in the last full window */
+	if(usecs_since(&frame->window, now) >= 2*AUG_FRAME_WINDOW)
+		return 0;
+
+	return frame->rate;
+}
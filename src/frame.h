@@ -0,0 +1,87 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUG_FRAME_H
+#define AUG_FRAME_H
+
+#include "timer.h"
+
+/* plugins and terminals only ask for a frame. the main loop 
+ * composites the panels and flushes to the outer terminal once 
+ * per iteration, so several requests in between cost a single 
+ * flush. this structure just keeps the books for that; the 
+ * caller provides the locking. */
+struct aug_frame {
+	/* a frame was asked for since the last flush */
+	int requested;
+	unsigned long requests;
+	unsigned long flushes;
+	/* flushes since @window began */
+	struct timeval window;
+	unsigned long window_flushes;
+	/* flushes per second over the last full window */
+	unsigned long rate;
+	/* backpressure from the outer terminal. while it is 
+	 * congested, flushes are held off until @hold_until and 
+	 * whatever is drawn in the meantime goes out as one frame
+	 * after that. each level of @congestion doubles the hold. */
+	int congestion;
+	struct timeval hold_until;
+	/* flushes which were held off */
+	unsigned long deferrals;
+};
+
+/* the outer terminal is congested if more than this many bytes
+ * are still queued for it... */
+#define AUG_FRAME_OUTQ_MAX 4096
+/* ...or a flush took longer than this many usecs (in which 
+ * case the write must have blocked) */
+#define AUG_FRAME_SLOW_FLUSH 20000
+/* the hold at the first level of congestion */
+#define AUG_FRAME_HOLD 16000
+#define AUG_FRAME_MAX_CONGESTION 6
+
+void frame_init(struct aug_frame *frame);
+
+/* returns 1 if no frame was asked for since the last flush, in
+ * which case whoever flushes has to be woken up. */
+int frame_request(struct aug_frame *frame);
+int frame_requested(const struct aug_frame *frame);
+
+/* records a flush to the outer terminal at @now */
+void frame_flushed(struct aug_frame *frame, const struct timeval *now);
+
+/* whether to flush at @now, given that @outq bytes (-1 if
+ * unknown) are waiting to be written to the outer terminal and
+ * whether it would take more output without blocking 
+ * (@writable). if not, the frame stays requested and should be
+ * tried again after frame_hold_left. */
+int frame_due(struct aug_frame *frame, const struct timeval *now, long outq,
+		int writable);
+/* how long from @now until a held off frame may go out */
+void frame_hold_left(const struct aug_frame *frame, const struct timeval *now,
+		struct timeval *left);
+/* records how the outer terminal coped with a flush which took
+ * @flush_usecs and left @outq bytes (-1 if unknown) queued 
+ * as of @now, which raises or lowers the congestion. */
+void frame_drained(struct aug_frame *frame, const struct timeval *now, 
+		long outq, long flush_usecs);
+
+/* flushes per second, as of @now */
+unsigned long frame_rate(const struct aug_frame *frame, const struct timeval *now);
+
+#endif /* AUG_FRAME_H */
@@ -0,0 +1,211 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "handle_table.h"
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include "util.h"
+
+#define STATE_CLOSING ((uint64_t) 1 << 31)
+#define STATE_REFS(_state) ( (_state) & (STATE_CLOSING - 1) )
+#define STATE_GEN(_state) ( (uint32_t) ((_state) >> 32) )
+#define STATE(_gen, _bits) ( ((uint64_t) (_gen) << 32) | (_bits) )
+
+/* the low bits of a handle hold the slot index plus one (so that
+ * a handle is never NULL), the rest hold as much of the generation
+ * as fits into a pointer. */
+#define HANDLE_INDEX_BITS 16
+#define HANDLE_GEN_MASK ( UINTPTR_MAX >> HANDLE_INDEX_BITS )
+
+static inline void *make_handle(size_t index, uint32_t gen) {
+	return (void *) ( ((uintptr_t) gen << HANDLE_INDEX_BITS) | (index + 1) );
+}
+
+static inline size_t handle_index(const void *handle) {
+	return ( (uintptr_t) handle & ((1 << HANDLE_INDEX_BITS) - 1) ) - 1;
+}
+
+static inline int handle_gen_matches(const void *handle, uint64_t state) {
+	return ((uintptr_t) handle >> HANDLE_INDEX_BITS) 
+			== ( (uintptr_t) STATE_GEN(state) & HANDLE_GEN_MASK );
+}
+
+static inline struct aug_handle_slot *slot_at(struct aug_handle_table *table, 
+		size_t index) {
+	return &table->chunks[index/AUG_HANDLE_TABLE_CHUNK][index % AUG_HANDLE_TABLE_CHUNK];
+}
+
+/* returns NULL if @handle could never have come from @table */
+static struct aug_handle_slot *handle_slot(struct aug_handle_table *table, 
+		const void *handle) {
+	size_t index;
+
+	if(handle == NULL)
+		return NULL;
+
+	index = handle_index(handle);
+	/* n_slots is only stored after the chunk is set up */
+	if(index >= __atomic_load_n(&table->n_slots, __ATOMIC_ACQUIRE) )
+		return NULL;
+
+	return slot_at(table, index);
+}
+
+void handle_table_init(struct aug_handle_table *table) {
+	size_t i;
+
+	for(i = 0; i < AUG_HANDLE_TABLE_CHUNKS; i++)
+		table->chunks[i] = NULL;
+	table->n_slots = 0;
+	table->free_head = 0;
+	AUG_LOCK_INIT(table);
+}
+
+void handle_table_free(struct aug_handle_table *table) {
+	size_t i;
+	struct aug_handle_slot *slot;
+
+	for(i = 0; i < table->n_slots; i++) {
+		slot = slot_at(table, i);
+		AUG_STATUS_EQUAL( pthread_cond_destroy(&slot->released), 0 );
+		AUG_LOCK_FREE(slot);
+	}
+	for(i = 0; i < AUG_HANDLE_TABLE_CHUNKS; i++)
+		free(table->chunks[i]);
+
+	AUG_LOCK_FREE(table);
+}
+
+/* table must be locked */
+static int grow(struct aug_handle_table *table) {
+	size_t i, chunk;
+	struct aug_handle_slot *slots;
+
+	chunk = table->n_slots/AUG_HANDLE_TABLE_CHUNK;
+	if(chunk >= AUG_HANDLE_TABLE_CHUNKS)
+		return -1;
+
+	slots = aug_malloc(AUG_HANDLE_TABLE_CHUNK*sizeof(*slots));
+	for(i = 0; i < AUG_HANDLE_TABLE_CHUNK; i++) {
+		slots[i].state = STATE(0, STATE_CLOSING);
+		slots[i].obj = NULL;
+		slots[i].next_free = table->free_head;
+		AUG_STATUS_EQUAL( pthread_cond_init(&slots[i].released, NULL), 0 );
+		AUG_LOCK_INIT(&slots[i]);
+		table->free_head = table->n_slots + i + 1;
+	}
+
+	table->chunks[chunk] = slots;
+	__atomic_store_n(&table->n_slots, table->n_slots + AUG_HANDLE_TABLE_CHUNK, 
+		__ATOMIC_RELEASE);
+	return 0;
+}
+
+void *handle_table_add(struct aug_handle_table *table, void *obj) {
+	struct aug_handle_slot *slot;
+	size_t index;
+	uint32_t gen;
+	void *handle;
+
+	handle = NULL;
+	AUG_LOCK(table);
+	if(table->free_head == 0 && grow(table) != 0) 
+		goto unlock;
+
+	index = table->free_head - 1;
+	slot = slot_at(table, index);
+	table->free_head = slot->next_free;
+
+	slot->obj = obj;
+	gen = STATE_GEN(slot->state);
+	/* publishes obj to handle_table_get */
+	__atomic_store_n(&slot->state, STATE(gen, 0), __ATOMIC_RELEASE);
+	handle = make_handle(index, gen);
+unlock:
+	AUG_UNLOCK(table);
+
+	return handle;
+}
+
+void *handle_table_get(struct aug_handle_table *table, const void *handle) {
+	struct aug_handle_slot *slot;
+	uint64_t state;
+
+	if( (slot = handle_slot(table, handle)) == NULL)
+		return NULL;
+
+	state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+	do {
+		if(!handle_gen_matches(handle, state) || (state & STATE_CLOSING) )
+			return NULL;
+	} while(!__atomic_compare_exchange_n(&slot->state, &state, state + 1, 1,
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) );
+
+	return slot->obj;
+}
+
+void handle_table_put(struct aug_handle_table *table, const void *handle) {
+	struct aug_handle_slot *slot;
+	uint64_t state;
+
+	if( (slot = handle_slot(table, handle)) == NULL)
+		err_exit(0, "put of invalid handle %p", handle);
+
+	state = __atomic_sub_fetch(&slot->state, 1, __ATOMIC_ACQ_REL);
+	if( (state & STATE_CLOSING) && STATE_REFS(state) == 0) {
+		/* the remover checks the count with the slot locked, 
+		 * so it cant miss this */
+		AUG_LOCK(slot);
+		AUG_STATUS_EQUAL( pthread_cond_broadcast(&slot->released), 0 );
+		AUG_UNLOCK(slot);
+	}
+}
+
+void *handle_table_remove(struct aug_handle_table *table, const void *handle) {
+	struct aug_handle_slot *slot;
+	uint64_t state;
+	void *obj;
+
+	if( (slot = handle_slot(table, handle)) == NULL)
+		return NULL;
+
+	state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+	do {
+		if(!handle_gen_matches(handle, state) || (state & STATE_CLOSING) )
+			return NULL;
+	} while(!__atomic_compare_exchange_n(&slot->state, &state, state | STATE_CLOSING, 
+				1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) );
+
+	AUG_LOCK(slot);
+	while(STATE_REFS(__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE)) != 0)
+		AUG_COND_WAIT(&slot->released, slot);
+	AUG_UNLOCK(slot);
+
+	obj = slot->obj;
+	AUG_LOCK(table);
+	slot->obj = NULL;
+	/* the next object in this slot gets a new generation */
+	__atomic_store_n(&slot->state, STATE(STATE_GEN(state) + 1, STATE_CLOSING), 
+		__ATOMIC_RELEASE);
+	slot->next_free = table->free_head;
+	table->free_head = handle_index(handle) + 1;
+	AUG_UNLOCK(table);
+
+	return obj;
+}
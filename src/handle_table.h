@@ -0,0 +1,69 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUG_HANDLE_TABLE_H
+#define AUG_HANDLE_TABLE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "lock.h"
+
+/* maps opaque handles to objects. a handle encodes a slot index
+ * and the generation of the slot at the time the object was added,
+ * so a handle to a removed object never resolves, even after its
+ * slot has been reused. each slot has an atomic reference count:
+ * handle_table_get/put dont take any lock, and handle_table_remove
+ * waits only for the users of the handle being removed. */
+
+#define AUG_HANDLE_TABLE_CHUNK 64
+#define AUG_HANDLE_TABLE_CHUNKS 64
+
+struct aug_handle_slot {
+	/* generation in the upper 32 bits, then a closing
+	 * bit and the reference count in the lower 31 bits */
+	uint64_t state;
+	void *obj;
+	size_t next_free;
+	pthread_cond_t released;
+	AUG_LOCK_MEMBERS;
+};
+
+struct aug_handle_table {
+	struct aug_handle_slot *chunks[AUG_HANDLE_TABLE_CHUNKS];
+	size_t n_slots;
+	size_t free_head; /* index+1 of the first free slot, 0 if none */
+	AUG_LOCK_MEMBERS;
+};
+
+void handle_table_init(struct aug_handle_table *table);
+/* frees the slots. objects still in the table are not touched. */
+void handle_table_free(struct aug_handle_table *table);
+
+/* returns the handle for @obj, or NULL if the table is full. */
+void *handle_table_add(struct aug_handle_table *table, void *obj);
+/* returns the object for @handle and takes a reference on it, or
+ * returns NULL if @handle was removed (or is being removed). a 
+ * non-NULL result must be released with handle_table_put. */
+void *handle_table_get(struct aug_handle_table *table, const void *handle);
+void handle_table_put(struct aug_handle_table *table, const void *handle);
+/* makes further gets of @handle fail, waits until every reference
+ * to it has been put and then returns its object. returns NULL if
+ * @handle was already removed. must not be called while holding a 
+ * reference to @handle. */
+void *handle_table_remove(struct aug_handle_table *table, const void *handle);
+
+#endif /* AUG_HANDLE_TABLE_H */
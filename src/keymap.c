@@ -18,92 +18,379 @@
 #include "keymap.h"
 #include <stdint.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include <ccan/htable/htable_type.h>
 
 #include "err.h"
+#include "util.h"
 
-struct aug_keymap_desc {
-	aug_on_key_fn on_key;
-	void *user;
+static inline const uint32_t *node_key(const struct aug_keymap_node *node) {
+	return &node->ch;
+}
 
-};
+static inline size_t hash_key(const uint32_t *ch) {
+	return (size_t) (*ch * 2654435761U);
+}
 
-static inline int cmp_addr(const void *a, const void *b) {
-	if(a < b)
-		return -1;
-	else if(a == b)
-		return 0;
+static inline bool node_eq(const struct aug_keymap_node *node, const uint32_t *ch) {
+	return node->ch == *ch;
+}
+
+HTABLE_DEFINE_TYPE(struct aug_keymap_node, node_key, hash_key, node_eq, keymap_wide);
+
+static struct aug_keymap_node *table_get(const struct aug_keymap_table *table, 
+		uint32_t ch) {
+	if(ch < AUG_KEYMAP_DIRECT_SIZE)
+		return (table->direct == NULL)? NULL : table->direct[ch];
 	else
-		return 1;
+		return (table->wide == NULL)? NULL : keymap_wide_get(table->wide, &ch);
 }
 
-void keymap_init(struct aug_keymap *map) {
-	map->avl = avl_new((AvlCompare) cmp_addr);
-	AUG_LOCK_INIT(map);
+static void table_put(struct aug_keymap_table *table, struct aug_keymap_node *node) {
+	if(node->ch < AUG_KEYMAP_DIRECT_SIZE) {
+		if(table->direct == NULL) {
+			table->direct = calloc(AUG_KEYMAP_DIRECT_SIZE, sizeof(*table->direct) );
+			if(table->direct == NULL)
+				err_exit(0, "memory error!");
+		}
+		table->direct[node->ch] = node;
+	}
+	else {
+		if(table->wide == NULL) {
+			table->wide = aug_malloc(sizeof(*table->wide) );
+			keymap_wide_init(table->wide);
+		}
+		if(keymap_wide_add(table->wide, node) == false)
+			err_exit(0, "memory error!");
+	}
+
+	table->size++;
 }
 
-void keymap_free(struct aug_keymap *map) {
-	AvlIter itr;
-	
-	avl_foreach(itr, map->avl) {
-		free(itr.value);
+static void table_free(struct aug_keymap_table *table) {
+	free(table->direct);
+	table->direct = NULL;
+
+	if(table->wide != NULL) {
+		keymap_wide_clear(table->wide);
+		free(table->wide);
+		table->wide = NULL;
 	}
 
-	avl_free(map->avl);
+	table->size = 0;
+}
+
+static void table_del(struct aug_keymap_table *table, struct aug_keymap_node *node) {
+	if(node->ch < AUG_KEYMAP_DIRECT_SIZE) 
+		table->direct[node->ch] = NULL;
+	else if(keymap_wide_del(table->wide, node) == false)
+		err_exit(0, "just found a key node, but now cant delete it from the table?");
 
-	AUG_LOCK_FREE(map);
+	if(--table->size == 0)
+		table_free(table);
 }
 
-void keymap_bind(struct aug_keymap *map, uint32_t ch, aug_on_key_fn on_key,
-					void *user) {
-	struct aug_keymap_desc *desc;
+static void node_init(struct aug_keymap_node *node, uint32_t ch, int timeout) {
+	node->ch = ch;
+	node->on_key = NULL;
+	node->user = NULL;
+	node->flags = 0;
+	node->timeout = timeout;
+	node->next.direct = NULL;
+	node->next.wide = NULL;
+	node->next.size = 0;
+}
 
-	/* unbind this key if it already is bound */
-	keymap_unbind(map, ch);
+/* free the nodes below @node */
+static void node_free_next(struct aug_keymap_node *node) {
+	struct keymap_wide_iter itr;
+	struct aug_keymap_node *child;
+	size_t i;
 
-	desc = malloc( sizeof(struct aug_keymap_desc) );
-	if(desc == NULL)
-		err_exit(0, "memory error!");
+	if(node->next.direct != NULL) {
+		for(i = 0; i < AUG_KEYMAP_DIRECT_SIZE; i++) {
+			if( (child = node->next.direct[i]) == NULL)
+				continue;
+			node_free_next(child);
+			free(child);
+		}
+	}
 
-	desc->on_key = on_key;
-	desc->user = user;
+	if(node->next.wide != NULL) {
+		for(child = keymap_wide_first(node->next.wide, &itr); child != NULL;
+				child = keymap_wide_next(node->next.wide, &itr) ) {
+			node_free_next(child);
+			free(child);
+		}
+	}
+
+	table_free(&node->next);
+}
 
-	avl_insert(map->avl, (void *) (intptr_t) ch, desc);
+/* returns the node at the end of @seq or NULL */
+static const struct aug_keymap_node *walk(const struct aug_keymap *map, 
+		const uint32_t *seq, size_t len) {
+	const struct aug_keymap_node *node;
+	size_t i;
+
+	node = &map->root;
+	for(i = 0; i < len && node != NULL; i++) 
+		node = table_get(&node->next, seq[i]);
+
+	return node;
+}
+
+void keymap_init(struct aug_keymap *map) {
+	node_init(&map->root, 0, 0);
+	map->size = 0;
+	AUG_RWLOCK_INIT(map);
+}
+
+void keymap_free(struct aug_keymap *map) {
+	node_free_next(&map->root);
+	map->size = 0;
+
+	AUG_RWLOCK_FREE(map);
+}
+
+void keymap_bind(struct aug_keymap *map, uint32_t ch, aug_on_key_fn on_key,
+					void *user) {
+	keymap_bind_seq(map, &ch, 1, on_key, user);
 } 
 
 void keymap_binding(struct aug_keymap *map, uint32_t ch, aug_on_key_fn *on_key,
 					void **user) {
-	struct aug_keymap_desc *desc;
+	keymap_binding_seq(map, &ch, 1, on_key, user);
+}
 
-	desc = avl_lookup(map->avl, (void *) (intptr_t) ch);
-	if(desc == NULL) {
+int keymap_unbind(struct aug_keymap *map, uint32_t ch) {
+	return keymap_unbind_seq(map, &ch, 1);
+}
+
+int keymap_bind_seq(struct aug_keymap *map, const uint32_t *seq, size_t len,
+					aug_on_key_fn on_key, void *user) {
+	struct aug_keymap_node *node, *next;
+	size_t i;
+
+	if(len < 1 || len > AUG_KEYMAP_MAX_SEQ)
+		return -1;
+
+	node = &map->root;
+	for(i = 0; i < len; i++) {
+		if( (next = table_get(&node->next, seq[i]) ) == NULL) {
+			next = aug_malloc(sizeof(*next) );
+			node_init(next, seq[i], AUG_KEYMAP_TIMEOUT);
+			table_put(&node->next, next);
+		}
+		node = next;
+	}
+
+	/* overwrite the binding if there already is one */
+	if(node->on_key == NULL)
+		map->size++;
+
+	node->on_key = on_key;
+	node->user = user;
+	node->flags = 0;
+
+	return 0;
+}
+
+void keymap_binding_seq(struct aug_keymap *map, const uint32_t *seq, size_t len,
+					aug_on_key_fn *on_key, void **user) {
+	const struct aug_keymap_node *node;
+
+	node = (len > 0)? walk(map, seq, len) : NULL;
+	if(node == NULL) {
 		*on_key = NULL;
 		if(user != NULL)
 			*user = NULL;
 	}
 	else {
-		*on_key = desc->on_key;
+		*on_key = node->on_key;
 		if(user != NULL)
-			*user = desc->user;
+			*user = node->user;
 	}
 }
 
-int keymap_unbind(struct aug_keymap *map, uint32_t ch) {
-	struct aug_keymap_desc *desc;
+int keymap_unbind_seq(struct aug_keymap *map, const uint32_t *seq, size_t len) {
+	struct aug_keymap_node *path[AUG_KEYMAP_MAX_SEQ+1];
+	size_t i;
 
-	desc = avl_lookup(map->avl, (void *) (intptr_t) ch);
-	if(desc == NULL) {
+	if(len < 1 || len > AUG_KEYMAP_MAX_SEQ)
 		return -1;
+
+	path[0] = &map->root;
+	for(i = 0; i < len; i++) {
+		if( (path[i+1] = table_get(&path[i]->next, seq[i]) ) == NULL)
+			return -1;
 	}
-	
-	if(avl_remove(map->avl, (void *) (intptr_t) ch) == false) 
-		err_exit(0, "just found an object, but now cant delete it from avl tree?");
 
-	free(desc);
+	if(path[len]->on_key == NULL)
+		return -1;
+
+	path[len]->on_key = NULL;
+	path[len]->user = NULL;
+	path[len]->flags = 0;
+	map->size--;
+
+	/* remove the nodes which no longer lead to a binding */
+	for(i = len; i > 0; i--) {
+		if(path[i]->on_key != NULL || path[i]->next.size > 0)
+			break;
+
+		table_del(&path[i-1]->next, path[i]);
+		free(path[i]);
+	}
 
 	return 0;	
 }
 
+int keymap_set_timeout(struct aug_keymap *map, const uint32_t *seq, size_t len,
+					int msecs) {
+	struct aug_keymap_node *node;
+
+	if( (node = (struct aug_keymap_node *) walk(map, seq, len) ) == NULL)
+		return -1;
+
+	node->timeout = msecs;
+	return 0;
+}
+
+int keymap_set_flags(struct aug_keymap *map, const uint32_t *seq, size_t len,
+					int flags) {
+	struct aug_keymap_node *node;
+
+	node = (len > 0)? (struct aug_keymap_node *) walk(map, seq, len) : NULL;
+	if(node == NULL || node->on_key == NULL)
+		return -1;
+
+	node->flags = flags;
+	return 0;
+}
+
 size_t keymap_size(const struct aug_keymap *map) {
-	return avl_count(map->avl);
+	return map->size;
+}
+
+void keymap_state_init(struct aug_keymap_state *state) {
+	state->active = 0;
+	state->len = 0;
+	state->has_deadline = 0;
+	state->on_key = NULL;
+	state->user = NULL;
+	state->flags = 0;
+	state->ch = 0;
+	state->again = 0;
+}
+
+static void set_deadline(struct aug_keymap_state *state, 
+		const struct aug_keymap_node *node, const struct timeval *now) {
+	struct timeval amt;
+
+	if(node->timeout <= 0) {
+		state->has_deadline = 0;
+		return;
+	}
+
+	amt.tv_sec = node->timeout / 1000;
+	amt.tv_usec = (node->timeout % 1000) * 1000;
+	timeradd(now, &amt, &state->deadline);
+	state->has_deadline = 1;
+}
+
+void keymap_start(const struct aug_keymap *map, struct aug_keymap_state *state, 
+					const struct timeval *now) {
+	keymap_state_init(state);
+	state->active = 1;
+	set_deadline(state, &map->root, now);
 }
 
+int keymap_active(const struct aug_keymap_state *state) {
+	return state->active;
+}
+
+static enum keymap_result command(struct aug_keymap_state *state, 
+		const struct aug_keymap_node *node) {
+	state->active = 0;
+	state->on_key = node->on_key;
+	state->user = node->user;
+	state->flags = node->flags;
+	state->ch = node->ch;
+	return KEYMAP_COMMAND;
+}
+
+enum keymap_result keymap_feed(const struct aug_keymap *map, 
+					struct aug_keymap_state *state, uint32_t ch,
+					const struct timeval *now) {
+	const struct aug_keymap_node *node, *next;
+
+	assert(state->active != 0);
+	state->again = 0;
+
+	/* the map may have changed since the last key, so
+	 * look up the sequence from the root each time. */
+	node = walk(map, state->keys, state->len);
+	next = (node != NULL)? table_get(&node->next, ch) : NULL;
+
+	if(next == NULL) {
+		if(node != NULL && state->len > 0 && node->on_key != NULL) {
+			/* the keys before @ch are bound. the
+			 * caller has to handle @ch on its own. */
+			state->again = 1;
+			return command(state, node);
+		}
+
+		state->active = 0;
+		if(state->len < AUG_KEYMAP_MAX_SEQ) 
+			state->keys[state->len++] = ch;
+		else
+			state->again = 1;
+		return KEYMAP_PASS;
+	}
+
+	state->keys[state->len++] = ch;
+	if(next->next.size > 0 && state->len < AUG_KEYMAP_MAX_SEQ) {
+		/* a longer sequence might be coming */
+		set_deadline(state, next, now);
+		return KEYMAP_NONE;
+	}
+
+	if(next->on_key != NULL) 
+		return command(state, next);
+
+	state->active = 0;
+	return KEYMAP_PASS;
+}
+
+enum keymap_result keymap_expire(const struct aug_keymap *map, 
+					struct aug_keymap_state *state, const struct timeval *now) {
+	const struct aug_keymap_node *node;
+
+	if(state->active == 0 || state->has_deadline == 0
+			|| timercmp(now, &state->deadline, <) )
+		return KEYMAP_NONE;
+
+	state->again = 0;
+	node = walk(map, state->keys, state->len);
+	if(node != NULL && state->len > 0 && node->on_key != NULL) 
+		return command(state, node);
+
+	state->active = 0;
+	return KEYMAP_PASS;
+}
+
+int keymap_time_left(const struct aug_keymap_state *state, 
+					const struct timeval *now, struct timeval *remaining) {
+	if(state->active == 0 || state->has_deadline == 0)
+		return -1;
+
+	if(timercmp(now, &state->deadline, <) )
+		timersub(&state->deadline, now, remaining);
+	else
+		timerclear(remaining);
+
+	return 0;
+}
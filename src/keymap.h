@@ -18,13 +18,54 @@
 #ifndef AUG_KEYMAP_H
 #define AUG_KEYMAP_H
 
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/time.h>
+
 #include "aug.h"
 #include "lock.h"
-#include <ccan/avl/avl.h>
+
+/* keys below this value are looked up in a flat array,
+ * anything above goes through a hash table. */
+#define AUG_KEYMAP_DIRECT_SIZE 256
+/* maximum number of keys in a sequence (not counting the
+ * command key) */
+#define AUG_KEYMAP_MAX_SEQ AUG_MAX_KEY_SEQ
+/* default number of milliseconds to wait for the next key
+ * of a sequence. zero means wait forever. */
+#define AUG_KEYMAP_TIMEOUT 1000
+
+struct aug_keymap_node;
+struct keymap_wide;
+
+/* maps a key to the next node of a sequence */
+struct aug_keymap_table {
+	struct aug_keymap_node **direct;
+	struct keymap_wide *wide;
+	size_t size;
+};
+
+/* a node of the key sequence trie. a node is bound if
+ * @on_key is not NULL and it is a prefix of longer
+ * sequences if @next is not empty. */
+struct aug_keymap_node {
+	uint32_t ch;
+	aug_on_key_fn on_key;
+	void *user;
+	int flags; /* AUG_KEY_* flags from aug.h */
+	/* milliseconds to wait for another key after this one 
+	 * before giving up on the longer sequences. */
+	int timeout;
+	struct aug_keymap_table next;
+};
 
 struct aug_keymap {
-	AVL *avl;
-	AUG_LOCK_MEMBERS;
+	/* the root node represents the command key. its 
+	 * timeout defaults to zero, so aug waits forever for
+	 * the key following the command key. */
+	struct aug_keymap_node root;
+	size_t size;
+	AUG_RWLOCK_MEMBERS;
 };
 
 void keymap_init(struct aug_keymap *map);
@@ -43,6 +84,89 @@ void keymap_binding(struct aug_keymap *map, uint32_t ch, aug_on_key_fn *on_key,
  */
 int keymap_unbind(struct aug_keymap *map, uint32_t ch);
 
+/* same as the above functions, but for a sequence of @len
+ * keys following the command key. keymap_bind_seq returns
+ * non-zero if @len is zero or greater than AUG_KEYMAP_MAX_SEQ. */
+int keymap_bind_seq(struct aug_keymap *map, const uint32_t *seq, size_t len,
+					aug_on_key_fn on_key, void *user);
+void keymap_binding_seq(struct aug_keymap *map, const uint32_t *seq, size_t len,
+					aug_on_key_fn *on_key, void **user);
+int keymap_unbind_seq(struct aug_keymap *map, const uint32_t *seq, size_t len);
+
+/* set the number of milliseconds to wait for the key after @seq.
+ * a @len of zero sets the timeout for the key after the command 
+ * key. returns non-zero if @seq is not a prefix of any binding. */
+int keymap_set_timeout(struct aug_keymap *map, const uint32_t *seq, size_t len,
+					int msecs);
+
+/* set the AUG_KEY_* flags of the binding for @seq. returns
+ * non-zero if @seq is not bound. */
+int keymap_set_flags(struct aug_keymap *map, const uint32_t *seq, size_t len,
+					int flags);
+
+/* the number of bound sequences */
 size_t keymap_size(const struct aug_keymap *map);
 
-#endif
\ No newline at end of file
+/* ======== input state machine ========
+ * tracks a key sequence as it is typed. the caller feeds 
+ * each key typed after the command key into keymap_feed and
+ * acts on the result. the state only stores the keys typed so
+ * far, so the map can be changed between calls.
+ */
+enum keymap_result {
+	/* nothing to do (yet) */
+	KEYMAP_NONE = 0,
+	/* the sequence is bound: state->on_key should be
+	 * invoked with state->ch and state->user */
+	KEYMAP_COMMAND,
+	/* the sequence is not bound: the command key followed
+	 * by the state->len keys in state->keys should be passed
+	 * through as ordinary input */
+	KEYMAP_PASS
+};
+
+struct aug_keymap_state {
+	int active;
+	uint32_t keys[AUG_KEYMAP_MAX_SEQ];
+	size_t len;
+	/* when the current prefix times out, if it has a timeout */
+	int has_deadline;
+	struct timeval deadline;
+	/* set when KEYMAP_COMMAND is returned. the bound 
+	 * sequence is left in @keys. */
+	aug_on_key_fn on_key;
+	void *user;
+	int flags;
+	uint32_t ch;
+	/* set when the last key given to keymap_feed was not
+	 * part of the sequence and has to be handled again 
+	 * after acting on the result. */
+	int again;
+};
+
+void keymap_state_init(struct aug_keymap_state *state);
+
+/* called when the command key is typed */
+void keymap_start(const struct aug_keymap *map, struct aug_keymap_state *state, 
+					const struct timeval *now);
+
+/* returns non-zero if a sequence is being typed */
+int keymap_active(const struct aug_keymap_state *state);
+
+/* feed the next key of a sequence. @state must be active. */
+enum keymap_result keymap_feed(const struct aug_keymap *map, 
+					struct aug_keymap_state *state, uint32_t ch,
+					const struct timeval *now);
+
+/* resolve the current sequence if its timeout has expired by @now. 
+ * returns KEYMAP_NONE if nothing has expired. */
+enum keymap_result keymap_expire(const struct aug_keymap *map, 
+					struct aug_keymap_state *state, const struct timeval *now);
+
+/* store the time remaining until the current sequence 
+ * expires in @remaining. returns non-zero if there is
+ * no pending timeout. */
+int keymap_time_left(const struct aug_keymap_state *state, 
+					const struct timeval *now, struct timeval *remaining);
+
+#endif
@@ -20,7 +20,11 @@
 
 #include <pthread.h>
 #include <stdio.h>
+#include <errno.h>
 #include "util.h"
+#include "lock_prof.h"
+#include "trace.h"
+#include "counters.h"
 
 #ifdef AUG_LOCK_DEBUG
 #	include <stdarg.h>
@@ -29,27 +33,71 @@
 
 #ifdef AUG_LOCK_DEBUG
 #	define AUG_LOCK_MEMBERS pthread_mutex_t aug_mtx; \
+		struct aug_lock_hold aug_lock_hold; \
 		int aug_lock_locked; \
 		struct aug_timer aug_lock_tmr; \
 		struct timeval aug_lock_elapsed;		
 #else
-#	define AUG_LOCK_MEMBERS pthread_mutex_t aug_mtx
+#	define AUG_LOCK_MEMBERS pthread_mutex_t aug_mtx; \
+		struct aug_lock_hold aug_lock_hold
 #endif
 
 #ifdef AUG_LOCK_DEBUG
 #	define AUG_LOCK_INIT(_lockable_struct_ptr) \
 		do { \
 			AUG_STATUS_EQUAL( pthread_mutex_init( &(_lockable_struct_ptr)->aug_mtx, NULL ), 0 ); \
+			(_lockable_struct_ptr)->aug_lock_hold.site = NULL; \
 			(_lockable_struct_ptr)->aug_lock_locked = 0; \
 		} while(0)
 #else
 #	define AUG_LOCK_INIT(_lockable_struct_ptr) \
-		AUG_STATUS_EQUAL( pthread_mutex_init( &(_lockable_struct_ptr)->aug_mtx, NULL ), 0 )
+		do { \
+			AUG_STATUS_EQUAL( pthread_mutex_init( &(_lockable_struct_ptr)->aug_mtx, NULL ), 0 ); \
+			(_lockable_struct_ptr)->aug_lock_hold.site = NULL; \
+		} while(0)
 #endif
 
 #define AUG_LOCK_FREE(_lockable_struct_ptr) \
 	AUG_STATUS_EQUAL( pthread_mutex_destroy( &(_lockable_struct_ptr)->aug_mtx ), 0 )
 
+/* take the mutex, counting the acquisition as a lock wait
+ * if another thread holds it. */
+static inline void lock_acquire(pthread_mutex_t *mtx) {
+	int s;
+
+	s = pthread_mutex_trylock(mtx);
+	if(s == 0)
+		return;
+	else if(s != EBUSY)
+		err_exit(s, "pthread_mutex_trylock failed");
+
+	counters_add(AUG_COUNTER_LOCK_WAITS, 1);
+	AUG_STATUS_EQUAL( pthread_mutex_lock(mtx), 0 );
+}
+
+/* take/release the mutex, going through the contention profiler
+ * or the tracer if either is enabled. each expansion of AUG_LOCK 
+ * is its own profiling site. see lock_prof.h and trace.h */
+#define AUG_LOCK_ACQUIRE(_lockable_struct_ptr) \
+	do { \
+		static struct aug_lock_site aug_lock_site = \
+			AUG_LOCK_SITE_INIT( stringify(_lockable_struct_ptr) ); \
+		if(lock_prof_enabled()) \
+			lock_prof_lock( &(_lockable_struct_ptr)->aug_mtx, &aug_lock_site, \
+				&(_lockable_struct_ptr)->aug_lock_hold ); \
+		else if(trace_enabled()) \
+			trace_lock( &(_lockable_struct_ptr)->aug_mtx, aug_lock_site.name ); \
+		else \
+			lock_acquire( &(_lockable_struct_ptr)->aug_mtx ); \
+	} while(0)
+
+#define AUG_LOCK_RELEASE(_lockable_struct_ptr) \
+	do { \
+		if( (_lockable_struct_ptr)->aug_lock_hold.site != NULL ) \
+			lock_prof_release( &(_lockable_struct_ptr)->aug_lock_hold ); \
+		AUG_STATUS_EQUAL( pthread_mutex_unlock( &(_lockable_struct_ptr)->aug_mtx ), 0 ); \
+	} while(0)
+
 #ifdef AUG_LOCK_DEBUG
 static inline int fprint_tid(const char *src, const char *func, int lineno, 
 		FILE *f, pthread_t pt, const char *suffix, ...) {
@@ -106,7 +154,7 @@ static inline int fprint_tid(const char *src, const char *func, int lineno,
 			fprint_tid(__FILE__, __func__, __LINE__, stderr, pthread_self(), \
 				":lock " stringify(_lockable_struct_ptr) ); \
 			AUG_STATUS_EQUAL( timer_init( &(_lockable_struct_ptr)->aug_lock_tmr ), 0); \
-			AUG_STATUS_EQUAL( pthread_mutex_lock( &(_lockable_struct_ptr)->aug_mtx ), 0 ); \
+			AUG_LOCK_ACQUIRE(_lockable_struct_ptr); \
 			AUG_STATUS_EQUAL( timer_elapsed( &(_lockable_struct_ptr)->aug_lock_tmr, \
 				&(_lockable_struct_ptr)->aug_lock_elapsed ), 0); \
 			AUG_LOCK_CHECK_ELAPSED( (_lockable_struct_ptr), \
@@ -118,9 +166,7 @@ static inline int fprint_tid(const char *src, const char *func, int lineno,
 		} while(0)
 #else
 #	define AUG_LOCK(_lockable_struct_ptr) \
-		do { \
-			AUG_STATUS_EQUAL( pthread_mutex_lock( &(_lockable_struct_ptr)->aug_mtx ), 0 ); \
-		} while(0)
+		AUG_LOCK_ACQUIRE(_lockable_struct_ptr)
 #endif
 
 #ifdef AUG_LOCK_DEBUG
@@ -135,13 +181,75 @@ static inline int fprint_tid(const char *src, const char *func, int lineno,
 			AUG_LOCK_CHECK_ELAPSED( (_lockable_struct_ptr), \
 				":held lock on " stringify(_lockable_struct_ptr) \
 				" for %d secs, %d usecs" ); \
-			AUG_STATUS_EQUAL( pthread_mutex_unlock( &(_lockable_struct_ptr)->aug_mtx ), 0 ); \
+			AUG_LOCK_RELEASE(_lockable_struct_ptr); \
 		} while(0)
 #else
 #	define AUG_UNLOCK(_lockable_struct_ptr) \
+		AUG_LOCK_RELEASE(_lockable_struct_ptr)
+#endif
+
+/* read/write locks for resources which are read far more often 
+ * than they are modified. */
+#define AUG_RWLOCK_MEMBERS pthread_rwlock_t aug_rwlock
+
+#define AUG_RWLOCK_INIT(_lockable_struct_ptr) \
+	AUG_STATUS_EQUAL( pthread_rwlock_init( &(_lockable_struct_ptr)->aug_rwlock, NULL ), 0 )
+
+#define AUG_RWLOCK_FREE(_lockable_struct_ptr) \
+	AUG_STATUS_EQUAL( pthread_rwlock_destroy( &(_lockable_struct_ptr)->aug_rwlock ), 0 )
+
+#ifdef AUG_LOCK_DEBUG
+#	define AUG_RWLOCK_DEBUG_PRINT(_fmt) \
+		fprint_tid(__FILE__, __func__, __LINE__, stderr, pthread_self(), _fmt)
+#else
+#	define AUG_RWLOCK_DEBUG_PRINT(_fmt) do {} while(0)
+#endif
+
+#define AUG_RDLOCK(_lockable_struct_ptr) \
+	do { \
+		AUG_RWLOCK_DEBUG_PRINT(":rdlock " stringify(_lockable_struct_ptr) ); \
+		AUG_STATUS_EQUAL( pthread_rwlock_rdlock( &(_lockable_struct_ptr)->aug_rwlock ), 0 ); \
+	} while(0)
+
+#define AUG_WRLOCK(_lockable_struct_ptr) \
+	do { \
+		AUG_RWLOCK_DEBUG_PRINT(":wrlock " stringify(_lockable_struct_ptr) ); \
+		AUG_STATUS_EQUAL( pthread_rwlock_wrlock( &(_lockable_struct_ptr)->aug_rwlock ), 0 ); \
+	} while(0)
+
+/* releases either a read or a write lock */
+#define AUG_RWUNLOCK(_lockable_struct_ptr) \
+	do { \
+		AUG_RWLOCK_DEBUG_PRINT(":rwunlock " stringify(_lockable_struct_ptr) ); \
+		AUG_STATUS_EQUAL( pthread_rwlock_unlock( &(_lockable_struct_ptr)->aug_rwlock ), 0 ); \
+	} while(0)
+
+/* wait on a condition variable with the lock of 
+ * @_lockable_struct_ptr held. the time spent waiting
+ * does not count towards the profiled hold time. */
+#define AUG_COND_WAIT_PROF(_cond_ptr, _lockable_struct_ptr) \
+	do { \
+		struct aug_lock_site *aug_cond_site = (_lockable_struct_ptr)->aug_lock_hold.site; \
+		if(aug_cond_site != NULL) \
+			lock_prof_release( &(_lockable_struct_ptr)->aug_lock_hold ); \
+		AUG_STATUS_EQUAL( pthread_cond_wait( (_cond_ptr), \
+			&(_lockable_struct_ptr)->aug_mtx ), 0 ); \
+		if(aug_cond_site != NULL) \
+			lock_prof_reacquired( &(_lockable_struct_ptr)->aug_lock_hold, aug_cond_site ); \
+	} while(0)
+
+#ifdef AUG_LOCK_DEBUG
+#	define AUG_COND_WAIT(_cond_ptr, _lockable_struct_ptr) \
 		do { \
-			AUG_STATUS_EQUAL( pthread_mutex_unlock( &(_lockable_struct_ptr)->aug_mtx ), 0 ); \
+			(_lockable_struct_ptr)->aug_lock_locked = 0; \
+			AUG_COND_WAIT_PROF(_cond_ptr, _lockable_struct_ptr); \
+			AUG_EQUAL( (_lockable_struct_ptr)->aug_lock_locked, 0 ); \
+			(_lockable_struct_ptr)->aug_lock_locked = 1; \
+			AUG_STATUS_EQUAL( timer_init( &(_lockable_struct_ptr)->aug_lock_tmr ), 0); \
 		} while(0)
+#else
+#	define AUG_COND_WAIT(_cond_ptr, _lockable_struct_ptr) \
+		AUG_COND_WAIT_PROF(_cond_ptr, _lockable_struct_ptr)
 #endif
 
 #endif /* AUG_LOCK_H */
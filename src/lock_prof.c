@@ -0,0 +1,367 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lock_prof.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "util.h"
+#include "trace.h"
+#include "counters.h"
+
+struct site_counts {
+	uint64_t acquired;
+	uint64_t contended;
+	uint64_t wait_ticks;
+	uint64_t hold_ticks;
+	uint32_t wait_hist[AUG_LOCK_PROF_BUCKETS];
+	uint32_t hold_hist[AUG_LOCK_PROF_BUCKETS];
+};
+
+/* each thread only ever writes to its own buffer, so the 
+ * counters dont need atomic increments. they are stored with
+ * relaxed atomics so that lock_prof_dump can read them from
+ * another thread. */
+struct thread_buf {
+	struct site_counts counts[AUG_LOCK_PROF_MAX_SITES];
+	/* set when the owning thread exits. the buffer (and its
+	 * counts, which still belong in the profile) is handed 
+	 * to the next thread which needs one. */
+	int exited;
+	struct thread_buf *next;
+};
+
+int g_lock_prof_enabled = 0;
+
+static __thread struct thread_buf *tl_buf = NULL;
+
+/* this cant be an AUG_LOCK lockable because it
+ * would end up profiling itself. */
+static struct {
+	pthread_mutex_t mtx;
+	pthread_once_t once;
+	pthread_key_t key;
+	struct aug_lock_site *sites[AUG_LOCK_PROF_MAX_SITES];
+	int nsites;
+	struct thread_buf *bufs;
+	double ticks_per_usec;
+} g_prof = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_ONCE_INIT, 0, {NULL}, 0, NULL, 0.0 };
+
+static void on_thread_exit(void *buf) {
+	/* a lock taken by a later destructor on this thread
+	 * gets a buffer of its own. */
+	tl_buf = NULL;
+	__atomic_store_n(&((struct thread_buf *) buf)->exited, 1, __ATOMIC_RELEASE);
+}
+
+static void make_key() {
+	AUG_STATUS_EQUAL( pthread_key_create(&g_prof.key, on_thread_exit), 0 );
+}
+
+/* the time stamp counter where we have one, otherwise
+ * microseconds from gettimeofday. */
+static inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+	uint32_t lo, hi;
+
+	__asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t) hi << 32) | lo;
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (uint64_t) tv.tv_sec*1000000 + tv.tv_usec;
+#endif
+}
+
+static inline uint64_t load(const uint64_t *p) {
+	return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+static inline void add(uint64_t *p, uint64_t n) {
+	__atomic_store_n(p, __atomic_load_n(p, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+static inline void add_hist(uint32_t *hist, uint64_t n) {
+	int b;
+
+	b = (n == 0)? 0 : 63 - __builtin_clzll(n);
+	if(b >= AUG_LOCK_PROF_BUCKETS)
+		b = AUG_LOCK_PROF_BUCKETS - 1;
+
+	__atomic_store_n(&hist[b], __atomic_load_n(&hist[b], __ATOMIC_RELAXED) + 1, 
+		__ATOMIC_RELAXED);
+}
+
+static void calibrate() {
+#if defined(__x86_64__) || defined(__i386__)
+	struct timeval tv0, tv1;
+	uint64_t t0, t1, usecs;
+
+	gettimeofday(&tv0, NULL);
+	t0 = ticks();
+	usleep(10000);
+	gettimeofday(&tv1, NULL);
+	t1 = ticks();
+
+	usecs = (tv1.tv_sec - tv0.tv_sec)*1000000 + (tv1.tv_usec - tv0.tv_usec);
+	g_prof.ticks_per_usec = (usecs > 0)? (double) (t1 - t0)/usecs : 1.0;
+#else
+	g_prof.ticks_per_usec = 1.0;
+#endif
+}
+
+void lock_prof_enable(int enable) {
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_prof.mtx), 0 );
+	if(enable && g_prof.ticks_per_usec == 0.0)
+		calibrate();
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_prof.mtx), 0 );
+
+	__atomic_store_n(&g_lock_prof_enabled, (enable != 0), __ATOMIC_RELAXED);
+}
+
+static int site_id(struct aug_lock_site *site) {
+	int id;
+
+	id = __atomic_load_n(&site->id, __ATOMIC_ACQUIRE);
+	if(id != 0)
+		return id;
+
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_prof.mtx), 0 );
+	id = site->id;
+	if(id == 0) {
+		/* slot 0 is unused so that 0 can mean unregistered */
+		if(g_prof.nsites + 1 < AUG_LOCK_PROF_MAX_SITES) {
+			id = ++g_prof.nsites;
+			g_prof.sites[id] = site;
+		}
+		else
+			id = -1;
+
+		__atomic_store_n(&site->id, id, __ATOMIC_RELEASE);
+	}
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_prof.mtx), 0 );
+
+	return id;
+}
+
+static void thread_buf() {
+	struct thread_buf *buf;
+
+	AUG_STATUS_EQUAL( pthread_once(&g_prof.once, make_key), 0 );
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_prof.mtx), 0 );
+	for(buf = g_prof.bufs; buf != NULL; buf = buf->next) 
+		if(__atomic_load_n(&buf->exited, __ATOMIC_ACQUIRE) != 0)
+			break;
+
+	if(buf == NULL) {
+		if( (buf = calloc(1, sizeof(*buf))) == NULL)
+			err_exit(errno, "failed to allocate lock profile buffer");
+		buf->next = g_prof.bufs;
+		g_prof.bufs = buf;
+	}
+	buf->exited = 0;
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_prof.mtx), 0 );
+
+	AUG_STATUS_EQUAL( pthread_setspecific(g_prof.key, buf), 0 );
+	tl_buf = buf;
+}
+
+static struct site_counts *site_counts(struct aug_lock_site *site) {
+	int id;
+
+	if( (id = site_id(site)) < 0)
+		return NULL;
+
+	if(tl_buf == NULL)
+		thread_buf();
+
+	return &tl_buf->counts[id];
+}
+
+void lock_prof_lock(pthread_mutex_t *mtx, struct aug_lock_site *site, 
+		struct aug_lock_hold *hold) {
+	struct site_counts *c;
+	uint64_t start, now, trace;
+	int s;
+
+	c = site_counts(site);
+	start = ticks();
+	s = pthread_mutex_trylock(mtx);
+	if(s == EBUSY) {
+		counters_add(AUG_COUNTER_LOCK_WAITS, 1);
+		trace = trace_begin();
+		AUG_STATUS_EQUAL( pthread_mutex_lock(mtx), 0 );
+		now = ticks();
+		trace_end(AUG_TRACE_LOCK_WAIT, site->name, trace, 0);
+		if(c != NULL) {
+			add(&c->contended, 1);
+			add(&c->wait_ticks, now - start);
+			add_hist(c->wait_hist, now - start);
+		}
+	}
+	else if(s != 0)
+		err_exit(s, "pthread_mutex_trylock failed");
+	else
+		now = start;
+
+	if(c != NULL) 
+		add(&c->acquired, 1);
+
+	hold->site = (c != NULL)? site : NULL;
+	hold->since = now;
+}
+
+void lock_prof_release(struct aug_lock_hold *hold) {
+	struct site_counts *c;
+	uint64_t held;
+
+	if(hold->site == NULL)
+		return;
+
+	held = ticks() - hold->since;
+	if( (c = site_counts(hold->site)) != NULL) {
+		add(&c->hold_ticks, held);
+		add_hist(c->hold_hist, held);
+	}
+	hold->site = NULL;
+}
+
+void lock_prof_reacquired(struct aug_lock_hold *hold, struct aug_lock_site *site) {
+	hold->site = site;
+	hold->since = ticks();
+}
+
+/* g_prof.mtx must be held */
+static void sum_site(int id, struct site_counts *sum) {
+	struct thread_buf *buf;
+	struct site_counts *c;
+	int i;
+
+	memset(sum, 0, sizeof(*sum));
+	for(buf = g_prof.bufs; buf != NULL; buf = buf->next) {
+		c = &buf->counts[id];
+		sum->acquired += load(&c->acquired);
+		sum->contended += load(&c->contended);
+		sum->wait_ticks += load(&c->wait_ticks);
+		sum->hold_ticks += load(&c->hold_ticks);
+		for(i = 0; i < AUG_LOCK_PROF_BUCKETS; i++) {
+			sum->wait_hist[i] += __atomic_load_n(&c->wait_hist[i], __ATOMIC_RELAXED);
+			sum->hold_hist[i] += __atomic_load_n(&c->hold_hist[i], __ATOMIC_RELAXED);
+		}
+	}
+}
+
+static inline uint64_t ticks_to_usec(uint64_t t) {
+	return (uint64_t) (t/g_prof.ticks_per_usec);
+}
+
+int lock_prof_stats(const char *name, struct aug_lock_prof_stats *stats) {
+	struct site_counts sum;
+	int id, matched;
+
+	memset(stats, 0, sizeof(*stats));
+	matched = 0;
+
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_prof.mtx), 0 );
+	for(id = 1; id <= g_prof.nsites; id++) {
+		if(strcmp(g_prof.sites[id]->name, name) != 0)
+			continue;
+
+		sum_site(id, &sum);
+		stats->acquired += sum.acquired;
+		stats->contended += sum.contended;
+		stats->wait_usec += ticks_to_usec(sum.wait_ticks);
+		stats->hold_usec += ticks_to_usec(sum.hold_ticks);
+		matched++;
+	}
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_prof.mtx), 0 );
+
+	return matched;
+}
+
+static void fprint_hist(FILE *f, const char *label, const uint32_t *hist) {
+	int i;
+
+	fprintf(f, "\t%s:", label);
+	for(i = 0; i < AUG_LOCK_PROF_BUCKETS; i++) {
+		if(hist[i] == 0)
+			continue;
+		/* bucket i holds values in [2^i, 2^(i+1)) ticks */
+		fprintf(f, " <%.1fus:%u", (double) ((uint64_t) 2 << i)/g_prof.ticks_per_usec, 
+			hist[i]);
+	}
+	fputc('\n', f);
+}
+
+void lock_prof_dump(FILE *f) {
+	struct site_counts sum;
+	struct aug_lock_site *site;
+	int id;
+
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_prof.mtx), 0 );
+	fprintf(f, "lock profile: %d sites, %.1f ticks/usec%s\n", g_prof.nsites, 
+		g_prof.ticks_per_usec, lock_prof_enabled()? "" : " (disabled)");
+	for(id = 1; id <= g_prof.nsites; id++) {
+		sum_site(id, &sum);
+		if(sum.acquired == 0)
+			continue;
+
+		site = g_prof.sites[id];
+		fprintf(f, "%s (%s:%d): acquired %llu, contended %llu (%.1f%%), "
+				"waited %lluus, held %lluus\n",
+			site->name, site->file, site->line,
+			(unsigned long long) sum.acquired, 
+			(unsigned long long) sum.contended,
+			100.0*sum.contended/sum.acquired,
+			(unsigned long long) ticks_to_usec(sum.wait_ticks), 
+			(unsigned long long) ticks_to_usec(sum.hold_ticks)
+		);
+		if(sum.contended > 0)
+			fprint_hist(f, "wait", sum.wait_hist);
+		fprint_hist(f, "hold", sum.hold_hist);
+	}
+	if(g_prof.nsites + 1 >= AUG_LOCK_PROF_MAX_SITES)
+		fprintf(f, "warning: ran out of lock sites, some were not profiled\n");
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_prof.mtx), 0 );
+
+	fflush(f);
+}
+
+/* must be called after all threads which took 
+ * profiled locks have exited (or will never lock again) */
+void lock_prof_free() {
+	struct thread_buf *buf, *next;
+
+	lock_prof_enable(0);
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_prof.mtx), 0 );
+	for(buf = g_prof.bufs; buf != NULL; buf = next) {
+		next = buf->next;
+		free(buf);
+	}
+	g_prof.bufs = NULL;
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_prof.mtx), 0 );
+
+	if(tl_buf != NULL) {
+		AUG_STATUS_EQUAL( pthread_setspecific(g_prof.key, NULL), 0 );
+		tl_buf = NULL;
+	}
+}
@@ -0,0 +1,80 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUG_LOCK_PROF_H
+#define AUG_LOCK_PROF_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+/* a contention profiler for the AUG_LOCK/AUG_UNLOCK macros.
+ * every place a lock is taken gets its own statically allocated
+ * aug_lock_site. when the profiler is enabled, acquisitions through
+ * that site are counted in a per thread buffer along with log2 
+ * histograms of how long the thread waited for the lock and how 
+ * long it held it. when disabled, the only cost is a load and a
+ * branch per lock and unlock. the buffers of all threads are summed
+ * up when the profile is dumped. */
+
+#define AUG_LOCK_PROF_MAX_SITES 128
+#define AUG_LOCK_PROF_BUCKETS 32
+
+struct aug_lock_site {
+	const char *name;
+	const char *file;
+	int line;
+	int id; /* 0 until first used, -1 if there was no room for it */
+};
+
+#define AUG_LOCK_SITE_INIT(_name) { (_name), __FILE__, __LINE__, 0 }
+
+/* lives inside every lockable struct. only the thread
+ * holding the lock reads or writes it. */
+struct aug_lock_hold {
+	struct aug_lock_site *site; /* NULL if not being profiled */
+	uint64_t since;
+};
+
+struct aug_lock_prof_stats {
+	uint64_t acquired;
+	uint64_t contended;
+	uint64_t wait_usec; /* total time spent waiting on contended acquisitions */
+	uint64_t hold_usec; /* total time the lock was held */
+};
+
+extern int g_lock_prof_enabled;
+
+static inline int lock_prof_enabled() {
+	return __atomic_load_n(&g_lock_prof_enabled, __ATOMIC_RELAXED);
+}
+
+void lock_prof_enable(int enable);
+void lock_prof_lock(pthread_mutex_t *mtx, struct aug_lock_site *site, 
+		struct aug_lock_hold *hold);
+/* call with the lock still held */
+void lock_prof_release(struct aug_lock_hold *hold);
+/* start a new hold period after a condition wait */
+void lock_prof_reacquired(struct aug_lock_hold *hold, struct aug_lock_site *site);
+
+/* sum the counters of every site named @name into @stats.
+ * returns the number of sites which matched. */
+int lock_prof_stats(const char *name, struct aug_lock_prof_stats *stats);
+void lock_prof_dump(FILE *f);
+void lock_prof_free();
+
+#endif /* AUG_LOCK_PROF_H */
@@ -0,0 +1,451 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+#include "util.h"
+
+struct log_record {
+	uint64_t sec;
+	uint32_t suppressed;
+	int level;
+	char subsys[AUG_LOG_SUBSYS_LEN];
+	char msg[AUG_LOG_MSG_LEN];
+};
+
+/* a single producer (the owning thread) advances @head and 
+ * a single consumer (whoever holds g_log.mtx) advances @tail. */
+struct log_ring {
+	uint64_t head;
+	uint64_t tail;
+	uint64_t dropped;
+	/* set when the owning thread exits. the ring is freed
+	 * once it has been drained, so the owner must not touch
+	 * it after setting this. */
+	int exited;
+	struct log_ring *next;
+	struct log_record records[AUG_LOG_RING_RECORDS];
+};
+
+#define LEVEL_OVERRIDES 16
+
+static const char *const LEVEL_NAMES[AUG_LOG_LEVELS] = {
+	[AUG_LOG_ERROR] = "error",
+	[AUG_LOG_WARN] = "warn",
+	[AUG_LOG_INFO] = "info",
+	[AUG_LOG_DEBUG] = "debug"
+};
+
+/* starts at 1 so that every site resolves its level
+ * the first time it is used */
+unsigned int g_log_gen = 1;
+
+static __thread struct log_ring *tl_ring = NULL;
+
+static struct {
+	/* drains the rings and guards the list of rings */
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	pthread_once_t once;
+	pthread_key_t key;
+	pthread_t writer;
+	int running;
+	/* seconds since the epoch, updated by the writer */
+	uint64_t clock;
+	struct log_ring *rings;
+	/* the timestamp of the last record written */
+	uint64_t stamp_sec;
+	char stamp[32];
+	uint64_t written;
+	uint64_t suppressed;
+	uint64_t dropped; /* by rings which have been freed */
+} g_log = { 
+	.mtx = PTHREAD_MUTEX_INITIALIZER, 
+	.cond = PTHREAD_COND_INITIALIZER, 
+	.once = PTHREAD_ONCE_INIT 
+};
+
+/* the level table is only read when a site resolves its level */
+static struct {
+	pthread_mutex_t mtx;
+	int level;
+	struct {
+		char subsys[AUG_LOG_SUBSYS_LEN];
+		int level;
+	} overrides[LEVEL_OVERRIDES];
+	int n;
+} g_levels = { .mtx = PTHREAD_MUTEX_INITIALIZER, .level = AUG_LOG_INFO };
+
+static inline int running() {
+	return __atomic_load_n(&g_log.running, __ATOMIC_ACQUIRE);
+}
+
+static uint64_t now_sec() {
+	if(running())
+		return __atomic_load_n(&g_log.clock, __ATOMIC_RELAXED);
+
+	return (uint64_t) time(NULL);
+}
+
+void log_site_init(struct aug_log_site *site, int level, const char *subsys) {
+	memset(site, 0, sizeof(*site));
+	site->subsys = subsys;
+	site->level = level;
+}
+
+/* g_levels.mtx must be held */
+static int lookup_level(const char *subsys) {
+	int i;
+
+	for(i = 0; i < g_levels.n; i++)
+		if(strncmp(g_levels.overrides[i].subsys, subsys, AUG_LOG_SUBSYS_LEN) == 0)
+			return g_levels.overrides[i].level;
+
+	return g_levels.level;
+}
+
+void log_site_resolve(struct aug_log_site *site) {
+	unsigned int gen;
+
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_levels.mtx), 0 );
+	gen = log_generation();
+	__atomic_store_n(&site->enabled, (site->level <= lookup_level(site->subsys)), 
+		__ATOMIC_RELAXED);
+	__atomic_store_n(&site->gen, gen, __ATOMIC_RELEASE);
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_levels.mtx), 0 );
+}
+
+int log_level(const char *subsys) {
+	int level;
+
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_levels.mtx), 0 );
+	level = lookup_level(subsys);
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_levels.mtx), 0 );
+
+	return level;
+}
+
+static int parse_level(const char *s, size_t len) {
+	int i;
+
+	for(i = 0; i < AUG_LOG_LEVELS; i++)
+		if(strlen(LEVEL_NAMES[i]) == len && strncmp(LEVEL_NAMES[i], s, len) == 0)
+			return i;
+
+	return -1;
+}
+
+int log_set_levels(const char *spec) {
+	int level, n, i;
+	const char *item, *end, *eq;
+	size_t len;
+	struct {
+		const char *subsys;
+		size_t len;
+		int level;
+	} items[LEVEL_OVERRIDES];
+
+	level = -1;
+	n = 0;
+	for(item = spec; *item != '\0'; item = (*end == ',')? end + 1 : end) {
+		if( (end = strchr(item, ',')) == NULL)
+			end = item + strlen(item);
+		if( (eq = memchr(item, '=', end - item)) == NULL) {
+			if( (level = parse_level(item, end - item)) < 0)
+				return -1;
+			continue;
+		}
+
+		len = eq - item;
+		if(len == 0 || len >= AUG_LOG_SUBSYS_LEN || n >= LEVEL_OVERRIDES)
+			return -1;
+		items[n].subsys = item;
+		items[n].len = len;
+		if( (items[n].level = parse_level(eq + 1, end - eq - 1)) < 0)
+			return -1;
+		n++;
+	}
+
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_levels.mtx), 0 );
+	if(level >= 0)
+		g_levels.level = level;
+	for(i = 0; i < n; i++) {
+		memcpy(g_levels.overrides[i].subsys, items[i].subsys, items[i].len);
+		g_levels.overrides[i].subsys[items[i].len] = '\0';
+		g_levels.overrides[i].level = items[i].level;
+	}
+	g_levels.n = n;
+	/* every site looks its level up again */
+	__atomic_add_fetch(&g_log_gen, 1, __ATOMIC_RELEASE);
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_levels.mtx), 0 );
+
+	return 0;
+}
+
+static void on_thread_exit(void *ring) {
+	/* a destructor which runs after this one and logs gets
+	 * a new ring (and this is called again for that one). */
+	tl_ring = NULL;
+	__atomic_store_n(&((struct log_ring *) ring)->exited, 1, __ATOMIC_RELEASE);
+}
+
+static void make_key() {
+	AUG_STATUS_EQUAL( pthread_key_create(&g_log.key, on_thread_exit), 0 );
+}
+
+static struct log_ring *ring() {
+	struct log_ring *r;
+
+	if(tl_ring != NULL)
+		return tl_ring;
+
+	if( (r = calloc(1, sizeof(*r))) == NULL)
+		err_exit(errno, "failed to allocate log ring");
+
+	AUG_STATUS_EQUAL( pthread_once(&g_log.once, make_key), 0 );
+	AUG_STATUS_EQUAL( pthread_setspecific(g_log.key, r), 0 );
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_log.mtx), 0 );
+	r->next = g_log.rings;
+	g_log.rings = r;
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_log.mtx), 0 );
+
+	tl_ring = r;
+	return r;
+}
+
+static void format_msg(struct log_record *rec, const char *format, va_list args) {
+	int n;
+
+	n = vsnprintf(rec->msg, sizeof(rec->msg), format, args);
+	if(n < 0)
+		snprintf(rec->msg, sizeof(rec->msg), "(bad log format: %s)\n", format);
+	else if( (size_t) n >= sizeof(rec->msg) )
+		strcpy(rec->msg + sizeof(rec->msg) - 5, "...\n");
+}
+
+static void copy_subsys(char *dst, const char *subsys) {
+	strncpy(dst, subsys, AUG_LOG_SUBSYS_LEN - 1);
+	dst[AUG_LOG_SUBSYS_LEN - 1] = '\0';
+}
+
+/* g_log.mtx must be held when the writer is running */
+static void write_record(FILE *f, const struct log_record *rec) {
+	struct tm tm;
+	time_t t;
+
+	if(rec->sec != g_log.stamp_sec || g_log.stamp[0] == '\0') {
+		t = (time_t) rec->sec;
+		g_log.stamp[0] = '\0';
+		if(localtime_r(&t, &tm) != NULL)
+			strftime(g_log.stamp, sizeof(g_log.stamp), "%m.%d %H:%M:%S", &tm);
+		g_log.stamp_sec = rec->sec;
+	}
+
+	if(rec->suppressed > 0)
+		fprintf(f, "%s(%s): suppressed %u similar messages\n", rec->subsys, 
+			g_log.stamp, rec->suppressed);
+	fprintf(f, "%s(%s): %s%s", rec->subsys, g_log.stamp, 
+		(rec->level == AUG_LOG_ERROR)? "error: " : 
+			(rec->level == AUG_LOG_WARN)? "warning: " : "",
+		rec->msg);
+	g_log.written++;
+}
+
+int log_site_vwrite(struct aug_log_site *site, const char *format_str, va_list args) {
+	struct log_ring *r;
+	struct log_record *rec, sync_rec;
+	uint64_t now, head;
+	uint32_t suppressed;
+
+	now = now_sec();
+	if(__atomic_load_n(&site->window, __ATOMIC_RELAXED) != now) {
+		__atomic_store_n(&site->window, now, __ATOMIC_RELAXED);
+		__atomic_store_n(&site->count, 0, __ATOMIC_RELAXED);
+	}
+	if(__atomic_add_fetch(&site->count, 1, __ATOMIC_RELAXED) > AUG_LOG_SITE_BURST) {
+		__atomic_add_fetch(&site->suppressed, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&g_log.suppressed, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+	suppressed = __atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED);
+
+	if(!running()) {
+		rec = &sync_rec;
+		format_msg(rec, format_str, args);
+		rec->sec = now;
+		rec->suppressed = suppressed;
+		rec->level = site->level;
+		copy_subsys(rec->subsys, site->subsys);
+		AUG_STATUS_EQUAL( pthread_mutex_lock(&g_log.mtx), 0 );
+		write_record(stderr, rec);
+		fflush(stderr);
+		AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_log.mtx), 0 );
+		return strlen(rec->msg);
+	}
+
+	r = ring();
+	head = r->head;
+	if(head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) >= AUG_LOG_RING_RECORDS) {
+		__atomic_store_n(&r->dropped, r->dropped + 1, __ATOMIC_RELAXED);
+		/* put the count back for the next message to report */
+		__atomic_add_fetch(&site->suppressed, suppressed, __ATOMIC_RELAXED);
+		return 0;
+	}
+
+	rec = &r->records[head & (AUG_LOG_RING_RECORDS - 1)];
+	format_msg(rec, format_str, args);
+	rec->sec = now;
+	rec->suppressed = suppressed;
+	rec->level = site->level;
+	copy_subsys(rec->subsys, site->subsys);
+	__atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+
+	return strlen(rec->msg);
+}
+
+int log_site_write(struct aug_log_site *site, const char *format, ...) {
+	va_list args;
+	int result;
+
+	va_start(args, format);
+	result = log_site_vwrite(site, format, args);
+	va_end(args);
+
+	return result;
+}
+
+/* g_log.mtx must be held */
+static void drain() {
+	struct log_ring **link, *r;
+	uint64_t head, tail;
+	int wrote;
+
+	wrote = 0;
+	for(link = &g_log.rings; (r = *link) != NULL; ) {
+		head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+		for(tail = r->tail; tail < head; tail++) {
+			write_record(stderr, &r->records[tail & (AUG_LOG_RING_RECORDS - 1)]);
+			wrote = 1;
+		}
+		__atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+
+		/* the owner cant write to it anymore, so once we have 
+		 * the last of its records the ring can go */
+		if(__atomic_load_n(&r->exited, __ATOMIC_ACQUIRE) != 0
+				&& __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == tail) {
+			g_log.dropped += __atomic_load_n(&r->dropped, __ATOMIC_RELAXED);
+			*link = r->next;
+			free(r);
+		}
+		else
+			link = &r->next;
+	}
+
+	if(wrote)
+		fflush(stderr);
+}
+
+static void *writer(void *user) {
+	struct timeval now;
+	struct timespec until;
+	int s;
+	(void)(user);
+
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_log.mtx), 0 );
+	while(running()) {
+		drain();
+
+		if(gettimeofday(&now, NULL) != 0)
+			err_exit(errno, "gettimeofday failed");
+		__atomic_store_n(&g_log.clock, now.tv_sec, __ATOMIC_RELAXED);
+		now.tv_usec += AUG_LOG_WRITE_MSECS*1000;
+		until.tv_sec = now.tv_sec + now.tv_usec/1000000;
+		until.tv_nsec = (now.tv_usec % 1000000)*1000;
+		s = pthread_cond_timedwait(&g_log.cond, &g_log.mtx, &until);
+		if(s != 0 && s != ETIMEDOUT)
+			err_exit(s, "pthread_cond_timedwait failed");
+	}
+	drain();
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_log.mtx), 0 );
+
+	return NULL;
+}
+
+void log_init() {
+	int s;
+
+	__atomic_store_n(&g_log.clock, (uint64_t) time(NULL), __ATOMIC_RELAXED);
+	__atomic_store_n(&g_log.running, 1, __ATOMIC_RELEASE);
+	if( (s = pthread_create(&g_log.writer, NULL, writer, NULL)) != 0)
+		err_exit(s, "failed to create log writer thread");
+}
+
+void log_flush() {
+	/* from err_exit on the writer, which may hold the lock */
+	if(running() && pthread_equal(pthread_self(), g_log.writer) )
+		return;
+
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_log.mtx), 0 );
+	drain();
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_log.mtx), 0 );
+}
+
+void log_stats(struct aug_log_stats *stats) {
+	struct log_ring *r;
+
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_log.mtx), 0 );
+	stats->written = g_log.written;
+	stats->suppressed = __atomic_load_n(&g_log.suppressed, __ATOMIC_RELAXED);
+	stats->dropped = g_log.dropped;
+	for(r = g_log.rings; r != NULL; r = r->next)
+		stats->dropped += __atomic_load_n(&r->dropped, __ATOMIC_RELAXED);
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_log.mtx), 0 );
+}
+
+void log_free() {
+	struct log_ring *r, *next;
+
+	if(!running())
+		return;
+
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_log.mtx), 0 );
+	__atomic_store_n(&g_log.running, 0, __ATOMIC_RELEASE);
+	AUG_STATUS_EQUAL( pthread_cond_signal(&g_log.cond), 0 );
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_log.mtx), 0 );
+	AUG_STATUS_EQUAL( pthread_join(g_log.writer, NULL), 0 );
+
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_log.mtx), 0 );
+	for(r = g_log.rings; r != NULL; r = next) {
+		next = r->next;
+		g_log.dropped += r->dropped;
+		free(r);
+	}
+	g_log.rings = NULL;
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_log.mtx), 0 );
+
+	if(tl_ring != NULL) {
+		AUG_STATUS_EQUAL( pthread_setspecific(g_log.key, NULL), 0 );
+		tl_ring = NULL;
+	}
+}
@@ -0,0 +1,122 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUG_LOG_H
+#define AUG_LOG_H
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+/* a logger which keeps formatting and writing off of the calling 
+ * thread. each thread formats its messages into its own ring of
+ * fixed size records without taking any locks and a writer thread
+ * drains the rings into the debug file (stderr) every 
+ * AUG_LOG_WRITE_MSECS. every place a message is logged from is an
+ * aug_log_site which caches whether its level is enabled and
+ * limits how many messages it logs per second, so a message that
+ * is filtered out or suppressed costs a couple of loads and 
+ * branches. before log_init and after log_free messages are 
+ * written straight to stderr. */
+
+enum aug_log_level {
+	AUG_LOG_ERROR = 0,
+	AUG_LOG_WARN,
+	AUG_LOG_INFO,
+	AUG_LOG_DEBUG,
+	AUG_LOG_LEVELS
+};
+
+#define AUG_LOG_MSG_LEN 240
+#define AUG_LOG_SUBSYS_LEN 32
+/* records per thread. must be a power of 2. */
+#define AUG_LOG_RING_RECORDS 256
+#define AUG_LOG_WRITE_MSECS 20
+/* messages a site may log per second. the rest are counted
+ * and reported along with the next message that gets through. */
+#define AUG_LOG_SITE_BURST 10
+
+struct aug_log_site {
+	const char *subsys;
+	int level;
+	/* the value of log_generation() when @enabled was worked out */
+	unsigned int gen;
+	int enabled;
+	/* rate limiting */
+	uint64_t window;
+	uint32_t count;
+	uint32_t suppressed;
+};
+
+#define AUG_LOG_SITE_INIT(_level, _subsys) { (_subsys), (_level), 0, 0, 0, 0, 0 }
+
+/* log a message from subsystem @_subsys (a string constant) 
+ * at level @_level. each expansion is its own aug_log_site. */
+#define AUG_LOG(_level, _subsys, ...) \
+	do { \
+		static struct aug_log_site aug_log_site = \
+			AUG_LOG_SITE_INIT( (_level), (_subsys) ); \
+		if(log_site_enabled(&aug_log_site)) \
+			log_site_write(&aug_log_site, __VA_ARGS__); \
+	} while(0)
+
+extern unsigned int g_log_gen;
+
+static inline unsigned int log_generation() {
+	return __atomic_load_n(&g_log_gen, __ATOMIC_ACQUIRE);
+}
+
+void log_site_init(struct aug_log_site *site, int level, const char *subsys);
+void log_site_resolve(struct aug_log_site *site);
+
+static inline int log_site_enabled(struct aug_log_site *site) {
+	if(__atomic_load_n(&site->gen, __ATOMIC_ACQUIRE) != log_generation())
+		log_site_resolve(site);
+	return __atomic_load_n(&site->enabled, __ATOMIC_RELAXED);
+}
+
+/* returns the length of the message, or 0 if it was 
+ * suppressed or dropped because the ring was full. */
+int log_site_write(struct aug_log_site *site, const char *format, ...)
+	__attribute__ ((format (printf, 2, 3)));
+int log_site_vwrite(struct aug_log_site *site, const char *format, va_list args);
+
+/* set the levels from @spec, a comma separated list of
+ * LEVEL (the default level) and SUBSYS=LEVEL items where
+ * LEVEL is one of error, warn, info or debug. e.g. 
+ * "warn,attr=debug,reverse=info". returns non-zero if 
+ * @spec cant be parsed, in which case nothing changes. */
+int log_set_levels(const char *spec);
+int log_level(const char *subsys);
+
+struct aug_log_stats {
+	uint64_t written;
+	uint64_t suppressed;
+	uint64_t dropped; /* because a ring was full */
+};
+
+/* start the writer thread */
+void log_init();
+/* write out whatever is in the rings now */
+void log_flush();
+void log_stats(struct aug_log_stats *stats);
+/* stop the writer thread after writing out everything. must
+ * be called after every other thread which logs has exited
+ * (or will never log again). */
+void log_free();
+
+#endif /* AUG_LOG_H */
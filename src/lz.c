@@ -0,0 +1,156 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lz.h"
+
+#include <stdint.h>
+#include <string.h>
+
+static inline uint32_t read32(const uint8_t *p) {
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t hash(uint32_t v) {
+	return (v*2654435761U) >> (32 - AUG_LZ_HASH_BITS);
+}
+
+/* the part of a length which didnt fit in the token */
+static uint8_t *put_len(uint8_t *out, size_t len) {
+	for(; len >= 255; len -= 255)
+		*out++ = 255;
+	*out++ = len;
+	return out;
+}
+
+/* a @match_len of 0 ends the stream */
+static uint8_t *put_seq(uint8_t *out, const uint8_t *lit, size_t lit_len, 
+		size_t offset, size_t match_len) {
+	uint8_t *token;
+
+	token = out++;
+	*token = ( (lit_len >= 15)? 15 : lit_len) << 4;
+	if(lit_len >= 15)
+		out = put_len(out, lit_len - 15);
+	memcpy(out, lit, lit_len);
+	out += lit_len;
+	if(match_len == 0)
+		return out;
+
+	*out++ = offset & 0xff;
+	*out++ = offset >> 8;
+	match_len -= AUG_LZ_MIN_MATCH;
+	*token |= (match_len >= 15)? 15 : match_len;
+	if(match_len >= 15)
+		out = put_len(out, match_len - 15);
+	return out;
+}
+
+size_t lz_compress(const void *src, size_t n, void *dst) {
+	uint32_t table[1 << AUG_LZ_HASH_BITS];
+	const uint8_t *in, *end, *p, *anchor, *ref;
+	uint8_t *out;
+	uint32_t h;
+	size_t len;
+
+	memset(table, 0, sizeof(table));
+	in = src;
+	end = in + n;
+	out = dst;
+	anchor = in;
+	for(p = in; p + AUG_LZ_MIN_MATCH <= end; ) {
+		h = hash(read32(p));
+		ref = in + table[h];
+		table[h] = p - in;
+		if(ref >= p || p - ref > AUG_LZ_MAX_OFFSET || read32(ref) != read32(p) ) {
+			p++;
+			continue;
+		}
+
+		for(len = AUG_LZ_MIN_MATCH; p + len < end && ref[len] == p[len]; len++)
+			;
+		out = put_seq(out, anchor, p - anchor, p - ref, len);
+		p += len;
+		anchor = p;
+	}
+
+	out = put_seq(out, anchor, end - anchor, 0, 0);
+	return out - (uint8_t *) dst;
+}
+
+/* returns -1 if the stream ends in the middle of the length */
+static ssize_t get_len(const uint8_t **in, const uint8_t *end, size_t len) {
+	uint8_t b;
+
+	if(len != 15)
+		return len;
+
+	do {
+		if(*in >= end)
+			return -1;
+		b = *(*in)++;
+		len += b;
+	} while(b == 255);
+
+	return len;
+}
+
+ssize_t lz_decompress(const void *src, size_t n, void *dst, size_t size) {
+	const uint8_t *in, *end, *ref;
+	uint8_t *out, *start, *out_end;
+	ssize_t lit_len, match_len;
+	size_t offset, i;
+	uint8_t token;
+
+	in = src;
+	end = in + n;
+	start = out = dst;
+	out_end = out + size;
+	while(in < end) {
+		token = *in++;
+		if( (lit_len = get_len(&in, end, token >> 4) ) < 0
+				|| lit_len > end - in || lit_len > out_end - out)
+			return -1;
+		memcpy(out, in, lit_len);
+		in += lit_len;
+		out += lit_len;
+		if(in == end) /* the last sequence */
+			return out - start;
+
+		if(end - in < 2)
+			return -1;
+		offset = in[0] | (in[1] << 8);
+		in += 2;
+		if(offset == 0 || offset > (size_t) (out - start) )
+			return -1;
+		if( (match_len = get_len(&in, end, token & 0x0f) ) < 0)
+			return -1;
+		match_len += AUG_LZ_MIN_MATCH;
+		if(match_len > out_end - out)
+			return -1;
+		/* the match may overlap what it is copying */
+		ref = out - offset;
+		for(i = 0; i < (size_t) match_len; i++)
+			out[i] = ref[i];
+		out += match_len;
+	}
+
+	/* the last sequence (which has no match) is missing */
+	return -1;
+}
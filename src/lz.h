@@ -0,0 +1,53 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUG_LZ_H
+#define AUG_LZ_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/* a small LZ77 codec for blocks of recorded terminal output, 
+ * which is mostly repeats of escape sequences and runs of 
+ * blanks. the format is a series of sequences, each of which 
+ * is a token byte (the number of literals in the high nibble 
+ * and the match length minus AUG_LZ_MIN_MATCH in the low 
+ * nibble, 15 meaning more length bytes follow), the literals,
+ * and a little endian 16 bit offset to copy the match from. the 
+ * last sequence has no match. it favors speed over ratio: a 
+ * block is compressed in one pass with a hash table of the 
+ * last position of each 4 byte prefix. */
+
+#define AUG_LZ_MIN_MATCH 4
+#define AUG_LZ_MAX_OFFSET 0xffff
+#define AUG_LZ_HASH_BITS 12
+
+/* the most lz_compress can write for @n bytes of input */
+static inline size_t lz_bound(size_t n) {
+	return n + n/255 + 16;
+}
+
+/* compress @n bytes at @src into @dst, which must have room for
+ * lz_bound(@n) bytes. returns the compressed length. */
+size_t lz_compress(const void *src, size_t n, void *dst);
+
+/* decompress @n bytes at @src into at most @size bytes at @dst.
+ * returns the decompressed length, or -1 if @src is corrupt or
+ * wouldnt fit. */
+ssize_t lz_decompress(const void *src, size_t n, void *dst, size_t size);
+
+#endif /* AUG_LZ_H */
@@ -0,0 +1,338 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mirror.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "util.h"
+#include "err.h"
+
+/* the viewer looks for a new frame this often */
+#define AUG_MIRROR_POLL_MSECS 16
+
+static inline struct aug_session_cell *grid_cell(struct aug_mirror *m, int row, int col) {
+	return &m->cells[row*AUG_MIRROR_MAX_COLS + col];
+}
+
+/* is @fd a mirror? its header is read into @hdr. */
+static int is_mirror(int fd, struct aug_mirror_hdr *hdr) {
+	return pread(fd, hdr, sizeof(*hdr), 0) == sizeof(*hdr) 
+		&& hdr->magic == AUG_MIRROR_MAGIC;
+}
+
+int mirror_open(struct aug_mirror *m, const char *path) {
+	struct aug_mirror_hdr *hdr, old;
+	size_t size;
+	int fd, stale, s;
+	void *addr;
+
+	/* only replace a mirror whose publisher has gone away */
+	if( (fd = open(path, O_RDONLY | O_NOFOLLOW) ) >= 0) {
+		stale = is_mirror(fd, &old) && old.alive == 0;
+		close(fd);
+		if(!stale) {
+			errno = EEXIST;
+			return -1;
+		}
+		if(unlink(path) != 0)
+			return -1;
+	}
+
+	size = mirror_size(AUG_MIRROR_MAX_ROWS, AUG_MIRROR_MAX_COLS);
+	if( (fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR) ) < 0)
+		return -1;
+	if(ftruncate(fd, size) != 0)
+		goto unlink_path;
+	addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(addr == MAP_FAILED)
+		goto unlink_path;
+
+	hdr = addr;
+	hdr->version = AUG_MIRROR_VERSION;
+	hdr->max_rows = AUG_MIRROR_MAX_ROWS;
+	hdr->max_cols = AUG_MIRROR_MAX_COLS;
+	hdr->seq = 0;
+	hdr->alive = 1;
+	hdr->rows = 0;
+	hdr->cols = 0;
+	hdr->cursor_row = 0;
+	hdr->cursor_col = 0;
+	/* the rest of the header has to be there before 
+	 * anyone can take this for a mirror */
+	__atomic_store_n(&hdr->magic, AUG_MIRROR_MAGIC, __ATOMIC_RELEASE);
+
+	m->fd = fd;
+	m->path = path;
+	m->hdr = hdr;
+	m->cells = (struct aug_session_cell *) ((char *) addr + AUG_MIRROR_CELLS_OFF);
+	m->valid = 0;
+	AUG_STATUS_EQUAL( rect_set_init(&m->damage, 0, 0), 0 );
+	return 0;
+
+unlink_path:
+	s = errno;
+	close(fd);
+	unlink(path);
+	errno = s;
+	return -1;
+}
+
+void mirror_close(struct aug_mirror *m) {
+	__atomic_store_n(&m->hdr->alive, 0, __ATOMIC_RELEASE);
+	if(munmap(m->hdr, mirror_size(AUG_MIRROR_MAX_ROWS, AUG_MIRROR_MAX_COLS)) != 0)
+		err_warn(errno, "mirror: munmap failed");
+	close(m->fd);
+	if(unlink(m->path) != 0)
+		err_warn(errno, "mirror: failed to remove %s", m->path);
+	rect_set_free(&m->damage);
+}
+
+void mirror_damage(struct aug_mirror *m, VTermRect rect) {
+	if(m->valid != 0)
+		rect_set_add(&m->damage, rect.start_col, rect.start_row, 
+			rect.end_col, rect.end_row);
+}
+
+/* the seqlock write side. only this thread writes to @seq,
+ * so it can be read without synchronization here. */
+static void write_begin(struct aug_mirror *m) {
+	__atomic_store_n(&m->hdr->seq, m->hdr->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void write_end(struct aug_mirror *m) {
+	__atomic_store_n(&m->hdr->seq, m->hdr->seq + 1, __ATOMIC_RELEASE);
+}
+
+void mirror_frame(struct aug_mirror *m, int rows, int cols,
+		int cursor_row, int cursor_col, aug_session_cell_fn cell, void *user) {
+	struct aug_rect_set_rect rect;
+	size_t row, col;
+	int full, writing;
+
+	if(rows > AUG_MIRROR_MAX_ROWS)
+		rows = AUG_MIRROR_MAX_ROWS;
+	if(cols > AUG_MIRROR_MAX_COLS)
+		cols = AUG_MIRROR_MAX_COLS;
+
+	full = (m->valid == 0 || (uint32_t) rows != m->hdr->rows 
+			|| (uint32_t) cols != m->hdr->cols);
+	writing = 0;
+	if(full != 0 || (uint32_t) cursor_row != m->hdr->cursor_row 
+			|| (uint32_t) cursor_col != m->hdr->cursor_col) {
+		write_begin(m);
+		writing = 1;
+	}
+
+	if(full != 0) {
+		for(row = 0; row < (size_t) rows; row++)
+			for(col = 0; col < (size_t) cols; col++)
+				(*cell)(row, col, grid_cell(m, row, col), user);
+
+		rect_set_free(&m->damage);
+		if(rect_set_init(&m->damage, cols, rows) != 0)
+			err_exit(0, "out of memory");
+		m->valid = 1;
+	}
+	else {
+		while(rect_set_pop(&m->damage, &rect) == 0) {
+			if(writing == 0) {
+				write_begin(m);
+				writing = 1;
+			}
+
+			for(row = rect.row_start; row < rect.row_end; row++) 
+				for(col = rect.col_start; col < rect.col_end; col++) 
+					(*cell)(row, col, grid_cell(m, row, col), user);
+		}
+	}
+
+	if(writing == 0) /* nothing changed, so no new frame */
+		return;
+
+	m->hdr->rows = rows;
+	m->hdr->cols = cols;
+	m->hdr->cursor_row = cursor_row;
+	m->hdr->cursor_col = cursor_col;
+	write_end(m);
+}
+
+/* ================== observers ================== */
+
+int mirror_reader_open(struct aug_mirror_reader *r, const char *path) {
+	const struct aug_mirror_hdr *hdr;
+	struct aug_mirror_hdr first;
+	struct stat st;
+	size_t size;
+	void *addr;
+	int fd, s;
+
+	if( (fd = open(path, O_RDONLY | O_CLOEXEC) ) < 0)
+		return -1;
+	if(fstat(fd, &st) != 0)
+		goto close_fd;
+	if(!is_mirror(fd, &first) || (size_t) st.st_size < sizeof(*hdr)) {
+		errno = EINVAL;
+		goto close_fd;
+	}
+
+	addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if(addr == MAP_FAILED)
+		goto close_fd;
+
+	hdr = addr;
+	size = mirror_size(hdr->max_rows, hdr->max_cols);
+	if(hdr->version != AUG_MIRROR_VERSION || (size_t) st.st_size < size) {
+		munmap(addr, st.st_size);
+		errno = EINVAL;
+		goto close_fd;
+	}
+
+	r->fd = fd;
+	r->hdr = hdr;
+	r->cells = (const struct aug_session_cell *) ((const char *) addr + AUG_MIRROR_CELLS_OFF);
+	r->seq = 0;
+	r->copy = NULL;
+	r->copy_size = 0;
+	return 0;
+
+close_fd:
+	s = errno;
+	close(fd);
+	errno = s;
+	return -1;
+}
+
+void mirror_reader_close(struct aug_mirror_reader *r) {
+	munmap((void *) r->hdr, mirror_size(r->hdr->max_rows, r->hdr->max_cols));
+	close(r->fd);
+	free(r->copy);
+	r->copy = NULL;
+}
+
+int mirror_reader_poll(struct aug_mirror_reader *r, struct aug_session_view *view) {
+	const struct aug_mirror_hdr *hdr;
+	struct aug_session_cell *cell;
+	uint64_t seq;
+	uint32_t rows, cols, cursor_row, cursor_col, row, col;
+	size_t n;
+	int resized;
+
+	hdr = r->hdr;
+	if(__atomic_load_n(&hdr->alive, __ATOMIC_ACQUIRE) == 0)
+		return -1;
+
+	seq = __atomic_load_n(&hdr->seq, __ATOMIC_ACQUIRE);
+	if(seq == r->seq || (seq & 1) != 0)
+		return 0;
+
+	rows = __atomic_load_n(&hdr->rows, __ATOMIC_RELAXED);
+	cols = __atomic_load_n(&hdr->cols, __ATOMIC_RELAXED);
+	cursor_row = __atomic_load_n(&hdr->cursor_row, __ATOMIC_RELAXED);
+	cursor_col = __atomic_load_n(&hdr->cursor_col, __ATOMIC_RELAXED);
+	if(rows > hdr->max_rows || cols > hdr->max_cols)
+		return 0; 
+
+	n = (size_t) rows*cols;
+	if(n > r->copy_size) {
+		free(r->copy);
+		r->copy = aug_malloc(n*sizeof(*r->copy));
+		r->copy_size = n;
+	}
+	for(row = 0; row < rows; row++)
+		memcpy(&r->copy[row*cols], &r->cells[row*hdr->max_cols], 
+			cols*sizeof(*r->copy));
+
+	/* if the publisher started on another frame in the 
+	 * meantime, what we copied may be torn */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if(__atomic_load_n(&hdr->seq, __ATOMIC_RELAXED) != seq)
+		return 0;
+	r->seq = seq;
+
+	resized = ( (int) rows != view->rows || (int) cols != view->cols);
+	if(resized)
+		session_view_resize(view, rows, cols);
+
+	for(row = 0; row < rows; row++) {
+		for(col = 0; col < cols; col++) {
+			cell = &view->cells[row*cols + col];
+			if(!resized && memcmp(cell, &r->copy[row*cols + col], sizeof(*cell)) == 0)
+				continue;
+			*cell = r->copy[row*cols + col];
+			rect_set_on(&view->dirty, col, row);
+		}
+	}
+
+	view->cursor_row = cursor_row;
+	view->cursor_col = cursor_col;
+	return 1;
+}
+
+int mirror_view(const char *path) {
+	struct aug_mirror_reader r;
+	struct aug_session_view view;
+	struct termios saved;
+	struct pollfd pfd;
+	char buf[64];
+	ssize_t n;
+	int status;
+
+	if(mirror_reader_open(&r, path) != 0) {
+		err_warn(errno, "failed to view %s", path);
+		return -1;
+	}
+
+	session_tty_enter(&saved);
+	session_view_init(&view);
+
+	pfd.fd = STDIN_FILENO;
+	pfd.events = POLLIN;
+	status = 0;
+	while(status == 0) {
+		if( (status = mirror_reader_poll(&r, &view) ) == 1) {
+			session_view_render(stdout, &view);
+			status = 0;
+		}
+		else if(status < 0)
+			break;
+
+		if(poll(&pfd, 1, AUG_MIRROR_POLL_MSECS) > 0) {
+			/* this is a read-only view, so keys only quit it */
+			n = read(STDIN_FILENO, buf, sizeof(buf));
+			if(n <= 0 || memchr(buf, 'q', n) != NULL 
+					|| memchr(buf, AUG_SESSION_DETACH_KEY, n) != NULL)
+				status = 1;
+		}
+	}
+
+	session_tty_leave(&saved);
+	printf("[%s %s]\n", (status < 0)? "mirror ended:" : "stopped viewing", path);
+
+	session_view_free(&view);
+	mirror_reader_close(&r);
+	return 0;
+}
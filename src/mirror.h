@@ -0,0 +1,120 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUG_MIRROR_H
+#define AUG_MIRROR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "vterm.h"
+#include "rect_set.h"
+#include "session.h"
+
+/* publishes the primary terminal's screen in a file which any 
+ * number of observers can map read-only (aug --view). the grid is
+ * guarded by a sequence lock: the publisher makes @seq odd before 
+ * it touches the grid and even again afterwards, and an observer 
+ * keeps a copy only if @seq was the same even number before and 
+ * after it copied. observers never write to the segment and the 
+ * publisher never waits for them, so each one costs the I/O loop 
+ * nothing. put the file on a tmpfs (/dev/shm) to keep it off 
+ * the disk. */
+#define AUG_MIRROR_MAGIC 0x7267756d /* "murg" */
+#define AUG_MIRROR_VERSION 2
+/* the grid is sized for the largest screen up front. the file is
+ * sparse, so only the part in use takes up memory. anything beyond
+ * these dimensions isnt published. */
+#define AUG_MIRROR_MAX_ROWS 512
+#define AUG_MIRROR_MAX_COLS 1024
+
+struct aug_mirror_hdr {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t max_rows;
+	uint32_t max_cols;
+	/* odd while the publisher is updating. @seq/2 is the number
+	 * of frames published so far. */
+	uint64_t seq;
+	/* cleared when the publisher goes away */
+	uint32_t alive;
+	uint32_t rows;
+	uint32_t cols;
+	uint32_t cursor_row;
+	uint32_t cursor_col;
+	/* the grid (max_rows*max_cols cells, @cols cells per row
+	 * are used) starts at offset AUG_MIRROR_CELLS_OFF */
+};
+
+#define AUG_MIRROR_CELLS_OFF 64
+
+static inline size_t mirror_size(size_t max_rows, size_t max_cols) {
+	return AUG_MIRROR_CELLS_OFF + max_rows*max_cols*sizeof(struct aug_session_cell);
+}
+
+struct aug_mirror {
+	int fd;
+	const char *path;
+	struct aug_mirror_hdr *hdr;
+	struct aug_session_cell *cells;
+	/* cells which may have changed since the last frame */
+	struct aug_rect_set damage;
+	/* whether the grid is in sync with the screen */
+	int valid;
+};
+
+/* the publisher. the file at @path is created, or replaced if it 
+ * is a mirror which was marked dead. returns -1 (with errno set) 
+ * on failure; errno is EEXIST if @path is something else or a
+ * mirror which is still alive. */
+int mirror_open(struct aug_mirror *m, const char *path);
+/* marks the mirror dead and removes the file */
+void mirror_close(struct aug_mirror *m);
+/* note that @rect of the screen may have changed. the calls below
+ * all need the terminal being mirrored to be locked. */
+void mirror_damage(struct aug_mirror *m, VTermRect rect);
+/* publish the changes since the last frame, if there are any */
+void mirror_frame(struct aug_mirror *m, int rows, int cols,
+		int cursor_row, int cursor_col, aug_session_cell_fn cell, void *user);
+
+/* an observer */
+struct aug_mirror_reader {
+	int fd;
+	const struct aug_mirror_hdr *hdr;
+	const struct aug_session_cell *cells;
+	/* the last frame copied */
+	uint64_t seq;
+	struct aug_session_cell *copy;
+	size_t copy_size;
+};
+
+/* returns -1 (with errno set) if @path cant be mapped or 
+ * isnt a mirror */
+int mirror_reader_open(struct aug_mirror_reader *r, const char *path);
+void mirror_reader_close(struct aug_mirror_reader *r);
+/* copy the latest frame into @view, marking the cells which 
+ * changed as dirty. returns 1 if there was a new frame, 0 if not
+ * (or if it was being written, in which case try again later) 
+ * and -1 if the publisher is gone. */
+int mirror_reader_poll(struct aug_mirror_reader *r, struct aug_session_view *view);
+
+/* the viewer: show the mirror at @path on stdout until the 
+ * publisher goes away or the user types q. returns non-zero 
+ * on failure. */
+int mirror_view(const char *path);
+
+#endif /* AUG_MIRROR_H */
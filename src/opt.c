@@ -126,8 +126,97 @@ const struct opt_desc AUG_OPTIONS[] = {
 		.lopt = {OPT_PLUGIN_PATH, 1, 0, LONG_ONLY_VAL(OPT_PLUGIN_PATH_INDEX)}
 	},
 	{
+#define OPT_LOCK_PROF CONF_LOCK_PROF
+#define OPT_LOCK_PROF_INDEX (OPT_PLUGIN_PATH_INDEX+1)
+		.usage = NULL,
+		.desc = {"profile lock contention. the profile is written to the",
+					"\tdebug file when aug receives SIGUSR1 and on exit.", NULL},
+		.lopt = {OPT_LOCK_PROF, 0, 0, LONG_ONLY_VAL(OPT_LOCK_PROF_INDEX)}
+	},
+	{
+#define OPT_TRACE CONF_TRACE
+#define OPT_TRACE_INDEX (OPT_LOCK_PROF_INDEX+1)
+		.usage = " FILEPATH",
+		.desc = {"trace I/O, rendering, plugin callbacks and lock waits and",
+					"\twrite the trace to FILEPATH (in chrome trace_event format)",
+					"\twhen aug receives SIGUSR1 and on exit.", NULL},
+		.lopt = {OPT_TRACE, 1, 0, LONG_ONLY_VAL(OPT_TRACE_INDEX)}
+	},
+	{
+#define OPT_LOG_LEVEL CONF_LOG_LEVEL
+#define OPT_LOG_LEVEL_INDEX (OPT_TRACE_INDEX+1)
+		.usage = " LEVEL[,SUBSYS=LEVEL]...",
+		.desc = {"the level (error, warn, info or debug) of messages written to",
+					"\tthe debug file, by default and for subsystems or plugins.",
+					"\tdefault: " CONF_LOG_LEVEL_DEFAULT, NULL},
+		.lopt = {OPT_LOG_LEVEL, 1, 0, LONG_ONLY_VAL(OPT_LOG_LEVEL_INDEX)}
+	},
+	{
+#define OPT_STATS_SOCKET CONF_STATS_SOCKET
+#define OPT_STATS_SOCKET_INDEX (OPT_LOG_LEVEL_INDEX+1)
+		.usage = " FILEPATH",
+		.desc = {"serve the performance counters on a unix socket at FILEPATH.",
+					"	each connection is sent a dump of the counters.", NULL},
+		.lopt = {OPT_STATS_SOCKET, 1, 0, LONG_ONLY_VAL(OPT_STATS_SOCKET_INDEX)}
+	},
+	{
+#define OPT_SESSION_SOCKET CONF_SESSION_SOCKET
+#define OPT_SESSION_SOCKET_INDEX (OPT_STATS_SOCKET_INDEX+1)
+		.usage = " FILEPATH",
+		.desc = {"run aug in a server process which outlives this terminal",
+					"	and serve the primary terminal on a unix socket at FILEPATH.",
+					"	this terminal and clients started with --attach FILEPATH",
+					"	see the screen and type into aug.", NULL},
+		.lopt = {OPT_SESSION_SOCKET, 1, 0, LONG_ONLY_VAL(OPT_SESSION_SOCKET_INDEX)}
+	},
+	{
+#define OPT_ATTACH "attach"
+#define OPT_ATTACH_INDEX (OPT_SESSION_SOCKET_INDEX+1)
+		.usage = " FILEPATH",
+		.desc = {"attach this terminal to the aug serving --" CONF_SESSION_SOCKET,
+					"	FILEPATH instead of starting a new aug. type ^\\ to detach.", NULL},
+		.lopt = {OPT_ATTACH, 1, 0, LONG_ONLY_VAL(OPT_ATTACH_INDEX)}
+	},
+	{
+#define OPT_MIRROR CONF_MIRROR
+#define OPT_MIRROR_INDEX (OPT_ATTACH_INDEX+1)
+		.usage = " FILEPATH",
+		.desc = {"publish the primary terminal's screen in FILEPATH (put it",
+					"	on a tmpfs such as /dev/shm) for read-only observers",
+					"	started with --view FILEPATH.", NULL},
+		.lopt = {OPT_MIRROR, 1, 0, LONG_ONLY_VAL(OPT_MIRROR_INDEX)}
+	},
+	{
+#define OPT_VIEW "view"
+#define OPT_VIEW_INDEX (OPT_MIRROR_INDEX+1)
+		.usage = " FILEPATH",
+		.desc = {"watch the screen published by the aug running with",
+					"	--" CONF_MIRROR " FILEPATH instead of starting a new aug.",
+					"	type q to stop watching.", NULL},
+		.lopt = {OPT_VIEW, 1, 0, LONG_ONLY_VAL(OPT_VIEW_INDEX)}
+	},
+	{
+#define OPT_RECORD CONF_RECORD
+#define OPT_RECORD_INDEX (OPT_VIEW_INDEX+1)
+		.usage = " FILEPATH",
+		.desc = {"record the primary terminal to FILEPATH, which must not",
+					"	exist yet. strftime conversions such as %Y%m%d-%H%M%S",
+					"	are filled in. play it back with --play FILEPATH.", NULL},
+		.lopt = {OPT_RECORD, 1, 0, LONG_ONLY_VAL(OPT_RECORD_INDEX)}
+	},
+	{
+#define OPT_PLAY "play"
+#define OPT_PLAY_INDEX (OPT_RECORD_INDEX+1)
+		.usage = " FILEPATH",
+		.desc = {"play the recording at FILEPATH instead of starting a new",
+					"	aug. space pauses, h/l and H/L seek back/forward 10 and",
+					"	60 seconds, 0-9 jump to that tenth of the recording and",
+					"	q quits.", NULL},
+		.lopt = {OPT_PLAY, 1, 0, LONG_ONLY_VAL(OPT_PLAY_INDEX)}
+	},
+	{
 #define OPT_HELP "help"
-#define OPT_HELP_INDEX (OPT_PLUGIN_PATH_INDEX+1)
+#define OPT_HELP_INDEX (OPT_PLAY_INDEX+1)
 		.usage = NULL,
 		.desc = {"display this message.", NULL},
 		.lopt = {OPT_HELP, 0, 0, 'h'}
@@ -293,6 +382,46 @@ int opt_parse(int argc, char *const argv[], struct aug_conf *conf) {
 			OPT_SET(conf->plugin_path, optarg);
 			break;
 
+		case LONG_ONLY_VAL(OPT_LOCK_PROF_INDEX):
+			OPT_SET(conf->lock_prof, true);
+			break;
+
+		case LONG_ONLY_VAL(OPT_TRACE_INDEX):
+			OPT_SET(conf->trace, optarg);
+			break;
+
+		case LONG_ONLY_VAL(OPT_LOG_LEVEL_INDEX):
+			OPT_SET(conf->log_level, optarg);
+			break;
+
+		case LONG_ONLY_VAL(OPT_STATS_SOCKET_INDEX):
+			OPT_SET(conf->stats_socket, optarg);
+			break;
+
+		case LONG_ONLY_VAL(OPT_SESSION_SOCKET_INDEX):
+			OPT_SET(conf->session_socket, optarg);
+			break;
+
+		case LONG_ONLY_VAL(OPT_ATTACH_INDEX):
+			OPT_SET(conf->attach, optarg);
+			break;
+
+		case LONG_ONLY_VAL(OPT_MIRROR_INDEX):
+			OPT_SET(conf->mirror, optarg);
+			break;
+
+		case LONG_ONLY_VAL(OPT_VIEW_INDEX):
+			OPT_SET(conf->view, optarg);
+			break;
+
+		case LONG_ONLY_VAL(OPT_RECORD_INDEX):
+			OPT_SET(conf->record, optarg);
+			break;
+
+		case LONG_ONLY_VAL(OPT_PLAY_INDEX):
+			OPT_SET(conf->play, optarg);
+			break;
+
 #undef OPT_SET
 		case 'h':
 			errno = OPT_ERR_HELP;
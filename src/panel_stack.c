@@ -17,7 +17,42 @@
  */
 #include "panel_stack.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "err.h"
+#include "util.h"
+
+/* where a visible panel was on the screen */
+struct panel_geom {
+	PANEL *panel;
+	int y, x, rows, cols;
+};
+
+/* columns [lo, hi) of a screen row that changed in newscr 
+ * during the current update. empty if lo >= hi. */
+struct row_span {
+	int lo, hi;
+};
+
+struct geom_list {
+	struct panel_geom *items;
+	size_t n;
+	size_t size;
+};
+
+static struct {
+	/* visible panels. kept up to date by push and rm, and 
+	 * resynced by every update in case a plugin hid or showed 
+	 * a panel itself. */
+	int size;
+	/* the stack (bottom to top) as of the last update */
+	struct geom_list last;
+	struct geom_list cur;
+	struct row_span *spans;
+	int n_spans;
+	struct aug_panel_stack_stats stats;
+} g_stack;
 
 void panel_stack_push(struct aug_plugin *plugin, 
 						int nlines, int ncols, int begin_y, int begin_x) {
@@ -34,6 +69,8 @@ void panel_stack_push(struct aug_plugin *plugin,
 
 	if(set_panel_userptr(panel, plugin) == ERR)
 		err_exit(0, "set_panel_userptr failed!");
+
+	g_stack.size++;
 }
 
 inline void panel_stack_top(PANEL **panel) {
@@ -49,14 +86,7 @@ void panel_stack_plugin(const PANEL *panel, const struct aug_plugin **plugin) {
 }
 
 void panel_stack_size(int *size) {
-	int i;
-	PANEL *panel;
-
-	i = 0;
-	PANEL_STACK_FOREACH(panel) {
-		i++;
-	}
-	*size = i;
+	*size = g_stack.size;
 }
 
 void panel_stack_rm(PANEL *panel) {
@@ -65,6 +95,9 @@ void panel_stack_rm(PANEL *panel) {
 	if( (win = panel_window(panel) ) == NULL ) 
 		err_exit(0, "could not get window from panel");
 
+	if(panel_hidden(panel) == FALSE)
+		g_stack.size--;
+
 	if( del_panel(panel) == ERR ) 
 		err_exit(0, "could not delete panel");
 	
@@ -73,6 +106,223 @@ void panel_stack_rm(PANEL *panel) {
 
 }
 
+static void geom_list_push(struct geom_list *list, PANEL *panel) {
+	struct panel_geom *geom;
+	WINDOW *win;
+
+	if(list->n == list->size) {
+		list->size = (list->size > 0)? list->size*2 : 8;
+		list->items = realloc(list->items, list->size*sizeof(*list->items) );
+		if(list->items == NULL)
+			err_exit(0, "out of memory");
+	}
+
+	geom = &list->items[list->n++];
+	win = panel_window(panel);
+	geom->panel = panel;
+	getbegyx(win, geom->y, geom->x);
+	getmaxyx(win, geom->rows, geom->cols);
+}
+
+static inline int geom_same(const struct panel_geom *a, const struct panel_geom *b) {
+	return a->panel == b->panel && a->y == b->y && a->x == b->x 
+		&& a->rows == b->rows && a->cols == b->cols;
+}
+
+static void span_add(struct row_span *span, int lo, int hi) {
+	if(lo < 0)
+		lo = 0;
+	if(hi > COLS)
+		hi = COLS;
+	if(lo >= hi)
+		return;
+
+	if(span->lo >= span->hi) {
+		span->lo = lo;
+		span->hi = hi;
+		return;
+	}
+	if(lo < span->lo)
+		span->lo = lo;
+	if(hi > span->hi)
+		span->hi = hi;
+}
+
+static inline int span_hits(const struct row_span *span, int lo, int hi) {
+	return span->lo < span->hi && span->lo < hi && lo < span->hi;
+}
+
+static void reset_spans() {
+	int i;
+
+	if(g_stack.n_spans != LINES) {
+		g_stack.spans = realloc(g_stack.spans, (LINES > 0? LINES : 1)*sizeof(*g_stack.spans) );
+		if(g_stack.spans == NULL)
+			err_exit(0, "out of memory");
+		g_stack.n_spans = LINES;
+	}
+
+	for(i = 0; i < g_stack.n_spans; i++) {
+		g_stack.spans[i].lo = 0;
+		g_stack.spans[i].hi = 0;
+	}
+}
+
+/* returns 0 if visible panels cover all of screen @row */
+static int uncovered(int row) {
+	const struct panel_geom *g;
+	size_t i;
+	int lo, hi, moved;
+
+	lo = 0;
+	hi = COLS;
+	do {
+		moved = 0;
+		for(i = 0; i < g_stack.cur.n; i++) {
+			g = &g_stack.cur.items[i];
+			if(row < g->y || row >= g->y + g->rows)
+				continue;
+			if(g->x <= lo && lo < g->x + g->cols) {
+				lo = g->x + g->cols;
+				moved = 1;
+			}
+			if(g->x < hi && hi <= g->x + g->cols) {
+				hi = g->x;
+				moved = 1;
+			}
+		}
+	} while(moved != 0 && lo < hi);
+
+	return lo < hi;
+}
+
+/* stdscr has to show through where a panel used to be */
+static void expose(const struct panel_geom *g) {
+	int row;
+
+	for(row = g->y; row < g->y + g->rows; row++) {
+		if(row < 0 || row >= LINES)
+			continue;
+		touchline(stdscr, row, 1);
+		span_add(&g_stack.spans[row], g->x, g->x + g->cols);
+	}
+}
+
+/* compares the stack to what it was at the last update. panels
+ * that were removed, hidden, moved or resized expose what was
+ * under them and panels that are new or moved are drawn in full. 
+ * if the order of the stack changed everything is redone. */
+static void diff_stack() {
+	struct panel_geom *old, *cur;
+	size_t i, j;
+	int reorder;
+
+	reorder = (g_stack.last.n != g_stack.cur.n);
+	for(i = 0; reorder == 0 && i < g_stack.cur.n; i++)
+		if(g_stack.last.items[i].panel != g_stack.cur.items[i].panel)
+			reorder = 1;
+
+	for(i = 0; i < g_stack.last.n; i++) {
+		old = &g_stack.last.items[i];
+		cur = NULL;
+		for(j = 0; reorder == 0 && j < g_stack.cur.n; j++)
+			if(g_stack.cur.items[j].panel == old->panel) {
+				cur = &g_stack.cur.items[j];
+				break;
+			}
+
+		if(cur == NULL || !geom_same(old, cur) )
+			expose(old);
+	}
+
+	for(i = 0; i < g_stack.cur.n; i++) {
+		cur = &g_stack.cur.items[i];
+		old = (reorder == 0)? &g_stack.last.items[i] : NULL;
+		if(old == NULL || !geom_same(old, cur) ) {
+			touchwin(panel_window(cur->panel) );
+			g_stack.stats.redrawn++;
+		}
+	}
+}
+
+/* lines of stdscr that changed go to newscr, except where they 
+ * are completely hidden under panels. panels dont need to be 
+ * redrawn over those lines, and the lines are touched again 
+ * when a panel stops covering them (see expose). curses only
+ * tells us whether a line was touched, not which columns, so
+ * any panel on a line that does go to newscr is redrawn there. */
+static void composite_stdscr() {
+	int row;
+
+	for(row = 0; row < LINES; row++) {
+		if(is_linetouched(stdscr, row) != TRUE)
+			continue;
+
+		if(uncovered(row) == 0) {
+			wtouchln(stdscr, row, 1, 0);
+			g_stack.stats.culled_rows++;
+			continue;
+		}
+		span_add(&g_stack.spans[row], 0, COLS);
+	}
+
+	if(wnoutrefresh(stdscr) == ERR)
+		err_exit(0, "wnoutrefresh failed!");
+}
+
+/* a panel is redrawn on the lines where something under it 
+ * changed in newscr, and what changed in the panel itself is 
+ * something that changed for the panels above. */
+static void composite_panel(const struct panel_geom *g) {
+	WINDOW *win;
+	int row;
+
+	win = panel_window(g->panel);
+	for(row = g->y; row < g->y + g->rows; row++) {
+		if(row < 0 || row >= LINES)
+			continue;
+		if(span_hits(&g_stack.spans[row], g->x, g->x + g->cols) )
+			touchline(win, row - g->y, 1);
+		if(is_linetouched(win, row - g->y) == TRUE)
+			span_add(&g_stack.spans[row], g->x, g->x + g->cols);
+	}
+
+	if(wnoutrefresh(win) == ERR)
+		err_exit(0, "wnoutrefresh failed!");
+}
+
+/* does the job of update_panels(), but only composites rows 
+ * that changed and leaves out stdscr rows that are hidden under 
+ * panels. */
 void panel_stack_update() {
-	update_panels();
-}
\ No newline at end of file
+	struct geom_list tmp;
+	PANEL *panel;
+	size_t i;
+
+	g_stack.cur.n = 0;
+	for(panel = panel_above(NULL); panel != NULL; panel = panel_above(panel) )
+		geom_list_push(&g_stack.cur, panel);
+	g_stack.size = (int) g_stack.cur.n;
+
+	reset_spans();
+	diff_stack();
+	composite_stdscr();
+	for(i = 0; i < g_stack.cur.n; i++)
+		composite_panel(&g_stack.cur.items[i]);
+	g_stack.stats.updates++;
+
+	tmp = g_stack.last;
+	g_stack.last = g_stack.cur;
+	g_stack.cur = tmp;
+}
+
+void panel_stack_stats(struct aug_panel_stack_stats *stats) {
+	*stats = g_stack.stats;
+}
+
+void panel_stack_free() {
+	free(g_stack.last.items);
+	free(g_stack.cur.items);
+	free(g_stack.spans);
+	memset(&g_stack, 0, sizeof(g_stack) );
+}
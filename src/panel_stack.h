@@ -58,7 +58,20 @@ void panel_stack_size(int *size);
  * associated window */
 void panel_stack_rm(PANEL *panel);
 
-/* update the panels */
+/* composite stdscr and the panels into newscr (like 
+ * update_panels() but only for what changed). */
 void panel_stack_update();
 
+struct aug_panel_stack_stats {
+	unsigned long updates;
+	/* stdscr rows left out because panels covered them */
+	unsigned long culled_rows;
+	/* panels redrawn in full because they were new or moved */
+	unsigned long redrawn;
+};
+void panel_stack_stats(struct aug_panel_stack_stats *stats);
+
+/* frees the bookkeeping of panel_stack_update */
+void panel_stack_free();
+
 #endif /* AUG_PANEL_STACK_H */
\ No newline at end of file
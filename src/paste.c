@@ -0,0 +1,169 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "paste.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "util.h"
+
+#define AUG_PASTE_BUF_INIT 4096
+
+static const uint32_t START_MARKER[AUG_PASTE_MARKER_LEN] = {
+	0x1b, '[', '2', '0', '0', '~'
+};
+static const uint32_t END_MARKER[AUG_PASTE_MARKER_LEN] = {
+	0x1b, '[', '2', '0', '1', '~'
+};
+
+void paste_init(struct aug_paste *paste) {
+	paste->in_paste = 0;
+	paste->n_held = 0;
+	paste->n_keys = 0;
+	paste->next_key = 0;
+	paste->buf = NULL;
+	paste->len = 0;
+	paste->size = 0;
+}
+
+void paste_free(struct aug_paste *paste) {
+	free(paste->buf);
+	paste->buf = NULL;
+	paste->size = 0;
+}
+
+static size_t utf8_encode(uint32_t ch, char *out) {
+	if(ch < 0x80) {
+		out[0] = ch;
+		return 1;
+	}
+	else if(ch < 0x800) {
+		out[0] = 0xc0 | (ch >> 6);
+		out[1] = 0x80 | (ch & 0x3f);
+		return 2;
+	}
+	else if(ch < 0x10000) {
+		out[0] = 0xe0 | (ch >> 12);
+		out[1] = 0x80 | ( (ch >> 6) & 0x3f);
+		out[2] = 0x80 | (ch & 0x3f);
+		return 3;
+	}
+	else {
+		out[0] = 0xf0 | ( (ch >> 18) & 0x07);
+		out[1] = 0x80 | ( (ch >> 12) & 0x3f);
+		out[2] = 0x80 | ( (ch >> 6) & 0x3f);
+		out[3] = 0x80 | (ch & 0x3f);
+		return 4;
+	}
+}
+
+static void append_body(struct aug_paste *paste, uint32_t ch) {
+	char *buf;
+
+	if(paste->len + 4 > paste->size) {
+		paste->size = (paste->size == 0)? AUG_PASTE_BUF_INIT : paste->size*2;
+		buf = realloc(paste->buf, paste->size);
+		if(buf == NULL)
+			err_exit(0, "out of memory");
+		paste->buf = buf;
+	}
+
+	paste->len += utf8_encode(ch, paste->buf + paste->len);
+}
+
+static void release_key(struct aug_paste *paste, uint32_t ch) {
+	if(paste->next_key == paste->n_keys) 
+		paste->next_key = paste->n_keys = 0;
+
+	assert(paste->n_keys < AUG_PASTE_MARKER_LEN);
+	paste->keys[paste->n_keys++] = ch;
+}
+
+/* the held characters turned out not to be a marker */
+static void spill_held(struct aug_paste *paste) {
+	size_t i;
+
+	for(i = 0; i < paste->n_held; i++) {
+		if(paste->in_paste)
+			append_body(paste, paste->held[i]);
+		else
+			release_key(paste, paste->held[i]);
+	}
+
+	paste->n_held = 0;
+}
+
+int paste_feed(struct aug_paste *paste, uint32_t ch) {
+	const uint32_t *marker;
+
+	marker = (paste->in_paste)? END_MARKER : START_MARKER;
+	if(ch == marker[paste->n_held]) {
+		paste->held[paste->n_held++] = ch;
+		if(paste->n_held < AUG_PASTE_MARKER_LEN)
+			return 0;
+
+		paste->n_held = 0;
+		if(paste->in_paste == 0) {
+			paste->in_paste = 1;
+			paste->len = 0;
+			return 0;
+		}
+
+		paste->in_paste = 0;
+		return 1;
+	}
+
+	spill_held(paste);
+	/* only the first character of a marker is an escape, so
+	 * @ch is the only thing that could start a new match */
+	if(ch == marker[0])
+		paste->held[paste->n_held++] = ch;
+	else if(paste->in_paste)
+		append_body(paste, ch);
+	else
+		release_key(paste, ch);
+
+	return 0;
+}
+
+int paste_key(struct aug_paste *paste, uint32_t *ch) {
+	if(paste->next_key == paste->n_keys)
+		return -1;
+
+	*ch = paste->keys[paste->next_key++];
+	return 0;
+}
+
+int paste_release(struct aug_paste *paste) {
+	if(paste->in_paste != 0 || paste->n_held == 0)
+		return -1;
+
+	spill_held(paste);
+	return 0;
+}
+
+void paste_clear(struct aug_paste *paste) {
+	paste->len = 0;
+	/* dont hang on to the memory from a huge paste */
+	if(paste->size > AUG_PASTE_BUF_INIT) {
+		free(paste->buf);
+		paste->buf = NULL;
+		paste->size = 0;
+	}
+}
@@ -0,0 +1,75 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUG_PASTE_H
+#define AUG_PASTE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* xterm bracketed paste mode (DECSET 2004). while it is on, the 
+ * terminal wraps anything the user pastes in AUG_PASTE_START and 
+ * AUG_PASTE_END so that we can tell pasted text from typed text. */
+#define AUG_PASTE_ENABLE "\033[?2004h"
+#define AUG_PASTE_DISABLE "\033[?2004l"
+#define AUG_PASTE_MARKER_LEN 6 /* strlen("\033[200~") */
+
+/* splits a stream of input characters into ordinary keys and the
+ * bodies of bracketed pastes. every character read from the input
+ * goes into paste_feed. characters that are not part of a paste come
+ * back out of paste_key in the same order they went in, though 
+ * they may be held back for a few characters while a possible 
+ * paste marker is being matched. */
+struct aug_paste {
+	int in_paste;
+	/* characters of a partially matched start or end marker */
+	uint32_t held[AUG_PASTE_MARKER_LEN];
+	size_t n_held;
+	/* ordinary keys waiting to be popped by paste_key */
+	uint32_t keys[AUG_PASTE_MARKER_LEN];
+	size_t n_keys;
+	size_t next_key;
+	/* utf-8 encoded body of the current paste */
+	char *buf;
+	size_t len;
+	size_t size;
+};
+
+void paste_init(struct aug_paste *paste);
+void paste_free(struct aug_paste *paste);
+
+/* feed the next character of input into @paste. returns 1 if @ch
+ * completed a paste, in which case @paste->buf holds the @paste->len 
+ * bytes of the paste body until the next call to paste_clear. 
+ * returns 0 otherwise. this should only be called once paste_key
+ * has run out of keys. */
+int paste_feed(struct aug_paste *paste, uint32_t ch);
+
+/* pop the next ordinary key into @ch. returns non-zero if no 
+ * keys are waiting. */
+int paste_key(struct aug_paste *paste, uint32_t *ch);
+
+/* call this when the input has no more characters to give. an 
+ * escape that isnt followed by the rest of a paste marker is just
+ * an escape key, so any partially matched start marker is released
+ * to paste_key. returns non-zero if nothing was released. */
+int paste_release(struct aug_paste *paste);
+
+/* discard the body of the last completed paste. */
+void paste_clear(struct aug_paste *paste);
+
+#endif /* AUG_PASTE_H */
@@ -32,7 +32,7 @@ static const char ERR_NAME_MISMATCH[] = "name mismatch";
 
 void plugin_list_init(struct aug_plugin_list *pl) {
 	list_head_init(&pl->head);
-	AUG_LOCK_INIT(pl);
+	AUG_RWLOCK_INIT(pl);
 }
 
 void plugin_list_free(struct aug_plugin_list *pl) {
@@ -44,7 +44,7 @@ void plugin_list_free(struct aug_plugin_list *pl) {
 		free(i);
 	}
 
-	AUG_LOCK_FREE(pl);
+	AUG_RWLOCK_FREE(pl);
 }
 
 /* returns non-zero and sets *err_msg* (if *err_msg* non-null) if
@@ -104,6 +104,7 @@ int plugin_list_push(struct aug_plugin_list *pl, const char *path, const char *n
 	//memset(&item->plugin.callbacks, 0, sizeof( struct aug_plugin_cb ) );
 	item->plugin.callbacks = NULL;
 	item->plugin.so_handle = handle;
+	log_site_init(&item->log_site, AUG_LOG_INFO, so_name);
 	
 	list_add_tail(&pl->head, &item->node);
 
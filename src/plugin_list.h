@@ -18,21 +18,31 @@
 #ifndef AUG_PLUGIN_LIST_H
 #define AUG_PLUGIN_LIST_H
 
+#include <stddef.h>
 #include "aug.h"
 #include <ccan/list/list.h>
 #include "lock.h"
+#include "log.h"
 
 /* ccan list structures */
 struct aug_plugin_list {
 	struct list_head head;
-	AUG_LOCK_MEMBERS;	
+	AUG_RWLOCK_MEMBERS;	
 };
 
 struct aug_plugin_item {
 	struct aug_plugin plugin;	
 	struct list_node node;
+	/* where the messages of the plugin are logged from. the
+	 * subsystem is the name of the plugin. */
+	struct aug_log_site log_site;
 };
 
+static inline struct aug_plugin_item *plugin_list_item(struct aug_plugin *plugin) {
+	return (struct aug_plugin_item *) 
+		( (char *) plugin - offsetof(struct aug_plugin_item, plugin) );
+}
+
 
 #define PLUGIN_LIST_FOREACH(_list_ptr, _item_ptr) \
 	list_for_each( &(_list_ptr)->head, _item_ptr, node)
@@ -0,0 +1,203 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "proc_events.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "err.h"
+#include "util.h"
+
+#if defined(__linux__)
+#	include <sys/epoll.h>
+#	include <sys/signalfd.h>
+#	include <sys/syscall.h>
+#	if !defined(SYS_pidfd_open)
+#		define SYS_pidfd_open 434
+#	endif
+
+/* the epoll data of a pidfd is the fd and the pid, that of
+ * the signalfd is all ones (no child has pid -1). */
+#define SIGFD_DATA UINT64_MAX
+#define PIDFD_DATA(_fd, _pid) 	( ( (uint64_t) (uint32_t) (_fd) << 32) | (uint32_t) (_pid) )
+
+static int pidfd_open(pid_t pid) {
+	return syscall(SYS_pidfd_open, pid, 0);
+}
+
+int proc_events_init(struct aug_proc_events *pe, const sigset_t *sigs) {
+	struct epoll_event ev;
+	int fd;
+
+	if( (pe->epfd = epoll_create1(EPOLL_CLOEXEC) ) < 0)
+		return -1;
+	if( (pe->sigfd = signalfd(-1, sigs, SFD_NONBLOCK|SFD_CLOEXEC) ) < 0)
+		goto close_ep;
+
+	ev.events = EPOLLIN;
+	ev.data.u64 = SIGFD_DATA;
+	if(epoll_ctl(pe->epfd, EPOLL_CTL_ADD, pe->sigfd, &ev) != 0)
+		goto close_sig;
+
+	/* see if this kernel has pidfds */
+	if( (fd = pidfd_open(getpid()) ) >= 0) {
+		close(fd);
+		pe->pidfds = 1;
+	}
+	else
+		pe->pidfds = 0;
+
+	return 0;
+
+close_sig:
+	close(pe->sigfd);
+close_ep:
+	close(pe->epfd);
+	return -1;
+}
+
+void proc_events_free(struct aug_proc_events *pe) {
+	/* closing the epoll fd doesnt close the pidfds of 
+	 * children that are still running, but we are exiting 
+	 * anyway at this point. */
+	if(close(pe->sigfd) != 0)
+		err_warn(errno, "failed to close signalfd");
+	if(close(pe->epfd) != 0)
+		err_warn(errno, "failed to close epoll fd");
+}
+
+int proc_events_watch(struct aug_proc_events *pe, pid_t pid) {
+	struct epoll_event ev;
+	int fd;
+
+	if(pe->pidfds == 0)
+		return -1;
+
+	if( (fd = pidfd_open(pid) ) < 0)
+		return -1;
+
+	ev.events = EPOLLIN;
+	ev.data.u64 = PIDFD_DATA(fd, pid);
+	if(epoll_ctl(pe->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void dispatch_signals(struct aug_proc_events *pe, 
+		void (*on_signal)(int, void *), void *user) {
+	struct signalfd_siginfo info;
+	ssize_t n;
+
+	while( (n = read(pe->sigfd, &info, sizeof(info)) ) == sizeof(info) )
+		(*on_signal)(info.ssi_signo, user);
+
+	if(n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		err_exit(errno, "failed to read signalfd");
+}
+
+static void dispatch_exit(uint64_t data,
+		void (*on_exit)(pid_t, int, void *), void *user) {
+	int fd, status;
+	pid_t pid;
+
+	fd = (int) (data >> 32);
+	pid = (pid_t) (uint32_t) data;
+
+	while( (pid = waitpid(pid, &status, WNOHANG) ) < 0 && errno == EINTR)
+		pid = (pid_t) (uint32_t) data;
+
+	/* a pidfd only becomes readable once the child has exited */
+	if(pid == 0)
+		return;
+	/* closing the pidfd also takes it out of the epoll set */
+	if(close(fd) != 0)
+		err_warn(errno, "failed to close pidfd");
+	if(pid < 0) {
+		if(errno != ECHILD)
+			err_exit(errno, "waitpid caused an error");
+		return;
+	}
+
+	(*on_exit)(pid, status, user);
+}
+
+void proc_events_dispatch(struct aug_proc_events *pe, 
+		void (*on_signal)(int signum, void *user), 
+		void (*on_exit)(pid_t pid, int status, void *user), void *user) {
+	struct epoll_event evs[16];
+	int i, n;
+
+	while( (n = epoll_wait(pe->epfd, evs, AUG_ARRAY_SIZE(evs), 0) ) != 0) {
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			err_exit(errno, "epoll_wait failed");
+		}
+
+		for(i = 0; i < n; i++) {
+			if(evs[i].data.u64 == SIGFD_DATA)
+				dispatch_signals(pe, on_signal, user);
+			else
+				dispatch_exit(evs[i].data.u64, on_exit, user);
+		}
+
+		if(n < (int) AUG_ARRAY_SIZE(evs))
+			break;
+	}
+}
+
+#else /* !defined(__linux__) */
+
+int proc_events_init(struct aug_proc_events *pe, const sigset_t *sigs) {
+	(void)(pe);
+	(void)(sigs);
+
+	errno = ENOSYS;
+	return -1;
+}
+
+void proc_events_free(struct aug_proc_events *pe) {
+	(void)(pe);
+}
+
+int proc_events_watch(struct aug_proc_events *pe, pid_t pid) {
+	(void)(pe);
+	(void)(pid);
+
+	return -1;
+}
+
+void proc_events_dispatch(struct aug_proc_events *pe, 
+		void (*on_signal)(int signum, void *user), 
+		void (*on_exit)(pid_t pid, int status, void *user), void *user) {
+	(void)(pe);
+	(void)(on_signal);
+	(void)(on_exit);
+	(void)(user);
+}
+
+#endif
+
+int proc_events_fd(const struct aug_proc_events *pe) {
+	return pe->epfd;
+}
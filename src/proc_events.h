@@ -0,0 +1,60 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUG_PROC_EVENTS_H
+#define AUG_PROC_EVENTS_H
+
+#include <signal.h>
+#include <sys/types.h>
+
+/* delivers signals and the exits of child processes through a 
+ * single file descriptor, so that an event loop can handle them 
+ * alongside its other I/O instead of through dedicated sigwait 
+ * threads. signals go through a signalfd and each watched child 
+ * gets its own pidfd, so an exit is reaped with a waitpid on 
+ * exactly that pid. this needs linux (pidfds need 5.3 or later), 
+ * elsewhere proc_events_init fails and the caller has to fall 
+ * back to sigwait. */
+struct aug_proc_events {
+	int epfd;
+	int sigfd;
+	/* whether child exits can be watched with pidfds. if not,
+	 * SIGCHLD should be part of the signals and the caller 
+	 * has to reap children itself. */
+	int pidfds;
+};
+
+/* the signals in @sigs must already be blocked in every thread.
+ * returns -1 (with errno set) if signalfd isnt available. */
+int proc_events_init(struct aug_proc_events *pe, const sigset_t *sigs);
+void proc_events_free(struct aug_proc_events *pe);
+
+/* becomes readable when proc_events_dispatch has something to do */
+int proc_events_fd(const struct aug_proc_events *pe);
+
+/* watch for the exit of child @pid. returns -1 if pidfds
+ * arent available. */
+int proc_events_watch(struct aug_proc_events *pe, pid_t pid);
+
+/* handle whatever is pending without blocking: @on_signal is
+ * called for each delivered signal and @on_exit for each watched
+ * child that exited, after it has been reaped. */
+void proc_events_dispatch(struct aug_proc_events *pe, 
+		void (*on_signal)(int signum, void *user), 
+		void (*on_exit)(pid_t pid, int status, void *user), void *user);
+
+#endif /* AUG_PROC_EVENTS_H */
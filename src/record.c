@@ -0,0 +1,615 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "record.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "util.h"
+#include "err.h"
+#include "lz.h"
+
+/* larger blocks than this can only come from a corrupt file */
+#define MAX_BLOCK (1 << 28)
+
+static uint64_t usecs_since(const struct timeval *start) {
+	struct timeval now, diff;
+
+	if(gettimeofday(&now, NULL) != 0)
+		err_exit(errno, "gettimeofday failed");
+	timersub(&now, start, &diff);
+	return (uint64_t) diff.tv_sec*1000000 + diff.tv_usec;
+}
+
+static void *grow(void *buf, size_t *size, size_t need) {
+	if(need <= *size)
+		return buf;
+
+	if(*size == 0)
+		*size = 4096;
+	while(*size < need)
+		*size *= 2;
+	if( (buf = realloc(buf, *size) ) == NULL)
+		err_exit(ENOMEM, "record: failed to grow a buffer to %zu bytes", *size);
+	return buf;
+}
+
+/* ================== the I/O loop side ================== */
+
+static void ring_put(struct aug_recorder *rec, uint64_t at, const void *data, size_t n) {
+	size_t off, first;
+
+	off = at & (AUG_RECORD_RING_SIZE - 1);
+	first = AUG_RECORD_RING_SIZE - off;
+	if(first > n)
+		first = n;
+	memcpy(rec->ring + off, data, first);
+	memcpy(rec->ring, (const unsigned char *) data + first, n - first);
+}
+
+static void push(struct aug_recorder *rec, uint32_t type, const void *data, size_t len) {
+	struct aug_record_event ev;
+	uint64_t head;
+	size_t size;
+
+	size = sizeof(ev) + AUG_RECORD_PAD(len);
+	head = rec->head;
+	if(size > AUG_RECORD_RING_SIZE - (head - __atomic_load_n(&rec->tail, __ATOMIC_ACQUIRE)) ) {
+		__atomic_fetch_add(&rec->lost, size, __ATOMIC_RELAXED);
+		return;
+	}
+
+	ev.usec = usecs_since(&rec->start);
+	ev.type = type;
+	ev.len = len;
+	ring_put(rec, head, &ev, sizeof(ev));
+	ring_put(rec, head + sizeof(ev), data, len);
+	__atomic_store_n(&rec->head, head + size, __ATOMIC_RELEASE);
+}
+
+void record_output(struct aug_recorder *rec, const char *buf, size_t n) {
+	push(rec, AUG_RECORD_OUTPUT, buf, n);
+}
+
+void record_input(struct aug_recorder *rec, uint32_t ch) {
+	push(rec, AUG_RECORD_INPUT, &ch, sizeof(ch));
+}
+
+void record_resize(struct aug_recorder *rec, int rows, int cols) {
+	struct aug_record_dims dims;
+
+	if(rows == rec->rows && cols == rec->cols)
+		return;
+
+	rec->rows = rows;
+	rec->cols = cols;
+	dims.rows = rows;
+	dims.cols = cols;
+	push(rec, AUG_RECORD_RESIZE, &dims, sizeof(dims));
+}
+
+/* ================== the writer ================== */
+
+static void ring_get(const struct aug_recorder *rec, uint64_t at, void *data, size_t n) {
+	size_t off, first;
+
+	off = at & (AUG_RECORD_RING_SIZE - 1);
+	first = AUG_RECORD_RING_SIZE - off;
+	if(first > n)
+		first = n;
+	memcpy(data, rec->ring + off, first);
+	memcpy( (unsigned char *) data + first, rec->ring, n - first);
+}
+
+/* append an event to the block and return where its @len 
+ * bytes of data go */
+static unsigned char *block_event(struct aug_recorder *rec, uint64_t usec, 
+		uint32_t type, size_t len) {
+	struct aug_record_event ev;
+	unsigned char *data;
+
+	rec->block = grow(rec->block, &rec->block_size, 
+		rec->block_len + sizeof(ev) + AUG_RECORD_PAD(len) );
+	ev.usec = usec;
+	ev.type = type;
+	ev.len = len;
+	memcpy(rec->block + rec->block_len, &ev, sizeof(ev));
+	data = rec->block + rec->block_len + sizeof(ev);
+	memset(data + len, 0, AUG_RECORD_PAD(len) - len);
+	rec->block_len += sizeof(ev) + AUG_RECORD_PAD(len);
+	rec->block_end = usec;
+
+	return data;
+}
+
+static void put_keyframe(struct aug_recorder *rec, uint64_t usec) {
+	struct aug_record_keyframe kf;
+	struct aug_session_cell *cells;
+	VTermScreenCell vcell;
+	VTermScreen *vts;
+	VTermPos pos, cursor;
+	unsigned char *data;
+	int rows, cols;
+
+	term_dims(&rec->shadow, &rows, &cols);
+	vterm_state_get_cursorpos(vterm_obtain_state(rec->shadow.vt), &cursor);
+	kf.rows = rows;
+	kf.cols = cols;
+	kf.cursor_row = cursor.row;
+	kf.cursor_col = cursor.col;
+
+	data = block_event(rec, usec, AUG_RECORD_KEYFRAME, 
+		sizeof(kf) + (size_t) rows*cols*sizeof(*cells) );
+	memcpy(data, &kf, sizeof(kf));
+	cells = (struct aug_session_cell *) (data + sizeof(kf));
+	vts = vterm_obtain_screen(rec->shadow.vt);
+	for(pos.row = 0; pos.row < rows; pos.row++) {
+		for(pos.col = 0; pos.col < cols; pos.col++) {
+			if( !vterm_screen_get_cell(vts, pos, &vcell) )
+				err_exit(0, "get_cell returned false status\n");
+			session_cell_from_vterm(&vcell, &cells[pos.row*cols + pos.col]);
+		}
+	}
+}
+
+/* compress and write out a block. returns -1 if it couldnt be 
+ * written, in which case the recording is over. */
+static int write_block(struct aug_recorder *rec, uint32_t type, uint64_t start, 
+		uint64_t end, const void *data, size_t len) {
+	struct aug_record_block_hdr hdr;
+
+	if(rec->failed != 0)
+		return -1;
+
+	rec->comp = grow(rec->comp, &rec->comp_size, lz_bound(len) );
+	hdr.magic = AUG_RECORD_BLOCK_MAGIC;
+	hdr.type = type;
+	hdr.start_usec = start;
+	hdr.end_usec = end;
+	hdr.raw_len = len;
+	hdr.comp_len = lz_compress(data, len, rec->comp);
+	if(write_all(rec->fd, &hdr, sizeof(hdr) ) != 0 
+			|| write_all(rec->fd, rec->comp, hdr.comp_len) != 0) {
+		err_warn(errno, "record: failed to write to %s, recording stopped", rec->path);
+		rec->failed = 1;
+		return -1;
+	}
+
+	rec->offset += sizeof(hdr) + hdr.comp_len;
+	return 0;
+}
+
+static void close_block(struct aug_recorder *rec) {
+	struct aug_record_index_entry *entry;
+	uint64_t offset;
+
+	if(rec->block_len == 0)
+		return;
+
+	offset = rec->offset;
+	if(write_block(rec, AUG_RECORD_BLOCK_EVENTS, rec->block_start, 
+			rec->block_end, rec->block, rec->block_len) == 0) {
+		rec->index = grow(rec->index, &rec->index_size, 
+			(rec->n_index + 1)*sizeof(*rec->index) );
+		entry = &rec->index[rec->n_index++];
+		entry->start_usec = rec->block_start;
+		entry->end_usec = rec->block_end;
+		entry->offset = offset;
+	}
+	rec->block_len = 0;
+}
+
+/* every block starts with the screen as it was before the 
+ * first event in it */
+static void open_block(struct aug_recorder *rec, uint64_t usec) {
+	rec->block_start = usec;
+	put_keyframe(rec, usec);
+}
+
+/* keep the shadow terminal in step with the recorded one */
+static void shadow_event(struct aug_recorder *rec, 
+		const struct aug_record_event *ev, const unsigned char *data) {
+	struct aug_record_dims dims;
+	char discard[256];
+
+	switch(ev->type) {
+	case AUG_RECORD_OUTPUT:
+		vterm_push_bytes(rec->shadow.vt, (const char *) data, ev->len);
+		/* nobody reads the shadow's answers to queries */
+		while(vterm_output_get_buffer_current(rec->shadow.vt) > 0)
+			vterm_output_bufferread(rec->shadow.vt, discard, sizeof(discard) );
+		break;
+	case AUG_RECORD_RESIZE:
+		memcpy(&dims, data, sizeof(dims) );
+		if(term_resize(&rec->shadow, dims.rows, dims.cols) != 0)
+			err_exit(0, "record: failed to resize the shadow terminal");
+		break;
+	}
+}
+
+/* rec->mtx must be held */
+static void drain(struct aug_recorder *rec) {
+	struct aug_record_event ev;
+	unsigned char *data;
+	uint64_t head, tail, lost, usec;
+
+	head = __atomic_load_n(&rec->head, __ATOMIC_ACQUIRE);
+	for(tail = rec->tail; tail < head; ) {
+		ring_get(rec, tail, &ev, sizeof(ev) );
+		if(rec->block_len == 0)
+			open_block(rec, ev.usec);
+		data = block_event(rec, ev.usec, ev.type, ev.len);
+		ring_get(rec, tail + sizeof(ev), data, ev.len);
+		tail += sizeof(ev) + AUG_RECORD_PAD(ev.len);
+		__atomic_store_n(&rec->tail, tail, __ATOMIC_RELEASE);
+
+		shadow_event(rec, &ev, data);
+		if(rec->block_len >= AUG_RECORD_BLOCK_SIZE
+				|| ev.usec - rec->block_start >= AUG_RECORD_BLOCK_USECS)
+			close_block(rec);
+	}
+
+	if( (lost = __atomic_exchange_n(&rec->lost, 0, __ATOMIC_RELAXED) ) > 0) {
+		usec = usecs_since(&rec->start);
+		if(rec->block_len == 0)
+			open_block(rec, usec);
+		memcpy(block_event(rec, usec, AUG_RECORD_LOST, sizeof(lost) ), 
+			&lost, sizeof(lost) );
+	}
+}
+
+static void *writer(void *user) {
+	struct aug_recorder *rec;
+	struct timeval now;
+	struct timespec until;
+	int s;
+
+	rec = user;
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&rec->mtx), 0 );
+	while(rec->running) {
+		drain(rec);
+		/* dont keep a quiet block in memory forever */
+		if(rec->block_len > 0 
+				&& usecs_since(&rec->start) - rec->block_start >= AUG_RECORD_BLOCK_USECS)
+			close_block(rec);
+
+		if(gettimeofday(&now, NULL) != 0)
+			err_exit(errno, "gettimeofday failed");
+		now.tv_usec += AUG_RECORD_WRITE_MSECS*1000;
+		until.tv_sec = now.tv_sec + now.tv_usec/1000000;
+		until.tv_nsec = (now.tv_usec % 1000000)*1000;
+		s = pthread_cond_timedwait(&rec->cond, &rec->mtx, &until);
+		if(s != 0 && s != ETIMEDOUT)
+			err_exit(s, "pthread_cond_timedwait failed");
+	}
+	drain(rec);
+	close_block(rec);
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&rec->mtx), 0 );
+
+	return NULL;
+}
+
+int record_start(struct aug_recorder *rec, const char *path, int rows, int cols) {
+	struct aug_record_file_hdr hdr;
+	int s;
+
+	if( (rec->fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 
+			S_IRUSR | S_IWUSR) ) < 0)
+		return -1;
+
+	if(gettimeofday(&rec->start, NULL) != 0)
+		err_exit(errno, "gettimeofday failed");
+	memset(&hdr, 0, sizeof(hdr) );
+	hdr.magic = AUG_RECORD_MAGIC;
+	hdr.version = AUG_RECORD_VERSION;
+	hdr.start_sec = rec->start.tv_sec;
+	hdr.start_usec = rec->start.tv_usec;
+	if(write_all(rec->fd, &hdr, sizeof(hdr) ) != 0) {
+		s = errno;
+		close(rec->fd);
+		unlink(path);
+		errno = s;
+		return -1;
+	}
+
+	rec->path = path;
+	rec->head = 0;
+	rec->tail = 0;
+	rec->lost = 0;
+	rec->ring = aug_malloc(AUG_RECORD_RING_SIZE);
+	rec->rows = rows;
+	rec->cols = cols;
+	rec->failed = 0;
+	term_init(&rec->shadow, rows, cols);
+	rec->block = NULL;
+	rec->block_len = 0;
+	rec->block_size = 0;
+	rec->comp = NULL;
+	rec->comp_size = 0;
+	rec->index = NULL;
+	rec->n_index = 0;
+	rec->index_size = 0;
+	rec->offset = sizeof(hdr);
+
+	AUG_STATUS_EQUAL( pthread_mutex_init(&rec->mtx, NULL), 0 );
+	AUG_STATUS_EQUAL( pthread_cond_init(&rec->cond, NULL), 0 );
+	rec->running = 1;
+	if( (s = pthread_create(&rec->writer, NULL, writer, rec) ) != 0)
+		err_exit(s, "failed to create record writer thread");
+
+	return 0;
+}
+
+void record_stop(struct aug_recorder *rec) {
+	struct aug_record_trailer trailer;
+	uint64_t offset;
+
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&rec->mtx), 0 );
+	rec->running = 0;
+	AUG_STATUS_EQUAL( pthread_cond_signal(&rec->cond), 0 );
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&rec->mtx), 0 );
+	AUG_STATUS_EQUAL( pthread_join(rec->writer, NULL), 0 );
+
+	offset = rec->offset;
+	if(write_block(rec, AUG_RECORD_BLOCK_INDEX, 0, 0, rec->index, 
+			rec->n_index*sizeof(*rec->index) ) == 0) {
+		memset(&trailer, 0, sizeof(trailer) );
+		trailer.magic = AUG_RECORD_MAGIC;
+		trailer.index_offset = offset;
+		if(write_all(rec->fd, &trailer, sizeof(trailer) ) != 0)
+			err_warn(errno, "record: failed to write to %s", rec->path);
+	}
+	if(close(rec->fd) != 0)
+		err_warn(errno, "record: failed to close %s", rec->path);
+
+	if(__atomic_load_n(&rec->lost, __ATOMIC_RELAXED) > 0)
+		err_warn(0, "record: %llu bytes were not recorded", 
+			(unsigned long long) rec->lost);
+	term_free(&rec->shadow);
+	free(rec->ring);
+	free(rec->block);
+	free(rec->comp);
+	free(rec->index);
+	AUG_STATUS_EQUAL( pthread_cond_destroy(&rec->cond), 0 );
+	AUG_STATUS_EQUAL( pthread_mutex_destroy(&rec->mtx), 0 );
+}
+
+/* ================== reading ================== */
+
+/* returns -1 if there arent @n bytes at @offset */
+static int read_at(int fd, void *buf, size_t n, uint64_t offset) {
+	ssize_t amt;
+
+	for(; n > 0; buf = (char *) buf + amt, n -= amt, offset += amt) {
+		if( (amt = pread(fd, buf, n, offset) ) < 0) {
+			if(errno == EINTR) {
+				amt = 0;
+				continue;
+			}
+			return -1;
+		}
+		if(amt == 0) {
+			errno = EINVAL;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* read and decompress the block at @offset into r->raw */
+static int read_block(struct aug_record_reader *r, uint64_t offset, uint32_t type,
+		struct aug_record_block_hdr *hdr) {
+	if(read_at(r->fd, hdr, sizeof(*hdr), offset) != 0
+			|| hdr->magic != AUG_RECORD_BLOCK_MAGIC || hdr->type != type
+			|| hdr->raw_len > MAX_BLOCK || hdr->comp_len > lz_bound(hdr->raw_len) )
+		return -1;
+
+	r->comp = grow(r->comp, &r->comp_size, hdr->comp_len);
+	r->raw = grow(r->raw, &r->raw_size, hdr->raw_len);
+	if(read_at(r->fd, r->comp, hdr->comp_len, offset + sizeof(*hdr) ) != 0
+			|| lz_decompress(r->comp, hdr->comp_len, r->raw, hdr->raw_len) 
+				!= (ssize_t) hdr->raw_len)
+		return -1;
+
+	r->raw_len = hdr->raw_len;
+	r->pos = 0;
+	return 0;
+}
+
+static int load_block(struct aug_record_reader *r, size_t i) {
+	struct aug_record_block_hdr hdr;
+
+	r->block = r->n_index;
+	if(read_block(r, r->index[i].offset, AUG_RECORD_BLOCK_EVENTS, &hdr) != 0)
+		return -1;
+
+	r->block = i;
+	return 0;
+}
+
+static void load_index(struct aug_record_reader *r) {
+	struct aug_record_trailer trailer;
+	struct aug_record_block_hdr hdr;
+	struct stat st;
+	uint64_t off, size;
+	size_t index_size;
+
+	if(fstat(r->fd, &st) != 0)
+		err_exit(errno, "fstat failed");
+	size = st.st_size;
+
+	if(size >= sizeof(r->hdr) + sizeof(trailer)
+			&& read_at(r->fd, &trailer, sizeof(trailer), size - sizeof(trailer) ) == 0
+			&& trailer.magic == AUG_RECORD_MAGIC
+			&& read_block(r, trailer.index_offset, AUG_RECORD_BLOCK_INDEX, &hdr) == 0
+			&& hdr.raw_len % sizeof(*r->index) == 0) {
+		r->n_index = hdr.raw_len / sizeof(*r->index);
+		r->index = aug_malloc(hdr.raw_len + 1);
+		memcpy(r->index, r->raw, hdr.raw_len);
+		return;
+	}
+
+	/* it wasnt stopped cleanly, so find the blocks which made 
+	 * it to the file whole */
+	r->n_index = 0;
+	r->index = NULL;
+	index_size = 0;
+	for(off = sizeof(r->hdr); off + sizeof(hdr) <= size; off += sizeof(hdr) + hdr.comp_len) {
+		if(read_at(r->fd, &hdr, sizeof(hdr), off) != 0
+				|| hdr.magic != AUG_RECORD_BLOCK_MAGIC
+				|| off + sizeof(hdr) + hdr.comp_len > size)
+			break;
+		if(hdr.type != AUG_RECORD_BLOCK_EVENTS)
+			continue;
+
+		r->index = grow(r->index, &index_size, (r->n_index + 1)*sizeof(*r->index) );
+		r->index[r->n_index].start_usec = hdr.start_usec;
+		r->index[r->n_index].end_usec = hdr.end_usec;
+		r->index[r->n_index].offset = off;
+		r->n_index++;
+	}
+}
+
+int record_reader_open(struct aug_record_reader *r, const char *path) {
+	if( (r->fd = open(path, O_RDONLY | O_CLOEXEC) ) < 0)
+		return -1;
+
+	r->index = NULL;
+	r->n_index = 0;
+	r->block = 0;
+	r->raw = NULL;
+	r->raw_len = 0;
+	r->raw_size = 0;
+	r->pos = 0;
+	r->comp = NULL;
+	r->comp_size = 0;
+	if(read_at(r->fd, &r->hdr, sizeof(r->hdr), 0) != 0
+			|| r->hdr.magic != AUG_RECORD_MAGIC 
+			|| r->hdr.version != AUG_RECORD_VERSION) 
+		goto invalid;
+
+	load_index(r);
+	if(record_reader_seek(r, 0) != 0)
+		goto invalid;
+
+	return 0;
+
+invalid:
+	record_reader_close(r);
+	errno = EINVAL;
+	return -1;
+}
+
+void record_reader_close(struct aug_record_reader *r) {
+	close(r->fd);
+	free(r->index);
+	free(r->raw);
+	free(r->comp);
+}
+
+uint64_t record_reader_duration(const struct aug_record_reader *r) {
+	if(r->n_index == 0)
+		return 0;
+
+	return r->index[r->n_index - 1].end_usec;
+}
+
+int record_reader_seek(struct aug_record_reader *r, uint64_t usec) {
+	size_t lo, hi, mid;
+
+	if(r->n_index == 0) {
+		r->block = 0;
+		return 0;
+	}
+
+	/* the last block which starts at or before @usec */
+	lo = 0;
+	hi = r->n_index;
+	while(hi - lo > 1) {
+		mid = lo + (hi - lo)/2;
+		if(r->index[mid].start_usec <= usec)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return load_block(r, lo);
+}
+
+int record_reader_next(struct aug_record_reader *r, 
+		struct aug_record_event *ev, const unsigned char **data) {
+	while(r->block < r->n_index && r->pos >= r->raw_len) {
+		if(r->block + 1 == r->n_index) {
+			r->block = r->n_index;
+			break;
+		}
+		if(load_block(r, r->block + 1) != 0)
+			return -1;
+	}
+	if(r->block >= r->n_index)
+		return 0;
+
+	if(r->raw_len - r->pos < sizeof(*ev) )
+		return -1;
+	memcpy(ev, r->raw + r->pos, sizeof(*ev) );
+	if(ev->len > r->raw_len - r->pos - sizeof(*ev) )
+		return -1;
+
+	*data = r->raw + r->pos + sizeof(*ev);
+	r->pos += sizeof(*ev) + AUG_RECORD_PAD(ev->len);
+	return 1;
+}
+
+void record_keyframe_restore(struct aug_term *term, 
+		const struct aug_record_keyframe *kf, const struct aug_session_cell *cells) {
+	struct aug_session_view view;
+	char *buf;
+	size_t len;
+	FILE *f;
+	int rows, cols;
+
+	term_dims(term, &rows, &cols);
+	if(rows != (int) kf->rows || cols != (int) kf->cols)
+		if(term_resize(term, kf->rows, kf->cols) != 0)
+			err_exit(0, "record: failed to resize terminal");
+	vterm_screen_reset(vterm_obtain_screen(term->vt), 1);
+
+	/* draw the cells with the same escape sequences that a 
+	 * client attached to a session gets */
+	session_view_init(&view);
+	session_view_resize(&view, kf->rows, kf->cols);
+	memcpy(view.cells, cells, (size_t) kf->rows*kf->cols*sizeof(*cells) );
+	rect_set_add(&view.dirty, 0, 0, kf->cols, kf->rows);
+	view.cursor_row = kf->cursor_row;
+	view.cursor_col = kf->cursor_col;
+
+	if( (f = open_memstream(&buf, &len) ) == NULL)
+		err_exit(errno, "open_memstream failed");
+	session_view_render(f, &view);
+	fclose(f);
+	vterm_push_bytes(term->vt, buf, len);
+
+	free(buf);
+	session_view_free(&view);
+}
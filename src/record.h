@@ -0,0 +1,232 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUG_RECORD_H
+#define AUG_RECORD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "term.h"
+#include "session.h"
+
+/* records the primary terminal to a file for later review with
+ * aug --play. the I/O loop only copies what the child wrote and 
+ * what was typed into a ring, with a timestamp. a writer thread
+ * drains the ring into blocks, feeds the output to a terminal of
+ * its own to keep track of the screen, and writes each block out
+ * compressed (see lz.h) once it is big or old enough. every block
+ * starts with a keyframe of that screen, so a player can seek to 
+ * any time by decoding a single block rather than replaying the 
+ * whole recording. 
+ *
+ * the file is a struct aug_record_file_hdr followed by blocks. 
+ * each block is a struct aug_record_block_hdr followed by 
+ * @comp_len bytes which decompress to @raw_len bytes of events.
+ * when the recording is stopped cleanly an index block (an array
+ * of struct aug_record_index_entry) and a struct 
+ * aug_record_trailer are appended. without them the blocks can 
+ * still be found by walking the headers. everything is in host
+ * byte order. */
+#define AUG_RECORD_MAGIC 0x63657261 /* "arec" */
+#define AUG_RECORD_BLOCK_MAGIC 0x6b6c6261 /* "ablk" */
+#define AUG_RECORD_VERSION 2
+
+struct aug_record_file_hdr {
+	uint32_t magic;
+	uint32_t version;
+	/* when the recording started (event times are relative
+	 * to this) */
+	uint64_t start_sec;
+	uint64_t start_usec;
+};
+
+enum aug_record_block_type {
+	AUG_RECORD_BLOCK_EVENTS = 1,
+	AUG_RECORD_BLOCK_INDEX
+};
+
+struct aug_record_block_hdr {
+	uint32_t magic;
+	uint32_t type;
+	/* the times of the first and last events */
+	uint64_t start_usec;
+	uint64_t end_usec;
+	uint32_t raw_len;
+	uint32_t comp_len;
+};
+
+struct aug_record_index_entry {
+	uint64_t start_usec;
+	uint64_t end_usec;
+	/* of the block header */
+	uint64_t offset;
+};
+
+struct aug_record_trailer {
+	uint32_t magic;
+	uint32_t pad;
+	/* of the index block's header */
+	uint64_t index_offset;
+};
+
+/* every event is a struct aug_record_event followed by @len 
+ * bytes of data, padded to a multiple of 8 */
+struct aug_record_event {
+	uint64_t usec;
+	uint32_t type;
+	uint32_t len;
+};
+
+#define AUG_RECORD_PAD(_len) ( ( (_len) + 7) & ~ (size_t) 7)
+
+enum aug_record_event_type {
+	/* bytes the child wrote */
+	AUG_RECORD_OUTPUT = 1,
+	/* a key read from the outer terminal (a uint32_t) */
+	AUG_RECORD_INPUT,
+	/* the terminal changed size (a struct aug_record_dims) */
+	AUG_RECORD_RESIZE,
+	/* the screen before the rest of the events in the block (a
+	 * struct aug_record_keyframe followed by rows*cols cells).
+	 * the screen's modes (scroll region, alternate screen etc.)
+	 * arent part of it. */
+	AUG_RECORD_KEYFRAME,
+	/* the ring was full, so this many bytes of events were 
+	 * dropped (a uint64_t). the screen is unreliable until
+	 * the next keyframe. */
+	AUG_RECORD_LOST
+};
+
+struct aug_record_dims {
+	uint32_t rows;
+	uint32_t cols;
+};
+
+struct aug_record_keyframe {
+	uint32_t rows;
+	uint32_t cols;
+	uint32_t cursor_row;
+	uint32_t cursor_col;
+};
+
+/* bytes of events the ring holds. must be a power of 2. */
+#define AUG_RECORD_RING_SIZE (1 << 22)
+/* a block is written out once it has this many bytes of 
+ * events or its first event is this old */
+#define AUG_RECORD_BLOCK_SIZE (1 << 18)
+#define AUG_RECORD_BLOCK_USECS 10000000
+#define AUG_RECORD_WRITE_MSECS 50
+
+struct aug_recorder {
+	int fd;
+	const char *path;
+	struct timeval start;
+	/* the I/O loop advances @head and the writer advances @tail */
+	uint64_t head;
+	uint64_t tail;
+	/* bytes of events dropped because the ring was full */
+	uint64_t lost;
+	unsigned char *ring;
+	/* the size last recorded, only used by the I/O loop */
+	int rows;
+	int cols;
+
+	/* the rest belongs to the writer */
+	pthread_t writer;
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	int running;
+	/* a write failed, so nothing more is written */
+	int failed;
+	/* the screen as of the last event drained */
+	struct aug_term shadow;
+	/* the block being filled */
+	unsigned char *block;
+	size_t block_len;
+	size_t block_size;
+	uint64_t block_start;
+	uint64_t block_end;
+	unsigned char *comp;
+	size_t comp_size;
+	struct aug_record_index_entry *index;
+	size_t n_index;
+	size_t index_size;
+	uint64_t offset;
+};
+
+/* start recording to a new file at @path, which may not exist
+ * yet, a terminal which is @rows by @cols. returns -1 (with errno
+ * set) on failure. */
+int record_start(struct aug_recorder *rec, const char *path, int rows, int cols);
+/* write out everything recorded and close the file */
+void record_stop(struct aug_recorder *rec);
+
+/* these are called with the terminal being recorded locked,
+ * which keeps them in order (resizes dont come from its I/O 
+ * loop). each one just copies into the ring. */
+void record_output(struct aug_recorder *rec, const char *buf, size_t n);
+void record_input(struct aug_recorder *rec, uint32_t ch);
+/* does nothing unless the size changed since the last call */
+void record_resize(struct aug_recorder *rec, int rows, int cols);
+
+/* reads a recording */
+struct aug_record_reader {
+	int fd;
+	struct aug_record_file_hdr hdr;
+	struct aug_record_index_entry *index;
+	size_t n_index;
+	/* the index of the block being read, or n_index if none */
+	size_t block;
+	unsigned char *raw;
+	size_t raw_len;
+	size_t raw_size;
+	/* of the next event in @raw */
+	size_t pos;
+	unsigned char *comp;
+	size_t comp_size;
+};
+
+/* returns -1 (with errno set) if @path cant be read or isnt 
+ * a recording. a recording which wasnt stopped cleanly (so it
+ * has no index) can be read and seeked up to the last block 
+ * which was written out whole: the index is rebuilt from the 
+ * block headers. */
+int record_reader_open(struct aug_record_reader *r, const char *path);
+void record_reader_close(struct aug_record_reader *r);
+/* the time of the last event */
+uint64_t record_reader_duration(const struct aug_record_reader *r);
+/* go to the start of the block which holds @usec, which begins 
+ * with a keyframe. returns -1 if the block is corrupt. */
+int record_reader_seek(struct aug_record_reader *r, uint64_t usec);
+/* read the next event. @data points into @r and is good until
+ * the next call. returns 1 if there was an event, 0 at the end 
+ * of the recording and -1 if the file is corrupt. */
+int record_reader_next(struct aug_record_reader *r, 
+		struct aug_record_event *ev, const unsigned char **data);
+
+/* put the screen in @kf on @term */
+void record_keyframe_restore(struct aug_term *term, 
+		const struct aug_record_keyframe *kf, const struct aug_session_cell *cells);
+
+/* the player: show the recording at @path on stdout. returns
+ * non-zero on failure. */
+int record_play(const char *path);
+
+#endif /* AUG_RECORD_H */
@@ -0,0 +1,265 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "record.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <termios.h>
+
+#include "util.h"
+#include "err.h"
+
+/* the player redraws this often */
+#define AUG_RECORD_PLAY_MSECS 16
+/* how far h/l and H/L seek */
+#define AUG_RECORD_SEEK_SHORT 10000000
+#define AUG_RECORD_SEEK_LONG 60000000
+
+struct player {
+	struct aug_record_reader r;
+	/* the recorded terminal as of @pos */
+	struct aug_term term;
+	uint64_t pos;
+	/* the first event after @pos */
+	int have_next;
+	struct aug_record_event next;
+	const unsigned char *data;
+	/* there are no more events */
+	int end;
+};
+
+/* returns -1 if the event is malformed */
+static int apply(struct aug_term *term, const struct aug_record_event *ev, 
+		const unsigned char *data) {
+	struct aug_record_keyframe kf;
+	struct aug_record_dims dims;
+	char discard[256];
+
+	switch(ev->type) {
+	case AUG_RECORD_OUTPUT:
+		vterm_push_bytes(term->vt, (const char *) data, ev->len);
+		while(vterm_output_get_buffer_current(term->vt) > 0)
+			vterm_output_bufferread(term->vt, discard, sizeof(discard) );
+		break;
+	case AUG_RECORD_RESIZE:
+		if(ev->len != sizeof(dims) )
+			return -1;
+		memcpy(&dims, data, sizeof(dims) );
+		if(dims.rows == 0 || dims.cols == 0 || term_resize(term, dims.rows, dims.cols) != 0)
+			return -1;
+		break;
+	case AUG_RECORD_KEYFRAME:
+		if(ev->len < sizeof(kf) )
+			return -1;
+		memcpy(&kf, data, sizeof(kf) );
+		if(kf.rows == 0 || kf.cols == 0 || ev->len != sizeof(kf) 
+				+ (uint64_t) kf.rows*kf.cols*sizeof(struct aug_session_cell) )
+			return -1;
+		record_keyframe_restore(term, &kf, 
+			(const struct aug_session_cell *) (data + sizeof(kf)) );
+		break;
+	default:
+		/* keys and gaps dont change the screen */
+		break;
+	}
+
+	return 0;
+}
+
+/* apply the events up to @usec */
+static int play_until(struct player *p, uint64_t usec) {
+	int s;
+
+	while(1) {
+		if(p->have_next == 0) {
+			if( (s = record_reader_next(&p->r, &p->next, &p->data) ) < 0)
+				return -1;
+			if(s == 0) {
+				p->end = 1;
+				return 0;
+			}
+			p->have_next = 1;
+		}
+		if(p->next.usec > usec)
+			return 0;
+
+		if(apply(&p->term, &p->next, p->data) != 0)
+			return -1;
+		p->have_next = 0;
+	}
+}
+
+/* decodes just the block which holds @usec */
+static int seek(struct player *p, uint64_t usec) {
+	uint64_t start;
+
+	if(record_reader_seek(&p->r, usec) != 0)
+		return -1;
+
+	p->have_next = 0;
+	p->end = 0;
+	/* before the first block there is only its keyframe */
+	if(p->r.block < p->r.n_index) {
+		start = p->r.index[p->r.block].start_usec;
+		if(usec < start)
+			usec = start;
+	}
+	p->pos = usec;
+	return play_until(p, usec);
+}
+
+/* copy the terminal into @view, marking what changed as dirty. 
+ * returns non-zero if anything changed. */
+static int snapshot(struct aug_term *term, struct aug_session_view *view) {
+	struct aug_session_cell cell, *old;
+	VTermScreenCell vcell;
+	VTermScreen *vts;
+	VTermPos pos, cursor;
+	int rows, cols, resized, changed;
+
+	term_dims(term, &rows, &cols);
+	resized = (rows != view->rows || cols != view->cols);
+	if(resized) {
+		session_view_resize(view, rows, cols);
+		fputs("\033[0m\033[H\033[2J", stdout);
+	}
+
+	changed = resized;
+	vts = vterm_obtain_screen(term->vt);
+	for(pos.row = 0; pos.row < rows; pos.row++) {
+		for(pos.col = 0; pos.col < cols; pos.col++) {
+			if( !vterm_screen_get_cell(vts, pos, &vcell) )
+				err_exit(0, "get_cell returned false status\n");
+			session_cell_from_vterm(&vcell, &cell);
+			old = &view->cells[pos.row*cols + pos.col];
+			if(!resized && memcmp(old, &cell, sizeof(cell) ) == 0)
+				continue;
+			*old = cell;
+			rect_set_on(&view->dirty, pos.col, pos.row);
+			changed = 1;
+		}
+	}
+
+	vterm_state_get_cursorpos(vterm_obtain_state(term->vt), &cursor);
+	if(cursor.row != view->cursor_row || cursor.col != view->cursor_col)
+		changed = 1;
+	view->cursor_row = cursor.row;
+	view->cursor_col = cursor.col;
+	return changed;
+}
+
+static uint64_t clamp_sub(uint64_t a, uint64_t b) {
+	return (a > b)? a - b : 0;
+}
+
+/* returns 1 to quit and -1 if a seek found a corrupt block */
+static int on_key(struct player *p, char key, int *paused) {
+	uint64_t duration;
+
+	duration = record_reader_duration(&p->r);
+	switch(key) {
+	case 'q':
+	case AUG_SESSION_DETACH_KEY:
+		return 1;
+	case ' ':
+		*paused = !*paused;
+		return 0;
+	case 'h':
+		return seek(p, clamp_sub(p->pos, AUG_RECORD_SEEK_SHORT) );
+	case 'l':
+		return seek(p, p->pos + AUG_RECORD_SEEK_SHORT);
+	case 'H':
+		return seek(p, clamp_sub(p->pos, AUG_RECORD_SEEK_LONG) );
+	case 'L':
+		return seek(p, p->pos + AUG_RECORD_SEEK_LONG);
+	default:
+		/* 0-9 jump to that tenth of the recording */
+		if(key >= '0' && key <= '9')
+			return seek(p, duration/10*(key - '0') );
+		return 0;
+	}
+}
+
+int record_play(const char *path) {
+	struct player p;
+	struct aug_session_view view;
+	struct termios saved;
+	struct timeval last, now, diff;
+	struct pollfd pfd;
+	char buf[64];
+	ssize_t n, i;
+	int status, paused;
+
+	if(record_reader_open(&p.r, path) != 0) {
+		err_warn(errno, "failed to play %s", path);
+		return -1;
+	}
+
+	/* the first keyframe sets the size */
+	term_init(&p.term, 1, 1);
+	session_view_init(&view);
+	if(seek(&p, 0) != 0) {
+		err_warn(0, "%s is corrupt", path);
+		status = -1;
+		goto done;
+	}
+
+	session_tty_enter(&saved);
+	pfd.fd = STDIN_FILENO;
+	pfd.events = POLLIN;
+	paused = 0;
+	status = 0;
+	if(gettimeofday(&last, NULL) != 0)
+		err_exit(errno, "gettimeofday failed");
+	while(status == 0) {
+		if(snapshot(&p.term, &view) != 0)
+			session_view_render(stdout, &view);
+
+		if(poll(&pfd, 1, AUG_RECORD_PLAY_MSECS) > 0) {
+			if( (n = read(STDIN_FILENO, buf, sizeof(buf)) ) <= 0)
+				break;
+			for(i = 0; i < n && status == 0; i++)
+				status = on_key(&p, buf[i], &paused);
+		}
+
+		if(gettimeofday(&now, NULL) != 0)
+			err_exit(errno, "gettimeofday failed");
+		timersub(&now, &last, &diff);
+		last = now;
+		if(status == 0 && paused == 0 && p.end == 0) {
+			p.pos += (uint64_t) diff.tv_sec*1000000 + diff.tv_usec;
+			status = play_until(&p, p.pos);
+		}
+	}
+	session_tty_leave(&saved);
+
+	if(status < 0)
+		printf("[%s is corrupt]\n", path);
+	else
+		printf("[stopped playing %s]\n", path);
+	status = (status < 0);
+
+done:
+	session_view_free(&view);
+	term_free(&p.term);
+	record_reader_close(&p.r);
+	return status;
+}
@@ -19,6 +19,7 @@
 #include "rect_set.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 static inline size_t rect_set_size(const struct aug_rect_set *rs) {
 	return rs->cols*rs->rows;
@@ -85,6 +86,29 @@ void rect_set_add(struct aug_rect_set *rs, size_t col_start, size_t row_start,
 			rect_set_on(rs, col, row);
 }
 
+void rect_set_shift(struct aug_rect_set *rs, int rows) {
+	size_t n, keep;
+
+	if(rs->map == NULL || rows == 0)
+		return;
+
+	n = (rows > 0)? (size_t) rows : (size_t) -rows;
+	if(n >= rs->rows) {
+		rect_set_clear(rs);
+		return;
+	}
+
+	keep = (rs->rows - n)*rs->cols;
+	if(rows > 0) {
+		memmove(rs->map, rs->map + n*rs->cols, keep);
+		memset(rs->map + keep, 0, n*rs->cols);
+	}
+	else {
+		memmove(rs->map + n*rs->cols, rs->map, keep);
+		memset(rs->map, 0, n*rs->cols);
+	}
+}
+
 static void cut_out_rect(struct aug_rect_set *rs, size_t col, size_t row, 
 		struct aug_rect_set_rect *rect) {
 	size_t col_width, row_width, tmp_col_width;
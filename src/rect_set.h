@@ -54,6 +54,12 @@ void rect_set_clear(struct aug_rect_set *rs);
 void rect_set_add(struct aug_rect_set *rs, size_t col_start, size_t row_start,
 		size_t col_end, size_t row_end);
 
+/* move every point @rows rows up (or down if @rows is negative), 
+ * the same way the contents of a window move when it scrolls. points 
+ * which move off the map are dropped and the rows which are 
+ * uncovered are turned off. */
+void rect_set_shift(struct aug_rect_set *rs, int rows);
+
 /* searches for any "on" points in the map and expands that point into 
  * a rectangle, deletes that rectangle from the map and returns. if no
  * "on" points are found, returns non-zero. 
@@ -19,124 +19,215 @@
 #include "region_map.h"
 
 #include <stdlib.h>
-#include <ccan/list/list.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ccan/htable/htable_type.h>
 
 #include "err.h"
 #include "util.h"
 
+enum edge_side {
+	SIDE_TOP = 0,
+	SIDE_BOT,
+	SIDE_LEFT,
+	SIDE_RIGHT,
+	SIDE_COUNT
+};
+
+/* @pub comes first so an aug_edgewin handed out by the
+ * region map can be turned back into its edgewin */
 struct edgewin {
+	struct aug_edgewin pub;
 	int size;
-	const void *key;
-	struct list_node node;
+	enum edge_side side;
+	/* deleted, but still taking up its slot */
+	int dead;
 };
 
+/* an entry is its own key, only the owner and window_fn of 
+ * the key are looked at */
+static inline const struct aug_edgewin *edgewin_key(const struct edgewin *ew) {
+	return &ew->pub;
+}
+
+static inline size_t hash_key(const struct aug_edgewin *key) {
+	return (size_t) ( ( (uintptr_t) key->owner ^ (uintptr_t) key->window_fn) 
+		* 2654435761U);
+}
+
+static inline bool same_key(const struct aug_edgewin *a, const void *owner,
+		void (*window_fn)(WINDOW *, void *) ) {
+	return a->owner == owner && a->window_fn == window_fn;
+}
+
+static inline bool edgewin_eq(const struct edgewin *ew, const struct aug_edgewin *key) {
+	return same_key(&ew->pub, key->owner, key->window_fn);
+}
+
+HTABLE_DEFINE_TYPE(struct edgewin, edgewin_key, hash_key, edgewin_eq, edgewin_table);
+
+/* the edge windows of all sides in one array in the order they
+ * were pushed. a delete only marks the entry dead and takes it 
+ * out of the hash table, the dead entries are squeezed out the
+ * next time the array is walked (see compact). the hash table 
+ * points into the array, so it is rebuilt whenever the array
+ * moves or is compacted. */
 static struct {
-	struct list_head top_edgewins;
-	struct list_head bot_edgewins;
-	struct list_head left_edgewins;
-	struct list_head right_edgewins;
+	struct edgewin *wins;
+	size_t n;
+	size_t size;
+	/* dead entries among the n */
+	size_t dead;
+	int side_n[SIDE_COUNT];
+	struct edgewin_table by_key;
+	/* bumped on every push and delete */
+	unsigned int gen;
+	struct {
+		int valid;
+		int lines;
+		int columns;
+		unsigned int gen;
+		struct aug_region primary;
+	} layout;
 } g_map;
 
-static void delete(struct edgewin *);
 static int init_region(int, int, int, int, int, int, struct aug_region *);
 
 void region_map_init() {
-	list_head_init(&g_map.top_edgewins);
-	list_head_init(&g_map.bot_edgewins);
-	list_head_init(&g_map.left_edgewins);
-	list_head_init(&g_map.right_edgewins);
+	g_map.wins = NULL;
+	g_map.n = 0;
+	g_map.size = 0;
+	g_map.dead = 0;
+	memset(g_map.side_n, 0, sizeof(g_map.side_n) );
+	edgewin_table_init(&g_map.by_key);
+	g_map.gen = 0;
+	g_map.layout.valid = 0;
 }
 
 void region_map_free() {
-	struct edgewin *next, *i;
+	edgewin_table_clear(&g_map.by_key);
+	free(g_map.wins);
+	g_map.wins = NULL;
+	g_map.n = 0;
+	g_map.size = 0;
+	g_map.dead = 0;
+}
 
-	list_for_each_safe(&g_map.top_edgewins, i, next, node) {
-		delete(i);
-	}
-	list_for_each_safe(&g_map.bot_edgewins, i, next, node) {
-		delete(i);
-	}
-	list_for_each_safe(&g_map.left_edgewins, i, next, node) {
-		delete(i);
-	}
-	list_for_each_safe(&g_map.right_edgewins, i, next, node) {
-		delete(i);
+static void rebuild_table() {
+	size_t i;
+
+	edgewin_table_clear(&g_map.by_key);
+	edgewin_table_init(&g_map.by_key);
+	for(i = 0; i < g_map.n; i++)
+		if(edgewin_table_add(&g_map.by_key, &g_map.wins[i]) == false)
+			err_exit(0, "memory error!");
+}
+
+/* drop the dead entries, keeping the others in push order */
+static void compact() {
+	size_t i, j;
+
+	if(g_map.dead == 0)
+		return;
+
+	for(i = 0, j = 0; i < g_map.n; i++) {
+		if(g_map.wins[i].dead != 0)
+			continue;
+		if(i != j)
+			g_map.wins[j] = g_map.wins[i];
+		j++;
 	}
+	g_map.n = j;
+	g_map.dead = 0;
+	rebuild_table();
 }
 
-static inline void edgewin_list_push(struct list_head *head, const void *key, int size) {
-	struct edgewin *item;
+static void push(enum edge_side side, void *owner, 
+		void (*window_fn)(WINDOW *, void *), void (*free_fn)(WINDOW *, void *),
+		int size) {
+	struct edgewin *ew;
 
 	if(size < 1)
 		err_exit(0, "size is less than 1");
 
-	item = aug_malloc( sizeof(struct edgewin) );
-	item->key = key;
-	item->size = size;
-	list_add_tail(head, &item->node);
-}
+	if(g_map.n == g_map.size)
+		compact();
+	if(g_map.n == g_map.size) {
+		g_map.size = (g_map.size > 0)? g_map.size*2 : 8;
+		g_map.wins = realloc(g_map.wins, g_map.size*sizeof(*g_map.wins) );
+		if(g_map.wins == NULL)
+			err_exit(0, "out of memory");
+		rebuild_table();
+	}
 
-void region_map_push_top(const void *key, int nlines) { 
-	edgewin_list_push(&g_map.top_edgewins, key, nlines);
+	ew = &g_map.wins[g_map.n++];
+	memset(&ew->pub, 0, sizeof(ew->pub) );
+	ew->pub.owner = owner;
+	ew->pub.window_fn = window_fn;
+	ew->pub.free_fn = free_fn;
+	ew->size = size;
+	ew->side = side;
+	ew->dead = 0;
+	if(edgewin_table_add(&g_map.by_key, ew) == false)
+		err_exit(0, "memory error!");
+
+	g_map.side_n[side]++;
+	g_map.gen++;
 }
-void region_map_push_bot(const void *key, int nlines) { 
-	edgewin_list_push(&g_map.bot_edgewins, key, nlines);
+
+void region_map_push_top(void *owner, void (*window_fn)(WINDOW *, void *), 
+		void (*free_fn)(WINDOW *, void *), int nlines) { 
+	push(SIDE_TOP, owner, window_fn, free_fn, nlines);
 }
-void region_map_push_left(const void *key, int ncols) { 
-	edgewin_list_push(&g_map.left_edgewins, key, ncols);
+void region_map_push_bot(void *owner, void (*window_fn)(WINDOW *, void *), 
+		void (*free_fn)(WINDOW *, void *), int nlines) { 
+	push(SIDE_BOT, owner, window_fn, free_fn, nlines);
 }
-void region_map_push_right(const void *key, int ncols) { 
-	edgewin_list_push(&g_map.right_edgewins, key, ncols);
+void region_map_push_left(void *owner, void (*window_fn)(WINDOW *, void *), 
+		void (*free_fn)(WINDOW *, void *), int ncols) { 
+	push(SIDE_LEFT, owner, window_fn, free_fn, ncols);
 }
-
-static void delete(struct edgewin *item) {
-	list_del(&item->node);
-	free(item);
+void region_map_push_right(void *owner, void (*window_fn)(WINDOW *, void *), 
+		void (*free_fn)(WINDOW *, void *), int ncols) { 
+	push(SIDE_RIGHT, owner, window_fn, free_fn, ncols);
 }
 
-static int edgewin_list_size(const struct list_head *head) {
-	struct edgewin *i;
-	int n;
-
-	n = 0;
-	list_for_each(head, i, node) 
-		n++;
-
-	return n;
+int region_map_top_size() { return g_map.side_n[SIDE_TOP]; }
+int region_map_bot_size() { return g_map.side_n[SIDE_BOT]; }
+int region_map_left_size() { return g_map.side_n[SIDE_LEFT]; }
+int region_map_right_size() { return g_map.side_n[SIDE_RIGHT]; }
+
+/* removes @ew, which came from region_map_lookup. whatever
+ * window was made for it has to be taken care of before this. 
+ * other entries stay where they are until the next layout, 
+ * count or get, and so does the memory of @ew. */
+void region_map_remove(struct aug_edgewin *ew) {
+	struct edgewin *entry;
+
+	entry = (struct edgewin *) ew;
+	if(entry->dead != 0)
+		err_exit(0, "edge window was already removed");
+
+	if(edgewin_table_del(&g_map.by_key, entry) == false)
+		err_exit(0, "edge window is not in the region map");
+	entry->dead = 1;
+	g_map.dead++;
+	g_map.side_n[entry->side]--;
+	g_map.gen++;
 }
 
-int region_map_top_size() { return edgewin_list_size(&g_map.top_edgewins); }
-int region_map_bot_size() { return edgewin_list_size(&g_map.bot_edgewins); }
-int region_map_left_size() { return edgewin_list_size(&g_map.left_edgewins); }
-int region_map_right_size() { return edgewin_list_size(&g_map.right_edgewins); }
-
-int region_map_delete(const void *key) {
-	struct edgewin *next, *i;
-	int status = -1;
-
-	list_for_each_safe(&g_map.top_edgewins, i, next, node) {
-		if(i->key == key) {
-			delete(i);
-			status = 0;
-		}
-	}
-	list_for_each_safe(&g_map.bot_edgewins, i, next, node) {
-		if(i->key == key) {
-			delete(i);
-			status = 0;
-		}
-	}
-	list_for_each_safe(&g_map.left_edgewins, i, next, node) {
-		if(i->key == key) {
-			delete(i);
-			status = 0;
-		}
-	}
-	list_for_each_safe(&g_map.right_edgewins, i, next, node) {
-		if(i->key == key) {
-			delete(i);
-			status = 0;
-		}
+/* removes every edge window pushed with @owner and @window_fn. 
+ * whatever window was made for them has to be taken care of 
+ * before this. */
+int region_map_delete(const void *owner, void (*window_fn)(WINDOW *, void *)) {
+	struct aug_edgewin *ew;
+	int status;
+
+	status = -1;
+	while( (ew = region_map_lookup(owner, window_fn) ) != NULL) {
+		region_map_remove(ew);
+		status = 0;
 	}
 
 	return status;
@@ -160,23 +251,17 @@ void region_map_key_regs_free(AVL *key_regs) {
 	avl_free(key_regs);
 }
 
-static void apply_horizontal_edgewins(struct list_head *edgewins, AVL *key_regs,
-			int lines, int *rows_left, int cols_left, int reverse) {
-	struct edgewin *i;
-	struct aug_region *region;
-	int y, allocd;
+static void layout_horizontal(enum edge_side side, int lines, int *rows_left, 
+		int cols_left, int reverse) {
+	struct edgewin *i, *end;
+	int y;
 
 	y = lines;
-	list_for_each(edgewins, i, node) {
-		allocd = 0;
-		if( (region = avl_lookup(key_regs, i->key)) == NULL) {
-			region = malloc( sizeof( struct aug_region ) );
-			if(region == NULL)
-				err_exit(0, "out of memory");
-
-			allocd = 1;
-		}
-	
+	end = g_map.wins + g_map.n;
+	for(i = g_map.wins; i < end; i++) {
+		if(i->side != side)
+			continue;
+
 		if(reverse == 0)
 			y = lines - *rows_left;
 		else {
@@ -184,90 +269,64 @@ static void apply_horizontal_edgewins(struct list_head *edgewins, AVL *key_regs,
 		}
 	
 		if(init_region(*rows_left-(i->size), cols_left, 
-				y, 0, i->size, cols_left, region) == 0)
+				y, 0, i->size, cols_left, &i->pub.region) == 0)
 			*rows_left -= i->size;
-
-		if(allocd != 0)
-			avl_insert(key_regs, i->key, region);
 	}
 }
 
-static void apply_vertical_edgewins(struct list_head *edgewins, AVL *key_regs,
-			int start_y, int cols, int rows_left, int *cols_left, int reverse) {
-	struct edgewin *i;
-	struct aug_region *region;
+static void layout_vertical(enum edge_side side, int start_y, int cols, 
+		int rows_left, int *cols_left, int reverse) {
+	struct edgewin *i, *end;
 	int x;
 
 	x = cols;
-	list_for_each(edgewins, i, node) {
-		region = malloc( sizeof( struct aug_region ) );
-		if(region == NULL)
-			err_exit(0, "out of memory");
-		
+	end = g_map.wins + g_map.n;
+	for(i = g_map.wins; i < end; i++) {
+		if(i->side != side)
+			continue;
+
 		if(reverse == 0)			
 			x = cols - *cols_left;
 		else
 			x = x - (i->size);
 
 		if(init_region(rows_left, *cols_left - (i->size), \
-				start_y, x, rows_left, i->size, region) == 0)
+				start_y, x, rows_left, i->size, &i->pub.region) == 0)
 			*cols_left -= i->size;
-		avl_insert(key_regs, i->key, region);
 	}
 }
 
-/* apply the region map to a rectangle of lines X columns dimension
- * and store the result in key_regs which is a map from keys to regions.
- * the leftover space is described by the primary output parameter.
- */
-int region_map_apply(int lines, int columns, AVL *key_regs, struct aug_region *primary) {
+/* lay out the edge windows on a rectangle of lines X columns
+ * dimension. the result is kept until the next push or delete,
+ * so doing this again for the same size costs nothing. the
+ * leftover space is described by the primary output parameter
+ * and the edge windows can be read with region_map_count and
+ * region_map_get. */
+int region_map_layout(int lines, int columns, struct aug_region *primary) {
 	int rows, cols, primary_y, primary_x;
 
+	if(lines < 1 || columns < 1)
+		return -1;
+
+	if(g_map.layout.valid != 0 
+			&& g_map.layout.lines == lines 
+			&& g_map.layout.columns == columns 
+			&& g_map.layout.gen == g_map.gen) {
+		*primary = g_map.layout.primary;
+		return 0;
+	}
+
+	compact();
 	rows = lines;
 	cols = columns;
 
-	if(rows < 1 || cols < 1)
-		return -1;
-
-	apply_horizontal_edgewins(
-		&g_map.top_edgewins, 
-		key_regs,
-		lines, 
-		&rows,
-		cols,
-		0
-	);
+	layout_horizontal(SIDE_TOP, lines, &rows, cols, 0);
 	primary_y = lines-rows;
+	layout_horizontal(SIDE_BOT, lines, &rows, cols, 1);
 
-	apply_horizontal_edgewins(
-		&g_map.bot_edgewins, 
-		key_regs,
-		lines, 
-		&rows,
-		cols,
-		1
-	);
-
-	apply_vertical_edgewins(
-		&g_map.left_edgewins, 
-		key_regs,
-		primary_y,
-		columns, 
-		rows,
-		&cols,
-		0
-	);
+	layout_vertical(SIDE_LEFT, primary_y, columns, rows, &cols, 0);
 	primary_x = columns-cols;
-
-	apply_vertical_edgewins(
-		&g_map.right_edgewins, 
-		key_regs,
-		primary_y,
-		columns, 
-		rows,
-		&cols,
-		1
-	);
+	layout_vertical(SIDE_RIGHT, primary_y, columns, rows, &cols, 1);
 		
 	init_region(
 		rows, 
@@ -279,9 +338,66 @@ int region_map_apply(int lines, int columns, AVL *key_regs, struct aug_region *p
 		primary
 	);
 
+	g_map.layout.valid = 1;
+	g_map.layout.lines = lines;
+	g_map.layout.columns = columns;
+	g_map.layout.gen = g_map.gen;
+	g_map.layout.primary = *primary;
+
 	return 0;
 }
 
+size_t region_map_count() {
+	compact();
+	return g_map.n;
+}
+
+/* the @i'th edge window in the order they were pushed. 
+ * valid until the next push or delete. */
+struct aug_edgewin *region_map_get(size_t i) {
+	compact();
+	if(i >= g_map.n)
+		err_exit(0, "edge window index %zu out of range", i);
+
+	return &g_map.wins[i].pub;
+}
+
+/* returns the (first) edge window pushed with @owner and 
+ * @window_fn or NULL */
+struct aug_edgewin *region_map_lookup(const void *owner, 
+		void (*window_fn)(WINDOW *, void *)) {
+	struct aug_edgewin key;
+	struct edgewin *ew;
+
+	key.owner = (void *) owner;
+	key.window_fn = window_fn;
+	ew = edgewin_table_get(&g_map.by_key, &key);
+	return (ew == NULL)? NULL : &ew->pub;
+}
+
+/* apply the region map to a rectangle of lines X columns dimension
+ * and store the result in key_regs which is a map from owners to 
+ * regions (so it is only useful if each owner has one edge window).
+ * regions already in key_regs are reused. the leftover space is 
+ * described by the primary output parameter.
+ */
+int region_map_apply(int lines, int columns, AVL *key_regs, struct aug_region *primary) {
+	struct aug_region *region;
+	size_t i;
+
+	if(region_map_layout(lines, columns, primary) != 0)
+		return -1;
+
+	for(i = 0; i < g_map.n; i++) {
+		if( (region = avl_lookup(key_regs, g_map.wins[i].pub.owner)) == NULL) {
+			region = aug_malloc( sizeof( struct aug_region ) );
+			avl_insert(key_regs, g_map.wins[i].pub.owner, region);
+		}
+		*region = g_map.wins[i].pub.region;
+	}
+
+	return 0;
+}
 
 /* rows: 	the number of rows available
  * cols: 	the number of columns available
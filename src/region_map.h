@@ -19,8 +19,11 @@
 #ifndef AUG_REGION_MAP_H
 #define AUG_REGION_MAP_H
 
+#include <stddef.h>
 #include <ccan/avl/avl.h>
 
+#include "ncurses.h"
+
 struct aug_region {
 	int y;
 	int x;
@@ -28,20 +31,51 @@ struct aug_region {
 	int cols;
 };
 
+/* an edge window as laid out by region_map_layout. the region map
+ * is the one registry of edge windows. they are found by @owner 
+ * (the plugin which asked for the window) and @window_fn (the 
+ * callback it gave), and besides the region each one carries the 
+ * window that was made for it. the callbacks, @win, @win_region 
+ * and @placed belong to whoever turns regions into windows (the 
+ * screen module), the region map only keeps them with the entry. */
+struct aug_edgewin {
+	void *owner;
+	void (*window_fn)(WINDOW *win, void *user);
+	/* may be NULL */
+	void (*free_fn)(WINDOW *win, void *user);
+	/* the result of the last layout */
+	struct aug_region region;
+	/* the window and the region it was made for. 
+	 * @placed is 0 until a window was first considered */
+	WINDOW *win;
+	struct aug_region win_region;
+	int placed;
+};
+
 void region_map_init();
 void region_map_free();
-void region_map_push_top(const void *key, int nlines);
-void region_map_push_bot(const void *key, int nlines);
-void region_map_push_left(const void *key, int ncols);
-void region_map_push_right(const void *key, int ncols);
+void region_map_push_top(void *owner, void (*window_fn)(WINDOW *, void *), 
+		void (*free_fn)(WINDOW *, void *), int nlines);
+void region_map_push_bot(void *owner, void (*window_fn)(WINDOW *, void *), 
+		void (*free_fn)(WINDOW *, void *), int nlines);
+void region_map_push_left(void *owner, void (*window_fn)(WINDOW *, void *), 
+		void (*free_fn)(WINDOW *, void *), int ncols);
+void region_map_push_right(void *owner, void (*window_fn)(WINDOW *, void *), 
+		void (*free_fn)(WINDOW *, void *), int ncols);
 int region_map_top_size();
 int region_map_bot_size(); 
 int region_map_left_size();
 int region_map_right_size();
-int region_map_delete(const void *key);
+int region_map_delete(const void *owner, void (*window_fn)(WINDOW *, void *));
+void region_map_remove(struct aug_edgewin *ew);
 AVL *region_map_key_regs_alloc();
 void region_map_key_regs_free(AVL *key_regs);
 void region_map_key_regs_clear(AVL **key_regs);
 int region_map_apply(int lines, int columns, AVL *key_regs, struct aug_region *primary);
+int region_map_layout(int lines, int columns, struct aug_region *primary);
+size_t region_map_count();
+struct aug_edgewin *region_map_get(size_t i);
+struct aug_edgewin *region_map_lookup(const void *owner, 
+		void (*window_fn)(WINDOW *, void *));
 
 #endif /* AUG_REGION_MAP_H */
\ No newline at end of file
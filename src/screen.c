@@ -18,10 +18,14 @@
 
 #include "screen.h"
 #include <errno.h>
+#include <limits.h>
 #include <stdint.h>
 #include <assert.h>
 #include <string.h>
 #include <strings.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <poll.h>
 
 #include <ccan/objset/objset.h>
 #include <ccan/build_assert/build_assert.h>
@@ -33,10 +37,15 @@
 #include "term_win.h"
 #include "region_map.h"
 #include "ncurses_util.h"
+#include "paste.h"
+#include "log.h"
+#include "lock.h"
+#include "session.h"
 
-extern void make_win_alloc_cb_new(void *cb_pair, WINDOW *win);
-extern void make_win_alloc_cb_free(void *cb_pair, WINDOW *win);
+extern void make_win_alloc_cb_new(const struct aug_edgewin *ew, WINDOW *win);
+extern void make_win_alloc_cb_free(const struct aug_edgewin *ew, WINDOW *win);
 
+static void vterm_cb_stage(void *user);
 static void vterm_cb_refresh(void *user);
 static int free_term_win();
 static int init_term_win();
@@ -54,24 +63,37 @@ static const VTermScreenCallbacks CB_SCREEN = {
 };
 
 static const struct aug_term_io_callbacks CB_TERM_IO = {
+	.stage = vterm_cb_stage,
 	.refresh = vterm_cb_refresh
 };
 
+/* plugin damage beyond this many rects repaints the whole terminal */
+#define SCREEN_PLUGIN_DAMAGE_MAX 16
+
 /* globals */
 static struct {
 	int color_on;
 	struct aug_term_win term_win;
-	AVL *windows;
+	/* the region the terminal window was made for. the
+	 * edge windows are kept in the region map. */
+	struct aug_region primary;
+	void (*damage_hook)(VTermRect rect, void *user);
+	void *damage_hook_user;
+	/* damage from plugins (primary_term_damage), which can come 
+	 * in without the terminal locked. it is handed to the term_win
+	 * when the terminal is staged. */
+	struct {
+		VTermRect rects[SCREEN_PLUGIN_DAMAGE_MAX];
+		int n;
+		AUG_LOCK_MEMBERS;
+	} plugin_damage;
 } g;	
 
-static AVL *init_window_table() {
-	return avl_new( (AvlCompare) void_compare);
-}
-
 int screen_init(struct aug_term *term) {
 	g.color_on = 0;
+	g.plugin_damage.n = 0;
+	AUG_LOCK_INIT(&g.plugin_damage);
 
-	g.windows = init_window_table();
 	
 	initscr();
 	screen_clear();
@@ -91,6 +113,10 @@ int screen_init(struct aug_term *term) {
 	if(nonl() == ERR)
 		goto fail;
 
+	/* have the outer terminal mark pastes so they can 
+	 * skip the keymap. (see paste.h) */
+	putp(AUG_PASTE_ENABLE);
+
 	return 0;
 fail:
 	errno = SCN_ERR_INIT;
@@ -124,6 +150,11 @@ static int init_term_win() {
 		goto fail;
 
 	term_win_init(&g.term_win, win);
+	g.term_win.composited = 1;
+	g.primary.y = 0;
+	g.primary.x = 0;
+	g.primary.rows = LINES;
+	g.primary.cols = COLS;
 
 	return 0;
 fail:
@@ -131,6 +162,7 @@ fail:
 }
 
 int screen_cleanup() {
+	putp(AUG_PASTE_DISABLE);
 	if(endwin() == ERR) {
 		return -1;
 	}
@@ -139,35 +171,74 @@ int screen_cleanup() {
 	}
 }
 
-static void free_windows() {
-	AvlIter i;
-
-	avl_foreach(i, g.windows) {
+static void free_edge(struct aug_edgewin *ew) {
+	if(ew->win != NULL) {
 		/* defined in aug.c: inform plugin that the WINDOW
 		 * object it was given for its edge window is about
 		 * to be destroyed so it can free associated resources */
-		make_win_alloc_cb_free(i.value, i.key);
-		if(delwin(i.key) == ERR)
+		make_win_alloc_cb_free(ew, ew->win);
+		/* nobody is going to paint over this anymore */
+		werase(ew->win);
+		if(delwin(ew->win) == ERR)
 			err_exit(0, "failed to delete window");
+		ew->win = NULL;
 	}
+	ew->placed = 0;
+}
 
-	avl_free(g.windows);
+/* destroys the window of @ew (from region_map_lookup). has 
+ * to be called before it is removed from the region map. */
+void screen_release_edgewin(struct aug_edgewin *ew) {
+	free_edge(ew);
 }
 
-void screen_free() {
-	AvlIter i;
+/* deletes the windows of all edge windows without telling
+ * their plugins. for shutdown, before the region map is freed. */
+void screen_free_edgewins() {
+	struct aug_edgewin *ew;
+	size_t i, n;
 
-	avl_foreach(i, g.windows) {
-		if(delwin(i.key) == ERR)
+	n = region_map_count();
+	for(i = 0; i < n; i++) {
+		ew = region_map_get(i);
+		if(ew->win != NULL && delwin(ew->win) == ERR)
 			fprintf(stderr, "warning: failed to delete window\n");
+		ew->win = NULL;
+		ew->placed = 0;
 	}
-	avl_free(g.windows);
+}
 
+void screen_free() {
 	if(free_term_win() != 0)
 		err_exit(0, "free_term_win failed!");
 
 	if(screen_cleanup() != 0)
 		err_exit(0, "screen_cleanup failed!");
+	AUG_LOCK_FREE(&g.plugin_damage);
+}
+
+/* move the damage plugins asked for into the term_win. the
+ * terminal must be locked. */
+static void take_plugin_damage() {
+	VTermRect rects[SCREEN_PLUGIN_DAMAGE_MAX];
+	int i, n;
+
+	AUG_LOCK(&g.plugin_damage);
+	n = g.plugin_damage.n;
+	memcpy(rects, g.plugin_damage.rects, n*sizeof(*rects));
+	g.plugin_damage.n = 0;
+	AUG_UNLOCK(&g.plugin_damage);
+
+	for(i = 0; i < n; i++)
+		term_win_defer_damage(&g.term_win, rects[i].start_col, rects[i].end_col, 
+			rects[i].start_row, rects[i].end_row);
+}
+
+static void vterm_cb_stage(void *user) {
+	(void)user;
+
+	take_plugin_damage();
+	term_win_stage(&g.term_win, g.color_on);
 }
 
 static void vterm_cb_refresh(void *user) {
@@ -282,12 +353,39 @@ int screen_damage(VTermRect rect, void *user) {
 		stderr, "screen: damage %d->%d,%d->%d\n", 
 		rect.start_row, rect.end_row, rect.start_col, rect.end_col
 	);*/
-	return term_win_damage(&g.term_win, rect, g.color_on);
+	if(g.damage_hook != NULL)
+		(*g.damage_hook)(rect, g.damage_hook_user);
+	return term_win_damage(&g.term_win, rect);
+}
+
+void screen_set_damage_hook(void (*hook)(VTermRect rect, void *user), void *user) {
+	g.damage_hook = hook;
+	g.damage_hook_user = user;
 }
 
 void screen_defer_damage(size_t col_start, size_t col_end, size_t row_start, 
 		size_t row_end) {
-	term_win_defer_damage(&g.term_win, col_start, col_end, row_start, row_end);
+	VTermRect *rect;
+
+	AUG_LOCK(&g.plugin_damage);
+	if(g.plugin_damage.n < SCREEN_PLUGIN_DAMAGE_MAX) {
+		rect = &g.plugin_damage.rects[g.plugin_damage.n++];
+		rect->start_col = col_start;
+		rect->end_col = col_end;
+		rect->start_row = row_start;
+		rect->end_row = row_end;
+	}
+	else {
+		/* too many to keep track of, so repaint everything
+		 * (term_win_defer_damage clips to the window) */
+		g.plugin_damage.n = 1;
+		rect = &g.plugin_damage.rects[0];
+		rect->start_col = 0;
+		rect->end_col = INT_MAX;
+		rect->start_row = 0;
+		rect->end_row = INT_MAX;
+	}
+	AUG_UNLOCK(&g.plugin_damage);
 }
 
 int screen_redraw_term_win() {
@@ -303,7 +401,7 @@ int screen_redraw_term_win() {
 	rect.start_col = 0;
 	rect.end_col = cols;
 
-	term_win_damage(&g.term_win, rect, g.color_on);
+	term_win_damage(&g.term_win, rect);
 	term_win_refresh(&g.term_win, g.color_on);
 
 	return 0;
@@ -313,6 +411,27 @@ void screen_term_win_dims(int *rows, int *cols) {
 	getmaxyx(g.term_win.win, *rows, *cols);
 }
 
+/* @cell was converted from @row, @col of the primary terminal.
+ * have it take on what was drawn there, which is after the 
+ * plugins had their say (see session_cell_apply_curses). */
+void screen_term_win_cell(int row, int col, struct aug_session_cell *cell) {
+	cchar_t cch;
+	int y, x;
+
+	if(g.term_win.win == NULL || !win_contained(g.term_win.win, row, col) )
+		return;
+
+	/* the window's cursor is where the terminal's cursor goes */
+	getyx(g.term_win.win, y, x);
+	if(mvwin_wch(g.term_win.win, row, col, &cch) != ERR)
+		session_cell_apply_curses(cell, &cch);
+	wmove(g.term_win.win, y, x);
+}
+
+unsigned long screen_cells_painted() {
+	return g.term_win.painted;
+}
+
 int screen_moverect(VTermRect dest, VTermRect src, void *user) {
 	(void)(user);
 	
@@ -322,7 +441,9 @@ int screen_moverect(VTermRect dest, VTermRect src, void *user) {
 		src.start_row, src.end_row, src.start_col, src.end_col
 	);*/
 
-	return term_win_moverect(&g.term_win, dest, src, g.color_on);
+	if(g.damage_hook != NULL)
+		(*g.damage_hook)(dest, g.damage_hook_user);
+	return term_win_moverect(&g.term_win, dest, src);
 }
 
 int screen_movecursor(VTermPos pos, VTermPos oldpos, int visible, void *user) {
@@ -333,57 +454,26 @@ int screen_movecursor(VTermPos pos, VTermPos oldpos, int visible, void *user) {
 		stderr, "screen: movecursor %d, %d => %d, %d\n",
 		oldpos.row, oldpos.col, pos.row, pos.col
 	);*/
-	return term_win_movecursor(&g.term_win, pos, oldpos, g.color_on);
+	return term_win_movecursor(&g.term_win, pos, oldpos);
 }
 
 int screen_bell(void *user) {
 	(void)(user);
 
-	if(beep() == ERR) {
-		fprintf(stderr, "bell failed\n");
-	}
-
-	/*if(flash() == ERR) {
-		fprintf(stderr, "flash failed\n");
-	}*/
-	return 1;
+	return term_win_bell(&g.term_win);
 }
 
 int screen_settermprop(VTermProp prop, VTermValue *val, void *user) {
-	
 	(void)(user);
 
-	/*fprintf(stderr, "settermprop: %d", prop);*/
-	switch(prop) { 
-	case VTERM_PROP_CURSORVISIBLE:
-		/* fprintf(stderr, " (CURSORVISIBLE) = %02x", val->boolean); */
-		/* will return ERR if cursor not supported, *
-		 * so we dont bother checking return value  */
-		curs_set(!!val->boolean); 
-		break;
-	case VTERM_PROP_CURSORBLINK: /* not sure if ncurses can change blink settings */
-		/* fprintf(stderr, " (CURSORBLINK) = %02x", val->boolean); */
-		break;
-	case VTERM_PROP_REVERSE: /* this should be taken care of by update cell i think */
-		/* fprintf(stderr, " (REVERSE) = %02x", val->boolean); */
-		break;
-	case VTERM_PROP_CURSORSHAPE: /* dont think curses can change cursor shape */
-		/* fprintf(stderr, " (CURSORSHAPE) = %d", val->number); */
-		break;
-	default:
-		;
-	}
-
-	/* fprintf(stderr, "\n"); */
-
-	return 1;
+	return term_win_settermprop(&g.term_win, prop, val);
 }
 
 int screen_sb_pushline(int cols, const VTermScreenCell *cells, void *user) {
 	(void)(user);
 	(void)(cells);
 
-	fprintf(stderr, "screen: pushline cols=%d\n", cols);
+	AUG_LOG(AUG_LOG_DEBUG, "screen", "pushline cols=%d\n", cols);
 
 	return 0;
 }
@@ -392,7 +482,7 @@ int screen_sb_popline(int cols, VTermScreenCell *cells, void *user) {
 	(void)(user);
 	(void)(cells);
 
-	fprintf(stderr, "screen: popline cols=%d\n", cols);
+	AUG_LOG(AUG_LOG_DEBUG, "screen", "popline cols=%d\n", cols);
 
 	return 0;
 }
@@ -413,6 +503,8 @@ static WINDOW *derwin_from_region(struct aug_region *region) {
 
 	if(win == NULL) 
 		err_exit(0, "failed to create derwin from region");
+	/* clear whatever used to be on this part of the screen */
+	werase(win);
 
 #ifdef AUG_DEBUG
 	getmaxyx(win, rows, cols);
@@ -432,64 +524,90 @@ static WINDOW *derwin_from_region(struct aug_region *region) {
 
 #define SCREEN_REGION_VALID(_region_ptr) ( (_region_ptr)->rows > 0 && (_region_ptr)->cols > 0 )
 
-static void resize_edge_windows(AVL *key_regs) {
-	AvlIter i;
-	struct aug_region *edge_reg;
-	WINDOW *edge_win;
-
-	free_windows();
-	g.windows = init_window_table();
+/* two empty regions are the same no matter where they are */
+static int region_same(const struct aug_region *a, const struct aug_region *b) {
+	if(!SCREEN_REGION_VALID(a) || !SCREEN_REGION_VALID(b) )
+		return SCREEN_REGION_VALID(a) == SCREEN_REGION_VALID(b);
 
-	avl_foreach(i, key_regs) {
-		edge_reg = (struct aug_region *) i.value;
+	return a->y == b->y && a->x == b->x 
+		&& a->rows == b->rows && a->cols == b->cols;
+}
 
-		if( SCREEN_REGION_VALID(edge_reg) ) {
-			edge_win = derwin_from_region(edge_reg);
-			avl_insert(g.windows, edge_win, i.key);
-		}
-		else {
-			edge_win = NULL;
+/* windows whose region didnt change are kept as they are and 
+ * their plugins dont hear about it. the rest are recreated. */
+static void resize_edge_windows(int fits) {
+	static const struct aug_region empty = {0, 0, 0, 0};
+	const struct aug_region *edge_reg;
+	struct aug_edgewin *ew;
+	size_t n, j;
+	int kept;
+
+	kept = 0;
+	n = region_map_count();
+	for(j = 0; j < n; j++) {
+		ew = region_map_get(j);
+		edge_reg = (fits != 0)? &ew->region : &empty;
+
+		if(ew->placed != 0 && region_same(&ew->win_region, edge_reg) ) {
+			kept++;
+			continue;
 		}
+		free_edge(ew);
+
+		if( SCREEN_REGION_VALID(edge_reg) ) 
+			ew->win = derwin_from_region(edge_reg);
+		ew->win_region = *edge_reg;
+		ew->placed = 1;
 
 		/* defined in aug.c: inform plugin of new WINDOW object
 		 * that it should use for its allocated edge window */
-		make_win_alloc_cb_new(i.key, edge_win);
+		make_win_alloc_cb_new(ew, ew->win);
 	} /* for each region */
 
+	AUG_LOG(AUG_LOG_DEBUG, "screen", "kept %d of %zu edge windows\n", kept, n);
 }
 
-/* this should be called before vterm_set_size
- * which will cause the term damage callback
- * to fully rewrite the screen.
- */
-void screen_resize() {
-	AVL *key_regs;
+/* recompute the layout of the edge windows and the terminal 
+ * window for the current screen size. */
+void screen_relayout() {
 	struct aug_region primary;
 	WINDOW *win;
+	int fits;
 
-	if(endwin() == ERR)
-		err_exit(0, "endwin failed!");
-	screen_refresh();
-	fprintf(stderr, "screen: resize to %d, %d\n", LINES, COLS);
+	fits = (region_map_layout(LINES, COLS, &primary) == 0);
+	if(fits == 0) {
+		/* the screen has no room for anything */
+		primary.rows = 0;
+		primary.cols = 0;
+	}
+	resize_edge_windows(fits);
+
+	if(g.term_win.win != NULL && region_same(&primary, &g.primary) )
+		return;
 
 	if(free_term_win() != 0)
 		err_exit(0, "failed to free term window");
-
-	key_regs = region_map_key_regs_alloc();
-	if(key_regs == NULL)
-		err_exit(0, "no memory");
-	region_map_apply(LINES, COLS, key_regs, &primary);
-	resize_edge_windows(key_regs);
-	
+	g.primary = primary;
 	if( SCREEN_REGION_VALID(&primary) ) {
 		win = derwin_from_region(&primary);
 		term_win_resize(&g.term_win, win);
 	}
-
-	region_map_key_regs_free(key_regs);
 }
 #undef SCREEN_REGION_VALID
 
+/* picks up the new size of the outer terminal. this should 
+ * be called before vterm_set_size which will cause the term 
+ * damage callback to fully rewrite the screen.
+ */
+void screen_resize() {
+	if(endwin() == ERR)
+		err_exit(0, "endwin failed!");
+	screen_refresh();
+	AUG_LOG(AUG_LOG_DEBUG, "screen", "resize to %d, %d\n", LINES, COLS);
+
+	screen_relayout();
+}
+
 /* converts a character into its string representation.
  * *str* should have enough space for 2 characters + one
  * one null byte.
@@ -544,6 +662,32 @@ void screen_doupdate() {
 		err_exit(0, "doupdate failed");
 }
 
+/* bytes written to the outer terminal which it hasnt taken 
+ * yet, or -1 if the tty cant tell us (ptys usually report 0, 
+ * so a slow flush is the other sign of congestion). */
+long screen_output_queued() {
+	int n;
+
+	if(ioctl(STDOUT_FILENO, TIOCOUTQ, &n) != 0)
+		return -1;
+
+	return n;
+}
+
+/* whether the outer terminal would take more output right 
+ * now. if we cant tell, assume it would. */
+int screen_output_writable() {
+	struct pollfd pfd;
+
+	pfd.fd = STDOUT_FILENO;
+	pfd.events = POLLOUT;
+	pfd.revents = 0;
+	if(poll(&pfd, 1, 0) < 0)
+		return 1;
+
+	return (pfd.revents & POLLOUT) != 0;
+}
+
 void screen_clear() {
 	if(clear() == ERR) 
 		err_exit(0, "failed to clear screen");
@@ -43,6 +43,12 @@ int screen_getch(uint32_t *ch);
 /*void screen_err_msg(int error, char **msg);*/
 int screen_color_start();
 int screen_damage(VTermRect rect, void *user);
+/* @hook is also told about every damaged (or moved to) rect of the
+ * terminal shown on the screen, with the terminal locked. */
+void screen_set_damage_hook(void (*hook)(VTermRect rect, void *user), void *user);
+/* queue damage to the primary terminal. this takes only a lock of 
+ * its own, so it can be called with or without the terminal locked.
+ * the damage is applied the next time the terminal is staged. */
 void screen_defer_damage(size_t col_start, size_t col_end, size_t row_start, 
 		size_t row_end);
 void screen_damage_win();
@@ -63,12 +69,22 @@ int screen_sb_popline(int cols, VTermScreenCell *cells, void *user);
 int screen_push_top_edgewin(int nlines, void **win);
 
 void screen_resize();
+void screen_relayout();
+struct aug_edgewin;
+void screen_release_edgewin(struct aug_edgewin *ew);
+void screen_free_edgewins();
 int screen_unctrl(uint32_t ch, char *str);
 int screen_keyname_to_key(const char *str, uint32_t *ch);
 void screen_doupdate();
+long screen_output_queued();
+int screen_output_writable();
 void screen_clear();
 int screen_redraw_term_win();
 void screen_term_win_dims(int *rows, int *cols);
+struct aug_session_cell;
+void screen_term_win_cell(int row, int col, struct aug_session_cell *cell);
+/* cells of the primary terminal written to the screen so far */
+unsigned long screen_cells_painted();
 const char *screen_err_msg(int err);
 
 #endif /* AUG_SCREEN_H */
\ No newline at end of file
@@ -0,0 +1,788 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "session.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#include "util.h"
+#include "err.h"
+#include "attr.h"
+#include "vterm_util.h"
+#include "vterm_ansi_colors.h"
+
+#define AUG_SESSION_BUF_INIT 4096
+
+void session_cell_from_vterm(const VTermScreenCell *vcell, 
+		struct aug_session_cell *cell) {
+	int i;
+
+	memset(cell, 0, sizeof(*cell));
+
+	cell->ch = vcell->chars[0];
+	for(i = 0; i < AUG_SESSION_COMBINING && i + 1 < VTERM_MAX_CHARS_PER_CELL
+			&& vcell->chars[0] != AUG_SESSION_CONTINUATION 
+			&& vcell->chars[i+1] != 0; i++)
+		cell->combining[i] = vcell->chars[i+1];
+	cell->width = vcell->width;
+	cell->fg[0] = vcell->fg.red;
+	cell->fg[1] = vcell->fg.green;
+	cell->fg[2] = vcell->fg.blue;
+	cell->bg[0] = vcell->bg.red;
+	cell->bg[1] = vcell->bg.green;
+	cell->bg[2] = vcell->bg.blue;
+
+	if(vcell->attrs.bold != 0)
+		cell->attrs |= AUG_SESSION_BOLD;
+	if(vcell->attrs.underline != 0)
+		cell->attrs |= AUG_SESSION_UNDERLINE;
+	if(vcell->attrs.italic != 0)
+		cell->attrs |= AUG_SESSION_ITALIC;
+	if(vcell->attrs.blink != 0)
+		cell->attrs |= AUG_SESSION_BLINK;
+	if(vcell->attrs.reverse != 0)
+		cell->attrs |= AUG_SESSION_REVERSE;
+	if(vcell->attrs.strike != 0)
+		cell->attrs |= AUG_SESSION_STRIKE;
+	/* see term.c:term_init */
+	if(vterm_color_equal(&vcell->fg, &VTERM_DEFAULT_COLOR) )
+		cell->attrs |= AUG_SESSION_DEFAULT_FG;
+	if(vterm_color_equal(&vcell->bg, &VTERM_DEFAULT_COLOR) )
+		cell->attrs |= AUG_SESSION_DEFAULT_BG;
+}
+
+static void color_from_curses(int color, uint8_t *rgb, uint8_t *attrs, uint8_t dflt) {
+	const VTermColor *vc;
+
+	if(color < 0 || color >= AUG_ANSI_COLORS) {
+		*attrs |= dflt;
+		memset(rgb, 0, 3);
+		return;
+	}
+
+	/* the curses colors are in the same order */
+	vc = &vterm_ansi_colors[color];
+	*attrs &= ~dflt;
+	rgb[0] = vc->red;
+	rgb[1] = vc->green;
+	rgb[2] = vc->blue;
+}
+
+void session_cell_apply_curses(struct aug_session_cell *cell, const cchar_t *cch) {
+	wchar_t wch[CCHARW_MAX + 1];
+	VTermColor fg, bg;
+	attr_t attr, vattr;
+	short pair, sfg, sbg;
+	int vpair, cfg, cbg, i;
+
+	/* drawn along with the wide character */
+	if(cell->ch == AUG_SESSION_CONTINUATION)
+		return;
+	memset(wch, 0, sizeof(wch));
+	if(getcchar(cch, wch, &attr, &pair, NULL) == ERR)
+		return;
+
+	/* an empty cell is drawn as a space */
+	if(wch[0] != L' ' || cell->ch != 0)
+		cell->ch = wch[0];
+	memset(cell->combining, 0, sizeof(cell->combining));
+	for(i = 0; i < AUG_SESSION_COMBINING && wch[0] != 0 && wch[i+1] != 0; i++)
+		cell->combining[i] = wch[i+1];
+
+	cell->attrs &= ~(AUG_SESSION_BOLD | AUG_SESSION_UNDERLINE 
+		| AUG_SESSION_BLINK | AUG_SESSION_REVERSE);
+	if(attr & A_BOLD)
+		cell->attrs |= AUG_SESSION_BOLD;
+	if(attr & A_UNDERLINE)
+		cell->attrs |= AUG_SESSION_UNDERLINE;
+	if(attr & A_BLINK)
+		cell->attrs |= AUG_SESSION_BLINK;
+	if(attr & A_REVERSE)
+		cell->attrs |= AUG_SESSION_REVERSE;
+
+	/* the terminal's colors are more precise than curses' 
+	 * version of them, so they stay unless the pair is not 
+	 * the one they were drawn with */
+	fg = VTERM_DEFAULT_COLOR;
+	bg = VTERM_DEFAULT_COLOR;
+	if( (cell->attrs & AUG_SESSION_DEFAULT_FG) == 0) {
+		fg.red = cell->fg[0];
+		fg.green = cell->fg[1];
+		fg.blue = cell->fg[2];
+	}
+	if( (cell->attrs & AUG_SESSION_DEFAULT_BG) == 0) {
+		bg.red = cell->bg[0];
+		bg.green = cell->bg[1];
+		bg.blue = cell->bg[2];
+	}
+	vattr = A_NORMAL;
+	attr_vterm_pair_to_curses_pair(fg, bg, &vattr, &vpair);
+	if(pair == vpair)
+		return;
+
+	cfg = cbg = -1;
+	if(pair > 0 && pair < AUG_REQ_PAIRS)
+		attr_curses_pair_to_curses_colors(pair, &cfg, &cbg);
+	else if(pair >= AUG_REQ_PAIRS && pair_content(pair, &sfg, &sbg) != ERR) {
+		/* a pair of the plugin's own */
+		cfg = sfg;
+		cbg = sbg;
+	}
+	color_from_curses(cfg, cell->fg, &cell->attrs, AUG_SESSION_DEFAULT_FG);
+	color_from_curses(cbg, cell->bg, &cell->attrs, AUG_SESSION_DEFAULT_BG);
+}
+
+/* ================== queue ================== */
+
+void session_queue_init(struct aug_session_queue *q) {
+	q->data = NULL;
+	q->off = 0;
+	q->len = 0;
+	q->size = 0;
+}
+
+void session_queue_free(struct aug_session_queue *q) {
+	free(q->data);
+	session_queue_init(q);
+}
+
+static void queue_append(struct aug_session_queue *q, const void *data, size_t n) {
+	char *buf;
+
+	if(q->len + n > q->size) {
+		/* move the unsent data to the front before growing */
+		if(q->off > 0) {
+			memmove(q->data, q->data + q->off, q->len - q->off);
+			q->len -= q->off;
+			q->off = 0;
+		}
+
+		if(q->len + n > q->size) {
+			if(q->size == 0)
+				q->size = AUG_SESSION_BUF_INIT;
+			while(q->len + n > q->size)
+				q->size *= 2;
+
+			buf = realloc(q->data, q->size);
+			if(buf == NULL)
+				err_exit(0, "out of memory");
+			q->data = buf;
+		}
+	}
+
+	memcpy(q->data + q->len, data, n);
+	q->len += n;
+}
+
+/* the payload has to be appended right after */
+static void queue_hdr(struct aug_session_queue *q, uint32_t type, size_t len) {
+	struct aug_session_hdr hdr;
+
+	hdr.type = type;
+	hdr.len = len;
+	queue_append(q, &hdr, sizeof(hdr));
+}
+
+void session_queue_msg(struct aug_session_queue *q, uint32_t type, 
+		const void *payload, size_t len) {
+	queue_hdr(q, type, len);
+	queue_append(q, payload, len);
+}
+
+int session_queue_flush(struct aug_session_queue *q, int fd) {
+	ssize_t n;
+
+	while(q->off < q->len) {
+		n = send(fd, q->data + q->off, q->len - q->off, MSG_NOSIGNAL);
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			return -1;
+		}
+		q->off += n;
+	}
+
+	q->off = q->len = 0;
+	return 0;
+}
+
+/* ================== reader ================== */
+
+void session_reader_init(struct aug_session_reader *r) {
+	r->data = NULL;
+	r->off = 0;
+	r->len = 0;
+	r->size = 0;
+}
+
+void session_reader_free(struct aug_session_reader *r) {
+	free(r->data);
+	session_reader_init(r);
+}
+
+int session_reader_fill(struct aug_session_reader *r, int fd) {
+	ssize_t n;
+	char *buf;
+
+	/* whatever was popped is done with now */
+	if(r->off > 0) {
+		memmove(r->data, r->data + r->off, r->len - r->off);
+		r->len -= r->off;
+		r->off = 0;
+	}
+
+	while(1) {
+		if(r->len == r->size) {
+			r->size = (r->size == 0)? AUG_SESSION_BUF_INIT : r->size*2;
+			buf = realloc(r->data, r->size);
+			if(buf == NULL)
+				err_exit(0, "out of memory");
+			r->data = buf;
+		}
+
+		n = read(fd, r->data + r->len, r->size - r->len);
+		if(n == 0) {
+			errno = 0;
+			return -1;
+		}
+		else if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			return -1;
+		}
+
+		r->len += n;
+		if(r->len < r->size)
+			return 0;
+	}
+}
+
+int session_reader_next(struct aug_session_reader *r, 
+		struct aug_session_hdr *hdr, const char **payload) {
+	if(r->len - r->off < sizeof(*hdr))
+		return 0;
+
+	memcpy(hdr, r->data + r->off, sizeof(*hdr));
+	if(hdr->len > AUG_SESSION_MAX_MSG)
+		return -1;
+	if(r->len - r->off - sizeof(*hdr) < hdr->len)
+		return 0;
+
+	*payload = r->data + r->off + sizeof(*hdr);
+	r->off += sizeof(*hdr) + hdr->len;
+	return 1;
+}
+
+/* ================== view ================== */
+
+void session_view_init(struct aug_session_view *view) {
+	view->rows = 0;
+	view->cols = 0;
+	view->cursor_row = 0;
+	view->cursor_col = 0;
+	view->cells = NULL;
+	AUG_STATUS_EQUAL( rect_set_init(&view->dirty, 0, 0), 0 );
+}
+
+void session_view_free(struct aug_session_view *view) {
+	free(view->cells);
+	view->cells = NULL;
+	rect_set_free(&view->dirty);
+}
+
+void session_view_resize(struct aug_session_view *view, int rows, int cols) {
+	free(view->cells);
+	view->cells = aug_malloc(rows*cols*sizeof(*view->cells));
+	rect_set_free(&view->dirty);
+	if(rect_set_init(&view->dirty, cols, rows) != 0)
+		err_exit(0, "out of memory");
+	view->rows = rows;
+	view->cols = cols;
+}
+
+int session_view_apply(struct aug_session_view *view, 
+		const struct aug_session_hdr *hdr, const char *payload) {
+	struct aug_session_screen scr;
+	struct aug_session_run run;
+	size_t off, n;
+
+	if(hdr->len < sizeof(scr))
+		return -1;
+	memcpy(&scr, payload, sizeof(scr));
+	off = sizeof(scr);
+
+	switch(hdr->type) {
+	case AUG_SESSION_MSG_FULL:
+		n = (size_t) scr.rows*scr.cols;
+		if(hdr->len - off != n*sizeof(struct aug_session_cell))
+			return -1;
+		if(scr.rows != view->rows || scr.cols != view->cols)
+			session_view_resize(view, scr.rows, scr.cols);
+		memcpy(view->cells, payload + off, n*sizeof(struct aug_session_cell));
+		rect_set_add(&view->dirty, 0, 0, view->cols, view->rows);
+		break;
+
+	case AUG_SESSION_MSG_DIFF:
+		if(scr.rows != view->rows || scr.cols != view->cols)
+			return -1;
+		while(off < hdr->len) {
+			if(hdr->len - off < sizeof(run))
+				return -1;
+			memcpy(&run, payload + off, sizeof(run));
+			off += sizeof(run);
+
+			n = run.len*sizeof(struct aug_session_cell);
+			if(hdr->len - off < n || run.row >= view->rows 
+					|| run.col + run.len > view->cols)
+				return -1;
+			memcpy(&view->cells[run.row*view->cols + run.col], payload + off, n);
+			rect_set_add(&view->dirty, run.col, run.row, run.col + run.len, run.row + 1);
+			off += n;
+		}
+		break;
+
+	default:
+		return -1;
+	}
+
+	view->cursor_row = scr.cursor_row;
+	view->cursor_col = scr.cursor_col;
+	return 0;
+}
+
+/* ================== server ================== */
+
+static void wake(struct aug_session *s, char why) {
+	if(write(s->wake[1], &why, 1) != 1 && errno != EAGAIN)
+		err_exit(errno, "session: failed to wake thread");
+}
+
+static void add_client(struct aug_session *s, int fd) {
+	struct aug_session_client *c;
+
+	c = &s->clients[s->n_clients++];
+	c->fd = fd;
+	c->needs_full = 1;
+	c->dead = 0;
+	session_queue_init(&c->out);
+	session_reader_init(&c->in);
+}
+
+static void accept_client(struct aug_session *s) {
+	int fd, added;
+	uid_t uid;
+
+	if( (fd = accept(s->fd, NULL, NULL) ) < 0) {
+		if(errno != EINTR && errno != EAGAIN && errno != ECONNABORTED)
+			err_warn(errno, "session: accept failed");
+		return;
+	}
+
+	/* children forked later on mustnt keep the client around */
+	if(fcntl(fd, F_SETFD, FD_CLOEXEC) != 0 || set_nonblocking(fd) != 0) {
+		err_warn(errno, "session: failed to set up client");
+		close(fd);
+		return;
+	}
+
+	/* the socket is only reachable by the user, but check
+	 * anyway in case its permissions were changed */
+	if(unix_peer_uid(fd, &uid) != 0) {
+		err_warn(errno, "session: failed to get the uid of a client");
+		close(fd);
+		return;
+	}
+	if(uid != geteuid()) {
+		err_warn(0, "session: refused a client with uid %d", (int) uid);
+		close(fd);
+		return;
+	}
+
+	AUG_LOCK(s);
+	added = (s->n_clients < AUG_SESSION_MAX_CLIENTS);
+	if(added)
+		add_client(s, fd);
+	AUG_UNLOCK(s);
+
+	if(!added) {
+		err_warn(0, "session: too many clients");
+		close(fd);
+		return;
+	}
+
+	(*s->on_attach)(s->user);
+}
+
+/* read from client @i and gather up what it typed in @input
+ * and the last size it asked for in @dims (@dims->rows is 0 if
+ * it didnt). the session must be locked. */
+static void read_client(struct aug_session *s, int i, struct aug_session_queue *input,
+		struct aug_session_dims *dims) {
+	struct aug_session_client *c;
+	struct aug_session_hdr hdr;
+	const char *payload;
+	int status;
+
+	c = &s->clients[i];
+	if(session_reader_fill(&c->in, c->fd) != 0) {
+		c->dead = 1;
+		return;
+	}
+
+	while( (status = session_reader_next(&c->in, &hdr, &payload) ) == 1) {
+		if(hdr.type == AUG_SESSION_MSG_INPUT)
+			queue_append(input, payload, hdr.len);
+		else if(hdr.type == AUG_SESSION_MSG_RESIZE && hdr.len == sizeof(*dims) )
+			memcpy(dims, payload, sizeof(*dims));
+		else {
+			status = -1;
+			break;
+		}
+	}
+
+	if(status < 0) {
+		err_warn(0, "session: client sent garbage");
+		c->dead = 1;
+	}
+}
+
+/* the session must be locked */
+static void reap_clients(struct aug_session *s) {
+	struct aug_session_client *c;
+	int i;
+
+	for(i = 0; i < s->n_clients; ) {
+		c = &s->clients[i];
+		if(c->dead == 0) {
+			i++;
+			continue;
+		}
+
+		close(c->fd);
+		session_queue_free(&c->out);
+		session_reader_free(&c->in);
+		*c = s->clients[--s->n_clients];
+	}
+}
+
+static void *session_thread(void *user) {
+	struct aug_session *s;
+	struct pollfd fds[2 + AUG_SESSION_MAX_CLIENTS];
+	struct aug_session_queue input;
+	struct aug_session_dims dims;
+	char why[16];
+	ssize_t n;
+	int i, n_fds, quit;
+
+	s = user;
+	session_queue_init(&input);
+	quit = 0;
+	while(quit == 0) {
+		fds[0].fd = s->fd;
+		fds[0].events = POLLIN;
+		fds[1].fd = s->wake[0];
+		fds[1].events = POLLIN;
+
+		/* only this thread adds or removes clients, so the
+		 * indices stay put until the next time around */
+		AUG_LOCK(s);
+		reap_clients(s);
+		for(i = 0; i < s->n_clients; i++) {
+			fds[2+i].fd = s->clients[i].fd;
+			fds[2+i].events = POLLIN;
+			if(session_queue_pending(&s->clients[i].out) > 0)
+				fds[2+i].events |= POLLOUT;
+		}
+		n_fds = 2 + s->n_clients;
+		AUG_UNLOCK(s);
+
+		if(poll(fds, n_fds, -1) < 0) {
+			if(errno == EINTR)
+				continue;
+			err_exit(errno, "session: poll failed");
+		}
+
+		if(fds[1].revents != 0) {
+			while( (n = read(s->wake[0], why, sizeof(why)) ) > 0)
+				if(memchr(why, 'q', n) != NULL)
+					quit = 1;
+		}
+
+		dims.rows = 0;
+		AUG_LOCK(s);
+		for(i = 0; i < n_fds - 2; i++) {
+			if(fds[2+i].revents & POLLOUT)
+				if(session_queue_flush(&s->clients[i].out, s->clients[i].fd) != 0)
+					s->clients[i].dead = 1;
+			if(fds[2+i].revents & (POLLIN | POLLHUP | POLLERR) )
+				read_client(s, i, &input, &dims);
+		}
+		AUG_UNLOCK(s);
+
+		/* the size follows whichever client asked last */
+		if(dims.rows > 0 && dims.cols > 0 && s->on_resize != NULL)
+			(*s->on_resize)(dims.rows, dims.cols, s->user);
+
+		if(session_queue_pending(&input) > 0) {
+			(*s->on_input)(input.data + input.off, 
+				session_queue_pending(&input), s->user);
+			input.off = input.len = 0;
+		}
+
+		if(quit == 0 && fds[0].revents != 0)
+			accept_client(s);
+	}
+
+	session_queue_free(&input);
+	return NULL;
+}
+
+int session_start(struct aug_session *s, const char *path,
+		void (*on_input)(const char *data, size_t len, void *user),
+		void (*on_resize)(int rows, int cols, void *user),
+		void (*on_attach)(void *user), void *user) {
+	int status;
+
+	s->path = path;
+	s->on_input = on_input;
+	s->on_resize = on_resize;
+	s->on_attach = on_attach;
+	s->user = user;
+	s->n_clients = 0;
+	s->shadow_valid = 0;
+	s->rows = 0;
+	s->cols = 0;
+	s->cursor_row = 0;
+	s->cursor_col = 0;
+	s->shadow = NULL;
+	AUG_STATUS_EQUAL( rect_set_init(&s->damage, 0, 0), 0 );
+	session_queue_init(&s->diff);
+	AUG_LOCK_INIT(s);
+
+	if( (s->fd = unix_listen(path) ) < 0)
+		goto free_session;
+	if(pipe(s->wake) != 0)
+		goto close_fd;
+	if(set_nonblocking(s->wake[0]) != 0 || set_nonblocking(s->wake[1]) != 0)
+		goto close_pipe;
+	if( (status = pthread_create(&s->thread, NULL, session_thread, s) ) != 0) {
+		errno = status;
+		goto close_pipe;
+	}
+
+	return 0;
+
+close_pipe:
+	status = errno;
+	close(s->wake[0]);
+	close(s->wake[1]);
+	errno = status;
+close_fd:
+	status = errno;
+	close(s->fd);
+	unlink(path);
+	errno = status;
+free_session:
+	status = errno;
+	rect_set_free(&s->damage);
+	session_queue_free(&s->diff);
+	AUG_LOCK_FREE(s);
+	errno = status;
+	return -1;
+}
+
+void session_stop(struct aug_session *s) {
+	int i;
+
+	wake(s, 'q');
+	AUG_STATUS_EQUAL( pthread_join(s->thread, NULL), 0 );
+
+	for(i = 0; i < s->n_clients; i++)
+		s->clients[i].dead = 1;
+	reap_clients(s);
+
+	close(s->wake[0]);
+	close(s->wake[1]);
+	close(s->fd);
+	if(unlink(s->path) != 0)
+		err_warn(errno, "session: failed to remove %s", s->path);
+
+	free(s->shadow);
+	rect_set_free(&s->damage);
+	session_queue_free(&s->diff);
+	AUG_LOCK_FREE(s);
+}
+
+void session_damage(struct aug_session *s, VTermRect rect) {
+	AUG_LOCK(s);
+	/* nothing to diff against anyway */
+	if(s->shadow_valid != 0)
+		rect_set_add(&s->damage, rect.start_col, rect.start_row, 
+			rect.end_col, rect.end_row);
+	AUG_UNLOCK(s);
+}
+
+static void resize_shadow(struct aug_session *s, int rows, int cols) {
+	free(s->shadow);
+	s->shadow = aug_malloc(rows*cols*sizeof(*s->shadow));
+	rect_set_free(&s->damage);
+	if(rect_set_init(&s->damage, cols, rows) != 0)
+		err_exit(0, "out of memory");
+	s->rows = rows;
+	s->cols = cols;
+}
+
+/* encode the damaged cells which differ from the shadow into 
+ * s->diff (the payload of a diff message) and update the shadow. 
+ * returns the number of runs. */
+static int encode_diff(struct aug_session *s, aug_session_cell_fn cell, void *user) {
+	struct aug_rect_set_rect rect;
+	struct aug_session_screen scr;
+	struct aug_session_run run;
+	struct aug_session_cell c, *shadow;
+	size_t row, col, run_off;
+	int runs, in_run;
+
+	scr.rows = s->rows;
+	scr.cols = s->cols;
+	scr.cursor_row = s->cursor_row;
+	scr.cursor_col = s->cursor_col;
+	s->diff.off = s->diff.len = 0;
+	queue_append(&s->diff, &scr, sizeof(scr));
+
+	run_off = 0;
+	runs = 0;
+	while(rect_set_pop(&s->damage, &rect) == 0) {
+		for(row = rect.row_start; row < rect.row_end; row++) {
+			in_run = 0;
+			for(col = rect.col_start; col < rect.col_end; col++) {
+				(*cell)(row, col, &c, user);
+				shadow = &s->shadow[row*s->cols + col];
+				if(memcmp(&c, shadow, sizeof(c)) == 0) {
+					in_run = 0;
+					continue;
+				}
+
+				*shadow = c;
+				if(in_run == 0) {
+					run.row = row;
+					run.col = col;
+					run.len = 0;
+					run.pad = 0;
+					run_off = s->diff.len;
+					queue_append(&s->diff, &run, sizeof(run));
+					in_run = 1;
+					runs++;
+				}
+				queue_append(&s->diff, &c, sizeof(c));
+				((struct aug_session_run *) (s->diff.data + run_off))->len++;
+			}
+		}
+	}
+
+	return runs;
+}
+
+void session_frame(struct aug_session *s, int rows, int cols,
+		int cursor_row, int cursor_col, aug_session_cell_fn cell, void *user) {
+	struct aug_session_client *c;
+	struct aug_session_screen scr;
+	int i, row, col, runs, moved, full, wake_thread;
+
+	AUG_LOCK(s);
+	if(s->n_clients == 0) {
+		s->shadow_valid = 0;
+		goto unlock;
+	}
+
+	if(rows != s->rows || cols != s->cols) {
+		resize_shadow(s, rows, cols);
+		s->shadow_valid = 0;
+	}
+
+	moved = (cursor_row != s->cursor_row || cursor_col != s->cursor_col);
+	s->cursor_row = cursor_row;
+	s->cursor_col = cursor_col;
+
+	full = 0;
+	runs = 0;
+	if(s->shadow_valid == 0) {
+		for(row = 0; row < rows; row++)
+			for(col = 0; col < cols; col++)
+				(*cell)(row, col, &s->shadow[row*cols + col], user);
+		rect_set_clear(&s->damage);
+		s->shadow_valid = 1;
+		full = 1;
+	}
+	else 
+		runs = encode_diff(s, cell, user);
+
+	wake_thread = 0;
+	for(i = 0; i < s->n_clients; i++) {
+		c = &s->clients[i];
+		if(c->dead != 0)
+			continue;
+
+		if(full != 0)
+			c->needs_full = 1;
+
+		if(c->needs_full != 0) {
+			/* a client which is behind has to catch up with 
+			 * what it was already sent first */
+			if(session_queue_pending(&c->out) > 0)
+				continue;
+			scr.rows = rows;
+			scr.cols = cols;
+			scr.cursor_row = cursor_row;
+			scr.cursor_col = cursor_col;
+			queue_hdr(&c->out, AUG_SESSION_MSG_FULL, 
+				sizeof(scr) + rows*cols*sizeof(*s->shadow));
+			queue_append(&c->out, &scr, sizeof(scr));
+			queue_append(&c->out, s->shadow, rows*cols*sizeof(*s->shadow));
+			c->needs_full = 0;
+		}
+		else if(runs > 0 || moved != 0) {
+			if(session_queue_pending(&c->out) > AUG_SESSION_MAX_QUEUED) {
+				c->needs_full = 1;
+				continue;
+			}
+			session_queue_msg(&c->out, AUG_SESSION_MSG_DIFF, 
+				s->diff.data, s->diff.len);
+		}
+
+		if(session_queue_flush(&c->out, c->fd) != 0)
+			c->dead = 1;
+		if(c->dead != 0 || session_queue_pending(&c->out) > 0)
+			wake_thread = 1;
+	}
+
+	if(wake_thread != 0)
+		wake(s, 'w');
+unlock:
+	AUG_UNLOCK(s);
+}
@@ -0,0 +1,293 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUG_SESSION_H
+#define AUG_SESSION_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <termios.h>
+#include <sys/types.h>
+
+#include "vterm.h"
+#include "ncurses.h"
+#include "lock.h"
+#include "rect_set.h"
+
+/* serves the primary terminal to clients attached over a unix 
+ * stream socket (see aug --attach). a client which attaches is 
+ * sent the whole screen once and after that only the cells which 
+ * changed in each frame, so what goes over the socket is 
+ * proportional to what changes on the screen rather than to the
+ * output of the child. what the client types is sent back and 
+ * typed into aug, and the size of its terminal becomes the 
+ * size of aug's.
+ *
+ * every message is a struct aug_session_hdr followed by @len
+ * bytes of payload. the socket is local, so everything is in host
+ * byte order. */
+struct aug_session_hdr {
+	uint32_t type;
+	uint32_t len;
+};
+
+enum aug_session_msg {
+	/* server to client: a struct aug_session_screen followed by
+	 * rows*cols cells, row by row */
+	AUG_SESSION_MSG_FULL = 1,
+	/* server to client: a struct aug_session_screen followed by 
+	 * runs. each run is a struct aug_session_run followed by 
+	 * @len cells which go at @row, @col to @col+@len-1. */
+	AUG_SESSION_MSG_DIFF,
+	/* client to server: bytes to write to the terminal */
+	AUG_SESSION_MSG_INPUT,
+	/* client to server: a struct aug_session_dims, the size of
+	 * the client's terminal. sent when it attaches and whenever
+	 * that terminal is resized. */
+	AUG_SESSION_MSG_RESIZE
+};
+
+struct aug_session_dims {
+	uint16_t rows;
+	uint16_t cols;
+};
+
+struct aug_session_screen {
+	uint16_t rows;
+	uint16_t cols;
+	uint16_t cursor_row;
+	uint16_t cursor_col;
+};
+
+struct aug_session_run {
+	uint16_t row;
+	uint16_t col;
+	uint16_t len;
+	uint16_t pad;
+};
+
+#define AUG_SESSION_BOLD       0x01
+#define AUG_SESSION_UNDERLINE  0x02
+#define AUG_SESSION_ITALIC     0x04
+#define AUG_SESSION_BLINK      0x08
+#define AUG_SESSION_REVERSE    0x10
+#define AUG_SESSION_STRIKE     0x20
+/* the cell uses the default fore/background color of
+ * whatever displays it, and @fg/@bg are meaningless */
+#define AUG_SESSION_DEFAULT_FG 0x40
+#define AUG_SESSION_DEFAULT_BG 0x80
+
+/* @ch is 0 for an empty cell and AUG_SESSION_CONTINUATION for
+ * the cell covered by the right half of a wide character. 
+ * @combining holds the combining characters which go with @ch, 
+ * followed by 0s (any beyond AUG_SESSION_COMBINING are dropped). */
+#define AUG_SESSION_CONTINUATION 0xffffffff
+#define AUG_SESSION_COMBINING 2
+
+struct aug_session_cell {
+	uint32_t ch;
+	uint32_t combining[AUG_SESSION_COMBINING];
+	uint8_t fg[3];
+	uint8_t bg[3];
+	uint8_t attrs;
+	uint8_t width;
+};
+
+/* messages bigger than this are treated as garbage */
+#define AUG_SESSION_MAX_MSG (1 << 24)
+#define AUG_SESSION_MAX_CLIENTS 16
+/* once this much is waiting to be sent to a client, it stops 
+ * getting diffs and is sent the whole screen again after it 
+ * catches up. */
+#define AUG_SESSION_MAX_QUEUED (1 << 20)
+
+void session_cell_from_vterm(const VTermScreenCell *vcell, 
+		struct aug_session_cell *cell);
+/* @cell was converted from a terminal cell which was drawn as
+ * @cch, so take on what the plugins changed while drawing it 
+ * (see the cell_update callback). */
+void session_cell_apply_curses(struct aug_session_cell *cell, const cchar_t *cch);
+
+/* bytes waiting to go out on a non-blocking fd */
+struct aug_session_queue {
+	char *data;
+	size_t off;
+	size_t len;
+	size_t size;
+};
+
+void session_queue_init(struct aug_session_queue *q);
+void session_queue_free(struct aug_session_queue *q);
+static inline size_t session_queue_pending(const struct aug_session_queue *q) {
+	return q->len - q->off;
+}
+void session_queue_msg(struct aug_session_queue *q, uint32_t type, 
+		const void *payload, size_t len);
+/* write as much as @fd takes without blocking. returns -1 
+ * (with errno set) if @fd is broken. */
+int session_queue_flush(struct aug_session_queue *q, int fd);
+
+/* reassembles messages from a stream */
+struct aug_session_reader {
+	char *data;
+	size_t off;
+	size_t len;
+	size_t size;
+};
+
+void session_reader_init(struct aug_session_reader *r);
+void session_reader_free(struct aug_session_reader *r);
+/* read what is available from @fd. returns -1 at end of file
+ * or on error (errno is 0 at end of file). */
+int session_reader_fill(struct aug_session_reader *r, int fd);
+/* pop the next complete message. @payload points into @r and is
+ * good until the next session_reader_fill. returns 1 if a message
+ * was popped, 0 if more input is needed and -1 if the stream 
+ * is garbage. */
+int session_reader_next(struct aug_session_reader *r, 
+		struct aug_session_hdr *hdr, const char **payload);
+
+/* the screen as a client sees it */
+struct aug_session_view {
+	int rows;
+	int cols;
+	int cursor_row;
+	int cursor_col;
+	struct aug_session_cell *cells;
+	/* cells changed by messages since this was last cleared */
+	struct aug_rect_set dirty;
+};
+
+void session_view_init(struct aug_session_view *view);
+void session_view_free(struct aug_session_view *view);
+/* the contents are undefined after a resize */
+void session_view_resize(struct aug_session_view *view, int rows, int cols);
+/* returns -1 if the message is malformed */
+int session_view_apply(struct aug_session_view *view, 
+		const struct aug_session_hdr *hdr, const char *payload);
+/* draw the dirty cells (and clear them) with escape sequences */
+void session_view_render(FILE *f, struct aug_session_view *view);
+
+struct aug_session_client {
+	int fd;
+	int needs_full;
+	/* set by whoever finds the client broken. the 
+	 * session thread closes it. */
+	int dead;
+	struct aug_session_queue out;
+	struct aug_session_reader in;
+};
+
+/* reads the cell at @row, @col of the screen being served */
+typedef void (*aug_session_cell_fn)(int row, int col, 
+		struct aug_session_cell *cell, void *user);
+
+struct aug_session {
+	int fd;
+	/* written to to wake the session thread. a 'q' stops it. */
+	int wake[2];
+	const char *path;
+	pthread_t thread;
+	/* protects everything below */
+	AUG_LOCK_MEMBERS;
+	struct aug_session_client clients[AUG_SESSION_MAX_CLIENTS];
+	int n_clients;
+	/* the screen as of the last frame. only valid
+	 * if there were clients at the last frame. */
+	int shadow_valid;
+	int rows;
+	int cols;
+	int cursor_row;
+	int cursor_col;
+	struct aug_session_cell *shadow;
+	/* cells which may have changed since the last frame */
+	struct aug_rect_set damage;
+	/* the last diff, encoded */
+	struct aug_session_queue diff;
+	/* called on the session thread with nothing locked */
+	void (*on_input)(const char *data, size_t len, void *user);
+	/* a client attached or its terminal was resized. may be NULL. */
+	void (*on_resize)(int rows, int cols, void *user);
+	/* a client attached and needs a frame */
+	void (*on_attach)(void *user);
+	void *user;
+};
+
+/* a socket at @path which nobody listens on is replaced, one which
+ * is in use fails with EADDRINUSE and any other kind of file is left
+ * alone. only clients of the same user are accepted. returns -1 
+ * (with errno set) on failure. */
+int session_start(struct aug_session *s, const char *path,
+		void (*on_input)(const char *data, size_t len, void *user),
+		void (*on_resize)(int rows, int cols, void *user),
+		void (*on_attach)(void *user), void *user);
+/* disconnects every client, joins the thread and removes the socket */
+void session_stop(struct aug_session *s);
+
+/* note that @rect of the screen may have changed */
+void session_damage(struct aug_session *s, VTermRect rect);
+
+/* send the changes since the last frame to the clients. @cell
+ * reads the screen, which must not change during the call. */
+void session_frame(struct aug_session *s, int rows, int cols,
+		int cursor_row, int cursor_col, aug_session_cell_fn cell, void *user);
+
+/* the server process (see aug --session-socket). aug forks it
+ * off before it does anything else, and it carries on as aug on
+ * a pty of its own which nothing but the session is attached to.
+ * so the child and all the other terminals keep running when
+ * the terminal aug was started from goes away. the original 
+ * process just attaches to the session. what clients type is 
+ * written to the pty, where aug reads it like it would from a 
+ * terminal, and their size becomes the pty's size, which aug 
+ * picks up from the SIGWINCH that follows. */
+struct aug_session_server {
+	/* the master side of the pty, only in the server */
+	int master;
+	/* the server writes to this once it is serving */
+	int ready[2];
+	/* throws away what is drawn on the pty */
+	pthread_t drain;
+};
+
+/* returns the pid of the server in the original process and 0
+ * in the server, whose stdin, stdout and controlling terminal 
+ * are now the pty. returns -1 (with errno set) on failure. */
+pid_t session_server_fork(struct aug_session_server *srv);
+/* in the server: the session is up, so clients can attach */
+void session_server_ready(struct aug_session_server *srv);
+/* in the original process: returns 0 once the server is ready 
+ * and -1 if it gave up before that */
+int session_server_wait(struct aug_session_server *srv);
+/* in the server: type @data into the pty */
+void session_server_input(struct aug_session_server *srv, const char *data, size_t len);
+void session_server_resize(struct aug_session_server *srv, int rows, int cols);
+
+/* put the terminal on stdin/stdout in raw mode and switch to
+ * the alternate screen, and back */
+void session_tty_enter(struct termios *saved);
+void session_tty_leave(const struct termios *saved);
+
+/* the client side: attach the terminal on stdin/stdout to the
+ * session at @path until the session ends or the user types
+ * AUG_SESSION_DETACH_KEY. returns non-zero on failure. */
+#define AUG_SESSION_DETACH_KEY 0x1c /* ^\ */
+int session_attach(const char *path);
+
+#endif /* AUG_SESSION_H */
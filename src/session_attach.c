@@ -0,0 +1,348 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "session.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "util.h"
+#include "err.h"
+
+/* the client side of a session: keeps a view of the served 
+ * screen up to date and draws the parts of it which changed
+ * with plain escape sequences, so it doesnt need curses. */
+
+static size_t utf8_encode(uint32_t ch, char *out) {
+	if(ch < 0x80) {
+		out[0] = ch;
+		return 1;
+	}
+	else if(ch < 0x800) {
+		out[0] = 0xc0 | (ch >> 6);
+		out[1] = 0x80 | (ch & 0x3f);
+		return 2;
+	}
+	else if(ch < 0x10000) {
+		out[0] = 0xe0 | (ch >> 12);
+		out[1] = 0x80 | ( (ch >> 6) & 0x3f);
+		out[2] = 0x80 | (ch & 0x3f);
+		return 3;
+	}
+	else {
+		out[0] = 0xf0 | ( (ch >> 18) & 0x07);
+		out[1] = 0x80 | ( (ch >> 12) & 0x3f);
+		out[2] = 0x80 | ( (ch >> 6) & 0x3f);
+		out[3] = 0x80 | (ch & 0x3f);
+		return 4;
+	}
+}
+
+static int same_style(const struct aug_session_cell *a, const struct aug_session_cell *b) {
+	return a->attrs == b->attrs 
+		&& memcmp(a->fg, b->fg, sizeof(a->fg)) == 0
+		&& memcmp(a->bg, b->bg, sizeof(a->bg)) == 0;
+}
+
+static void put_style(FILE *f, const struct aug_session_cell *cell) {
+	fputs("\033[0", f);
+	if(cell->attrs & AUG_SESSION_BOLD)
+		fputs(";1", f);
+	if(cell->attrs & AUG_SESSION_ITALIC)
+		fputs(";3", f);
+	if(cell->attrs & AUG_SESSION_UNDERLINE)
+		fputs(";4", f);
+	if(cell->attrs & AUG_SESSION_BLINK)
+		fputs(";5", f);
+	if(cell->attrs & AUG_SESSION_REVERSE)
+		fputs(";7", f);
+	if(cell->attrs & AUG_SESSION_STRIKE)
+		fputs(";9", f);
+	if( (cell->attrs & AUG_SESSION_DEFAULT_FG) == 0)
+		fprintf(f, ";38;2;%d;%d;%d", cell->fg[0], cell->fg[1], cell->fg[2]);
+	if( (cell->attrs & AUG_SESSION_DEFAULT_BG) == 0)
+		fprintf(f, ";48;2;%d;%d;%d", cell->bg[0], cell->bg[1], cell->bg[2]);
+	fputc('m', f);
+}
+
+void session_view_render(FILE *f, struct aug_session_view *view) {
+	struct aug_rect_set_rect rect;
+	const struct aug_session_cell *cell, *style;
+	char buf[4];
+	size_t row, col;
+	int moved, i;
+
+	style = NULL;
+	while(rect_set_pop(&view->dirty, &rect) == 0) {
+		for(row = rect.row_start; row < rect.row_end; row++) {
+			moved = 0;
+			for(col = rect.col_start; col < rect.col_end; col++) {
+				cell = &view->cells[row*view->cols + col];
+				/* drawn along with the wide character to the left */
+				if(cell->ch == AUG_SESSION_CONTINUATION) {
+					moved = 0;
+					continue;
+				}
+
+				if(moved == 0) {
+					fprintf(f, "\033[%d;%dH", (int) row+1, (int) col+1);
+					moved = 1;
+				}
+				if(style == NULL || !same_style(style, cell) ) {
+					put_style(f, cell);
+					style = cell;
+				}
+				if(cell->ch == 0)
+					fputc(' ', f);
+				else {
+					fwrite(buf, 1, utf8_encode(cell->ch, buf), f);
+					for(i = 0; i < AUG_SESSION_COMBINING && cell->combining[i] != 0; i++)
+						fwrite(buf, 1, utf8_encode(cell->combining[i], buf), f);
+				}
+			}
+		}
+	}
+
+	fprintf(f, "\033[0m\033[%d;%dH", view->cursor_row+1, view->cursor_col+1);
+	fflush(f);
+}
+
+static int send_msg(int fd, uint32_t type, const void *data, size_t n) {
+	struct aug_session_hdr hdr;
+
+	hdr.type = type;
+	hdr.len = n;
+	if(write_all(fd, (const char *) &hdr, sizeof(hdr)) != 0)
+		return -1;
+	return write_all(fd, data, n);
+}
+
+static int send_input(int fd, const char *data, size_t n) {
+	if(n == 0)
+		return 0;
+
+	return send_msg(fd, AUG_SESSION_MSG_INPUT, data, n);
+}
+
+/* ask for the size of the terminal on stdout */
+static int send_size(int fd) {
+	struct aug_session_dims dims;
+	struct winsize ws;
+
+	if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) != 0 || ws.ws_row == 0 || ws.ws_col == 0)
+		return 0;
+
+	dims.rows = ws.ws_row;
+	dims.cols = ws.ws_col;
+	return send_msg(fd, AUG_SESSION_MSG_RESIZE, &dims, sizeof(dims));
+}
+
+/* the SIGWINCH handler just wakes up the poll in session_attach */
+static int g_winch_pipe[2];
+
+static void on_winch(int signum) {
+	int saved;
+	(void)(signum);
+
+	saved = errno;
+	if(write(g_winch_pipe[1], "w", 1) < 0) {
+		/* already full, so it will wake up anyway */
+	}
+	errno = saved;
+}
+
+static int connect_to(const char *path) {
+	struct sockaddr_un addr;
+	int fd;
+
+	if(strlen(path) >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if( (fd = socket(AF_UNIX, SOCK_STREAM, 0) ) < 0)
+		return -1;
+	if(connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/* returns 1 if the session ended, -1 on error and 0 otherwise */
+static int on_server(int fd, struct aug_session_reader *r, 
+		struct aug_session_view *view) {
+	struct aug_session_hdr hdr;
+	const char *payload;
+	int status, ended, rows, cols;
+
+	ended = (session_reader_fill(r, fd) != 0);
+	if(ended && errno != 0)
+		return -1;
+
+	rows = view->rows;
+	cols = view->cols;
+	while( (status = session_reader_next(r, &hdr, &payload) ) == 1)
+		if(session_view_apply(view, &hdr, payload) != 0)
+			return -1;
+	if(status < 0)
+		return -1;
+
+	/* dont leave bits of the old screen around */
+	if(view->rows != rows || view->cols != cols)
+		fputs("\033[0m\033[H\033[2J", stdout);
+
+	session_view_render(stdout, view);
+	return ended;
+}
+
+/* returns 1 if the user detached, -1 on error and 0 otherwise */
+static int on_keys(int fd) {
+	char buf[512], *detach;
+	ssize_t n;
+
+	if( (n = read(STDIN_FILENO, buf, sizeof(buf)) ) < 0)
+		return (errno == EINTR)? 0 : -1;
+	else if(n == 0) /* nothing more to type */
+		return 1;
+
+	detach = memchr(buf, AUG_SESSION_DETACH_KEY, n);
+	if(detach != NULL)
+		n = detach - buf;
+	if(send_input(fd, buf, n) != 0)
+		return -1;
+
+	return (detach != NULL);
+}
+
+void session_tty_enter(struct termios *saved) {
+	struct termios raw;
+
+	if(tcgetattr(STDIN_FILENO, saved) != 0)
+		err_exit(errno, "tcgetattr failed");
+	raw = *saved;
+	cfmakeraw(&raw);
+	if(tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) != 0)
+		err_exit(errno, "tcsetattr failed");
+
+	/* alternate screen, cleared */
+	fputs("\033[?1049h\033[H\033[2J", stdout);
+	fflush(stdout);
+}
+
+void session_tty_leave(const struct termios *saved) {
+	fputs("\033[0m\033[?1049l", stdout);
+	fflush(stdout);
+	tcsetattr(STDIN_FILENO, TCSAFLUSH, saved);
+}
+
+int session_attach(const char *path) {
+	struct aug_session_reader reader;
+	struct aug_session_view view;
+	struct termios saved;
+	struct sigaction act, prev_act;
+	struct pollfd fds[3];
+	char buf[16];
+	int fd, status;
+	const char *why;
+
+	if( (fd = connect_to(path) ) < 0) {
+		err_warn(errno, "failed to attach to %s", path);
+		return -1;
+	}
+	if(set_nonblocking(fd) != 0) 
+		err_exit(errno, "failed to set session socket non-blocking");
+
+	if(pipe(g_winch_pipe) != 0 || set_nonblocking(g_winch_pipe[0]) != 0
+			|| set_nonblocking(g_winch_pipe[1]) != 0)
+		err_exit(errno, "failed to make winch pipe");
+	memset(&act, 0, sizeof(act));
+	act.sa_handler = on_winch;
+	if(sigemptyset(&act.sa_mask) != 0 || sigaction(SIGWINCH, &act, &prev_act) != 0)
+		err_exit(errno, "failed to handle SIGWINCH");
+
+	session_tty_enter(&saved);
+	session_reader_init(&reader);
+	session_view_init(&view);
+
+	fds[0].fd = fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = STDIN_FILENO;
+	fds[1].events = POLLIN;
+	fds[2].fd = g_winch_pipe[0];
+	fds[2].events = POLLIN;
+	/* the session takes on the size of our terminal */
+	status = (send_size(fd) == 0)? 0 : -1;
+	while(status == 0) {
+		if(poll(fds, 3, -1) < 0) {
+			if(errno == EINTR)
+				continue;
+			status = -1;
+			break;
+		}
+
+		if(fds[0].revents != 0)
+			status = on_server(fd, &reader, &view);
+		if(status == 0 && fds[1].revents != 0) {
+			status = on_keys(fd);
+			if(status == 1)
+				status = 2;
+		}
+		if(status == 0 && fds[2].revents != 0) {
+			while(read(g_winch_pipe[0], buf, sizeof(buf)) > 0)
+				continue;
+			if(send_size(fd) != 0)
+				status = -1;
+		}
+	}
+
+	session_tty_leave(&saved);
+	if(sigaction(SIGWINCH, &prev_act, NULL) != 0)
+		err_exit(errno, "failed to restore SIGWINCH handler");
+	close(g_winch_pipe[0]);
+	close(g_winch_pipe[1]);
+
+	switch(status) {
+	case 1:
+		why = "session ended";
+		break;
+	case 2:
+		why = "detached";
+		break;
+	default:
+		why = "lost the session";
+	}
+	printf("[%s from %s]\n", why, path);
+
+	session_view_free(&view);
+	session_reader_free(&reader);
+	close(fd);
+	return (status < 0);
+}
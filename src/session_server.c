@@ -0,0 +1,147 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "session.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#if defined(__FreeBSD__)
+#	include <libutil.h>
+#elif defined(__OpenBSD__) || defined(__NetBSD__) || defined(__APPLE__)
+#	include <util.h>
+#else
+#	include <pty.h>
+#endif
+
+#include "util.h"
+#include "err.h"
+
+/* nobody looks at the pty, but curses would block once it 
+ * filled up */
+static void *drain(void *user) {
+	struct aug_session_server *srv;
+	char buf[4096];
+	ssize_t n;
+
+	srv = user;
+	while( (n = read(srv->master, buf, sizeof(buf)) ) != 0)
+		if(n < 0 && errno != EINTR)
+			break;
+
+	return NULL;
+}
+
+/* in the server: make the pty the controlling terminal, stdin 
+ * and stdout, with the same settings and size as the original
+ * terminal had */
+static void take_pty(struct aug_session_server *srv, 
+		const struct termios *tio, const struct winsize *ws) {
+	sigset_t all, saved;
+	int slave;
+
+	/* a session of its own, so the server doesnt get the 
+	 * hangup when the original terminal goes away */
+	if(setsid() < 0)
+		err_exit(errno, "session: setsid failed");
+	if(openpty(&srv->master, &slave, NULL, tio, ws) != 0)
+		err_exit(errno, "session: openpty failed");
+	/* the children of the server dont need these */
+	if(fcntl(srv->master, F_SETFD, FD_CLOEXEC) != 0
+			|| fcntl(srv->ready[1], F_SETFD, FD_CLOEXEC) != 0)
+		err_exit(errno, "session: failed to set close-on-exec");
+	if(ioctl(slave, TIOCSCTTY, 0) != 0)
+		err_exit(errno, "session: failed to take the pty as controlling terminal");
+	if(dup2(slave, STDIN_FILENO) < 0 || dup2(slave, STDOUT_FILENO) < 0)
+		err_exit(errno, "session: dup2 failed");
+	if(slave != STDIN_FILENO && slave != STDOUT_FILENO)
+		close(slave);
+
+	/* aug hasnt blocked the signals it handles yet, so make 
+	 * sure this thread never gets them */
+	if(sigfillset(&all) != 0)
+		err_exit(errno, "session: failed to make signal set");
+	AUG_STATUS_EQUAL( pthread_sigmask(SIG_SETMASK, &all, &saved), 0 );
+	aug_detached_thread(drain, srv, &srv->drain);
+	AUG_STATUS_EQUAL( pthread_sigmask(SIG_SETMASK, &saved, NULL), 0 );
+}
+
+pid_t session_server_fork(struct aug_session_server *srv) {
+	struct termios tio;
+	struct winsize ws;
+	pid_t pid;
+	int status;
+
+	srv->master = -1;
+	if(tcgetattr(STDIN_FILENO, &tio) != 0 || ioctl(STDIN_FILENO, TIOCGWINSZ, &ws) != 0)
+		return -1;
+	if(pipe(srv->ready) != 0)
+		return -1;
+
+	if( (pid = fork() ) < 0) {
+		status = errno;
+		close(srv->ready[0]);
+		close(srv->ready[1]);
+		errno = status;
+		return -1;
+	}
+	else if(pid > 0) {
+		close(srv->ready[1]);
+		return pid;
+	}
+
+	close(srv->ready[0]);
+	take_pty(srv, &tio, &ws);
+	return 0;
+}
+
+void session_server_ready(struct aug_session_server *srv) {
+	if(write_all(srv->ready[1], "r", 1) != 0)
+		err_warn(errno, "session: failed to tell the original process we are up");
+	close(srv->ready[1]);
+}
+
+int session_server_wait(struct aug_session_server *srv) {
+	ssize_t n;
+	char c;
+
+	/* if the server dies first, all we get is the end of file */
+	while( (n = read(srv->ready[0], &c, 1) ) < 0 && errno == EINTR)
+		continue;
+	close(srv->ready[0]);
+
+	return (n == 1)? 0 : -1;
+}
+
+void session_server_input(struct aug_session_server *srv, const char *data, size_t len) {
+	if(write_all(srv->master, data, len) != 0)
+		err_warn(errno, "session: failed to type into the pty");
+}
+
+void session_server_resize(struct aug_session_server *srv, int rows, int cols) {
+	struct winsize ws;
+
+	memset(&ws, 0, sizeof(ws));
+	ws.ws_row = rows;
+	ws.ws_col = cols;
+	/* the kernel sends us a SIGWINCH if that changed the size */
+	if(ioctl(srv->master, TIOCSWINSZ, &ws) != 0)
+		err_warn(errno, "session: failed to resize the pty");
+}
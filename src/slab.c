@@ -0,0 +1,152 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "slab.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "util.h"
+
+struct aug_slab_page {
+	struct aug_slab_page *next;
+	/* free objects of this page, linked through their first bytes */
+	void *free_objs;
+	size_t used;
+	/* objects start here */
+	union {
+		long double ld;
+		void *p;
+		long long ll;
+	} objs[];
+};
+
+static inline char *page_objs(struct aug_slab_page *page) {
+	return (char *) page->objs;
+}
+
+static inline size_t page_bytes(const struct aug_slab *slab) {
+	return sizeof(struct aug_slab_page) + slab->obj_size*slab->per_page;
+}
+
+void slab_init(struct aug_slab *slab, size_t obj_size, size_t per_page) {
+	size_t align;
+
+	/* keep every object aligned like the objects of the page */
+	align = sizeof(((struct aug_slab_page *) NULL)->objs[0]);
+	if(obj_size < sizeof(void *))
+		obj_size = sizeof(void *);
+	slab->obj_size = (obj_size + align - 1)/align*align;
+	slab->per_page = (per_page > 0)? per_page : 1;
+	slab->pages = NULL;
+	slab->n_pages = 0;
+	slab->in_use = 0;
+	AUG_LOCK_INIT(slab);
+}
+
+void slab_free(struct aug_slab *slab) {
+	struct aug_slab_page *page, *next;
+
+	if(slab->in_use != 0)
+		err_warn(0, "freeing slab with %zu objects still in use", slab->in_use);
+
+	for(page = slab->pages; page != NULL; page = next) {
+		next = page->next;
+		free(page);
+	}
+	slab->pages = NULL;
+	slab->n_pages = 0;
+	AUG_LOCK_FREE(slab);
+}
+
+/* slab must be locked */
+static struct aug_slab_page *new_page(struct aug_slab *slab) {
+	struct aug_slab_page *page;
+	size_t i;
+	char *obj;
+
+	page = aug_malloc(page_bytes(slab));
+	page->used = 0;
+	page->free_objs = NULL;
+	/* link in reverse so that objects are handed out in address order */
+	for(i = slab->per_page; i > 0; i--) {
+		obj = page_objs(page) + (i-1)*slab->obj_size;
+		*(void **) obj = page->free_objs;
+		page->free_objs = obj;
+	}
+
+	page->next = slab->pages;
+	slab->pages = page;
+	slab->n_pages++;
+
+	return page;
+}
+
+void *slab_alloc(struct aug_slab *slab) {
+	struct aug_slab_page *page;
+	void *obj;
+
+	AUG_LOCK(slab);
+	for(page = slab->pages; page != NULL; page = page->next)
+		if(page->free_objs != NULL)
+			break;
+	if(page == NULL)
+		page = new_page(slab);
+
+	obj = page->free_objs;
+	page->free_objs = *(void **) obj;
+	page->used++;
+	slab->in_use++;
+	AUG_UNLOCK(slab);
+
+	return obj;
+}
+
+void slab_release(struct aug_slab *slab, void *obj) {
+	struct aug_slab_page *page, **prev;
+	char *start;
+
+	AUG_LOCK(slab);
+	for(prev = &slab->pages; (page = *prev) != NULL; prev = &page->next) {
+		start = page_objs(page);
+		if( (char *) obj >= start 
+				&& (char *) obj < start + slab->per_page*slab->obj_size)
+			break;
+	}
+	if(page == NULL)
+		err_exit(0, "released object %p does not belong to the slab", obj);
+
+	*(void **) obj = page->free_objs;
+	page->free_objs = obj;
+	page->used--;
+	slab->in_use--;
+
+	/* keep one page around so that a single object coming 
+	 * and going doesnt cause a malloc every time */
+	if(page->used == 0 && slab->n_pages > 1) {
+		*prev = page->next;
+		slab->n_pages--;
+		free(page);
+	}
+	AUG_UNLOCK(slab);
+}
+
+void slab_stats(struct aug_slab *slab, size_t *in_use, size_t *bytes) {
+	AUG_LOCK(slab);
+	*in_use = slab->in_use;
+	*bytes = slab->n_pages*page_bytes(slab);
+	AUG_UNLOCK(slab);
+}
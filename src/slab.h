@@ -0,0 +1,50 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUG_SLAB_H
+#define AUG_SLAB_H
+
+#include <stddef.h>
+#include "lock.h"
+
+/* allocates fixed size objects out of pages which hold @per_page
+ * objects each, so many small long lived objects dont each pay for 
+ * a separate malloc. a page is freed as soon as it is empty (except
+ * for the last one). */
+struct aug_slab_page;
+
+struct aug_slab {
+	size_t obj_size;
+	size_t per_page;
+	struct aug_slab_page *pages;
+	size_t n_pages;
+	size_t in_use;
+	AUG_LOCK_MEMBERS;
+};
+
+void slab_init(struct aug_slab *slab, size_t obj_size, size_t per_page);
+/* frees every page, even if some objects were never released */
+void slab_free(struct aug_slab *slab);
+
+/* returns uninitialized memory for one object */
+void *slab_alloc(struct aug_slab *slab);
+void slab_release(struct aug_slab *slab, void *obj);
+
+/* @in_use objects are allocated in pages totalling @bytes */
+void slab_stats(struct aug_slab *slab, size_t *in_use, size_t *bytes);
+
+#endif /* AUG_SLAB_H */
@@ -0,0 +1,128 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "stats_sock.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "err.h"
+
+static void serve(struct aug_stats_sock *ss) {
+	int fd;
+	FILE *f;
+
+	if( (fd = accept(ss->fd, NULL, NULL) ) < 0) {
+		if(errno != EINTR && errno != EAGAIN && errno != ECONNABORTED)
+			err_warn(errno, "stats socket: accept failed");
+		return;
+	}
+
+	if( (f = fdopen(fd, "w") ) == NULL) {
+		err_warn(errno, "stats socket: fdopen failed");
+		close(fd);
+		return;
+	}
+	(*ss->dump)(f);
+	fclose(f);
+}
+
+static void *stats_sock_thread(void *user) {
+	struct aug_stats_sock *ss;
+	struct pollfd fds[2];
+	sigset_t sigset;
+	int s;
+
+	/* a client which hangs up early should get us EPIPE,
+	 * not kill the whole process */
+	if(sigemptyset(&sigset) != 0 || sigaddset(&sigset, SIGPIPE) != 0)
+		err_exit(errno, "sigset failed");
+	if( (s = pthread_sigmask(SIG_BLOCK, &sigset, NULL) ) != 0)
+		err_exit(s, "pthread_sigmask failed");
+
+	ss = user;
+	fds[0].fd = ss->fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = ss->stop[0];
+	fds[1].events = POLLIN;
+
+	while(1) {
+		if(poll(fds, 2, -1) < 0) {
+			if(errno == EINTR)
+				continue;
+			err_exit(errno, "stats socket: poll failed");
+		}
+
+		if(fds[1].revents != 0)
+			break;
+		if(fds[0].revents != 0)
+			serve(ss);
+	}
+
+	return NULL;
+}
+
+int stats_sock_start(struct aug_stats_sock *ss, const char *path, 
+		void (*dump)(FILE *f)) {
+	int s;
+
+	ss->path = path;
+	ss->dump = dump;
+
+	if( (ss->fd = unix_listen(path) ) < 0)
+		return -1;
+
+	if(pipe(ss->stop) != 0)
+		goto close_fd;
+	if( (s = pthread_create(&ss->thread, NULL, stats_sock_thread, ss) ) != 0) {
+		errno = s;
+		goto close_pipe;
+	}
+
+	return 0;
+
+close_pipe:
+	s = errno;
+	close(ss->stop[0]);
+	close(ss->stop[1]);
+	errno = s;
+close_fd:
+	s = errno;
+	close(ss->fd);
+	unlink(path);
+	errno = s;
+	return -1;
+}
+
+void stats_sock_stop(struct aug_stats_sock *ss) {
+	char ch;
+
+	ch = 0;
+	if(write(ss->stop[1], &ch, 1) != 1)
+		err_exit(errno, "stats socket: failed to wake thread");
+	AUG_STATUS_EQUAL( pthread_join(ss->thread, NULL), 0 );
+
+	close(ss->stop[0]);
+	close(ss->stop[1]);
+	close(ss->fd);
+	if(unlink(ss->path) != 0)
+		err_warn(errno, "stats socket: failed to remove %s", ss->path);
+}
@@ -0,0 +1,45 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUG_STATS_SOCK_H
+#define AUG_STATS_SOCK_H
+
+#include <stdio.h>
+#include <pthread.h>
+
+/* serves a dump on a unix stream socket: a thread accepts each
+ * connection, writes the output of @dump to it and closes it, 
+ * so `socat - UNIX-CONNECT:path` (or `nc -U path`) prints the 
+ * dump. @dump runs on the socket thread with nothing locked. */
+struct aug_stats_sock {
+	int fd;
+	/* written to by stats_sock_stop to wake the thread */
+	int stop[2];
+	const char *path;
+	void (*dump)(FILE *f);
+	pthread_t thread;
+};
+
+/* a socket at @path which nobody listens on is replaced, one which
+ * is in use fails with EADDRINUSE and any other kind of file is 
+ * left alone. returns -1 (with errno set) on failure. */
+int stats_sock_start(struct aug_stats_sock *ss, const char *path, 
+		void (*dump)(FILE *f));
+/* joins the thread and removes the socket */
+void stats_sock_stop(struct aug_stats_sock *ss);
+
+#endif /* AUG_STATS_SOCK_H */
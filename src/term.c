@@ -51,6 +51,7 @@ void term_init(struct aug_term *term, int rows, int cols) {
 
 	term_inject_clear(term);
 	term->user = NULL;
+	term->io_callbacks.stage = NULL;
 	term->io_callbacks.refresh = NULL;
 
 	AUG_LOCK_INIT(term);
@@ -120,6 +121,7 @@ void term_clear_callbacks(struct aug_term *term) {
 	
 	vts = vterm_obtain_screen(term->vt);
 	vterm_screen_set_callbacks(vts, &CB_SCREEN_NULL, term->user);
+	term->io_callbacks.stage = NULL;
 	term->io_callbacks.refresh = NULL;	
 }
 
@@ -22,6 +22,9 @@
 #include "lock.h"
 
 struct aug_term_io_callbacks {
+	/* called before refresh with the terminal locked 
+	 * but without the render locks */
+	void (*stage)(void *user);
 	void (*refresh)(void *user);
 };
 
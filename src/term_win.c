@@ -27,6 +27,8 @@
 #include "attr.h"
 #include "ncurses_util.h"
 #include "rect_set.h"
+#include "log.h"
+#include "counters.h"
 
 extern int aug_cell_update(
 	int rows, int cols, int *row, int *col, 
@@ -38,7 +40,7 @@ extern int aug_cursor_move(
 	int rows, int cols, int old_row, 
 	int old_col, int *new_row, int *new_col
 );
-extern void aug_primary_term_dims_change(int rows, int cols);
+extern void aug_primary_term_dims_change(const struct aug_term *term, int rows, int cols);
 
 static void resize_terminal(struct aug_term_win *);
 
@@ -48,16 +50,33 @@ static void init_deferred_damage(struct aug_term_win *tw) {
 	term_win_dims(tw, &rows, &cols);
 	if(rect_set_init(&tw->deferred_damage, cols, rows) != 0)
 		err_exit(0, "memory error allocating rect set of size %dx%d\n", rows, cols);
+	if(rect_set_init(&tw->staged_damage, cols, rows) != 0)
+		err_exit(0, "memory error allocating rect set of size %dx%d\n", rows, cols);
+	tw->staged = aug_malloc( (rows*cols > 0? rows*cols : 1)*sizeof(*tw->staged) );
+	/* pending scrolls apply to the old map */
+	tw->deferred_scroll = 0;
+	tw->cursor_moved = 0;
 }
 
 void term_win_init(struct aug_term_win *tw, WINDOW *win) {
 	tw->term = NULL;
 	tw->win = win;
+	tw->bell = 0;
+	tw->cursor_visible = -1;
+	tw->composited = 0;
+	tw->painted = 0;
 	init_deferred_damage(tw);
 }
 
-void term_win_free(struct aug_term_win *tw) {
+static void free_deferred_damage(struct aug_term_win *tw) {
 	rect_set_free(&tw->deferred_damage);
+	rect_set_free(&tw->staged_damage);
+	free(tw->staged);
+	tw->staged = NULL;
+}
+
+void term_win_free(struct aug_term_win *tw) {
+	free_deferred_damage(tw);
 }
 
 void term_win_reset_damage(struct aug_term_win *tw) {
@@ -85,47 +104,55 @@ void term_win_dims(const struct aug_term_win *tw, int *rows, int *cols) {
 	}
 }
 
-void term_win_update_cell(struct aug_term_win *tw, VTermPos pos, int color_on) {
-	VTermScreen *vts;
+/* doesnt touch the window, so the terminal only needs to be locked */
+static void convert_cell(VTermScreen *vts, VTermPos pos, int color_on, 
+		struct aug_term_win_cell *out) {
 	VTermScreenCell cell;
-	attr_t attr;
-	int pair;
+	int i;
+
+	if( !vterm_screen_get_cell(vts, pos, &cell) )
+		err_exit(0, "get_cell returned false status\n");
+
+	/* convert vterm attributes into ncurses attributes (not colors) */
+	attr_vterm_attr_to_curses_attr(&cell, &out->attr);
+	if(color_on) /* convert vterm colors into ncurses colors */
+		attr_vterm_pair_to_curses_pair(cell.fg, cell.bg, &out->attr, &out->pair);
+	else
+		out->pair = 0;
+
+	if(cell.chars[0] == 0) {
+		out->chars[0] = L' ';
+		out->chars[1] = 0;
+	}
+	else {
+		for(i = 0; i < VTERM_MAX_CHARS_PER_CELL && cell.chars[i] != 0; i++)
+			out->chars[i] = (wchar_t) cell.chars[i];
+		out->chars[i] = 0;
+	}
+}
+
+/* write a converted cell to the window. the screen must be locked. */
+static void put_cell(struct aug_term_win *tw, VTermPos pos, 
+		struct aug_term_win_cell *cell) {
 	cchar_t cch;
-	wchar_t *wch;
-	wchar_t erasech = L' ';
 	int maxx, maxy;
 
 	memset(&cch, 0, sizeof(cch));
-	if(tw->term == NULL || tw->win == NULL)
-		return;
-
-	vts = vterm_obtain_screen(tw->term->vt);
 	getmaxyx(tw->win, maxy, maxx);
 
 	/* sometimes this happens when
 	 * a window resize recently happened
 	 */
 	if(!win_contained(tw->win, pos.row, pos.col) ) {
-		fprintf(stderr, "tried to update out of bounds cell at %d/%d %d/%d\n", pos.row, maxy-1, pos.col, maxx-1);
+		AUG_LOG(AUG_LOG_WARN, "term_win", "tried to update out of bounds cell at %d/%d %d/%d\n", 
+			pos.row, maxy-1, pos.col, maxx-1);
 		return;
 	}
 
-	if( !vterm_screen_get_cell(vts, pos, &cell) )
-		err_exit(0, "get_cell returned false status\n");
-
-	/* convert vterm attributes into ncurses attributes (not colors) */
-	attr_vterm_attr_to_curses_attr(&cell, &attr);
-	if(color_on) /* convert vterm colors into ncurses colors */
-		attr_vterm_pair_to_curses_pair(cell.fg, cell.bg, &attr, &pair);
-	else
-		pair = 0;
-
-	
-	wch = (cell.chars[0] == 0)? &erasech : (wchar_t *) &cell.chars[0];
-
-	if(aug_cell_update(maxy, maxx, &pos.row, &pos.col, wch, &attr, &pair) != 0) /* run API callbacks */
+	if(aug_cell_update(maxy, maxx, &pos.row, &pos.col, cell->chars, &cell->attr, 
+			&cell->pair) != 0) /* run API callbacks */
 		return;
-	if(setcchar(&cch, wch, attr, pair, NULL) == ERR)
+	if(setcchar(&cch, cell->chars, cell->attr, cell->pair, NULL) == ERR)
 		err_exit(0, "setcchar failed");
 	if(wmove(tw->win, pos.row, pos.col) == ERR)
 		err_exit(0, "move failed: %d/%d, %d/%d\n", pos.row, maxy-1, pos.col, maxx-1);
@@ -133,7 +160,61 @@ void term_win_update_cell(struct aug_term_win *tw, VTermPos pos, int color_on) {
 	/* sometimes writing to the last cell fails... but it doesnt matter? */
 	if(wadd_wch(tw->win, &cch) == ERR && (pos.row) != (maxy-1) && (pos.col) != (maxx-1) )
 		err_exit(0, "add_wch failed at %d/%d, %d/%d: ", pos.row, maxy-1, pos.col, maxx-1);
+	tw->painted++;
+	counters_add(AUG_COUNTER_CELLS_PAINTED, 1);
+}
+
+void term_win_update_cell(struct aug_term_win *tw, VTermPos pos, int color_on) {
+	struct aug_term_win_cell cell;
 
+	if(tw->term == NULL || tw->win == NULL)
+		return;
+
+	if(!win_contained(tw->win, pos.row, pos.col) ) {
+		AUG_LOG(AUG_LOG_WARN, "term_win", "tried to update out of bounds cell at %d %d\n", 
+			pos.row, pos.col);
+		return;
+	}
+
+	convert_cell(vterm_obtain_screen(tw->term->vt), pos, color_on, &cell);
+	put_cell(tw, pos, &cell);
+}
+
+/* convert all the damage recorded so far into the staging
+ * buffer. needs only the terminal locked, not the screen. */
+void term_win_stage(struct aug_term_win *tw, int color_on) {
+	struct aug_rect_set_rect rect;
+	VTermScreen *vts;
+	VTermPos pos;
+	int cols;
+
+	if(tw->term == NULL)
+		return;
+
+	vts = vterm_obtain_screen(tw->term->vt);
+	cols = tw->deferred_damage.cols;
+	while(rect_set_pop(&tw->deferred_damage, &rect) == 0) {
+		for(pos.row = rect.row_start; pos.row < (int) rect.row_end; pos.row++) 
+			for(pos.col = rect.col_start; pos.col < (int) rect.col_end; pos.col++) 
+				convert_cell(vts, pos, color_on, &tw->staged[pos.row*cols + pos.col]);
+
+		rect_set_add(&tw->staged_damage, rect.col_start, rect.row_start, 
+			rect.col_end, rect.row_end);
+	}
+}
+
+/* copy the staged cells into the window */
+static void commit_staged(struct aug_term_win *tw) {
+	struct aug_rect_set_rect rect;
+	VTermPos pos;
+	int cols;
+
+	cols = tw->staged_damage.cols;
+	while(rect_set_pop(&tw->staged_damage, &rect) == 0) {
+		for(pos.row = rect.row_start; pos.row < (int) rect.row_end; pos.row++) 
+			for(pos.col = rect.col_start; pos.col < (int) rect.col_end; pos.col++) 
+				put_cell(tw, pos, &tw->staged[pos.row*cols + pos.col]);
+	}
 }
 
 static void flush_damage(struct aug_term_win *tw, VTermRect rect, int color_on) {
@@ -173,38 +254,116 @@ static void term_win_flush_damage(struct aug_term_win *tw, int color_on) {
 	}
 }
 
-int term_win_damage(struct aug_term_win *tw, VTermRect rect, int color_on) {
+int term_win_damage(struct aug_term_win *tw, VTermRect rect) {
 	/*fprintf(
 		stderr, "term_win: damage %d->%d, %d->%d\n", 
 		rect.start_row, rect.end_row, rect.start_col, rect.end_col
 	);*/
 	term_win_defer_damage(tw, rect.start_col, rect.end_col, rect.start_row, rect.end_row);
-	term_win_flush_damage(tw, color_on);
 	return 1;
 }
 
+/* scroll the window by the net amount of the scrolls
+ * recorded since the last refresh. */
+static void flush_scroll(struct aug_term_win *tw) {
+	int rows, cols, offset;
+
+	offset = tw->deferred_scroll;
+	tw->deferred_scroll = 0;
+	if(offset == 0)
+		return;
+
+	win_dims(tw->win, &rows, &cols);
+	/* if the window scrolled by its whole height or a plugin
+	 * vetoes the scroll, just repaint everything. */
+	if(offset >= rows || offset <= -rows 
+			|| aug_pre_scroll(rows, cols, offset) != 0) {
+		term_win_defer_damage(tw, 0, cols, 0, rows);
+		return;
+	}
+
+	scrollok(tw->win, true);
+	idlok(tw->win, true);
+	wscrl(tw->win, offset);
+	idlok(tw->win, false);
+	scrollok(tw->win, false);
+
+	aug_post_scroll(rows, cols, offset);
+}
+
+static void flush_cursor(struct aug_term_win *tw) {
+	VTermPos pos;
+	int maxy, maxx;
+
+	if(tw->cursor_moved == 0)
+		return;
+	tw->cursor_moved = 0;
+
+	vterm_state_get_cursorpos(vterm_obtain_state(tw->term->vt), &pos);
+	/* sometimes this happens when
+	 * a window resize recently happened. */
+	if(!win_contained(tw->win, pos.row, pos.col) ) {
+		AUG_LOG(AUG_LOG_WARN, "term_win", "tried to move cursor out of bounds to %d, %d\n", 
+			pos.row, pos.col);
+		return;
+	}
+
+	getmaxyx(tw->win, maxy, maxx);
+	if(aug_cursor_move(maxy, maxx, tw->old_cursor.row, tw->old_cursor.col, 
+			&pos.row, &pos.col) != 0) /* run API callbacks */
+		return;
+
+	if(wmove(tw->win, pos.row, pos.col) == ERR)
+		err_exit(0, "move failed: %d, %d", pos.row, pos.col);
+}
+
+/* apply everything recorded since the last refresh to the window */
 void term_win_refresh(struct aug_term_win *tw, int color_on) {
-	if(tw->win == NULL)
+	if(tw->bell != 0) {
+		tw->bell = 0;
+		if(beep() == ERR)
+			fprintf(stderr, "bell failed\n");
+	}
+
+	if(tw->cursor_visible >= 0) {
+		/* will return ERR if cursor not supported, *
+		 * so we dont bother checking return value  */
+		curs_set(tw->cursor_visible); 
+		tw->cursor_visible = -1;
+	}
+
+	if(tw->win == NULL || tw->term == NULL)
 		return;
 
+	flush_scroll(tw);
+	commit_staged(tw);
+	/* anything damaged since term_win_stage (or never staged) */
 	term_win_flush_damage(tw, color_on);
+	flush_cursor(tw);
 
 	wsyncup(tw->win);
 	wcursyncup(tw->win);
+	if(tw->composited != 0) {
+		/* stdscr has the changes now */
+		untouchwin(tw->win);
+		return;
+	}
 	if(wnoutrefresh(tw->win) == ERR)
 		err_exit(0, "wnoutrefresh failed!");
 
 }
 
-int term_win_moverect(struct aug_term_win *tw, VTermRect dest, VTermRect src, int color_on) {
+int term_win_moverect(struct aug_term_win *tw, VTermRect dest, VTermRect src) {
 	int rows, cols, offset;
 
-	if(tw->win == NULL)
+	/* the damage map always has the dimensions of the window */
+	rows = tw->deferred_damage.rows;
+	cols = tw->deferred_damage.cols;
+	if(rows < 1 || cols < 1)
 		goto not_moved;
 
-	win_dims(tw->win, &rows, &cols);
 	if( src.start_col != 0 || src.end_col != cols) {
-		fprintf(stderr, "term_win: moverect invalid src rect "
+		AUG_LOG(AUG_LOG_WARN, "term_win", "moverect invalid src rect "
 						"%d->%d, %d->%d. wanted columns 0->%d (dims=%dx%d)\n",
 						src.start_row, src.end_row, src.start_col, src.end_col,
 						cols, rows, cols);
@@ -218,7 +377,7 @@ int term_win_moverect(struct aug_term_win *tw, VTermRect dest, VTermRect src, in
 		offset = src.start_row;
 	}
 	else {
-		fprintf(stderr, "term_win: moverect invalid src rect "
+		AUG_LOG(AUG_LOG_WARN, "term_win", "moverect invalid src rect "
 						"%d->%d, %d->%d. wanted rows x->%d or 0->%d-x (dims=%dx%d)\n",
 						src.start_row, src.end_row, src.start_col, src.end_col,
 						rows, rows, rows, cols);
@@ -228,25 +387,19 @@ int term_win_moverect(struct aug_term_win *tw, VTermRect dest, VTermRect src, in
 	if( dest.start_col != 0 || dest.end_col != cols 
 			|| dest.start_row != src.start_row - offset
 			|| dest.end_row != src.end_row - offset ) {
-		fprintf(stderr, "term_win: moverect invalid dest rect "
+		AUG_LOG(AUG_LOG_WARN, "term_win", "moverect invalid dest rect "
 						"%d->%d, %d->%d. wanted %d->%d, 0->%d (dims=%dx%d)\n", 
 						dest.start_row, dest.end_row, dest.start_col, dest.end_col,
 						src.start_row-offset, src.end_row-offset, cols, rows, cols);
 		goto not_moved;
 	}
 
-	term_win_flush_damage(tw, color_on);
-
-	if(aug_pre_scroll(rows, cols, offset) != 0)
-		goto not_moved;
-
-	scrollok(tw->win, true);
-	idlok(tw->win, true);
-	wscrl(tw->win, offset);
-	idlok(tw->win, false);
-	scrollok(tw->win, false);
-
-	aug_post_scroll(rows, cols, offset);
+	/* damage recorded so far moves along with the rows it
+	 * refers to. rows uncovered by the scroll are damaged by
+	 * vterm, so scrolling the window by the net offset later 
+	 * gives the same result as scrolling it each time. */
+	rect_set_shift(&tw->deferred_damage, offset);
+	tw->deferred_scroll += offset;
 
 	return 1;
 
@@ -254,28 +407,47 @@ not_moved:
 	return 0;
 }
 
-int term_win_movecursor(struct aug_term_win *tw, VTermPos pos, VTermPos oldpos, int color_on) {
-	int maxy, maxx;
-
-	if(tw->win == NULL)
-		goto done;
+int term_win_movecursor(struct aug_term_win *tw, VTermPos pos, VTermPos oldpos) {
+	(void)(pos);
 
-	/* sometimes this happens when
-	 * a window resize recently happened. */
-	if(!win_contained(tw->win, pos.row, pos.col) ) {
-		fprintf(stderr, "tried to move cursor out of bounds to %d, %d\n", pos.row, pos.col);
-		goto done;
+	/* the new position is read back from vterm at refresh.
+	 * only the first move since the last refresh knows 
+	 * where the cursor was drawn. */
+	if(tw->cursor_moved == 0) {
+		tw->old_cursor = oldpos;
+		tw->cursor_moved = 1;
 	}
 
-	getmaxyx(tw->win, maxy, maxx);
-	if(aug_cursor_move(maxy, maxx, oldpos.row, oldpos.col, &pos.row, &pos.col) != 0) /* run API callbacks */
-		goto done;
+	return 1;
+}
 
-	term_win_flush_damage(tw, color_on);
-	if(wmove(tw->win, pos.row, pos.col) == ERR)
-		err_exit(0, "move failed: %d, %d", pos.row, pos.col);
+int term_win_bell(struct aug_term_win *tw) {
+	tw->bell = 1;
+	return 1;
+}
+
+int term_win_settermprop(struct aug_term_win *tw, VTermProp prop, VTermValue *val) {
+	/*fprintf(stderr, "settermprop: %d", prop);*/
+	switch(prop) { 
+	case VTERM_PROP_CURSORVISIBLE:
+		/* fprintf(stderr, " (CURSORVISIBLE) = %02x", val->boolean); */
+		tw->cursor_visible = !!val->boolean;
+		break;
+	case VTERM_PROP_CURSORBLINK: /* not sure if ncurses can change blink settings */
+		/* fprintf(stderr, " (CURSORBLINK) = %02x", val->boolean); */
+		break;
+	case VTERM_PROP_REVERSE: /* this should be taken care of by update cell i think */
+		/* fprintf(stderr, " (REVERSE) = %02x", val->boolean); */
+		break;
+	case VTERM_PROP_CURSORSHAPE: /* dont think curses can change cursor shape */
+		/* fprintf(stderr, " (CURSORSHAPE) = %d", val->number); */
+		break;
+	default:
+		;
+	}
+
+	/* fprintf(stderr, "\n"); */
 
-done:
 	return 1;
 }
 
@@ -285,9 +457,12 @@ done:
 void term_win_resize(struct aug_term_win *tw, WINDOW *win) {
 	tw->win = win;
 	/* if we are changing windows then the deferred
-	 * damage was never relevant, so we can trash it here */
-	rect_set_free(&tw->deferred_damage);
+	 * damage was never relevant, so we can trash it here.
+	 * the new window has to be painted from scratch. */
+	free_deferred_damage(tw);
 	init_deferred_damage(tw);
+	rect_set_add(&tw->deferred_damage, 0, 0, 
+		tw->deferred_damage.cols, tw->deferred_damage.rows);
 
 	resize_terminal(tw);
 }
@@ -309,5 +484,13 @@ static void resize_terminal(struct aug_term_win *tw) {
 		if(term_resize(tw->term, rows, cols) != 0)
 			err_exit(errno, "error resizing terminal!");
 
-	aug_primary_term_dims_change(rows, cols);
+	aug_primary_term_dims_change(tw->term, rows, cols);
+}
+
+size_t term_win_mem(const struct aug_term_win *tw) {
+	size_t cells;
+
+	cells = tw->deferred_damage.rows*tw->deferred_damage.cols;
+	/* two byte maps and the staging buffer */
+	return cells*(2*sizeof(uint8_t) + sizeof(*tw->staged));
 }
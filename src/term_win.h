@@ -23,10 +23,45 @@
 #include "term.h"
 #include "rect_set.h"
 
+/* the vterm callbacks below run while the terminal is being
+ * parsed, which happens without the screen lock. so they only 
+ * record what changed, and term_win_refresh (which must be called
+ * with the screen locked) applies it all to @win. the callbacks 
+ * never touch @win, as it can be swapped out or deleted by the
+ * thread holding the screen lock. 
+ * term_win_stage converts the damaged cells from vterm into a
+ * staging buffer without calling into ncurses, so several terminals
+ * can do that work at the same time. term_win_refresh then only 
+ * has to copy the staged cells into @win. */
+struct aug_term_win_cell {
+	wchar_t chars[VTERM_MAX_CHARS_PER_CELL + 1];
+	attr_t attr;
+	int pair;
+};
+
 struct aug_term_win {
 	WINDOW *win;
 	struct aug_term *term;
+	/* cells to repaint, in the current coordinates of the terminal */
 	struct aug_rect_set deferred_damage;
+	/* net number of rows to scroll @win up by (down if negative) */
+	int deferred_scroll;
+	int cursor_moved;
+	/* where the cursor was before it moved */
+	VTermPos old_cursor;
+	int bell;
+	/* 0 or 1 if the cursor visibility changed, otherwise -1 */
+	int cursor_visible;
+	/* converted cells, same dimensions as deferred_damage */
+	struct aug_term_win_cell *staged;
+	/* which cells of -staged- have to be copied to @win */
+	struct aug_rect_set staged_damage;
+	/* if non-zero @win is a subwindow of stdscr that reaches the
+	 * screen through panel_stack_update, so term_win_refresh only
+	 * syncs it into stdscr. */
+	int composited;
+	/* cells written to @win so far */
+	unsigned long painted;
 };
 
 void term_win_init(struct aug_term_win *tw, WINDOW *win);
@@ -37,10 +72,15 @@ void term_win_defer_damage(struct aug_term_win *tw, size_t col_start,
 void term_win_set_term(struct aug_term_win *tw, struct aug_term *term);
 void term_win_dims(const struct aug_term_win *tw, int *rows, int *cols);
 void term_win_update_cell(struct aug_term_win *tw, VTermPos pos, int color_on);
+void term_win_stage(struct aug_term_win *tw, int color_on);
 void term_win_refresh(struct aug_term_win *tw, int color_on);
-int term_win_damage(struct aug_term_win *tw, VTermRect rect, int color_on);
-int term_win_moverect(struct aug_term_win *tw, VTermRect dest, VTermRect src, int color_on);
-int term_win_movecursor(struct aug_term_win *tw, VTermPos pos, VTermPos oldpos, int color_on);
+int term_win_damage(struct aug_term_win *tw, VTermRect rect);
+int term_win_moverect(struct aug_term_win *tw, VTermRect dest, VTermRect src);
+int term_win_movecursor(struct aug_term_win *tw, VTermPos pos, VTermPos oldpos);
+int term_win_bell(struct aug_term_win *tw);
+int term_win_settermprop(struct aug_term_win *tw, VTermProp prop, VTermValue *val);
 void term_win_resize(struct aug_term_win *tw, WINDOW *win);
+/* bytes allocated for @tw (not counting the struct itself) */
+size_t term_win_mem(const struct aug_term_win *tw);
 
 #endif /* AUG_TERM_WIN */
\ No newline at end of file
@@ -0,0 +1,319 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "counters.h"
+
+struct trace_event {
+	uint64_t begin;
+	uint64_t dur;
+	const char *name;
+	uint32_t type;
+	uint32_t arg;
+};
+
+/* only the owning thread writes to a ring. an event is written
+ * into its slot before @head is advanced past it, so a reader 
+ * which loads @head before and after copying the ring can tell
+ * which of the events it copied were overwritten meanwhile. */
+struct trace_ring {
+	uint64_t head;
+	struct trace_event events[AUG_TRACE_RING_EVENTS];
+	int tid;
+	const char *name;
+	/* set when the owning thread exits. the ring is handed
+	 * to the next thread which needs one. */
+	int exited;
+	struct trace_ring *next;
+};
+
+static const struct {
+	const char *name;
+	const char *cat;
+	const char *arg;
+} TYPES[AUG_TRACE_TYPES] = {
+	[AUG_TRACE_PTY_READ] = {"pty_read", "io", "bytes"},
+	[AUG_TRACE_VTERM_PUSH] = {"vterm_push", "io", "bytes"},
+	[AUG_TRACE_DAMAGE_FLUSH] = {"damage_flush", "render", NULL},
+	[AUG_TRACE_REFRESH] = {"refresh", "render", NULL},
+	[AUG_TRACE_PLUGIN_CB] = {"plugin", "plugin", NULL},
+	[AUG_TRACE_LOCK_WAIT] = {"lock_wait", "lock", NULL},
+	[AUG_TRACE_FRAME] = {"frame", "render", "frame"},
+	[AUG_TRACE_DOUPDATE] = {"doupdate", "render", NULL},
+	[AUG_TRACE_SIGNAL] = {"signal", "signal", "signum"}
+};
+
+int g_trace_enabled = 0;
+
+static __thread struct trace_ring *tl_ring = NULL;
+static __thread const char *tl_name = NULL;
+
+/* taken when a thread gets its ring and while dumping, never
+ * while recording an event. */
+static struct {
+	pthread_mutex_t mtx;
+	pthread_once_t once;
+	pthread_key_t key;
+	struct trace_ring *rings;
+	int ntids;
+	uint64_t epoch;
+} g_trace = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_ONCE_INIT, 0, NULL, 0, 0 };
+
+static void on_thread_exit(void *ring) {
+	/* a destructor which runs after this one and traces gets
+	 * a new ring (and this is called again for that one). */
+	tl_ring = NULL;
+	__atomic_store_n(&((struct trace_ring *) ring)->exited, 1, __ATOMIC_RELEASE);
+}
+
+static void make_key() {
+	AUG_STATUS_EQUAL( pthread_key_create(&g_trace.key, on_thread_exit), 0 );
+}
+
+static struct trace_ring *ring() {
+	struct trace_ring *r;
+
+	if(tl_ring != NULL)
+		return tl_ring;
+
+	AUG_STATUS_EQUAL( pthread_once(&g_trace.once, make_key), 0 );
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_trace.mtx), 0 );
+	for(r = g_trace.rings; r != NULL; r = r->next) 
+		if(__atomic_load_n(&r->exited, __ATOMIC_ACQUIRE) != 0)
+			break;
+
+	if(r == NULL) {
+		if( (r = malloc(sizeof(*r))) == NULL)
+			err_exit(errno, "failed to allocate trace ring");
+		r->next = g_trace.rings;
+		g_trace.rings = r;
+	}
+	/* else the events of the thread which exited are lost */
+	r->head = 0;
+	r->tid = ++g_trace.ntids;
+	r->name = tl_name;
+	r->exited = 0;
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_trace.mtx), 0 );
+
+	AUG_STATUS_EQUAL( pthread_setspecific(g_trace.key, r), 0 );
+	tl_ring = r;
+	return r;
+}
+
+void trace_end(enum aug_trace_type type, const char *name, uint64_t begin, 
+		uint32_t arg) {
+	struct trace_ring *r;
+	struct trace_event *ev;
+	uint64_t head;
+
+	if(begin == 0)
+		return;
+
+	r = ring();
+	head = r->head;
+	ev = &r->events[head & (AUG_TRACE_RING_EVENTS - 1)];
+	ev->begin = begin;
+	ev->dur = trace_now() - begin;
+	ev->name = name;
+	ev->type = type;
+	ev->arg = arg;
+	__atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void trace_thread_name(const char *name) {
+	tl_name = name;
+	if(tl_ring != NULL) {
+		AUG_STATUS_EQUAL( pthread_mutex_lock(&g_trace.mtx), 0 );
+		tl_ring->name = name;
+		AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_trace.mtx), 0 );
+	}
+}
+
+void trace_lock(pthread_mutex_t *mtx, const char *name) {
+	uint64_t begin;
+	int s;
+
+	s = pthread_mutex_trylock(mtx);
+	if(s == 0)
+		return;
+	else if(s != EBUSY)
+		err_exit(s, "pthread_mutex_trylock failed");
+
+	counters_add(AUG_COUNTER_LOCK_WAITS, 1);
+	begin = trace_begin();
+	AUG_STATUS_EQUAL( pthread_mutex_lock(mtx), 0 );
+	trace_end(AUG_TRACE_LOCK_WAIT, name, begin, 0);
+}
+
+void trace_enable(int enable) {
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_trace.mtx), 0 );
+	if(enable && !trace_enabled())
+		g_trace.epoch = trace_now();
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_trace.mtx), 0 );
+
+	__atomic_store_n(&g_trace_enabled, (enable != 0), __ATOMIC_RELAXED);
+}
+
+/* g_trace.mtx must be held. copies the events of @r which are
+ * still intact into @events (oldest first) and returns how many 
+ * there are. */
+static size_t copy_ring(const struct trace_ring *r, struct trace_event *events) {
+	uint64_t head, after, first, i;
+	size_t n;
+
+	head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+	first = (head > AUG_TRACE_RING_EVENTS)? head - AUG_TRACE_RING_EVENTS : 0;
+	for(i = first; i < head; i++)
+		events[i - first] = r->events[i & (AUG_TRACE_RING_EVENTS - 1)];
+
+	/* the owner may have kept going while we copied. the slots
+	 * of the events from (after - AUG_TRACE_RING_EVENTS) on may 
+	 * have been reused, and the one after them may be in the 
+	 * middle of being rewritten, so a full ring gives up its
+	 * oldest event even if the owner is idle. */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	after = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+	n = head - first;
+	if(after >= AUG_TRACE_RING_EVENTS && after - AUG_TRACE_RING_EVENTS + 1 > first) {
+		i = after - AUG_TRACE_RING_EVENTS + 1 - first;
+		if(i > n)
+			i = n;
+		memmove(events, events + i, (n - i)*sizeof(*events));
+		n -= i;
+	}
+
+	return n;
+}
+
+void trace_stats(struct aug_trace_stats *stats) {
+	struct trace_ring *r;
+	uint64_t head;
+
+	memset(stats, 0, sizeof(*stats));
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_trace.mtx), 0 );
+	for(r = g_trace.rings; r != NULL; r = r->next) {
+		head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+		stats->recorded += head;
+		if(head > AUG_TRACE_RING_EVENTS)
+			stats->overwritten += head - AUG_TRACE_RING_EVENTS;
+		stats->threads++;
+	}
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_trace.mtx), 0 );
+}
+
+static void fprint_str(FILE *f, const char *s) {
+	fputc('"', f);
+	for(; *s != '\0'; s++) {
+		if(*s == '"' || *s == '\\')
+			fputc('\\', f);
+		if((unsigned char) *s < 0x20)
+			fprintf(f, "\\u%04x", (unsigned char) *s);
+		else
+			fputc(*s, f);
+	}
+	fputc('"', f);
+}
+
+void trace_dump(FILE *f) {
+	struct trace_ring *r;
+	struct trace_event *events, *ev;
+	size_t n, i;
+	pid_t pid;
+	int first;
+
+	if( (events = malloc(sizeof(*events)*AUG_TRACE_RING_EVENTS)) == NULL)
+		err_exit(errno, "failed to allocate trace dump buffer");
+
+	pid = getpid();
+	first = 1;
+	fprintf(f, "{\"traceEvents\": [\n");
+
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_trace.mtx), 0 );
+	for(r = g_trace.rings; r != NULL; r = r->next) {
+		if(!first)
+			fprintf(f, ",\n");
+		first = 0;
+		fprintf(f, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, "
+			"\"tid\": %d, \"args\": {\"name\": ", (int) pid, r->tid);
+		if(r->name != NULL)
+			fprint_str(f, r->name);
+		else
+			fprintf(f, "\"thread %d\"", r->tid);
+		fprintf(f, "}}");
+
+		n = copy_ring(r, events);
+		for(i = 0; i < n; i++) {
+			ev = &events[i];
+			/* left over from before tracing was last enabled */
+			if(ev->begin < g_trace.epoch)
+				continue;
+
+			fprintf(f, ",\n{\"name\": ");
+			fprint_str(f, (ev->name != NULL)? ev->name : TYPES[ev->type].name);
+			fprintf(f, ", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, "
+				"\"dur\": %.3f, \"pid\": %d, \"tid\": %d", 
+				TYPES[ev->type].cat, (ev->begin - g_trace.epoch)/1000.0, 
+				ev->dur/1000.0, (int) pid, r->tid);
+			if(TYPES[ev->type].arg != NULL)
+				fprintf(f, ", \"args\": {\"%s\": %u}", TYPES[ev->type].arg, ev->arg);
+			fputc('}', f);
+		}
+	}
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_trace.mtx), 0 );
+
+	fprintf(f, "\n], \"displayTimeUnit\": \"ms\"}\n");
+	fflush(f);
+	free(events);
+}
+
+int trace_dump_path(const char *path) {
+	FILE *f;
+
+	if( (f = fopen(path, "w")) == NULL)
+		return -1;
+
+	trace_dump(f);
+	if(fclose(f) != 0)
+		return -1;
+
+	return 0;
+}
+
+void trace_free() {
+	struct trace_ring *r, *next;
+
+	trace_enable(0);
+	AUG_STATUS_EQUAL( pthread_mutex_lock(&g_trace.mtx), 0 );
+	for(r = g_trace.rings; r != NULL; r = next) {
+		next = r->next;
+		free(r);
+	}
+	g_trace.rings = NULL;
+	AUG_STATUS_EQUAL( pthread_mutex_unlock(&g_trace.mtx), 0 );
+
+	if(tl_ring != NULL) {
+		AUG_STATUS_EQUAL( pthread_setspecific(g_trace.key, NULL), 0 );
+		tl_ring = NULL;
+	}
+}
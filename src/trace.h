@@ -0,0 +1,111 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUG_TRACE_H
+#define AUG_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+/* an event tracer for finding out where the time of a frame goes.
+ * each thread records fixed size events into its own ring buffer
+ * without taking any locks; when a ring is full the oldest events
+ * are overwritten. trace_dump writes the rings of all threads out
+ * in the chrome trace_event format, which chrome://tracing and 
+ * perfetto can load. when tracing is disabled, trace_begin costs
+ * a load and a branch and trace_end returns right away. */
+
+/* events per thread. must be a power of 2. */
+#define AUG_TRACE_RING_EVENTS (1 << 15)
+
+enum aug_trace_type {
+	AUG_TRACE_PTY_READ = 0,
+	AUG_TRACE_VTERM_PUSH,
+	AUG_TRACE_DAMAGE_FLUSH,
+	AUG_TRACE_REFRESH,
+	AUG_TRACE_PLUGIN_CB,
+	AUG_TRACE_LOCK_WAIT,
+	AUG_TRACE_FRAME,
+	AUG_TRACE_DOUPDATE,
+	AUG_TRACE_SIGNAL,
+	AUG_TRACE_TYPES
+};
+
+struct aug_trace_stats {
+	uint64_t recorded;
+	uint64_t overwritten;
+	int threads;
+};
+
+extern int g_trace_enabled;
+
+static inline int trace_enabled() {
+	return __atomic_load_n(&g_trace_enabled, __ATOMIC_RELAXED);
+}
+
+/* nanoseconds on a clock which is the same for every thread */
+static inline uint64_t trace_now() {
+#if defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec*1000000000 + ts.tv_nsec;
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (uint64_t) tv.tv_sec*1000000000 + (uint64_t) tv.tv_usec*1000;
+#endif
+}
+
+/* returns the start time of an event, or 0 if tracing is off */
+static inline uint64_t trace_begin() {
+	return trace_enabled()? trace_now() : 0;
+}
+
+/* record an event of @type which began at @begin (the value
+ * returned by trace_begin) and ends now. nothing is recorded if
+ * @begin is 0. @name must be a string which lives at least until 
+ * the next call to trace_free; if it is NULL the name of @type 
+ * is used. @arg is shown in the event details (the number of 
+ * bytes for pty reads for example). */
+void trace_end(enum aug_trace_type type, const char *name, uint64_t begin, 
+		uint32_t arg);
+
+/* the name which the calling thread gets in the trace. @name
+ * must be a string constant. */
+void trace_thread_name(const char *name);
+
+/* lock @mtx, recording an AUG_TRACE_LOCK_WAIT event named
+ * @name if another thread holds it. */
+void trace_lock(pthread_mutex_t *mtx, const char *name);
+
+/* enabling tracing starts the clock the timestamps in
+ * the trace are relative to. */
+void trace_enable(int enable);
+void trace_stats(struct aug_trace_stats *stats);
+void trace_dump(FILE *f);
+/* returns non-zero (with errno set) if @path cant be written */
+int trace_dump_path(const char *path);
+/* must be called after all threads which recorded 
+ * events have exited (or will never record again) */
+void trace_free();
+
+#endif /* AUG_TRACE_H */
@@ -15,11 +15,19 @@
  * You should have received a copy of the GNU General Public License
  * along with aug.  If not, see <http://www.gnu.org/licenses/>.
  */
+#if defined(__linux__)
+/* for struct ucred */
+#	define _GNU_SOURCE
+#endif
 #include "util.h"
 
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <pthread.h>
 
 #include "err.h"
@@ -51,6 +59,23 @@ void write_n_or_exit(int fd, const void *buf, size_t n) {
 	}
 }
 
+int write_all(int fd, const void *buf, size_t n) {
+	const char *data;
+	ssize_t amt;
+
+	for(data = buf; n > 0; data += amt, n -= amt) {
+		if( (amt = write(fd, data, n) ) < 0) {
+			if(errno == EINTR) {
+				amt = 0;
+				continue;
+			}
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
 inline void *aug_malloc(size_t size) {
 	void *result = malloc(size);
 	if(result == NULL)
@@ -87,3 +112,96 @@ void aug_detached_thread(void *(*fn)(void *), void *user, pthread_t *tid) {
 }
  
 
+/* is something listening on the socket at @addr? */
+static int unix_alive(const struct sockaddr_un *addr) {
+	int fd, alive;
+
+	if( (fd = socket(AF_UNIX, SOCK_STREAM, 0) ) < 0)
+		return -1;
+	/* dont wait on a listener whose backlog is full */
+	if(set_nonblocking(fd) != 0) {
+		close(fd);
+		return -1;
+	}
+	alive = (connect(fd, (const struct sockaddr *) addr, sizeof(*addr)) == 0
+		|| errno == EAGAIN || errno == EINPROGRESS);
+	close(fd);
+	return alive;
+}
+
+int unix_listen(const char *path) {
+	struct sockaddr_un addr;
+	struct stat st;
+	mode_t mask;
+	int fd, s, alive;
+
+	if(strlen(path) >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if( (fd = socket(AF_UNIX, SOCK_STREAM, 0) ) < 0)
+		return -1;
+	if(fcntl(fd, F_SETFD, FD_CLOEXEC) != 0)
+		goto close_fd;
+	/* a connection which goes away before it is accepted
+	 * mustnt leave anyone blocked in accept */
+	if(set_nonblocking(fd) != 0)
+		goto close_fd;
+
+	/* a socket nobody listens on was left behind by an aug 
+	 * which didnt exit cleanly */
+	if(lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+		if( (alive = unix_alive(&addr) ) < 0)
+			goto close_fd;
+		if(alive) {
+			errno = EADDRINUSE;
+			goto close_fd;
+		}
+		if(unlink(path) != 0)
+			goto close_fd;
+	}
+
+	/* the socket mustnt be reachable by anyone else, not even
+	 * for the moment between bind and a chmod */
+	mask = umask(S_IRWXG | S_IRWXO);
+	s = bind(fd, (struct sockaddr *) &addr, sizeof(addr));
+	umask(mask);
+	if(s != 0)
+		goto close_fd;
+	if(listen(fd, 8) != 0) {
+		s = errno;
+		unlink(path);
+		errno = s;
+		goto close_fd;
+	}
+
+	return fd;
+
+close_fd:
+	s = errno;
+	close(fd);
+	errno = s;
+	return -1;
+}
+
+int unix_peer_uid(int fd, uid_t *uid) {
+#if defined(__linux__)
+	struct ucred cred;
+	socklen_t len;
+
+	len = sizeof(cred);
+	if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+		return -1;
+	*uid = cred.uid;
+	return 0;
+#else
+	gid_t gid;
+
+	return getpeereid(fd, uid, &gid);
+#endif
+}
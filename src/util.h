@@ -20,6 +20,7 @@
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/types.h>
 #include <ccan/str/str.h>
 #include <ccan/array_size/array_size.h>
 #include <pthread.h>
@@ -55,8 +56,22 @@
 
 int set_nonblocking(int fd);
 void write_n_or_exit(int fd, const void *buf, size_t n);
+/* write all @n bytes to a blocking @fd, retrying after 
+ * interruptions. returns -1 (with errno set) on failure. */
+int write_all(int fd, const void *buf, size_t n);
 void *aug_malloc(size_t size);
 int void_compare(const void *a, const void *b);
 void aug_detached_thread(void *(*fn)(void *), void *user, pthread_t *tid);
+/* listen on a non-blocking, close-on-exec unix stream socket at 
+ * @path which only the user can connect to. a socket at @path 
+ * which nobody listens on is replaced; if something does, errno 
+ * is EADDRINUSE. any other kind of file is left alone. the umask
+ * is changed for the moment of the bind, so this shouldnt race 
+ * with threads creating files. returns the socket or -1 (with 
+ * errno set). */
+int unix_listen(const char *path);
+/* the effective uid of the process at the other end of the 
+ * connected unix socket @fd. returns -1 (with errno set) on failure. */
+int unix_peer_uid(int fd, uid_t *uid);
 
 #endif
\ No newline at end of file
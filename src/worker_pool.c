@@ -0,0 +1,129 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "worker_pool.h"
+
+#include <stdlib.h>
+#include "err.h"
+#include "util.h"
+
+struct worker_task {
+	void (*fn)(void *user);
+	void *user;
+	struct list_node node;
+};
+
+static void *worker_thread(void *user) {
+	struct aug_worker_pool *pool;
+	struct worker_task *task;
+
+	pool = user;
+	AUG_LOCK(pool);
+	while(1) {
+		while(list_empty(&pool->tasks) && !pool->stop)
+			AUG_COND_WAIT(&pool->task_cond, pool);
+
+		task = list_top(&pool->tasks, struct worker_task, node);
+		if(task == NULL) /* stopped and nothing left to run */
+			break;
+		list_del(&task->node);
+
+		pool->busy++;
+		AUG_UNLOCK(pool);
+
+		(*task->fn)(task->user);
+		free(task);
+
+		AUG_LOCK(pool);
+		pool->busy--;
+		if(pool->busy == 0 && list_empty(&pool->tasks)) 
+			AUG_STATUS_EQUAL( pthread_cond_broadcast(&pool->idle_cond), 0 );
+	}
+	AUG_UNLOCK(pool);
+
+	return NULL;
+}
+
+void worker_pool_init(struct aug_worker_pool *pool, size_t n_threads) {
+	size_t i;
+	int s;
+
+	if(n_threads < 1)
+		err_exit(0, "worker pool needs at least one thread");
+
+	list_head_init(&pool->tasks);
+	pool->busy = 0;
+	pool->stop = 0;
+	AUG_LOCK_INIT(pool);
+	AUG_STATUS_EQUAL( pthread_cond_init(&pool->task_cond, NULL), 0 );
+	AUG_STATUS_EQUAL( pthread_cond_init(&pool->idle_cond, NULL), 0 );
+
+	pool->threads = malloc( sizeof(pthread_t) * n_threads );
+	if(pool->threads == NULL)
+		err_exit(0, "out of memory");
+	
+	for(i = 0; i < n_threads; i++) {
+		s = pthread_create(&pool->threads[i], NULL, worker_thread, pool);
+		if(s != 0)
+			err_exit(s, "failed to create worker thread");
+	}
+	pool->n_threads = n_threads;
+}
+
+void worker_pool_free(struct aug_worker_pool *pool) {
+	size_t i;
+	int s;
+
+	AUG_LOCK(pool);
+	pool->stop = 1;
+	AUG_STATUS_EQUAL( pthread_cond_broadcast(&pool->task_cond), 0 );
+	AUG_UNLOCK(pool);
+
+	for(i = 0; i < pool->n_threads; i++) {
+		s = pthread_join(pool->threads[i], NULL);
+		if(s != 0)
+			err_exit(s, "failed to join worker thread");
+	}
+	free(pool->threads);
+
+	AUG_STATUS_EQUAL( pthread_cond_destroy(&pool->task_cond), 0 );
+	AUG_STATUS_EQUAL( pthread_cond_destroy(&pool->idle_cond), 0 );
+	AUG_LOCK_FREE(pool);
+}
+
+void worker_pool_push(struct aug_worker_pool *pool, void (*fn)(void *user), 
+		void *user) {
+	struct worker_task *task;
+
+	task = malloc( sizeof(*task) );
+	if(task == NULL)
+		err_exit(0, "out of memory");
+	task->fn = fn;
+	task->user = user;
+
+	AUG_LOCK(pool);
+	list_add_tail(&pool->tasks, &task->node);
+	AUG_STATUS_EQUAL( pthread_cond_signal(&pool->task_cond), 0 );
+	AUG_UNLOCK(pool);
+}
+
+void worker_pool_wait(struct aug_worker_pool *pool) {
+	AUG_LOCK(pool);
+	while(pool->busy > 0 || !list_empty(&pool->tasks))
+		AUG_COND_WAIT(&pool->idle_cond, pool);
+	AUG_UNLOCK(pool);
+}
@@ -0,0 +1,52 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUG_WORKER_POOL_H
+#define AUG_WORKER_POOL_H
+
+#include <pthread.h>
+#include <ccan/list/list.h>
+#include "lock.h"
+
+/* a fixed number of threads which run queued tasks in the order
+ * they were pushed. with a single thread the tasks also finish in
+ * that order. */
+struct aug_worker_pool {
+	pthread_t *threads;
+	size_t n_threads;
+	struct list_head tasks;
+	/* number of tasks which have been popped but have not returned */
+	size_t busy;
+	int stop;
+	pthread_cond_t task_cond;
+	pthread_cond_t idle_cond;
+	AUG_LOCK_MEMBERS;
+};
+
+/* starts @n_threads threads. the threads inherit the signal mask
+ * of the calling thread. */
+void worker_pool_init(struct aug_worker_pool *pool, size_t n_threads);
+/* runs every task still in the queue, then joins the threads. */
+void worker_pool_free(struct aug_worker_pool *pool);
+
+/* queue @fn to be called with @user on one of the threads of @pool */
+void worker_pool_push(struct aug_worker_pool *pool, void (*fn)(void *user), 
+		void *user);
+/* blocks until the queue is empty and no task is running */
+void worker_pool_wait(struct aug_worker_pool *pool);
+
+#endif /* AUG_WORKER_POOL_H */
@@ -99,7 +99,8 @@ static int api_test_main(FILE *output, int argc, char *argv[]) {
 		plan_tests(
 			131 + 4 + 
 			4*2 + /* pre_scroll and post_scroll */
-			3 /* primary_term_dims_change */
+			3 + /* primary_term_dims_change */
+			14 + 1 /* headless terminal */
 		); 
 		diag("test the plugin api");
 		diag("parent: start");
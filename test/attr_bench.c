@@ -0,0 +1,123 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "attr.h"
+#include "vterm_ansi_colors.h"
+
+/* the color conversions done for every cell that is painted.
+ *   exact         attr_vterm_color_to_curses_color for each 
+ *                 of the ansi colors
+ *   nearest       attr_vterm_color_to_nearest_curses_color for
+ *                 rgb colors (256 color and truecolor output)
+ *   pair_ansi     attr_vterm_pair_to_curses_pair for ansi fg/bg
+ *   pair_default  attr_vterm_pair_to_curses_pair for the
+ *                 default fg/bg
+ * attr_vterm_pair_to_curses_pair with rgb colors writes a line 
+ * to stderr for each color, so it is left out; its cost is 
+ * nearest plus the write. */
+
+#define RGB_COLORS 256
+
+static VTermColor g_rgb[RGB_COLORS];
+
+static void run_exact(size_t n, void *user) {
+	int color, bright;
+	size_t i;
+
+	(void)(user);
+	for(i = 0; i < n; i++)
+		if(attr_vterm_color_to_curses_color(
+				vterm_ansi_colors[i % AUG_TOTAL_ANSI_COLORS], 
+				&color, &bright) != 0)
+			err_exit(0, "ansi color %zu not found", i % AUG_TOTAL_ANSI_COLORS);
+}
+
+static void run_nearest(size_t n, void *user) {
+	int color, bright;
+	size_t i;
+
+	(void)(user);
+	for(i = 0; i < n; i++) {
+		attr_vterm_color_to_nearest_curses_color(g_rgb[i % RGB_COLORS], 
+			&color, &bright);
+		__asm__ __volatile__("" : : "r"(color));
+	}
+}
+
+static void run_pair_ansi(size_t n, void *user) {
+	attr_t attr;
+	int pair;
+	size_t i;
+
+	(void)(user);
+	for(i = 0; i < n; i++) {
+		attr = 0;
+		attr_vterm_pair_to_curses_pair(
+			vterm_ansi_colors[i % AUG_TOTAL_ANSI_COLORS],
+			vterm_ansi_colors[(i/AUG_TOTAL_ANSI_COLORS) % AUG_TOTAL_ANSI_COLORS],
+			&attr, &pair);
+		__asm__ __volatile__("" : : "r"(pair));
+	}
+}
+
+static void run_pair_default(size_t n, void *user) {
+	attr_t attr;
+	int pair;
+	size_t i;
+
+	(void)(user);
+	for(i = 0; i < n; i++) {
+		attr = 0;
+		attr_vterm_pair_to_curses_pair(VTERM_DEFAULT_COLOR, VTERM_DEFAULT_COLOR, 
+			&attr, &pair);
+		__asm__ __volatile__("" : : "r"(pair));
+	}
+}
+
+int main() {
+	static const struct {
+		const char *name;
+		void (*fn)(size_t n, void *user);
+	} cases[] = {
+		{"exact", run_exact},
+		{"nearest", run_nearest},
+		{"pair_ansi", run_pair_ansi},
+		{"pair_default", run_pair_default}
+	};
+	unsigned int seed;
+	size_t i, iters;
+	double ns;
+
+	seed = 1;
+	for(i = 0; i < RGB_COLORS; i++) {
+		seed = seed*1103515245 + 12345;
+		g_rgb[i].red = seed >> 8;
+		g_rgb[i].green = seed >> 16;
+		g_rgb[i].blue = seed >> 24;
+	}
+
+	for(i = 0; i < AUG_ARRAY_SIZE(cases); i++) {
+		ns = bench_ns_per_op(cases[i].fn, NULL, &iters);
+		bench_report(stdout, "attr", cases[i].name, "", ns, iters);
+	}
+
+	return 0;
+}
@@ -0,0 +1,285 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUG_BENCH_H
+#define AUG_BENCH_H
+
+/* helpers shared by the *_bench programs (see make bench). 
+ * results are written as one JSON object per line so they 
+ * can be collected and compared between revisions. */
+
+#ifndef _XOPEN_SOURCE
+#	define _XOPEN_SOURCE 700
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#if defined(__FreeBSD__)
+#	include <libutil.h>
+#	include <termios.h>
+#elif defined(__OpenBSD__) || defined(__NetBSD__) || defined(__APPLE__)
+#	include <termios.h>
+#	include <util.h>
+#else
+#	include <pty.h>
+#endif
+
+#include "util.h"
+#include "err.h"
+
+#define AUG_BENCH_ROWS 50
+#define AUG_BENCH_COLS 160
+#define AUG_BENCH_TERM "xterm-256color"
+
+/* growable byte buffer for generated fixtures */
+struct bench_buf {
+	char *data;
+	size_t len;
+	size_t size;
+};
+
+static inline void bench_buf_init(struct bench_buf *bb) {
+	bb->data = NULL;
+	bb->len = 0;
+	bb->size = 0;
+}
+
+static inline void bench_buf_free(struct bench_buf *bb) {
+	free(bb->data);
+	bench_buf_init(bb);
+}
+
+static inline void bench_buf_reserve(struct bench_buf *bb, size_t n) {
+	if(bb->len + n <= bb->size)
+		return;
+
+	while(bb->len + n > bb->size)
+		bb->size = (bb->size > 0)? bb->size*2 : 4096;
+	AUG_PTR_NON_NULL( (bb->data = realloc(bb->data, bb->size) ) );
+}
+
+static inline void bench_buf_add(struct bench_buf *bb, const char *data, size_t n) {
+	bench_buf_reserve(bb, n);
+	memcpy(bb->data + bb->len, data, n);
+	bb->len += n;
+}
+
+static inline void bench_buf_printf(struct bench_buf *bb, const char *format, ...) {
+	va_list args;
+	char buf[512];
+	int n;
+
+	va_start(args, format);
+	n = vsnprintf(buf, sizeof(buf), format, args);
+	va_end(args);
+	if(n < 0 || (size_t) n >= sizeof(buf) )
+		err_exit(0, "bench_buf_printf: output too long");
+
+	bench_buf_add(bb, buf, n);
+}
+
+/* reads all of @path into @bb. returns non-zero on error. */
+static inline int bench_buf_load(struct bench_buf *bb, const char *path) {
+	FILE *f;
+	size_t n;
+
+	if( (f = fopen(path, "r") ) == NULL)
+		return -1;
+
+	do {
+		bench_buf_reserve(bb, 65536);
+		n = fread(bb->data + bb->len, 1, bb->size - bb->len, f);
+		bb->len += n;
+	} while(n > 0);
+
+	n = ferror(f);
+	fclose(f);
+	return (n != 0)? -1 : 0;
+}
+
+static inline double bench_now() {
+	struct timeval tv;
+
+	if(gettimeofday(&tv, NULL) != 0)
+		err_exit(errno, "gettimeofday failed");
+	return tv.tv_sec + tv.tv_usec/1e6;
+}
+
+/* samples (in seconds) from which percentiles are taken */
+struct bench_samples {
+	double *v;
+	size_t n;
+	size_t size;
+};
+
+static inline void bench_samples_init(struct bench_samples *s) {
+	s->v = NULL;
+	s->n = 0;
+	s->size = 0;
+}
+
+static inline void bench_samples_free(struct bench_samples *s) {
+	free(s->v);
+	bench_samples_init(s);
+}
+
+static inline void bench_samples_add(struct bench_samples *s, double secs) {
+	if(s->n == s->size) {
+		s->size = (s->size > 0)? s->size*2 : 1024;
+		AUG_PTR_NON_NULL( (s->v = realloc(s->v, s->size*sizeof(double)) ) );
+	}
+	s->v[s->n++] = secs;
+}
+
+static inline int bench_cmp_double(const void *a, const void *b) {
+	double x = *(const double *) a, y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+/* the @pct percentile in microseconds. sorts the samples. */
+static inline double bench_samples_pct(struct bench_samples *s, int pct) {
+	size_t i;
+
+	if(s->n < 1)
+		return 0;
+
+	qsort(s->v, s->n, sizeof(double), bench_cmp_double);
+	i = (s->n * pct) / 100;
+	if(i >= s->n)
+		i = s->n - 1;
+	return s->v[i] * 1e6;
+}
+
+/* a microbenchmark case runs for at least this long */
+#define AUG_BENCH_MIN_SECS 0.2
+
+/* calls @fn with a growing number of iterations until one call
+ * takes at least AUG_BENCH_MIN_SECS. returns the nanoseconds per 
+ * iteration of that call and sets *@iters to its iterations. */
+static inline double bench_ns_per_op(void (*fn)(size_t n, void *user), void *user, 
+		size_t *iters) {
+	double t;
+	size_t n;
+
+	for(n = 1; ; n *= 2) {
+		t = bench_now();
+		(*fn)(n, user);
+		t = bench_now() - t;
+		if(t >= AUG_BENCH_MIN_SECS || n >= ((size_t) 1 << 40) )
+			break;
+	}
+
+	*iters = n;
+	return t*1e9/n;
+}
+
+/* prints the result of a microbenchmark case as a line of JSON. 
+ * @params is a (possibly empty) list of extra members, such as
+ * "\"cols\": 80, ". */
+static inline void bench_report(FILE *out, const char *bench, const char *name, 
+		const char *params, double ns_per_op, size_t iters) {
+	fprintf(out, "{\"bench\": \"%s\", \"case\": \"%s\", %s\"ns_per_op\": %.1f, "
+		"\"iters\": %zu}\n", bench, name, params, ns_per_op, iters);
+	fflush(out);
+}
+
+/* the outer terminal: stdin and stdout are moved onto a pty of
+ * AUG_BENCH_ROWS x AUG_BENCH_COLS whose output is read (and counted)
+ * by a thread, so curses writes somewhere real without ever 
+ * blocking. results go to what stdout was before. */
+static struct {
+	int master;
+	int slave;
+	pthread_t reader;
+	unsigned long long bytes;
+	FILE *results;
+} g_bench_pty;
+
+static inline void *bench_pty_reader(void *user) {
+	char buf[16384];
+	ssize_t n;
+
+	(void)(user);
+	while( (n = read(g_bench_pty.master, buf, sizeof(buf)) ) != 0) {
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			/* EIO once the slave is closed */
+			break;
+		}
+		g_bench_pty.bytes += n;
+	}
+
+	return NULL;
+}
+
+static inline FILE *bench_pty_init() {
+	struct winsize size;
+	int fd, s;
+
+	size.ws_row = AUG_BENCH_ROWS;
+	size.ws_col = AUG_BENCH_COLS;
+	size.ws_xpixel = 0;
+	size.ws_ypixel = 0;
+	if(openpty(&g_bench_pty.master, &g_bench_pty.slave, NULL, NULL, &size) != 0)
+		err_exit(errno, "openpty failed");
+
+	if( (fd = dup(STDOUT_FILENO) ) < 0)
+		err_exit(errno, "dup failed");
+	AUG_PTR_NON_NULL( (g_bench_pty.results = fdopen(fd, "w") ) );
+
+	if(dup2(g_bench_pty.slave, STDIN_FILENO) < 0 
+			|| dup2(g_bench_pty.slave, STDOUT_FILENO) < 0)
+		err_exit(errno, "dup2 failed");
+
+	g_bench_pty.bytes = 0;
+	if( (s = pthread_create(&g_bench_pty.reader, NULL, bench_pty_reader, NULL) ) != 0)
+		err_exit(s, "pthread_create failed");
+
+	if(setenv("TERM", AUG_BENCH_TERM, 1) != 0)
+		err_exit(errno, "setenv failed");
+
+	return g_bench_pty.results;
+}
+
+/* bytes written to the outer terminal so far. only approximate 
+ * while curses may still be writing. */
+static inline unsigned long long bench_pty_bytes() {
+	return g_bench_pty.bytes;
+}
+
+static inline void bench_pty_free() {
+	int s;
+
+	close(STDIN_FILENO);
+	close(STDOUT_FILENO);
+	close(g_bench_pty.slave);
+	if( (s = pthread_join(g_bench_pty.reader, NULL) ) != 0)
+		err_exit(s, "pthread_join failed");
+	close(g_bench_pty.master);
+	fclose(g_bench_pty.results);
+}
+
+#endif /* AUG_BENCH_H */
@@ -0,0 +1,146 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUG_BENCH_FIXTURES_H
+#define AUG_BENCH_FIXTURES_H
+
+/* generated stand-ins for output captured from real programs.
+ * they are generated rather than stored so they always fit 
+ * AUG_BENCH_ROWS x AUG_BENCH_COLS and the repository stays small.
+ * the numbers come from a fixed LCG so every run replays the 
+ * same bytes. a real capture (from script(1) for example) can 
+ * be replayed by passing its path to the bench program. */
+
+#include "bench.h"
+
+struct bench_fixture {
+	const char *name;
+	void (*gen)(struct bench_buf *bb);
+};
+
+static unsigned int g_fixture_seed;
+
+static unsigned int fixture_rand() {
+	g_fixture_seed = g_fixture_seed*1103515245 + 12345;
+	return (g_fixture_seed >> 16) & 0x7fff;
+}
+
+/* a long log scrolling by, like `cat /var/log/syslog` */
+static void fixture_cat_log(struct bench_buf *bb) {
+	int i;
+
+	for(i = 0; i < 20000; i++) 
+		bench_buf_printf(bb, "Jun  1 12:%02d:%02d host sshd[%u]: Accepted "
+			"publickey for user%u from 10.0.%u.%u port %u ssh2\r\n",
+			(i/60) % 60, i % 60, 1000 + fixture_rand() % 30000, 
+			fixture_rand() % 100, fixture_rand() % 256, fixture_rand() % 256,
+			1024 + fixture_rand() % 60000);
+}
+
+/* scrolling through a file in an editor: a scroll region above a 
+ * status line, syntax colors on each new line and the cursor being
+ * put back after every step */
+static void fixture_vim_scroll(struct bench_buf *bb) {
+	int i, j, words;
+
+	bench_buf_printf(bb, "\033[?1049h\033[H\033[2J\033[1;%dr", AUG_BENCH_ROWS-1);
+	for(i = 0; i < 5000; i++) {
+		if( (i/500) % 2 == 0) /* scroll down, then back up */
+			bench_buf_printf(bb, "\033[%d;1H\n", AUG_BENCH_ROWS-1);
+		else 
+			bench_buf_printf(bb, "\033[1;1H\033M");
+		bench_buf_printf(bb, "\033[33m%5d \033[m", i);
+		words = fixture_rand() % 12;
+		for(j = 0; j < words; j++)
+			bench_buf_printf(bb, "\033[38;5;%um%s\033[m ", 
+				fixture_rand() % 256, (j % 3 == 0)? "static" : "value_x");
+		bench_buf_printf(bb, "\033[K\033[%d;1H\033[7m\"file.c\" line %d of 5000"
+			"\033[K\033[m\033[%d;%uH", AUG_BENCH_ROWS, i, 
+			1 + fixture_rand() % (AUG_BENCH_ROWS-1), 1 + fixture_rand() % 80);
+	}
+	bench_buf_printf(bb, "\033[r\033[?1049l");
+}
+
+/* a process monitor redrawing meters and a process table */
+static void fixture_htop_redraw(struct bench_buf *bb) {
+	int frame, row, j, n;
+
+	bench_buf_printf(bb, "\033[H\033[2J");
+	for(frame = 0; frame < 500; frame++) {
+		bench_buf_printf(bb, "\033[H");
+		for(row = 0; row < 4; row++) {
+			n = fixture_rand() % 60;
+			bench_buf_printf(bb, "\033[%d;3H\033[1m%2d\033[m[\033[32m", row+1, row);
+			for(j = 0; j < 60; j++)
+				bench_buf_add(bb, (j < n)? "|" : " ", 1);
+			bench_buf_printf(bb, "\033[m%3d.%d%%]", n, fixture_rand() % 10);
+		}
+		bench_buf_printf(bb, "\033[6;1H\033[30;42m  PID USER      PRI  NI  VIRT   RES"
+			"   SHR S CPU%% MEM%%   TIME+  Command\033[K\033[m");
+		for(row = 6; row < AUG_BENCH_ROWS; row++) 
+			bench_buf_printf(bb, "\033[%d;1H%5u %-9s %3u %3d %5uM %5uM %5uM %c "
+				"\033[1m%4.1f\033[m %4.1f %2u:%02u.%02u \033[36m/usr/bin/proc%u\033[m\033[K",
+				row+1, fixture_rand(), "root", 20, 0, fixture_rand() % 4096, 
+				fixture_rand() % 512, fixture_rand() % 64, 
+				(fixture_rand() % 4 == 0)? 'R' : 'S', 
+				(fixture_rand() % 1000)/10.0, (fixture_rand() % 1000)/10.0, 
+				fixture_rand() % 60, fixture_rand() % 60, fixture_rand() % 100, 
+				fixture_rand() % 50);
+	}
+}
+
+/* full screen 24 bit color gradients that shift every frame */
+static void fixture_truecolor(struct bench_buf *bb) {
+	int frame, row, col;
+
+	for(frame = 0; frame < 60; frame++) {
+		bench_buf_printf(bb, "\033[H");
+		for(row = 0; row < AUG_BENCH_ROWS; row++) {
+			bench_buf_printf(bb, "\033[%d;1H", row+1);
+			for(col = 0; col < AUG_BENCH_COLS; col++)
+				bench_buf_printf(bb, "\033[48;2;%d;%d;%dm ", 
+					(col*255/AUG_BENCH_COLS + frame*4) % 256, 
+					(row*255/AUG_BENCH_ROWS + frame*2) % 256, 
+					(frame*8) % 256);
+		}
+		bench_buf_printf(bb, "\033[m");
+	}
+}
+
+/* single characters written all over the screen */
+static void fixture_cursor_addressing(struct bench_buf *bb) {
+	int i;
+
+	for(i = 0; i < 200000; i++)
+		bench_buf_printf(bb, "\033[%u;%uH%c", 1 + fixture_rand() % AUG_BENCH_ROWS,
+			1 + fixture_rand() % AUG_BENCH_COLS, 'a' + fixture_rand() % 26);
+}
+
+static const struct bench_fixture g_bench_fixtures[] = {
+	{"cat_log", fixture_cat_log},
+	{"vim_scroll", fixture_vim_scroll},
+	{"htop_redraw", fixture_htop_redraw},
+	{"truecolor", fixture_truecolor},
+	{"cursor_addressing", fixture_cursor_addressing}
+};
+
+static void bench_fixture_gen(const struct bench_fixture *fixture, struct bench_buf *bb) {
+	g_fixture_seed = 1;
+	(*fixture->gen)(bb);
+}
+
+#endif /* AUG_BENCH_FIXTURES_H */
@@ -0,0 +1,116 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ccan/tap/tap.h>
+
+#include "util.h"
+#include "buf_pool.h"
+
+struct aug_test {
+	void (*fn)();
+	int amt;
+};
+
+void test1() {
+	struct aug_buf_pool pool;
+	struct aug_buf_pool_stats stats;
+	char *a, *b;
+
+	diag("++++test1++++");	
+	diag("no memory is used until a buffer is borrowed");
+	
+	buf_pool_init(&pool, 4096, 2);
+	buf_pool_stats(&pool, &stats);
+	ok1(stats.bytes == 0);
+
+	a = buf_pool_get(&pool);
+	b = buf_pool_get(&pool);
+	ok1(a != NULL && b != NULL && a != b);
+	memset(a, 'a', 4096);
+	memset(b, 'b', 4096);
+	buf_pool_stats(&pool, &stats);
+	ok1(stats.n_lent == 2);
+	ok1(stats.bytes == 2*4096);
+
+	diag("returned buffers are lent out again");
+	buf_pool_put(&pool, a);
+	ok1(buf_pool_get(&pool) == a);
+	buf_pool_put(&pool, a);
+	buf_pool_put(&pool, b);
+	buf_pool_stats(&pool, &stats);
+	ok1(stats.n_lent == 0);
+	ok1(stats.n_idle == 2);
+	ok1(stats.peak_lent == 2);
+
+	buf_pool_free(&pool);
+#define TEST1AMT 8
+	diag("----test1----\n#");
+}
+
+void test2() {
+	struct aug_buf_pool pool;
+	struct aug_buf_pool_stats stats;
+	void *bufs[16];
+	int i;
+
+	diag("++++test2++++");	
+	diag("only max_idle buffers are kept after a burst");
+
+	buf_pool_init(&pool, 1024, 3);
+	for(i = 0; i < (int) AUG_ARRAY_SIZE(bufs); i++)
+		bufs[i] = buf_pool_get(&pool);
+	buf_pool_stats(&pool, &stats);
+	ok1(stats.bytes == AUG_ARRAY_SIZE(bufs)*1024);
+
+	for(i = 0; i < (int) AUG_ARRAY_SIZE(bufs); i++)
+		buf_pool_put(&pool, bufs[i]);
+	buf_pool_stats(&pool, &stats);
+	ok1(stats.n_idle == 3);
+	ok1(stats.bytes == 3*1024);
+	ok1(stats.peak_lent == AUG_ARRAY_SIZE(bufs));
+
+	buf_pool_free(&pool);
+#define TEST2AMT 4
+	diag("----test2----\n#");
+}
+
+int main()
+{
+	int i, len, total_tests;
+#define TESTN(_num) {test##_num, TEST##_num##AMT}
+	struct aug_test tests[] = {
+		TESTN(1),
+		TESTN(2)
+	};
+
+	total_tests = 0;
+	len = AUG_ARRAY_SIZE(tests);
+	for(i = 0; i < len; i++) {
+		total_tests += tests[i].amt;
+	}
+
+	plan_tests(total_tests);
+
+	for(i = 0; i < len; i++) {
+		(*tests[i].fn)();
+	}
+
+	return exit_status();
+}
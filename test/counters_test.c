@@ -0,0 +1,233 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <ccan/tap/tap.h>
+
+#include "util.h"
+#include "lock.h"
+#include "counters.h"
+#include "stats_sock.h"
+#include "aug.h"
+
+struct aug_test {
+	void (*fn)();
+	int amt;
+};
+
+static struct {
+	int val;
+	AUG_LOCK_MEMBERS;
+} g_a;
+
+void test1() {
+	struct aug_counters c0, c1;
+	char buf[2048];
+	FILE *f;
+	size_t n;
+
+	diag("++++test1++++");	
+	diag("counters add up and only ever increase");
+	counters_start();
+	counters_read(&c0);
+	counters_add(AUG_COUNTER_PTY_BYTES, 4096);
+	counters_add(AUG_COUNTER_PTY_BYTES, 10);
+	counters_add(AUG_COUNTER_VTERM_PUSHES, 2);
+	counters_add(AUG_COUNTER_FRAMES_RENDERED, 1);
+	counters_add(AUG_COUNTER_INPUT_KEYS, 3);
+	usleep(2000);
+	counters_read(&c1);
+	ok1(c1.pty_bytes - c0.pty_bytes == 4106);
+	ok1(c1.vterm_pushes - c0.vterm_pushes == 2);
+	ok1(c1.frames_rendered - c0.frames_rendered == 1);
+	ok1(c1.input_keys - c0.input_keys == 3);
+	ok1(c1.cells_painted == c0.cells_painted);
+	ok1(c1.primary_pty_bytes == 0);
+	ok1(c1.uptime_usec >= c0.uptime_usec + 2000);
+
+	diag("the dump has one line per counter");
+	if( (f = tmpfile()) == NULL)
+		err_exit(errno, "tmpfile failed");
+	counters_fprint(f, &c1);
+	rewind(f);
+	n = fread(buf, 1, sizeof(buf)-1, f);
+	buf[n] = '\0';
+	fclose(f);
+	ok1(strstr(buf, "pty_bytes 4106\n") != NULL);
+	ok1(strstr(buf, "\nlock_waits ") != NULL);
+
+	diag("levels are set rather than added up");
+	counters_set(AUG_COUNTER_CONGESTION, 3);
+	counters_set(AUG_COUNTER_CONGESTION, 2);
+	counters_read(&c1);
+	ok1(c1.congestion == 2);
+#define TEST1AMT 10
+	diag("----test1----\n#");
+}
+
+static pthread_barrier_t g_held;
+
+/* takes the lock before main does and keeps it until main
+ * is waiting for it */
+static void *hold_a(void *user) {
+	uint64_t waits = *(uint64_t *) user;
+
+	AUG_LOCK(&g_a);
+	pthread_barrier_wait(&g_held);
+	while(counters_get(AUG_COUNTER_LOCK_WAITS) == waits)
+		usleep(1000);
+	g_a.val++;
+	AUG_UNLOCK(&g_a);
+
+	return NULL;
+}
+
+void test2() {
+	uint64_t waits;
+	pthread_t tid;
+
+	diag("++++test2++++");	
+	diag("taking a free lock isnt a wait");
+	AUG_LOCK_INIT(&g_a);
+	waits = counters_get(AUG_COUNTER_LOCK_WAITS);
+	AUG_LOCK(&g_a);
+	AUG_UNLOCK(&g_a);
+	ok1(counters_get(AUG_COUNTER_LOCK_WAITS) == waits);
+
+	diag("waiting for a held lock is counted");
+	AUG_STATUS_EQUAL( pthread_barrier_init(&g_held, NULL, 2), 0 );
+	AUG_STATUS_EQUAL( pthread_create(&tid, NULL, hold_a, &waits), 0 );
+	pthread_barrier_wait(&g_held);
+	AUG_LOCK(&g_a);
+	g_a.val++;
+	AUG_UNLOCK(&g_a);
+	AUG_STATUS_EQUAL( pthread_join(tid, NULL), 0 );
+	ok1(g_a.val == 2);
+	ok1(counters_get(AUG_COUNTER_LOCK_WAITS) == waits + 1);
+
+	AUG_STATUS_EQUAL( pthread_barrier_destroy(&g_held), 0 );
+	AUG_LOCK_FREE(&g_a);
+#define TEST2AMT 3
+	diag("----test2----\n#");
+}
+
+static void dump(FILE *f) {
+	struct aug_counters c;
+
+	counters_read(&c);
+	counters_fprint(f, &c);
+}
+
+/* connect to the socket at @path and read what it sends until
+ * it hangs up. returns -1 if the connection fails. */
+static ssize_t read_sock(const char *path, char *buf, size_t size) {
+	struct sockaddr_un addr;
+	ssize_t n, total;
+	int fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path)-1);
+
+	if( (fd = socket(AF_UNIX, SOCK_STREAM, 0) ) < 0)
+		err_exit(errno, "socket failed");
+	if(connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	total = 0;
+	while( (n = read(fd, buf + total, size - 1 - total) ) > 0)
+		total += n;
+	buf[total] = '\0';
+
+	close(fd);
+	return total;
+}
+
+void test3() {
+	struct aug_stats_sock ss;
+	struct stat st;
+	char dir[] = "/tmp/aug_counters_test.XXXXXX";
+	char path[128], buf[2048];
+	FILE *f;
+
+	diag("++++test3++++");	
+	if(mkdtemp(dir) == NULL)
+		err_exit(errno, "mkdtemp failed");
+	snprintf(path, sizeof(path), "%s/stats", dir);
+
+	diag("each connection to the socket gets a dump");
+	counters_add(AUG_COUNTER_CALLBACKS, 7);
+	ok1(stats_sock_start(&ss, path, dump) == 0);
+	ok1(lstat(path, &st) == 0 && (st.st_mode & 0777) == 0600);
+	ok1(read_sock(path, buf, sizeof(buf)) > 0);
+	ok1(strstr(buf, "callbacks 7\n") != NULL);
+	counters_add(AUG_COUNTER_CALLBACKS, 1);
+	ok1(read_sock(path, buf, sizeof(buf)) > 0);
+	ok1(strstr(buf, "callbacks 8\n") != NULL);
+
+	diag("the socket is removed when it is stopped");
+	stats_sock_stop(&ss);
+	ok1(lstat(path, &st) != 0 && errno == ENOENT);
+	ok1(read_sock(path, buf, sizeof(buf)) < 0);
+
+	diag("a file which isnt a socket isnt replaced");
+	if( (f = fopen(path, "w") ) == NULL)
+		err_exit(errno, "fopen failed");
+	fclose(f);
+	ok1(stats_sock_start(&ss, path, dump) != 0 && errno == EADDRINUSE);
+	ok1(lstat(path, &st) == 0 && S_ISREG(st.st_mode));
+
+	unlink(path);
+	rmdir(dir);
+#define TEST3AMT 10
+	diag("----test3----\n#");
+}
+
+int main()
+{
+	int i, len, total_tests;
+#define TESTN(_num) {test##_num, TEST##_num##AMT}
+	struct aug_test tests[] = {
+		TESTN(1),
+		TESTN(2),
+		TESTN(3)
+	};
+
+	total_tests = 0;
+	len = AUG_ARRAY_SIZE(tests);
+	for(i = 0; i < len; i++) {
+		total_tests += tests[i].amt;
+	}
+
+	plan_tests(total_tests);
+
+	for(i = 0; i < len; i++) {
+		(*tests[i].fn)();
+	}
+
+	return exit_status();
+}
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+
+/* the child process for echo_latency_bench. like toysh but 
+ * without line editing: every byte read is drawn right away in
+ * the top left corner of the screen. with the argument "flood" 
+ * lines are also scrolled through the rest of the screen as fast
+ * as they can be written. exits on ^D. */
+
+static pthread_mutex_t g_out_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static void out(const char *buf, size_t len) {
+	ssize_t n;
+
+	pthread_mutex_lock(&g_out_mtx);
+	while(len > 0) {
+		if( (n = write(STDOUT_FILENO, buf, len) ) < 0) {
+			if(errno == EINTR)
+				continue;
+			exit(1);
+		}
+		buf += n;
+		len -= n;
+	}
+	pthread_mutex_unlock(&g_out_mtx);
+}
+
+static void *flood(void *user) {
+	char buf[256];
+	unsigned long i;
+	int rows, n;
+
+	rows = *(int *) user;
+	for(i = 0; ; i++) {
+		n = snprintf(buf, sizeof(buf), "\0337\033[%d;1H\nflood line %lu "
+			"abcdefghijklmnopqrstuvwxyz abcdefghijklmnopqrstuvwxyz\0338", rows, i);
+		out(buf, n);
+	}
+
+	return NULL;
+}
+
+int main(int argc, char **argv) {
+	struct termios tio;
+	struct winsize size;
+	pthread_t tid;
+	char buf[64], ch;
+	int rows, n;
+
+	if(tcgetattr(STDIN_FILENO, &tio) == 0) {
+		cfmakeraw(&tio);
+		tcsetattr(STDIN_FILENO, TCSANOW, &tio);
+	}
+	rows = 24;
+	if(ioctl(STDIN_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 3)
+		rows = size.ws_row;
+
+	n = snprintf(buf, sizeof(buf), "\033[H\033[2J\033[3;%dr", rows);
+	out(buf, n);
+	if(argc > 1 && strcmp(argv[1], "flood") == 0)
+		if(pthread_create(&tid, NULL, flood, &rows) != 0)
+			return 1;
+
+	while( (n = read(STDIN_FILENO, &ch, 1) ) != 0) {
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			return 1;
+		}
+		if(ch == 0x04)
+			break;
+
+		n = snprintf(buf, sizeof(buf), "\0337\033[1;1H%c\0338", ch);
+		out(buf, n);
+	}
+
+	return 0;
+}
@@ -0,0 +1,256 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#include "bench.h"
+
+/* measures how long a keystroke takes to come back as a glyph on 
+ * the outer terminal. aug runs on a pty with build/echo_child as
+ * its primary child, which draws each byte it reads in the top 
+ * left corner of the screen. a key is written to the outer side 
+ * of the pty and the clock stops when the same character shows up
+ * in what aug writes back. the keys cycle through punctuation 
+ * which neither the escape sequences curses writes nor the
+ * background load contain, and consecutive keys differ so curses
+ * always has to redraw the cell. one key is in flight at a time.
+ * 
+ * each kind of background load is a separate run of aug:
+ *   idle         nothing else going on
+ *   flood        the primary child scrolls lines through the rest 
+ *                of its screen while echoing
+ *   cell_update  the reverse plugin hooks every cell update
+ *   sibling      the busy_term plugin runs a terminal in a panel
+ *                which never stops printing
+ *   sibling16    the same with 16 terminals in a grid, each one 
+ *                staging its cells on its own thread outside the 
+ *                screen lock
+ * usage: echo_latency_bench [-n KEYS] [LOAD ...]
+ * prints one line of JSON per load. set AUG_BENCH_AUG to use an 
+ * aug binary other than ./aug. */
+
+#define ECHO_CHILD "./build/echo_child"
+#define KEY_TIMEOUT_MS 2000
+#define STARTUP_TIMEOUT_MS 10000
+/* time between a key coming back and the next one being sent */
+#define KEY_GAP_MS 10
+
+static const char KEYS[] = "!#$%&*+";
+
+struct load {
+	const char *name;
+	const char *augrc;
+	const char *child_arg;
+};
+
+static const struct load LOADS[] = {
+	{"idle", "[aug]\n", NULL},
+	{"flood", "[aug]\n", "flood"},
+	{"cell_update", "[aug]\n[reverse]\n", NULL},
+	{"sibling", "[aug]\n[busy_term]\n", NULL},
+	{"sibling16", "[aug]\n[busy_term]\nterms = 16 ;\n", NULL}
+};
+
+struct run {
+	pid_t pid;
+	int master;
+	char rcpath[64];
+	char logpath[64];
+};
+
+static void start_aug(struct run *run, const struct load *load) {
+	struct winsize size;
+	const char *aug;
+	FILE *f;
+	int fd;
+
+	snprintf(run->rcpath, sizeof(run->rcpath), "/tmp/aug_bench_rc.XXXXXX");
+	if( (fd = mkstemp(run->rcpath) ) < 0)
+		err_exit(errno, "mkstemp failed");
+	AUG_PTR_NON_NULL( (f = fdopen(fd, "w") ) );
+	fputs(load->augrc, f);
+	fclose(f);
+	snprintf(run->logpath, sizeof(run->logpath), "./build/echo_latency_%s.log", load->name);
+
+	if( (aug = getenv("AUG_BENCH_AUG") ) == NULL)
+		aug = "./aug";
+
+	size.ws_row = AUG_BENCH_ROWS;
+	size.ws_col = AUG_BENCH_COLS;
+	size.ws_xpixel = 0;
+	size.ws_ypixel = 0;
+	run->pid = forkpty(&run->master, NULL, NULL, &size);
+	if(run->pid < 0)
+		err_exit(errno, "forkpty failed");
+	else if(run->pid == 0) {
+		setenv("TERM", AUG_BENCH_TERM, 1);
+		execl(aug, aug, "-c", run->rcpath, 
+			"--plugin-path", "./plugin/reverse:./test/plugin/busy_term",
+			"-d", run->logpath, ECHO_CHILD, load->child_arg, (char *) NULL);
+		fprintf(stderr, "failed to exec %s: %s\n", aug, strerror(errno));
+		_exit(127);
+	}
+
+	if(fcntl(run->master, F_SETFL, O_NONBLOCK) != 0)
+		err_exit(errno, "fcntl failed");
+}
+
+static void stop_aug(struct run *run) {
+	int status, i;
+
+	/* ^D makes echo_child exit, which makes aug exit */
+	if(write(run->master, "\x04", 1) != 1)
+		fprintf(stderr, "failed to write to aug: %s\n", strerror(errno));
+
+	for(i = 0; i < 500; i++) {
+		if(waitpid(run->pid, &status, WNOHANG) == run->pid)
+			goto done;
+		usleep(10000);
+	}
+	fprintf(stderr, "aug did not exit, killing it\n");
+	kill(run->pid, SIGKILL);
+	waitpid(run->pid, &status, 0);
+done:
+	close(run->master);
+	unlink(run->rcpath);
+}
+
+/* reads what aug writes until @ch shows up (returns 0) or 
+ * @timeout_ms passes (returns -1). with @ch < 0 it just reads
+ * for @timeout_ms. */
+static int wait_for(struct run *run, int ch, int timeout_ms) {
+	struct pollfd pfd;
+	char buf[16384];
+	double deadline, left;
+	ssize_t n, i;
+
+	deadline = bench_now() + timeout_ms/1e3;
+	pfd.fd = run->master;
+	pfd.events = POLLIN;
+	while( (left = deadline - bench_now() ) > 0) {
+		if(poll(&pfd, 1, (int) (left*1e3) + 1) < 0) {
+			if(errno == EINTR)
+				continue;
+			err_exit(errno, "poll failed");
+		}
+
+		while( (n = read(run->master, buf, sizeof(buf)) ) > 0) 
+			for(i = 0; ch >= 0 && i < n; i++)
+				if(buf[i] == ch)
+					return 0;
+
+		if(n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR) )
+			return -1; /* aug is gone */
+	}
+
+	return -1;
+}
+
+static int send_key(struct run *run, char key) {
+	while(write(run->master, &key, 1) != 1)
+		if(errno != EINTR && errno != EAGAIN)
+			return -1;
+	return 0;
+}
+
+static void bench_load(FILE *out, const struct load *load, int n_keys) {
+	struct run run;
+	struct bench_samples samples;
+	double t0, max;
+	int i, k, lost, key;
+
+	start_aug(&run, load);
+	bench_samples_init(&samples);
+
+	/* the first echo means aug and the child are up */
+	k = 0;
+	for(i = 0; i < STARTUP_TIMEOUT_MS/200; i++) {
+		key = KEYS[k++ % (sizeof(KEYS)-1)];
+		if(send_key(&run, key) != 0 || wait_for(&run, key, 200) == 0)
+			break;
+	}
+
+	lost = 0;
+	max = 0;
+	for(i = 0; i < n_keys; i++) {
+		key = KEYS[k++ % (sizeof(KEYS)-1)];
+		wait_for(&run, -1, KEY_GAP_MS);
+
+		t0 = bench_now();
+		if(send_key(&run, key) != 0 || wait_for(&run, key, KEY_TIMEOUT_MS) != 0) {
+			lost++;
+			continue;
+		}
+		t0 = bench_now() - t0;
+		if(t0 > max)
+			max = t0;
+		bench_samples_add(&samples, t0);
+	}
+
+	stop_aug(&run);
+
+	fprintf(out, "{\"bench\": \"echo_latency\", \"load\": \"%s\", \"keys\": %d, "
+		"\"lost\": %d, \"usec_p50\": %.1f, \"usec_p90\": %.1f, \"usec_p99\": %.1f, "
+		"\"usec_max\": %.1f}\n",
+		load->name, n_keys, lost, bench_samples_pct(&samples, 50), 
+		bench_samples_pct(&samples, 90), bench_samples_pct(&samples, 99), max*1e6);
+	fflush(out);
+
+	bench_samples_free(&samples);
+}
+
+int main(int argc, char *argv[]) {
+	int i, j, n_keys, ran;
+
+	n_keys = 500;
+	i = 1;
+	if(argc > 2 && strcmp(argv[1], "-n") == 0) {
+		n_keys = atoi(argv[2]);
+		i = 3;
+	}
+
+	ran = 0;
+	for(j = 0; j < (int) AUG_ARRAY_SIZE(LOADS); j++) {
+		if(i < argc) {
+			int k;
+			for(k = i; k < argc; k++)
+				if(strcmp(argv[k], LOADS[j].name) == 0)
+					break;
+			if(k == argc)
+				continue;
+		}
+
+		bench_load(stdout, &LOADS[j], n_keys);
+		ran++;
+	}
+
+	if(ran == 0) {
+		fprintf(stderr, "usage: %s [-n KEYS] [LOAD ...]\nloads:", argv[0]);
+		for(j = 0; j < (int) AUG_ARRAY_SIZE(LOADS); j++)
+			fprintf(stderr, " %s", LOADS[j].name);
+		fprintf(stderr, "\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,179 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <ccan/tap/tap.h>
+
+#include "util.h"
+#include "frame.h"
+
+struct aug_test {
+	void (*fn)();
+	int amt;
+};
+
+void test1() {
+	struct aug_frame frame;
+	struct timeval now;
+
+	diag("++++test1++++");	
+	diag("requests between flushes fold into one frame");
+
+	frame_init(&frame);
+	ok1(frame_requested(&frame) == 0);
+	ok1(frame_request(&frame) == 1);
+	ok1(frame_request(&frame) == 0);
+	ok1(frame_request(&frame) == 0);
+	ok1(frame_requested(&frame) != 0);
+
+	now.tv_sec = 100;
+	now.tv_usec = 0;
+	frame_flushed(&frame, &now);
+	ok1(frame_requested(&frame) == 0);
+	ok1(frame.requests == 3);
+	ok1(frame.flushes == 1);
+
+	diag("the next request has to wake the flusher again");
+	ok1(frame_request(&frame) == 1);
+#define TEST1AMT 9
+	diag("----test1----\n#");
+}
+
+void test2() {
+	struct aug_frame frame;
+	struct timeval now;
+	int i;
+
+	diag("++++test2++++");	
+	diag("flushes per second");
+
+	frame_init(&frame);
+	now.tv_sec = 100;
+	now.tv_usec = 0;
+	/* 20 flushes 50ms apart */
+	for(i = 0; i < 20; i++) {
+		frame_flushed(&frame, &now);
+		now.tv_usec += 50000;
+		if(now.tv_usec >= 1000000) {
+			now.tv_sec++;
+			now.tv_usec -= 1000000;
+		}
+	}
+	ok1(frame_rate(&frame, &now) == 0);
+	frame_flushed(&frame, &now);
+	ok1(frame_rate(&frame, &now) == 20);
+	ok1(frame.flushes == 21);
+
+	diag("the rate drops to zero when nothing is flushed");
+	now.tv_sec += 3;
+	ok1(frame_rate(&frame, &now) == 0);
+#define TEST2AMT 4
+	diag("----test2----\n#");
+}
+
+static void advance(struct timeval *now, long usecs) {
+	struct timeval diff;
+
+	diff.tv_sec = usecs / 1000000;
+	diff.tv_usec = usecs % 1000000;
+	timeradd(now, &diff, now);
+}
+
+void test3() {
+	struct aug_frame frame;
+	struct timeval now, left;
+	int i;
+
+	diag("++++test3++++");	
+	diag("an idle outer terminal takes every frame");
+	frame_init(&frame);
+	now.tv_sec = 100;
+	now.tv_usec = 0;
+	ok1(frame_due(&frame, &now, 0, 1) == 1);
+	frame_drained(&frame, &now, 0, 1000);
+	ok1(frame.congestion == 0);
+	ok1(frame_due(&frame, &now, -1, 1) == 1);
+
+	diag("a full output queue holds off the flush");
+	frame_request(&frame);
+	ok1(frame_due(&frame, &now, AUG_FRAME_OUTQ_MAX + 1, 1) == 0);
+	ok1(frame.congestion == 1);
+	ok1(frame.deferrals == 1);
+	ok1(frame_requested(&frame) != 0);
+	advance(&now, AUG_FRAME_HOLD/2);
+	ok1(frame_due(&frame, &now, 0, 1) == 0);
+	advance(&now, AUG_FRAME_HOLD/2);
+	ok1(frame_due(&frame, &now, 0, 1) == 1);
+
+	diag("slow flushes back off exponentially up to a limit");
+	for(i = 0; i < 2*AUG_FRAME_MAX_CONGESTION; i++)
+		frame_drained(&frame, &now, 0, AUG_FRAME_SLOW_FLUSH + 1);
+	ok1(frame.congestion == AUG_FRAME_MAX_CONGESTION);
+	advance(&now, (AUG_FRAME_HOLD << (AUG_FRAME_MAX_CONGESTION - 1)) - 1);
+	ok1(frame_due(&frame, &now, 0, 1) == 0);
+	advance(&now, 1);
+	ok1(frame_due(&frame, &now, 0, 1) == 1);
+
+	diag("the congestion drains one level per quick flush");
+	frame_drained(&frame, &now, 0, 1000);
+	ok1(frame.congestion == AUG_FRAME_MAX_CONGESTION - 1);
+	for(i = 0; i < AUG_FRAME_MAX_CONGESTION; i++)
+		frame_drained(&frame, &now, 0, 1000);
+	ok1(frame.congestion == 0);
+	ok1(frame_due(&frame, &now, 0, 1) == 1);
+
+	diag("a terminal which wont take more output holds off the flush");
+	ok1(frame_due(&frame, &now, 0, 0) == 0);
+	ok1(frame.congestion == 1);
+	frame_hold_left(&frame, &now, &left);
+	ok1(left.tv_sec == 0 && left.tv_usec == AUG_FRAME_HOLD);
+	advance(&now, AUG_FRAME_HOLD/4);
+	frame_hold_left(&frame, &now, &left);
+	ok1(left.tv_sec == 0 && left.tv_usec == AUG_FRAME_HOLD - AUG_FRAME_HOLD/4);
+	advance(&now, AUG_FRAME_HOLD);
+	frame_hold_left(&frame, &now, &left);
+	ok1(left.tv_sec == 0 && left.tv_usec == 0);
+	ok1(frame_due(&frame, &now, 0, 1) == 1);
+#define TEST3AMT 21
+	diag("----test3----\n#");
+}
+
+int main()
+{
+	int i, len, total_tests;
+#define TESTN(_num) {test##_num, TEST##_num##AMT}
+	struct aug_test tests[] = {
+		TESTN(1),
+		TESTN(2),
+		TESTN(3)
+	};
+
+	total_tests = 0;
+	len = AUG_ARRAY_SIZE(tests);
+	for(i = 0; i < len; i++) {
+		total_tests += tests[i].amt;
+	}
+
+	plan_tests(total_tests);
+
+	for(i = 0; i < len; i++) {
+		(*tests[i].fn)();
+	}
+
+	return exit_status();
+}
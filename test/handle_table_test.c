@@ -0,0 +1,169 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <ccan/tap/tap.h>
+
+#include "util.h"
+#include "handle_table.h"
+
+struct aug_test {
+	void (*fn)();
+	int amt;
+};
+
+static struct aug_handle_table g_table;
+
+void test1() {
+	int a, b;
+	void *ha, *hb;
+
+	diag("++++test1++++");	
+	diag("handles resolve until they are removed");
+	
+	handle_table_init(&g_table);
+	ha = handle_table_add(&g_table, &a);
+	ok1(ha != NULL);
+	ok1(handle_table_get(&g_table, ha) == &a);
+	handle_table_put(&g_table, ha);
+	ok1(handle_table_remove(&g_table, ha) == &a);
+	ok1(handle_table_get(&g_table, ha) == NULL);
+	ok1(handle_table_remove(&g_table, ha) == NULL);
+
+	diag("a reused slot does not resolve the old handle");
+	hb = handle_table_add(&g_table, &b);
+	ok1(hb != NULL && hb != ha);
+	ok1(handle_table_get(&g_table, ha) == NULL);
+	ok1(handle_table_get(&g_table, hb) == &b);
+	handle_table_put(&g_table, hb);
+	ok1(handle_table_remove(&g_table, hb) == &b);
+
+	diag("garbage handles dont resolve");
+	ok1(handle_table_get(&g_table, NULL) == NULL);
+	ok1(handle_table_get(&g_table, (void *) 0xffff) == NULL);
+
+	handle_table_free(&g_table);
+
+#define TEST1AMT 5 + 4 + 2
+	diag("----test1----\n#");
+}
+
+static volatile int g_user_done;
+
+static void *user(void *handle) {
+	AUG_PTR_NON_NULL( handle_table_get(&g_table, handle) );
+	usleep(50000);
+	g_user_done = 1;
+	handle_table_put(&g_table, handle);
+
+	return NULL;
+}
+
+void test2() {
+	int a, b, c;
+	void *ha, *hb, *hc;
+	pthread_t tid;
+
+	diag("++++test2++++");	
+	diag("remove waits for the users of that handle only");
+	
+	handle_table_init(&g_table);
+	ha = handle_table_add(&g_table, &a);
+	hb = handle_table_add(&g_table, &b);
+	hc = handle_table_add(&g_table, &c);
+
+	/* a reference on hb which is never put would hang this test
+	 * if remove waited on other handles */
+	ok1(handle_table_get(&g_table, hb) == &b);
+
+	g_user_done = 0;
+	AUG_STATUS_EQUAL( pthread_create(&tid, NULL, user, ha), 0 );
+	usleep(10000);
+	ok1(handle_table_remove(&g_table, hc) == &c);
+	ok1(handle_table_remove(&g_table, ha) == &a);
+	ok1(g_user_done == 1);
+	AUG_STATUS_EQUAL( pthread_join(tid, NULL), 0 );
+
+	handle_table_put(&g_table, hb);
+	ok1(handle_table_remove(&g_table, hb) == &b);
+	handle_table_free(&g_table);
+
+#define TEST2AMT 5
+	diag("----test2----\n#");
+}
+
+void test3() {
+#define TEST3_OBJS (AUG_HANDLE_TABLE_CHUNK*3 + 5)
+	int objs[TEST3_OBJS];
+	void *handles[TEST3_OBJS];
+	int i, all;
+
+	diag("++++test3++++");	
+	diag("the table grows past one chunk");
+	
+	handle_table_init(&g_table);
+	for(i = 0; i < TEST3_OBJS; i++) 
+		handles[i] = handle_table_add(&g_table, &objs[i]);
+
+	all = 1;
+	for(i = 0; i < TEST3_OBJS; i++) {
+		if(handle_table_get(&g_table, handles[i]) != &objs[i])
+			all = 0;
+		else
+			handle_table_put(&g_table, handles[i]);
+	}
+	ok1(all == 1);
+
+	all = 1;
+	for(i = 0; i < TEST3_OBJS; i++) 
+		if(handle_table_remove(&g_table, handles[i]) != &objs[i])
+			all = 0;
+	ok1(all == 1);
+
+	handle_table_free(&g_table);
+
+#define TEST3AMT 2
+	diag("----test3----\n#");
+}
+
+int main()
+{
+	int i, len, total_tests;
+#define TESTN(_num) {test##_num, TEST##_num##AMT}
+	struct aug_test tests[] = {
+		TESTN(1),
+		TESTN(2),
+		TESTN(3)
+	};
+
+	total_tests = 0;
+	len = AUG_ARRAY_SIZE(tests);
+	for(i = 0; i < len; i++) {
+		total_tests += tests[i].amt;
+	}
+
+	plan_tests(total_tests);
+
+	for(i = 0; i < len; i++) {
+		(*tests[i].fn)();
+	}
+
+	return exit_status();
+}
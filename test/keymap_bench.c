@@ -0,0 +1,123 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "keymap.h"
+
+/* lookups in a keymap with a realistic number of bindings: 
+ * a few dozen single keys (some of them above 255, like the 
+ * keys a plugin might bind to function keys) and a few
+ * sequences.
+ *   binding_ascii  keymap_binding for a bound key below 256
+ *   binding_wide   keymap_binding for a bound key above 255
+ *   binding_miss   keymap_binding for a key that is not bound
+ *   seq_feed       keymap_start followed by keymap_feed for
+ *                  each key of a bound 3 key sequence */
+
+#define ASCII_KEYS 48
+#define WIDE_KEYS 16
+#define SEQS 8
+
+static void on_key(uint32_t ch, void *user) {
+	(void)(ch);
+	(void)(user);
+}
+
+static void run_binding(struct aug_keymap *map, uint32_t base, uint32_t mod, size_t n) {
+	aug_on_key_fn fn;
+	void *user;
+	size_t i;
+
+	for(i = 0; i < n; i++) {
+		keymap_binding(map, base + (i % mod), &fn, &user);
+		/* keep the lookup from being optimized away */
+		__asm__ __volatile__("" : : "r"(fn));
+	}
+}
+
+static void run_binding_ascii(size_t n, void *user) {
+	run_binding(user, 'A', ASCII_KEYS, n);
+}
+
+static void run_binding_wide(size_t n, void *user) {
+	run_binding(user, 0x10000, WIDE_KEYS, n);
+}
+
+static void run_binding_miss(size_t n, void *user) {
+	run_binding(user, 0x20000, WIDE_KEYS, n);
+}
+
+static void run_seq_feed(size_t n, void *user) {
+	struct aug_keymap_state state;
+	struct timeval now;
+	uint32_t seq[3];
+	size_t i;
+
+	gettimeofday(&now, NULL);
+	for(i = 0; i < n; i++) {
+		seq[0] = 0x30000;
+		seq[1] = 'a' + (i % SEQS);
+		seq[2] = 'z';
+		keymap_start(user, &state, &now);
+		if(keymap_feed(user, &state, seq[0], &now) != KEYMAP_NONE
+				|| keymap_feed(user, &state, seq[1], &now) != KEYMAP_NONE
+				|| keymap_feed(user, &state, seq[2], &now) != KEYMAP_COMMAND)
+			err_exit(0, "sequence %zu did not resolve", i % SEQS);
+	}
+}
+
+int main() {
+	static const struct {
+		const char *name;
+		void (*fn)(size_t n, void *user);
+	} cases[] = {
+		{"binding_ascii", run_binding_ascii},
+		{"binding_wide", run_binding_wide},
+		{"binding_miss", run_binding_miss},
+		{"seq_feed", run_seq_feed}
+	};
+	struct aug_keymap map;
+	uint32_t seq[3];
+	char params[32];
+	size_t i, iters;
+	double ns;
+
+	keymap_init(&map);
+	for(i = 0; i < ASCII_KEYS; i++)
+		keymap_bind(&map, 'A' + i, on_key, NULL);
+	for(i = 0; i < WIDE_KEYS; i++)
+		keymap_bind(&map, 0x10000 + i, on_key, NULL);
+	for(i = 0; i < SEQS; i++) {
+		seq[0] = 0x30000;
+		seq[1] = 'a' + i;
+		seq[2] = 'z';
+		if(keymap_bind_seq(&map, seq, 3, on_key, NULL) != 0)
+			err_exit(0, "failed to bind sequence %zu", i);
+	}
+
+	snprintf(params, sizeof(params), "\"bindings\": %zu, ", keymap_size(&map));
+	for(i = 0; i < AUG_ARRAY_SIZE(cases); i++) {
+		ns = bench_ns_per_op(cases[i].fn, &map, &iters);
+		bench_report(stdout, "keymap", cases[i].name, params, ns, iters);
+	}
+
+	keymap_free(&map);
+	return 0;
+}
@@ -175,6 +175,226 @@ void test3() {
 	keymap_free(&map);
 }
 
+static void test4_cb(uint32_t chr, void *user) {
+	(void)(chr);
+	(void)(user);
+}
+
+void test4() {
+	struct aug_keymap map;
+	aug_on_key_fn on_key;
+	void *user;
+	const uint32_t seq_ab[] = {'a', 'b'};
+	const uint32_t seq_ac[] = {'a', 'c'};
+	const uint32_t seq_wide[] = {0x263a, 'x', 0x1f600};
+	const uint32_t seq_long[AUG_KEYMAP_MAX_SEQ+1] = {0};
+
+	keymap_init(&map);
+	diag("++++test4++++");	
+	diag("bind key sequences");
+	ok1(keymap_bind_seq(&map, seq_ab, 2, test4_cb, (void *) 1) == 0);
+	ok1(keymap_bind_seq(&map, seq_ac, 2, test4_cb, (void *) 2) == 0);
+	ok1(keymap_bind_seq(&map, seq_wide, 3, test4_cb, (void *) 3) == 0);
+	ok1(keymap_size(&map) == 3);
+
+	diag("empty and overlong sequences are rejected");
+	ok1(keymap_bind_seq(&map, seq_ab, 0, test4_cb, NULL) != 0);
+	ok1(keymap_bind_seq(&map, seq_long, AUG_KEYMAP_MAX_SEQ+1, test4_cb, NULL) != 0);
+	ok1(keymap_size(&map) == 3);
+
+	diag("look up the sequences");
+	keymap_binding_seq(&map, seq_ac, 2, &on_key, &user);
+	ok1(on_key == test4_cb);
+	ok1(user == (void *) 2);
+	keymap_binding_seq(&map, seq_wide, 3, &on_key, &user);
+	ok1(on_key == test4_cb);
+	ok1(user == (void *) 3);
+
+	diag("a prefix of a sequence is not a binding");
+	keymap_binding(&map, 'a', &on_key, &user);
+	ok1(on_key == NULL);
+	ok1(user == NULL);
+	ok1(keymap_unbind(&map, 'a') != 0);
+
+	diag("a single key can be bound alongside longer sequences");
+	keymap_bind(&map, 'a', test4_cb, (void *) 4);
+	keymap_binding(&map, 'a', &on_key, &user);
+	ok1(user == (void *) 4);
+	ok1(keymap_size(&map) == 4);
+
+	diag("unbind sequences");
+	ok1(keymap_unbind_seq(&map, seq_ab, 2) == 0);
+	ok1(keymap_unbind_seq(&map, seq_ab, 2) != 0);
+	ok1(keymap_unbind_seq(&map, seq_wide, 2) != 0);
+	ok1(keymap_unbind_seq(&map, seq_wide, 3) == 0);
+	ok1(keymap_size(&map) == 2);
+	keymap_binding_seq(&map, seq_ac, 2, &on_key, &user);
+	ok1(user == (void *) 2);
+
+	diag("flags can only be set on bound sequences");
+	ok1(keymap_set_flags(&map, seq_ab, 1, AUG_KEY_SYNC) == 0);
+	ok1(keymap_set_flags(&map, seq_ac, 1, AUG_KEY_SYNC) == 0);
+	ok1(keymap_set_flags(&map, seq_wide, 3, AUG_KEY_SYNC) != 0);
+
+	diag("the unbound sequences are pruned from the trie");
+	ok1(keymap_set_timeout(&map, seq_wide, 1, 10) != 0);
+	ok1(keymap_set_timeout(&map, seq_ac, 1, 10) == 0);
+
+#define TEST4AMT 4 + 3 + 4 + 3 + 2 + 6 + 3 + 2
+	diag("----test4----\n#");
+
+	keymap_free(&map);
+}
+
+static void tv_msecs(struct timeval *tv, int msecs) {
+	tv->tv_sec = 1000 + msecs / 1000;
+	tv->tv_usec = (msecs % 1000) * 1000;
+}
+
+void test5() {
+	struct aug_keymap map;
+	struct aug_keymap_state st;
+	struct timeval now, left;
+	const uint32_t seq_ab[] = {'a', 'b'};
+	const uint32_t seq_wide[] = {0x263a, 0x263b};
+
+	keymap_init(&map);
+	keymap_state_init(&st);
+	diag("++++test5++++");	
+	diag("feed key sequences through the state machine");
+	keymap_bind_seq(&map, seq_ab, 2, test4_cb, (void *) 1);
+	keymap_bind_seq(&map, seq_wide, 2, test4_cb, (void *) 2);
+	keymap_bind(&map, 'c', test4_cb, (void *) 3);
+	keymap_set_flags(&map, seq_wide, 2, AUG_KEY_SYNC);
+	tv_msecs(&now, 0);
+
+	ok1(keymap_active(&st) == 0);
+	keymap_start(&map, &st, &now);
+	ok1(keymap_active(&st) != 0);
+	diag("the key after the command key waits forever by default");
+	ok1(keymap_time_left(&st, &now, &left) != 0);
+	ok1(keymap_feed(&map, &st, 'a', &now) == KEYMAP_NONE);
+	ok1(keymap_active(&st) != 0);
+	ok1(keymap_feed(&map, &st, 'b', &now) == KEYMAP_COMMAND);
+	ok1(keymap_active(&st) == 0);
+	ok1(st.on_key == test4_cb);
+	ok1(st.user == (void *) 1);
+	ok1(st.ch == 'b');
+	ok1(st.flags == 0);
+	ok1(st.again == 0);
+
+	diag("single key binding");
+	keymap_start(&map, &st, &now);
+	ok1(keymap_feed(&map, &st, 'c', &now) == KEYMAP_COMMAND);
+	ok1(st.user == (void *) 3);
+
+	diag("wide key sequence");
+	keymap_start(&map, &st, &now);
+	ok1(keymap_feed(&map, &st, 0x263a, &now) == KEYMAP_NONE);
+	ok1(keymap_feed(&map, &st, 0x263b, &now) == KEYMAP_COMMAND);
+	ok1(st.user == (void *) 2);
+	ok1(st.flags == AUG_KEY_SYNC);
+
+	diag("unbound keys are passed through");
+	keymap_start(&map, &st, &now);
+	ok1(keymap_feed(&map, &st, 'x', &now) == KEYMAP_PASS);
+	ok1(st.len == 1 && st.keys[0] == 'x');
+	ok1(keymap_active(&st) == 0);
+
+	keymap_start(&map, &st, &now);
+	ok1(keymap_feed(&map, &st, 'a', &now) == KEYMAP_NONE);
+	ok1(keymap_feed(&map, &st, 'z', &now) == KEYMAP_PASS);
+	ok1(st.len == 2 && st.keys[0] == 'a' && st.keys[1] == 'z');
+	ok1(st.again == 0);
+
+	diag("unbinding in the middle of a sequence passes it through");
+	keymap_start(&map, &st, &now);
+	ok1(keymap_feed(&map, &st, 'a', &now) == KEYMAP_NONE);
+	keymap_unbind_seq(&map, seq_ab, 2);
+	ok1(keymap_feed(&map, &st, 'b', &now) == KEYMAP_PASS);
+	ok1(st.len == 2 && st.keys[0] == 'a' && st.keys[1] == 'b');
+
+#define TEST5AMT 12 + 2 + 4 + 3 + 4 + 3
+	diag("----test5----\n#");
+
+	keymap_free(&map);
+}
+
+void test6() {
+	struct aug_keymap map;
+	struct aug_keymap_state st;
+	struct timeval now, left;
+	const uint32_t seq_ab[] = {'a', 'b'};
+	const uint32_t seq_xy[] = {'x', 'y'};
+
+	keymap_init(&map);
+	keymap_state_init(&st);
+	diag("++++test6++++");	
+	diag("sequence timeouts");
+	keymap_bind(&map, 'a', test4_cb, (void *) 1);
+	keymap_bind_seq(&map, seq_ab, 2, test4_cb, (void *) 2);
+	keymap_bind_seq(&map, seq_xy, 2, test4_cb, (void *) 3);
+	ok1(keymap_set_timeout(&map, seq_ab, 1, 500) == 0);
+
+	diag("a bound prefix fires when its timeout expires");
+	tv_msecs(&now, 0);
+	keymap_start(&map, &st, &now);
+	ok1(keymap_expire(&map, &st, &now) == KEYMAP_NONE);
+	ok1(keymap_feed(&map, &st, 'a', &now) == KEYMAP_NONE);
+	ok1(keymap_time_left(&st, &now, &left) == 0);
+	ok1(left.tv_sec == 0 && left.tv_usec == 500000);
+	tv_msecs(&now, 499);
+	ok1(keymap_expire(&map, &st, &now) == KEYMAP_NONE);
+	ok1(keymap_active(&st) != 0);
+	tv_msecs(&now, 500);
+	ok1(keymap_time_left(&st, &now, &left) == 0);
+	ok1(left.tv_sec == 0 && left.tv_usec == 0);
+	ok1(keymap_expire(&map, &st, &now) == KEYMAP_COMMAND);
+	ok1(st.user == (void *) 1);
+	ok1(keymap_active(&st) == 0);
+	ok1(keymap_time_left(&st, &now, &left) != 0);
+
+	diag("the longer sequence wins if it arrives in time");
+	tv_msecs(&now, 0);
+	keymap_start(&map, &st, &now);
+	ok1(keymap_feed(&map, &st, 'a', &now) == KEYMAP_NONE);
+	tv_msecs(&now, 499);
+	ok1(keymap_feed(&map, &st, 'b', &now) == KEYMAP_COMMAND);
+	ok1(st.user == (void *) 2);
+
+	diag("a bound prefix fires early if another key arrives");
+	tv_msecs(&now, 0);
+	keymap_start(&map, &st, &now);
+	ok1(keymap_feed(&map, &st, 'a', &now) == KEYMAP_NONE);
+	ok1(keymap_feed(&map, &st, 'q', &now) == KEYMAP_COMMAND);
+	ok1(st.user == (void *) 1);
+	ok1(st.ch == 'a');
+	ok1(st.again != 0);
+
+	diag("an unbound prefix is passed through when it expires");
+	tv_msecs(&now, 0);
+	keymap_start(&map, &st, &now);
+	ok1(keymap_feed(&map, &st, 'x', &now) == KEYMAP_NONE);
+	tv_msecs(&now, AUG_KEYMAP_TIMEOUT - 1);
+	ok1(keymap_expire(&map, &st, &now) == KEYMAP_NONE);
+	tv_msecs(&now, AUG_KEYMAP_TIMEOUT);
+	ok1(keymap_expire(&map, &st, &now) == KEYMAP_PASS);
+	ok1(st.len == 1 && st.keys[0] == 'x');
+
+	diag("a timeout on the command key itself");
+	ok1(keymap_set_timeout(&map, NULL, 0, 2000) == 0);
+	tv_msecs(&now, 0);
+	keymap_start(&map, &st, &now);
+	tv_msecs(&now, 2000);
+	ok1(keymap_expire(&map, &st, &now) == KEYMAP_PASS);
+	ok1(st.len == 0);
+
+#define TEST6AMT 1 + 12 + 3 + 5 + 4 + 3
+	diag("----test6----\n#");
+
+	keymap_free(&map);
+}
+
 int main()
 {
 	int i, len, total_tests;
@@ -182,7 +402,10 @@ int main()
 	struct aug_test tests[] = {
 		TESTN(1),
 		TESTN(2),
-		TESTN(3)
+		TESTN(3),
+		TESTN(4),
+		TESTN(5),
+		TESTN(6)
 	};
 
 	total_tests = 0;
@@ -0,0 +1,273 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <ccan/tap/tap.h>
+
+#include "util.h"
+#include "lock.h"
+#include "counters.h"
+
+struct aug_test {
+	void (*fn)();
+	int amt;
+};
+
+static struct {
+	int val;
+	AUG_LOCK_MEMBERS;
+} g_a, g_b, g_c, g_d, g_e;
+
+static pthread_barrier_t g_held;
+
+/* takes the lock before main does and keeps it for a while
+ * after main starts waiting for it */
+static void *hold_b(void *user) {
+	uint64_t waits = *(uint64_t *) user;
+
+	AUG_LOCK(&g_b);
+	pthread_barrier_wait(&g_held);
+	while(counters_get(AUG_COUNTER_LOCK_WAITS) == waits)
+		usleep(1000);
+	usleep(50000);
+	g_b.val++;
+	AUG_UNLOCK(&g_b);
+
+	return NULL;
+}
+
+static pthread_cond_t g_cond;
+
+static void *lock_e(void *user) {
+	int i;
+	(void)(user);
+
+	for(i = 0; i < 10; i++) {
+		AUG_LOCK(&g_e);
+		g_e.val++;
+		AUG_UNLOCK(&g_e);
+	}
+
+	return NULL;
+}
+
+static void *signal_c(void *user) {
+	(void)(user);
+
+	usleep(50000);
+	AUG_LOCK(&g_c);
+	g_c.val = 1;
+	AUG_STATUS_EQUAL( pthread_cond_signal(&g_cond), 0 );
+	AUG_UNLOCK(&g_c);
+
+	return NULL;
+}
+
+void test1() {
+	struct aug_lock_prof_stats stats;
+	int i;
+
+	diag("++++test1++++");	
+	diag("nothing is recorded while the profiler is off");
+	
+	AUG_LOCK_INIT(&g_a);
+	for(i = 0; i < 10; i++) {
+		AUG_LOCK(&g_a);
+		g_a.val++;
+		AUG_UNLOCK(&g_a);
+	}
+	ok1(lock_prof_stats("&g_a", &stats) == 0);
+	ok1(stats.acquired == 0);
+
+	diag("uncontended acquisitions are counted per site");
+	lock_prof_enable(1);
+	for(i = 0; i < 100; i++) {
+		AUG_LOCK(&g_a);
+		g_a.val++;
+		AUG_UNLOCK(&g_a);
+	}
+	AUG_LOCK(&g_a);
+	g_a.val++;
+	AUG_UNLOCK(&g_a);
+	ok1(lock_prof_stats("&g_a", &stats) == 2);
+	ok1(stats.acquired == 101);
+	ok1(stats.contended == 0);
+	ok1(stats.wait_usec == 0);
+	
+	lock_prof_enable(0);
+	AUG_LOCK_FREE(&g_a);
+
+#define TEST1AMT 2 + 4
+	diag("----test1----\n#");
+}
+
+void test2() {
+	struct aug_lock_prof_stats stats;
+	pthread_t tid;
+	uint64_t waits;
+
+	diag("++++test2++++");	
+	diag("waiting on a held lock is counted as contention");
+	
+	AUG_LOCK_INIT(&g_b);
+	lock_prof_enable(1);
+	waits = counters_get(AUG_COUNTER_LOCK_WAITS);
+	AUG_STATUS_EQUAL( pthread_barrier_init(&g_held, NULL, 2), 0 );
+	AUG_STATUS_EQUAL( pthread_create(&tid, NULL, hold_b, &waits), 0 );
+	pthread_barrier_wait(&g_held);
+	AUG_LOCK(&g_b);
+	g_b.val++;
+	AUG_UNLOCK(&g_b);
+	AUG_STATUS_EQUAL( pthread_join(tid, NULL), 0 );
+	AUG_STATUS_EQUAL( pthread_barrier_destroy(&g_held), 0 );
+	lock_prof_enable(0);
+
+	ok1(g_b.val == 2);
+	lock_prof_stats("&g_b", &stats);
+	ok1(stats.acquired == 2);
+	ok1(stats.contended == 1);
+	diag("waited %llu usecs", (unsigned long long) stats.wait_usec);
+	ok1(stats.wait_usec >= 20000);
+	diag("held %llu usecs", (unsigned long long) stats.hold_usec);
+	ok1(stats.hold_usec >= 40000);
+
+	AUG_LOCK_FREE(&g_b);
+
+#define TEST2AMT 5
+	diag("----test2----\n#");
+}
+
+void test3() {
+	struct aug_lock_prof_stats stats;
+	pthread_t tid;
+
+	diag("++++test3++++");	
+	diag("time spent in a condition wait is not counted as held");
+	
+	AUG_LOCK_INIT(&g_c);
+	AUG_STATUS_EQUAL( pthread_cond_init(&g_cond, NULL), 0 );
+	lock_prof_enable(1);
+	
+	AUG_STATUS_EQUAL( pthread_create(&tid, NULL, signal_c, NULL), 0 );
+	AUG_LOCK(&g_c);
+	while(g_c.val == 0)
+		AUG_COND_WAIT(&g_cond, &g_c);
+	AUG_UNLOCK(&g_c);
+	AUG_STATUS_EQUAL( pthread_join(tid, NULL), 0 );
+	lock_prof_enable(0);
+
+	lock_prof_stats("&g_c", &stats);
+	ok1(stats.acquired == 2);
+	diag("held %llu usecs", (unsigned long long) stats.hold_usec);
+	ok1(stats.hold_usec < 25000);
+
+	AUG_STATUS_EQUAL( pthread_cond_destroy(&g_cond), 0 );
+	AUG_LOCK_FREE(&g_c);
+
+#define TEST3AMT 2
+	diag("----test3----\n#");
+}
+
+void test4() {
+	FILE *f;
+	char line[512];
+	int found;
+
+	diag("++++test4++++");	
+	diag("the dump lists every site which was used");
+	
+	AUG_LOCK_INIT(&g_d);
+	lock_prof_enable(1);
+	AUG_LOCK(&g_d);
+	AUG_UNLOCK(&g_d);
+
+	ok1( (f = tmpfile()) != NULL );
+	lock_prof_dump(f);
+	rewind(f);
+	found = 0;
+	while(fgets(line, sizeof(line), f) != NULL) {
+		diag("%s", line);
+		if(strncmp(line, "&g_d (", 6) == 0 && strstr(line, "acquired 1,") != NULL)
+			found = 1;
+	}
+	ok1(found == 1);
+	fclose(f);
+
+	lock_prof_free();
+	AUG_LOCK_FREE(&g_d);
+
+#define TEST4AMT 2
+	diag("----test4----\n#");
+}
+
+void test5() {
+	struct aug_lock_prof_stats stats;
+	pthread_t tid;
+	int i;
+
+	diag("++++test5++++");	
+	diag("counts of threads which exited stay in the profile");
+	
+	AUG_LOCK_INIT(&g_e);
+	lock_prof_enable(1);
+	for(i = 0; i < 50; i++) {
+		AUG_STATUS_EQUAL( pthread_create(&tid, NULL, lock_e, NULL), 0 );
+		AUG_STATUS_EQUAL( pthread_join(tid, NULL), 0 );
+	}
+	lock_prof_enable(0);
+
+	ok1(g_e.val == 500);
+	lock_prof_stats("&g_e", &stats);
+	ok1(stats.acquired == 500);
+
+	lock_prof_free();
+	AUG_LOCK_FREE(&g_e);
+
+#define TEST5AMT 2
+	diag("----test5----\n#");
+}
+
+int main()
+{
+	int i, len, total_tests;
+#define TESTN(_num) {test##_num, TEST##_num##AMT}
+	struct aug_test tests[] = {
+		TESTN(1),
+		TESTN(2),
+		TESTN(3),
+		TESTN(4),
+		TESTN(5)
+	};
+
+	total_tests = 0;
+	len = AUG_ARRAY_SIZE(tests);
+	for(i = 0; i < len; i++) {
+		total_tests += tests[i].amt;
+	}
+
+	plan_tests(total_tests);
+
+	for(i = 0; i < len; i++) {
+		(*tests[i].fn)();
+	}
+
+	return exit_status();
+}
@@ -0,0 +1,101 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <stdlib.h>
+
+#include "ncurses_test.h"
+
+/* aug draws into a screen which writes to /dev/null and
+ * reads from a pipe which nobody writes to */
+#ifdef initscr
+#	undef initscr
+#endif
+#define initscr() ncurses_test_init("/dev/null")
+
+#ifdef endwin
+#	undef endwin
+#endif
+#define endwin() ncurses_test_end()
+
+#ifdef raw
+#	undef raw
+#endif
+#define raw() OK
+
+/* keep the paste mode sequences out of the test output */
+#ifdef putp
+#	undef putp
+#endif
+#define putp(str) OK
+
+#include "screen.c"
+
+#undef initscr
+#undef endwin
+#undef raw
+#undef putp
+
+#include <ccan/tap/tap.h>
+#include <ccan/array_size/array_size.h>
+
+/* for openpty */
+#include "child.h"
+
+/* runs aug on /bin/sh with the lock_stress plugin, which types
+ * into a few cat terminals and calls into the api from a thread
+ * of its own while the primary terminal prints a flood of lines
+ * (see test/plugin/lock_stress). the plugin checks that every 
+ * round made it through every terminal and that the shell got
+ * to run exit, so a deadlock hangs the test and a lost update
+ * fails it. run it under helgrind or drd (make 
+ * helgrind-lock_stress_test) to check the real locks of the I/O 
+ * loop, the terminals and the screen for races and lock order
+ * violations. */
+
+/* ok1 calls made by the plugin */
+#define STRESS_PLUGIN_TESTS 4
+
+int aug_main(int argc, char *argv[]);
+
+int main(int argc, char *argv[]) {
+	char *args[] = {
+		argv[0], "-c", "./test/lock_stress_augrc", 
+		"--plugin-path", "./test/plugin/lock_stress", 
+		"-d", "./build/lock_stress.log", 
+		"/bin/sh", NULL 
+	};
+	int master, slave;
+	(void)(argc);
+	(void)(nct_printf);
+
+	/* aug takes the terminal settings of its children from 
+	 * stdin, so that has to be a terminal even when the test
+	 * isnt run from one. */
+	if(openpty(&master, &slave, NULL, NULL, NULL) != 0)
+		err_exit(errno, "openpty failed");
+	if(dup2(slave, STDIN_FILENO) == -1)
+		err_exit(errno, "error duping to stdin");
+
+	plan_tests(STRESS_PLUGIN_TESTS + 1);
+	diag("stress the locks of aug from a plugin");
+	ok1(aug_main(ARRAY_SIZE(args)-1, args) == 0);
+	close(master);
+	close(slave);
+
+	return exit_status();
+}
@@ -0,0 +1,235 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <ccan/tap/tap.h>
+
+#include "util.h"
+#include "log.h"
+
+struct aug_test {
+	void (*fn)();
+	int amt;
+};
+
+static char g_path[] = "/tmp/aug_log_test.XXXXXX";
+
+/* send stderr to a fresh file */
+static void capture() {
+	if(freopen(g_path, "w+", stderr) == NULL)
+		err_exit(errno, "failed to redirect stderr");
+}
+
+/* count the lines of what was logged containing @needle */
+static int count_logged(const char *needle) {
+	char line[1024];
+	FILE *f;
+	int n;
+
+	fflush(stderr);
+	if( (f = fopen(g_path, "r")) == NULL)
+		err_exit(errno, "failed to open %s", g_path);
+
+	n = 0;
+	while(fgets(line, sizeof(line), f) != NULL)
+		if(strstr(line, needle) != NULL)
+			n++;
+
+	fclose(f);
+	return n;
+}
+
+static void log_debug(const char *subsys, int i) {
+	struct aug_log_site site;
+
+	log_site_init(&site, AUG_LOG_DEBUG, subsys);
+	if(log_site_enabled(&site))
+		log_site_write(&site, "debug %d\n", i);
+}
+
+void test1() {
+	diag("++++test1++++");	
+	diag("levels can be set per subsystem");
+	ok1(log_level("attr") == AUG_LOG_INFO);
+	ok1(log_set_levels("warn,attr=debug,plug=error") == 0);
+	ok1(log_level("attr") == AUG_LOG_DEBUG);
+	ok1(log_level("plug") == AUG_LOG_ERROR);
+	ok1(log_level("screen") == AUG_LOG_WARN);
+
+	diag("a bad spec changes nothing");
+	ok1(log_set_levels("loud") != 0);
+	ok1(log_set_levels("attr=") != 0);
+	ok1(log_set_levels("=info") != 0);
+	ok1(log_set_levels("info,screen=debug,x") != 0);
+	ok1(log_level("attr") == AUG_LOG_DEBUG);
+	ok1(log_level("screen") == AUG_LOG_WARN);
+
+	diag("messages are written straight away without the writer");
+	capture();
+	log_debug("attr", 1);
+	log_debug("screen", 2);
+	AUG_LOG(AUG_LOG_WARN, "screen", "warn %d\n", 3);
+	ok1(count_logged("attr(") == 1);
+	ok1(count_logged("debug 2") == 0);
+	ok1(count_logged("): warning: warn 3") == 1);
+
+	diag("sites pick up changed levels");
+	ok1(log_set_levels("error") == 0);
+	AUG_LOG(AUG_LOG_WARN, "screen", "warn %d\n", 4);
+	ok1(count_logged("warn 4") == 0);
+	ok1(log_set_levels("info") == 0);
+
+#define TEST1AMT 17
+	diag("----test1----\n#");
+}
+
+static void *log_some(void *user) {
+	int i;
+
+	for(i = 0; i < 5; i++)
+		AUG_LOG(AUG_LOG_INFO, "thread", "%s %d\n", (const char *) user, i);
+
+	return NULL;
+}
+
+static pthread_key_t g_late_key;
+
+/* runs after the log's own destructor has handed its ring over */
+static void log_late(void *user) {
+	log_flush();
+	AUG_LOG(AUG_LOG_INFO, "thread", "%s\n", (const char *) user);
+}
+
+static void *log_at_exit(void *user) {
+	AUG_LOG(AUG_LOG_INFO, "thread", "early\n");
+	AUG_STATUS_EQUAL( pthread_setspecific(g_late_key, user), 0 );
+
+	return NULL;
+}
+
+/* every message comes from the same site */
+static void burst(int n) {
+	int i;
+
+	for(i = 0; i < n; i++)
+		AUG_LOG(AUG_LOG_INFO, "burst", "burst %d\n", i);
+}
+
+void test2() {
+	struct aug_log_stats stats;
+	struct aug_log_site site;
+	pthread_t tid;
+	char big[AUG_LOG_MSG_LEN*2];
+	uint64_t written;
+	time_t t;
+
+	diag("++++test2++++");	
+	log_stats(&stats);
+	written = stats.written;
+	capture();
+	log_init();
+
+	diag("messages from every thread are written by the writer");
+	AUG_STATUS_EQUAL( pthread_create(&tid, NULL, log_some, "other"), 0 );
+	log_some("main");
+	AUG_STATUS_EQUAL( pthread_join(tid, NULL), 0 );
+	log_flush();
+	ok1(count_logged("thread(") == 10);
+	ok1(count_logged("other 4") == 1);
+	ok1(count_logged("main 4") == 1);
+
+	diag("a thread can still log after its ring is handed back");
+	AUG_STATUS_EQUAL( pthread_key_create(&g_late_key, log_late), 0 );
+	AUG_STATUS_EQUAL( pthread_create(&tid, NULL, log_at_exit, "late"), 0 );
+	AUG_STATUS_EQUAL( pthread_join(tid, NULL), 0 );
+	log_flush();
+	ok1(count_logged("early") == 1);
+	ok1(count_logged("late") == 1);
+	AUG_STATUS_EQUAL( pthread_key_delete(g_late_key), 0 );
+
+	diag("long messages are cut short");
+	memset(big, 'x', sizeof(big) - 2);
+	big[sizeof(big) - 2] = '\n';
+	big[sizeof(big) - 1] = '\0';
+	log_site_init(&site, AUG_LOG_INFO, "plugin");
+	ok1(log_site_write(&site, "%s", big) == AUG_LOG_MSG_LEN - 1);
+	log_flush();
+	ok1(count_logged("xxx...") == 1);
+
+	diag("a site logs at most AUG_LOG_SITE_BURST messages per second");
+	/* start the burst at the beginning of a second */
+	for(t = time(NULL); time(NULL) == t; )
+		usleep(1000);
+	usleep(2*AUG_LOG_WRITE_MSECS*1000);
+	burst(AUG_LOG_SITE_BURST + 5);
+	log_flush();
+	ok1(count_logged("burst(") == AUG_LOG_SITE_BURST);
+	log_stats(&stats);
+	ok1(stats.suppressed == 5);
+	ok1(stats.dropped == 0);
+
+	diag("the next message reports how many were suppressed");
+	usleep(1000000);
+	burst(2);
+	log_flush();
+	/* the two messages plus the report */
+	ok1(count_logged("burst(") == AUG_LOG_SITE_BURST + 3);
+	ok1(count_logged("suppressed 5 similar messages") == 1);
+
+	log_free();
+	log_stats(&stats);
+	ok1(stats.written - written == 10 + 2 + 1 + AUG_LOG_SITE_BURST + 2);
+	unlink(g_path);
+
+#define TEST2AMT 13
+	diag("----test2----\n#");
+}
+
+int main()
+{
+	int i, len, total_tests;
+	int fd;
+#define TESTN(_num) {test##_num, TEST##_num##AMT}
+	struct aug_test tests[] = {
+		TESTN(1),
+		TESTN(2)
+	};
+
+	if( (fd = mkstemp(g_path)) < 0)
+		err_exit(errno, "mkstemp failed");
+	close(fd);
+
+	total_tests = 0;
+	len = AUG_ARRAY_SIZE(tests);
+	for(i = 0; i < len; i++) {
+		total_tests += tests[i].amt;
+	}
+
+	plan_tests(total_tests);
+
+	for(i = 0; i < len; i++) {
+		(*tests[i].fn)();
+	}
+
+	return exit_status();
+}
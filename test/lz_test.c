@@ -0,0 +1,139 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ccan/tap/tap.h>
+
+#include "util.h"
+#include "lz.h"
+
+struct aug_test {
+	void (*fn)();
+	int amt;
+};
+
+/* compress @n bytes at @src and decompress them again. returns 
+ * the compressed length, or -1 if they didnt come back the same. */
+static ssize_t round_trip(const char *src, size_t n) {
+	char *comp, *out;
+	size_t comp_len;
+	ssize_t result;
+
+	comp = aug_malloc(lz_bound(n));
+	out = aug_malloc(n + 1);
+	comp_len = lz_compress(src, n, comp);
+	result = -1;
+	if(comp_len <= lz_bound(n)
+			&& lz_decompress(comp, comp_len, out, n + 1) == (ssize_t) n
+			&& memcmp(src, out, n) == 0)
+		result = comp_len;
+
+	free(comp);
+	free(out);
+	return result;
+}
+
+void test1() {
+	char buf[1 << 16];
+	size_t i, n;
+	ssize_t len;
+
+	diag("++++test1++++");
+	diag("empty and tiny inputs");
+	ok1(round_trip("", 0) >= 0);
+	ok1(round_trip("a", 1) >= 0);
+	ok1(round_trip("abcd", 4) >= 0);
+
+	diag("repetitive terminal output shrinks a lot");
+	n = 0;
+	for(i = 0; n + 64 < sizeof(buf); i++)
+		n += sprintf(buf + n, "\033[1;32m$ \033[0mls -l file%zu\r\n", i % 10);
+	len = round_trip(buf, n);
+	ok1(len > 0 && (size_t) len < n/4);
+
+	diag("long runs and overlapping matches");
+	memset(buf, ' ', sizeof(buf));
+	len = round_trip(buf, sizeof(buf));
+	ok1(len > 0 && len < 512);
+
+	diag("random data barely grows");
+	srand(1);
+	for(i = 0; i < sizeof(buf); i++)
+		buf[i] = rand();
+	len = round_trip(buf, sizeof(buf));
+	ok1(len > 0 && (size_t) len <= lz_bound(sizeof(buf)));
+#define TEST1AMT 6
+	diag("----test1----\n#");
+}
+
+void test2() {
+	char src[4096], comp[lz_bound(4096)], out[4096];
+	size_t i, comp_len;
+
+	diag("++++test2++++");
+	for(i = 0; i < sizeof(src); i++)
+		src[i] = "hello terminal "[i % 15];
+	comp_len = lz_compress(src, sizeof(src), comp);
+
+	diag("output which doesnt fit is rejected");
+	ok1(lz_decompress(comp, comp_len, out, sizeof(out) - 1) == -1);
+
+	diag("truncated input is rejected");
+	ok1(lz_decompress(comp, comp_len - 1, out, sizeof(out)) == -1);
+
+	diag("an offset before the start is rejected");
+	comp[0] = 0x10; /* one literal and a match */
+	comp[1] = 'x';
+	comp[2] = 2;
+	comp[3] = 0;
+	ok1(lz_decompress(comp, 4, out, sizeof(out)) == -1);
+	comp[2] = 0;
+	ok1(lz_decompress(comp, 4, out, sizeof(out)) == -1);
+
+	diag("a length which runs off the end is rejected");
+	comp[0] = 0xf0;
+	comp[1] = (char) 255;
+	ok1(lz_decompress(comp, 2, out, sizeof(out)) == -1);
+#define TEST2AMT 5
+	diag("----test2----\n#");
+}
+
+int main()
+{
+	int i, len, total_tests;
+#define TESTN(_num) {test##_num, TEST##_num##AMT}
+	struct aug_test tests[] = {
+		TESTN(1),
+		TESTN(2)
+	};
+
+	total_tests = 0;
+	len = AUG_ARRAY_SIZE(tests);
+	for(i = 0; i < len; i++) {
+		total_tests += tests[i].amt;
+	}
+
+	plan_tests(total_tests);
+
+	for(i = 0; i < len; i++) {
+		(*tests[i].fn)();
+	}
+
+	return exit_status();
+}
@@ -0,0 +1,240 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <ccan/tap/tap.h>
+
+#include "util.h"
+#include "mirror.h"
+#include "session_test.h"
+
+struct aug_test {
+	void (*fn)();
+	int amt;
+};
+
+static void mirror_path(char *path, size_t size) {
+	snprintf(path, size, "/tmp/aug-mirror-test-%d", (int) getpid());
+}
+
+void test1() {
+	struct aug_mirror m, other;
+	struct aug_mirror_hdr hdr;
+	struct aug_mirror_reader r;
+	struct aug_session_view view;
+	VTermRect rect;
+	char path[64];
+	uint64_t seq;
+	int fd;
+
+	diag("++++test1++++");
+	mirror_path(path, sizeof(path));
+	unlink(path);
+	memset(g_screen, 0, sizeof(g_screen));
+	screen_put(1, 2, "hi");
+
+	ok1(mirror_open(&m, path) == 0);
+	ok1(mirror_reader_open(&r, path) == 0);
+	session_view_init(&view);
+
+	diag("nothing to read before the first frame");
+	ok1(mirror_reader_poll(&r, &view) == 0);
+
+	diag("the first frame is the whole screen");
+	mirror_frame(&m, ROWS, COLS, 1, 4, screen_cell, NULL);
+	ok1(mirror_reader_poll(&r, &view) == 1);
+	ok1(view.rows == ROWS && view.cols == COLS);
+	ok1(view.cursor_row == 1 && view.cursor_col == 4);
+	ok1(view_has(&view, 1, 2, "hi"));
+	ok1(dirty_cells(&view) == ROWS*COLS);
+	ok1(mirror_reader_poll(&r, &view) == 0);
+
+	diag("a frame without changes isnt published");
+	seq = m.hdr->seq;
+	mirror_frame(&m, ROWS, COLS, 1, 4, screen_cell, NULL);
+	ok1(m.hdr->seq == seq);
+	ok1(mirror_reader_poll(&r, &view) == 0);
+
+	diag("only damaged cells are copied to the grid");
+	screen_put(3, 8, "yo");
+	screen_put(0, 0, "xx");
+	rect.start_row = 3;
+	rect.end_row = 4;
+	rect.start_col = 8;
+	rect.end_col = 10;
+	mirror_damage(&m, rect);
+	mirror_frame(&m, ROWS, COLS, 3, 9, screen_cell, NULL);
+	ok1(m.hdr->seq == seq + 2);
+	ok1(mirror_reader_poll(&r, &view) == 1);
+	ok1(view_has(&view, 3, 8, "yo"));
+	ok1(!view_has(&view, 0, 0, "xx"));
+	ok1(view.cursor_row == 3 && view.cursor_col == 9);
+	ok1(dirty_cells(&view) == 2);
+
+	diag("a resize republishes everything");
+	mirror_frame(&m, ROWS - 1, COLS, 0, 0, screen_cell, NULL);
+	ok1(mirror_reader_poll(&r, &view) == 1);
+	ok1(view.rows == ROWS - 1 && view_has(&view, 0, 0, "xx"));
+	ok1(dirty_cells(&view) == (ROWS - 1)*COLS);
+
+	diag("a mirror which is still alive isnt replaced");
+	ok1(mirror_open(&other, path) != 0 && errno == EEXIST);
+	ok1(m.hdr->alive == 1 && mirror_reader_poll(&r, &view) == 0);
+
+	diag("observers find out when the publisher goes away");
+	mirror_close(&m);
+	ok1(mirror_reader_poll(&r, &view) == -1);
+	ok1(access(path, F_OK) != 0 && errno == ENOENT);
+	mirror_reader_close(&r);
+
+	diag("other files are neither read nor replaced");
+	fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+	ok1(fd >= 0 && write(fd, path, sizeof(path)) == sizeof(path));
+	close(fd);
+	ok1(mirror_reader_open(&r, path) != 0 && errno == EINVAL);
+	ok1(mirror_open(&m, path) != 0 && errno == EEXIST);
+	ok1(access(path, F_OK) == 0);
+	unlink(path);
+
+	diag("a mirror which was marked dead is replaced");
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = AUG_MIRROR_MAGIC;
+	hdr.version = AUG_MIRROR_VERSION;
+	fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+	ok1(fd >= 0 && write(fd, &hdr, sizeof(hdr)) == sizeof(hdr));
+	close(fd);
+	ok1(mirror_open(&m, path) == 0);
+	ok1(m.hdr->alive == 1);
+	mirror_close(&m);
+
+	session_view_free(&view);
+#define TEST1AMT 31
+	diag("----test1----\n#");
+}
+
+#define FRAMES 2000
+/* big enough that the observer is likely to catch the 
+ * publisher in the middle of a frame */
+#define BIG_ROWS 100
+#define BIG_COLS 200
+
+static void frame_cell(int row, int col, struct aug_session_cell *cell, void *user) {
+	(void)(row);
+	(void)(col);
+
+	memset(cell, 0, sizeof(*cell));
+	cell->ch = *(uint32_t *) user;
+}
+
+static void *publish_frames(void *user) {
+	struct aug_mirror *m;
+	VTermRect rect;
+	uint32_t i;
+
+	m = user;
+	rect.start_row = 0;
+	rect.end_row = BIG_ROWS;
+	rect.start_col = 0;
+	rect.end_col = BIG_COLS;
+	for(i = 1; i <= FRAMES; i++) {
+		mirror_damage(m, rect);
+		mirror_frame(m, BIG_ROWS, BIG_COLS, 0, 0, frame_cell, &i);
+		sched_yield();
+	}
+
+	return NULL;
+}
+
+void test2() {
+	struct aug_mirror m;
+	struct aug_mirror_reader r;
+	struct aug_session_view view;
+	pthread_t thread;
+	char path[64];
+	int i, frames, torn, last, n;
+	uint32_t ch;
+
+	diag("++++test2++++");
+	diag("observers never see a frame which is half written");
+	mirror_path(path, sizeof(path));
+	unlink(path);
+	ok1(mirror_open(&m, path) == 0);
+	ok1(mirror_reader_open(&r, path) == 0);
+	session_view_init(&view);
+
+	ok1(pthread_create(&thread, NULL, publish_frames, &m) == 0);
+	frames = 0;
+	torn = 0;
+	last = 0;
+	do {
+		if(mirror_reader_poll(&r, &view) != 1)
+			continue;
+		frames++;
+		dirty_cells(&view);
+		ch = view.cells[0].ch;
+		for(i = 1; i < BIG_ROWS*BIG_COLS; i++)
+			if(view.cells[i].ch != ch)
+				break;
+		if(i < BIG_ROWS*BIG_COLS || (int) ch < last)
+			torn++;
+		last = ch;
+	} while(last != FRAMES);
+	ok1(pthread_join(thread, NULL) == 0);
+
+	diag("read %d of %d frames", frames, FRAMES);
+	ok1(frames > 0);
+	ok1(torn == 0);
+	n = mirror_reader_poll(&r, &view);
+	ok1(n == 0);
+
+	mirror_close(&m);
+	mirror_reader_close(&r);
+	session_view_free(&view);
+#define TEST2AMT 7
+	diag("----test2----\n#");
+}
+
+int main()
+{
+	int i, len, total_tests;
+#define TESTN(_num) {test##_num, TEST##_num##AMT}
+	struct aug_test tests[] = {
+		TESTN(1),
+		TESTN(2)
+	};
+
+	total_tests = 0;
+	len = AUG_ARRAY_SIZE(tests);
+	for(i = 0; i < len; i++) {
+		total_tests += tests[i].amt;
+	}
+
+	plan_tests(total_tests);
+
+	for(i = 0; i < len; i++) {
+		(*tests[i].fn)();
+	}
+
+	return exit_status();
+}
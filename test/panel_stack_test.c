@@ -239,6 +239,96 @@ int test4() {
 	return 0;
 }
 
+static void fill_panel(PANEL *panel, chtype ch) {
+	WINDOW *win;
+	int rows, cols, y, x;
+
+	win = panel_window(panel);
+	getmaxyx(win, rows, cols);
+	for(y = 0; y < rows; y++)
+		for(x = 0; x < cols; x++)
+			mvwaddch(win, y, x, ch);
+}
+
+static inline chtype screen_ch(int y, int x) {
+	return mvwinch(newscr, y, x) & A_CHARTEXT;
+}
+
+int test5() {
+	int dummy_plugin[2];
+	PANEL *panel, *cover;
+	int size;
+	struct aug_panel_stack_stats stats, prev;
+
+	dummy_plugin[0] = 1;
+	dummy_plugin[1] = 2;
+
+	diag("++++test5++++");
+	diag("test that panel_stack_update composites changes and moves");
+
+	werase(stdscr);
+	mvwaddch(stdscr, 2, 2, 'a');
+	panel_stack_push((struct aug_plugin *) &dummy_plugin[0], 4, 4, 1, 1);
+	panel_stack_top(&panel);
+	RETURN_IF( panel == NULL, -1);
+	fill_panel(panel, 'p');
+
+	panel_stack_update();
+	ok1(screen_ch(2, 2) == 'p');
+	ok1(screen_ch(0, 0) == ' ');
+
+	diag("a change under the panel doesnt show through");
+	mvwaddch(stdscr, 2, 2, 'b');
+	mvwaddch(stdscr, 2, 8, 'c');
+	panel_stack_update();
+	ok1(screen_ch(2, 2) == 'p');
+	ok1(screen_ch(2, 8) == 'c');
+
+	diag("moving the panel exposes what was under it");
+	RETURN_IF( move_panel(panel, 6, 6) == ERR, -1);
+	panel_stack_update();
+	ok1(screen_ch(2, 2) == 'b');
+	ok1(screen_ch(7, 7) == 'p');
+
+	diag("rows hidden under a full width panel are culled");
+	panel_stack_push((struct aug_plugin *) &dummy_plugin[1], 2, COLS, 0, 0);
+	panel_stack_top(&cover);
+	RETURN_IF( cover == NULL, -1);
+	fill_panel(cover, 'q');
+	panel_stack_size(&size);
+	ok1(size == 2);
+	panel_stack_update();
+	panel_stack_stats(&prev);
+	mvwaddch(stdscr, 0, 3, 'd');
+	panel_stack_update();
+	panel_stack_stats(&stats);
+	ok1(stats.culled_rows == prev.culled_rows + 1);
+	ok1(stats.redrawn == prev.redrawn);
+	ok1(screen_ch(0, 3) == 'q');
+
+	diag("hiding the panel shows the culled row");
+	RETURN_IF( hide_panel(cover) == ERR, -1);
+	panel_stack_update();
+	panel_stack_size(&size);
+	ok1(size == 1);
+	ok1(screen_ch(0, 3) == 'd');
+
+	RETURN_IF( show_panel(cover) == ERR, -1);
+	panel_stack_update();
+	ok1(screen_ch(0, 3) == 'q');
+	panel_stack_rm(cover);
+	panel_stack_rm(panel);
+	panel_stack_update();
+	panel_stack_size(&size);
+	ok1(size == 0);
+	ok1(screen_ch(0, 3) == 'd' && screen_ch(7, 7) == ' ');
+
+	panel_stack_free();
+#define TEST5AMT 15
+	diag("----test5----\n#");
+	return 0;
+}
+
 struct aug_test {
 	int (*fn)();
 	int amt;
@@ -253,7 +343,8 @@ int main()
 		TESTN(1),
 		TESTN(2),
 		TESTN(3),
-		TESTN(4)
+		TESTN(4),
+		TESTN(5)
 	};
 	(void)(nct_printf);
 
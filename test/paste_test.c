@@ -0,0 +1,188 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ccan/tap/tap.h>
+
+#include "util.h"
+#include "paste.h"
+
+struct aug_test {
+	void (*fn)();
+	int amt;
+};
+
+/* feed @str into @paste one char at a time. returns the number of
+ * completed pastes and stores the popped keys in @keys. */
+static int feed_str(struct aug_paste *paste, const char *str, char *keys, 
+		size_t keys_size) {
+	uint32_t ch;
+	size_t n;
+	int completed;
+
+	completed = 0;
+	n = 0;
+	for(; *str != '\0'; str++) {
+		if(paste_feed(paste, (unsigned char) *str) == 1)
+			completed++;
+
+		while(paste_key(paste, &ch) == 0 && n+1 < keys_size)
+			keys[n++] = ch;
+	}
+
+	if(paste_release(paste) == 0) 
+		while(paste_key(paste, &ch) == 0 && n+1 < keys_size)
+			keys[n++] = ch;
+
+	keys[n] = '\0';
+	return completed;
+}
+
+void test1() {
+	struct aug_paste paste;
+	char keys[64];
+
+	diag("++++test1++++");	
+	diag("ordinary keys pass straight through");
+	paste_init(&paste);
+	
+	ok1(feed_str(&paste, "echo hi\r", keys, sizeof(keys)) == 0);
+	ok1(strcmp(keys, "echo hi\r") == 0);
+	ok1(paste.in_paste == 0);
+
+	diag("a lone escape is released when the input runs dry");
+	ok1(feed_str(&paste, "\033", keys, sizeof(keys)) == 0);
+	ok1(strcmp(keys, "\033") == 0);
+
+	diag("a partial marker followed by other keys is released in order");
+	ok1(feed_str(&paste, "\033[20x\033[A", keys, sizeof(keys)) == 0);
+	ok1(strcmp(keys, "\033[20x\033[A") == 0);
+
+#define TEST1AMT 3 + 2 + 2
+	diag("----test1----\n#");
+	paste_free(&paste);
+}
+
+void test2() {
+	struct aug_paste paste;
+	char keys[64];
+	static const char body[] = "ls -l\r\033[A\033[201x";
+
+	diag("++++test2++++");	
+	diag("a bracketed paste is collected into the paste buffer");
+	paste_init(&paste);
+
+	ok1(feed_str(&paste, "a\033[200~ls -l\r\033[A\033[201x\033[201~b", keys, 
+			sizeof(keys)) == 1);
+	ok1(strcmp(keys, "ab") == 0);
+	ok1(paste.len == strlen(body) );
+	ok1(memcmp(paste.buf, body, paste.len) == 0);
+	ok1(paste.in_paste == 0);
+
+	diag("paste_clear empties the body");
+	paste_clear(&paste);
+	ok1(paste.len == 0);
+
+#define TEST2AMT 5 + 1
+	diag("----test2----\n#");
+	paste_free(&paste);
+}
+
+void test3() {
+	struct aug_paste paste;
+	char keys[64];
+	uint32_t ch;
+	static const char body[] = "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80";
+
+	diag("++++test3++++");	
+	diag("a paste split across reads stays open and is utf-8 encoded");
+	paste_init(&paste);
+
+	ok1(feed_str(&paste, "\033[200~", keys, sizeof(keys)) == 0);
+	ok1(paste.in_paste != 0);
+	ok1(paste_release(&paste) != 0);
+
+	ok1(paste_feed(&paste, 0xe9) == 0);
+	ok1(paste_feed(&paste, 0x20ac) == 0);
+	ok1(paste_feed(&paste, 0x1f600) == 0);
+	ok1(paste_key(&paste, &ch) != 0);
+
+	ok1(feed_str(&paste, "\033[201~", keys, sizeof(keys)) == 1);
+	ok1(keys[0] == '\0');
+	ok1(paste.len == strlen(body) );
+	ok1(memcmp(paste.buf, body, paste.len) == 0);
+
+#define TEST3AMT 3 + 4 + 4
+	diag("----test3----\n#");
+	paste_free(&paste);
+}
+
+void test4() {
+	struct aug_paste paste;
+	char keys[16];
+	char *big;
+	size_t i, amt;
+
+	diag("++++test4++++");	
+	diag("large pastes grow the buffer");
+	paste_init(&paste);
+
+	amt = 1024*1024;
+	big = malloc(amt + 2*AUG_PASTE_MARKER_LEN + 1);
+	memcpy(big, "\033[200~", AUG_PASTE_MARKER_LEN);
+	for(i = 0; i < amt; i++)
+		big[AUG_PASTE_MARKER_LEN + i] = 'a' + (i % 26);
+	memcpy(big + AUG_PASTE_MARKER_LEN + amt, "\033[201~", AUG_PASTE_MARKER_LEN+1);
+
+	ok1(feed_str(&paste, big, keys, sizeof(keys)) == 1);
+	ok1(keys[0] == '\0');
+	ok1(paste.len == amt);
+	ok1(memcmp(paste.buf, big + AUG_PASTE_MARKER_LEN, amt) == 0);
+
+	free(big);
+#define TEST4AMT 4
+	diag("----test4----\n#");
+	paste_free(&paste);
+}
+
+int main()
+{
+	int i, len, total_tests;
+#define TESTN(_num) {test##_num, TEST##_num##AMT}
+	struct aug_test tests[] = {
+		TESTN(1),
+		TESTN(2),
+		TESTN(3),
+		TESTN(4)
+	};
+
+	total_tests = 0;
+	len = AUG_ARRAY_SIZE(tests);
+	for(i = 0; i < len; i++) {
+		total_tests += tests[i].amt;
+	}
+
+	plan_tests(total_tests);
+
+	for(i = 0; i < len; i++) {
+		(*tests[i].fn)();
+	}
+
+	return exit_status();
+}
@@ -65,6 +65,7 @@ static PANEL *g_pan1, *g_pan2, *g_pan3;
 static struct aug_terminal_win g_pan_twin, g_top_twin;
 static WINDOW *g_pan2_dwin, *g_pan3_dwin;
 static pthread_t g_thread1, g_thread2, g_thread3, g_thread4;
+static pthread_t g_thread5, g_headless_thread;
 
 static void *g_pan_term;
 static int g_pan_term_freed;
@@ -75,6 +76,11 @@ static const char g_vi_msg[] = "zoidberg is a crafty consumer! (\\/)(,;;,)(\\/)"
 static void *g_top_term;
 static char *g_top_term_argv[] = {"./build/toysh", NULL};
 
+static void *g_headless_term;
+static char *g_headless_argv[] = {"/bin/cat", NULL};
+#define HEADLESS_ROWS 6
+#define HEADLESS_COLS 20
+
 /* if called from the main thread (a callback from aug
  * or the init and free functions), this will deadlock
  * if aug called the plugin while it had a lock on the
@@ -881,6 +887,132 @@ static void *thread4(void *user) {
 	return NULL;
 }
 
+static void *headless_io(void *user) {
+	(void)(user);
+
+	(*g_api->terminal_run)(g_plugin, g_headless_term);
+	return NULL;
+}
+
+static void headless_input(const char *str) {
+	int amt, len;
+
+	len = strlen(str);
+	for(amt = 0; amt < len; usleep(10000))
+		amt += (*g_api->terminal_input_chars)(g_plugin, g_headless_term, str+amt, len-amt);
+}
+
+/* wait for @str to show up at the start of @row of the 
+ * headless terminal. returns non-zero if it never does. */
+static int headless_wait(int row, const char *str) {
+	uint32_t buf[4096];
+	size_t n, len, i;
+	int rows, cols, tries;
+
+	len = strlen(str);
+	for(tries = 0; tries < 1000; tries++, usleep(10000)) {
+		n = (*g_api->terminal_snapshot)(g_plugin, g_headless_term, buf, 
+				ARRAY_SIZE(buf), &rows, &cols);
+		if( (size_t) row*cols + len > n)
+			continue;
+
+		for(i = 0; i < len; i++)
+			if(buf[row*cols + i] != (uint32_t) str[i])
+				break;
+		if(i == len)
+			return 0;
+	}
+
+	return -1;
+}
+
+/* returns how many cells of @win hold @ch */
+static int win_count(WINDOW *win, chtype ch) {
+	int row, col, n;
+
+	n = 0;
+	(*g_api->lock_screen)(g_plugin);
+	for(row = 0; row < HEADLESS_ROWS; row++)
+		for(col = 0; col < HEADLESS_COLS; col++)
+			if( (mvwinch(win, row, col) & A_CHARTEXT) == ch)
+				n++;
+	(*g_api->unlock_screen)(g_plugin);
+
+	return n;
+}
+
+static void win_fill(WINDOW *win, chtype ch) {
+	int row, col;
+
+	(*g_api->lock_screen)(g_plugin);
+	for(row = 0; row < HEADLESS_ROWS; row++)
+		for(col = 0; col < HEADLESS_COLS; col++)
+			mvwaddch(win, row, col, ch);
+	(*g_api->unlock_screen)(g_plugin);
+}
+
+static void *thread5(void *user) {
+	struct aug_terminal_win twin;
+	uint32_t buf[4096];
+	int rows, cols;
+	size_t n;
+	(void)(user);
+
+	diag("++++thread5++++");
+	diag("create a headless terminal and feed it output");
+	(*g_api->terminal_new)(g_plugin, NULL, g_headless_argv, &g_headless_term);
+	if(pthread_create(&g_headless_thread, NULL, headless_io, NULL) != 0) {
+		diag("expected to be able to create a thread. abort...");
+		return NULL;
+	}
+	/* the pty echoes the line and then cat writes it back */
+	headless_input("abc\r");
+	ok1(headless_wait(0, "abc") == 0);
+	ok1(headless_wait(1, "abc") == 0);
+
+	diag("a snapshot with no room only reports the dimensions");
+	ok1((*g_api->terminal_snapshot)(g_plugin, g_headless_term, buf, 0, &rows, &cols) == 0);
+	ok1(rows > 2 && cols > 3 && (size_t) cols + 3 <= ARRAY_SIZE(buf));
+
+	diag("a snapshot stops when the buffer is full");
+	n = (*g_api->terminal_snapshot)(g_plugin, g_headless_term, buf, 
+			cols + 3, &rows, &cols);
+	ok1(n == (size_t) cols + 3 && (size_t) rows*cols > n);
+	ok1(buf[0] == 'a' && buf[2] == 'c' && buf[3] == ' ');
+	ok1(buf[cols] == 'a' && buf[cols+1] == 'b' && buf[cols+2] == 'c');
+
+	diag("attaching a window resizes the terminal and paints all of it");
+	(*g_api->lock_screen)(g_plugin);
+	twin.win = newwin(HEADLESS_ROWS, HEADLESS_COLS, 0, 0);
+	(*g_api->unlock_screen)(g_plugin);
+	win_fill(twin.win, 'x');
+	(*g_api->terminal_attach)(g_plugin, g_headless_term, &twin);
+	ok1((*g_api->terminal_snapshot)(g_plugin, g_headless_term, buf, 0, &rows, &cols) == 0);
+	ok1(rows == HEADLESS_ROWS && cols == HEADLESS_COLS);
+	ok1(win_count(twin.win, 'x') == 0);
+	ok1(win_count(twin.win, 'a') == 2 && win_count(twin.win, 'c') == 2);
+
+	diag("detaching the window leaves it alone");
+	(*g_api->terminal_attach)(g_plugin, g_headless_term, NULL);
+	win_fill(twin.win, 'x');
+	headless_input("xyz\r");
+	ok1(headless_wait(3, "xyz") == 0);
+	(*g_api->terminal_refresh)(g_plugin, g_headless_term);
+	usleep(100000);
+	ok1(win_count(twin.win, 'x') == HEADLESS_ROWS*HEADLESS_COLS);
+
+	kill((*g_api->terminal_pid)(g_plugin, g_headless_term), SIGKILL);
+	ok1(pthread_join(g_headless_thread, NULL) == 0);
+	(*g_api->terminal_delete)(g_plugin, g_headless_term);
+
+	(*g_api->lock_screen)(g_plugin);
+	delwin(twin.win);
+	(*g_api->unlock_screen)(g_plugin);
+
+	diag("----thread5----\n#");
+	return NULL;
+}
+
 void top_terminal_cb_free(WINDOW *win, void *user) {
 	static int ran_once = 0;
 	(void)(win);
@@ -1108,6 +1240,12 @@ int aug_plugin_init(struct aug_plugin *plugin, const struct aug_api *api) {
 		return -1;
 	}
 
+	diag("create thread for headless terminal");
+	if(pthread_create(&g_thread5, NULL, thread5, NULL) != 0) {
+		diag("expected to be able to create a thread. abort...");
+		return -1;
+	}
+
 	diag("----plugin_init----\n#");
 
 	return 0;
@@ -1140,6 +1278,7 @@ void aug_plugin_free() {
 	ok1(pthread_join(g_thread4, NULL) == 0);	
 	ok1(pthread_join(g_thread3, NULL) == 0);
 	ok1(pthread_join(g_thread2, NULL) == 0);
+	ok1(pthread_join(g_thread5, NULL) == 0);
 	
 	diag("all threads finished");
 
@@ -0,0 +1,94 @@
+#include "aug_plugin.h"
+#include "aug_api.h"
+
+#include <stdlib.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+/* terminals in panels over the bottom right quarter of the 
+ * screen which run a command that never stops writing (the 
+ * "cmd" key, by default seq). the "terms" key (1 to 
+ * BUSY_TERM_MAX, by default 1) sets how many, tiled in a grid.
+ * used as background load by echo_latency_bench. */
+
+const char aug_plugin_name[] = "busy_term";
+
+AUG_GLOBAL_API_OBJECTS
+
+#define BUSY_TERM_MAX 16
+
+static struct {
+	PANEL *panel;
+	struct aug_terminal_win twin;
+	void *term;
+	pthread_t tid;
+} g_terms[BUSY_TERM_MAX];
+static int g_n;
+static char *g_argv[] = {"/bin/sh", "-c", "seq 1000000000", NULL};
+
+static void *run_term(void *user) {
+	aug_terminal_run(user);
+	return NULL;
+}
+
+int aug_plugin_init(struct aug_plugin *plugin, const struct aug_api *api) {
+	const char *val;
+	int rows, cols, y, x, grid_cols, grid_rows, i;
+
+	AUG_API_INIT(plugin, api);
+
+	if(aug_conf_val(aug_plugin_name, "cmd", &val) == 0)
+		g_argv[2] = (char *) val;
+
+	g_n = 1;
+	if(aug_conf_val(aug_plugin_name, "terms", &val) == 0)
+		g_n = atoi(val);
+	if(g_n < 1 || g_n > BUSY_TERM_MAX) {
+		aug_log("terms must be between 1 and %d\n", BUSY_TERM_MAX);
+		return -1;
+	}
+	for(grid_cols = 1; grid_cols*grid_cols < g_n; grid_cols++)
+		;
+	grid_rows = (g_n + grid_cols - 1)/grid_cols;
+
+	aug_lock_screen();
+	rows = LINES/2;
+	cols = COLS/2;
+	y = LINES - rows;
+	x = COLS - cols;
+	aug_unlock_screen();
+	rows /= grid_rows;
+	cols /= grid_cols;
+	if(rows < 1 || cols < 1)
+		return -1;
+
+	for(i = 0; i < g_n; i++) {
+		aug_screen_panel_alloc(rows, cols, y + (i/grid_cols)*rows, 
+			x + (i%grid_cols)*cols, &g_terms[i].panel);
+		g_terms[i].twin.win = panel_window(g_terms[i].panel);
+		aug_terminal_new(&g_terms[i].twin, g_argv, &g_terms[i].term);
+
+		if(pthread_create(&g_terms[i].tid, NULL, run_term, g_terms[i].term) != 0) {
+			aug_log("failed to create thread\n");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void aug_plugin_free() {
+	pid_t pid;
+	int i;
+
+	for(i = 0; i < g_n; i++) {
+		if( (pid = aug_terminal_pid(g_terms[i].term) ) > 0)
+			kill(pid, SIGKILL);
+		pthread_join(g_terms[i].tid, NULL);
+
+		aug_terminal_delete(g_terms[i].term);
+		aug_screen_panel_dealloc(g_terms[i].panel);
+	}
+}
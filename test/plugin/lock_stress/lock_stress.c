@@ -0,0 +1,207 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "aug_plugin.h"
+#include "aug_api.h"
+
+#include <stdio.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <ccan/tap/tap.h>
+#include <ccan/array_size/array_size.h>
+
+/* drives the locks of a running aug from a plugin thread (see
+ * test/lock_stress_test.c). a few terminals run cat, the first
+ * STRESS_PANELS of them in panels and the rest headless, while the
+ * primary terminal prints a flood of lines. each round the thread
+ * types a line into every terminal, damages the primary terminal,
+ * binds and unbinds a key, draws into a panel and asks for a frame,
+ * and then waits for every terminal to show its line. */
+
+const char aug_plugin_name[] = "lock_stress";
+
+AUG_GLOBAL_API_OBJECTS
+
+#define STRESS_TERMS 4
+#define STRESS_PANELS 2
+#define STRESS_ROUNDS 40
+#define STRESS_PANEL_ROWS 5
+#define STRESS_PANEL_COLS 24
+/* how long to wait for a line to show up, in 10ms tries */
+#define STRESS_WAIT_TRIES 500
+#define STRESS_KEY 'z'
+
+static struct {
+	void *term;
+	PANEL *panel;
+	struct aug_terminal_win twin;
+	pthread_t tid;
+} g_terms[STRESS_TERMS];
+static char *g_cat_argv[] = {"/bin/cat", NULL};
+static pthread_t g_stress_tid;
+static int g_started;
+/* written by the stress thread, read once it was joined */
+static int g_rounds_shown;
+static int g_bind_fails;
+
+static void *run_term(void *user) {
+	aug_terminal_run(user);
+	return NULL;
+}
+
+static void on_key(uint32_t ch, void *user) {
+	(void)(ch);
+	(void)(user);
+}
+
+static void term_input(void *term, const char *str) {
+	size_t amt, len;
+
+	len = strlen(str);
+	for(amt = 0; amt < len; usleep(1000))
+		amt += aug_terminal_input_chars(term, str + amt, len - amt);
+}
+
+static void primary_input(const char *str) {
+	size_t amt, len;
+
+	len = strlen(str);
+	for(amt = 0; amt < len; usleep(1000))
+		amt += aug_primary_input_chars(str + amt, len - amt);
+}
+
+/* wait for a row of @term to start with @str. returns 
+ * non-zero if none does in time. */
+static int term_wait(void *term, const char *str) {
+	uint32_t buf[4096];
+	size_t n, len, i;
+	int rows, cols, row, tries;
+
+	len = strlen(str);
+	for(tries = 0; tries < STRESS_WAIT_TRIES; tries++, usleep(10000)) {
+		n = aug_terminal_snapshot(term, buf, ARRAY_SIZE(buf), &rows, &cols);
+		for(row = 0; (size_t) row*cols + len <= n; row++) {
+			for(i = 0; i < len; i++)
+				if(buf[row*cols + i] != (uint32_t) str[i])
+					break;
+			if(i == len)
+				return 0;
+		}
+	}
+
+	return -1;
+}
+
+/* the update calls dont lock anything, so they go under 
+ * the screen lock like the drawing. */
+static void draw_panel(int round) {
+	WINDOW *win;
+
+	aug_lock_screen();
+	win = panel_window(g_terms[round % STRESS_PANELS].panel);
+	mvwprintw(win, 0, 0, "%d", round);
+	aug_screen_panel_update();
+	aug_screen_doupdate();
+	aug_unlock_screen();
+}
+
+static void *stress(void *user) {
+	char line[32];
+	int round, i, shown;
+	(void)(user);
+
+	primary_input("seq 1 20000\r");
+	for(round = 0; round < STRESS_ROUNDS; round++) {
+		for(i = 0; i < STRESS_TERMS; i++) {
+			snprintf(line, sizeof(line), "t%d r%d\r", i, round);
+			term_input(g_terms[i].term, line);
+		}
+
+		aug_primary_term_damage(0, round + 1, 0, round + 1);
+		if(aug_key_bind(STRESS_KEY, on_key, NULL) != 0)
+			g_bind_fails++;
+		draw_panel(round);
+		if(aug_key_unbind(STRESS_KEY) != 0)
+			g_bind_fails++;
+
+		shown = 1;
+		for(i = 0; i < STRESS_TERMS; i++) {
+			snprintf(line, sizeof(line), "t%d r%d", i, round);
+			if(term_wait(g_terms[i].term, line) != 0)
+				shown = 0;
+		}
+		g_rounds_shown += shown;
+	}
+
+	/* the shell reads this once the flood is done */
+	primary_input("exit\r");
+	return NULL;
+}
+
+int aug_plugin_init(struct aug_plugin *plugin, const struct aug_api *api) {
+	int i;
+
+	AUG_API_INIT(plugin, api);
+
+	for(i = 0; i < STRESS_TERMS; i++) {
+		if(i < STRESS_PANELS) {
+			aug_screen_panel_alloc(STRESS_PANEL_ROWS, STRESS_PANEL_COLS, 
+				i*STRESS_PANEL_ROWS, 0, &g_terms[i].panel);
+			g_terms[i].twin.win = panel_window(g_terms[i].panel);
+			aug_terminal_new(&g_terms[i].twin, g_cat_argv, &g_terms[i].term);
+		}
+		else
+			aug_terminal_new(NULL, g_cat_argv, &g_terms[i].term);
+
+		if(pthread_create(&g_terms[i].tid, NULL, run_term, g_terms[i].term) != 0) {
+			aug_log("failed to create thread\n");
+			return -1;
+		}
+	}
+
+	if(pthread_create(&g_stress_tid, NULL, stress, NULL) != 0) {
+		aug_log("failed to create thread\n");
+		return -1;
+	}
+	g_started = 1;
+
+	return 0;
+}
+
+void aug_plugin_free() {
+	int i, joined;
+
+	if(g_started == 0)
+		return;
+
+	ok1(pthread_join(g_stress_tid, NULL) == 0);
+	ok1(g_rounds_shown == STRESS_ROUNDS);
+	ok1(g_bind_fails == 0);
+
+	joined = 0;
+	for(i = 0; i < STRESS_TERMS; i++) {
+		kill(aug_terminal_pid(g_terms[i].term), SIGKILL);
+		if(pthread_join(g_terms[i].tid, NULL) == 0)
+			joined++;
+		aug_terminal_delete(g_terms[i].term);
+		if(i < STRESS_PANELS)
+			aug_screen_panel_dealloc(g_terms[i].panel);
+	}
+	ok1(joined == STRESS_TERMS);
+}
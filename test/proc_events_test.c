@@ -0,0 +1,153 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <ccan/tap/tap.h>
+
+#include "util.h"
+#include "proc_events.h"
+
+struct aug_test {
+	void (*fn)();
+	int amt;
+};
+
+struct events {
+	int n_usr1;
+	int n_other;
+	pid_t exited;
+	int status;
+};
+
+static void on_signal(int signum, void *user) {
+	struct events *ev = user;
+
+	if(signum == SIGUSR1)
+		ev->n_usr1++;
+	else
+		ev->n_other++;
+}
+
+static void on_child_exit(pid_t pid, int status, void *user) {
+	struct events *ev = user;
+
+	ev->exited = pid;
+	ev->status = status;
+}
+
+static int wait_readable(int fd) {
+	struct pollfd pfd;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	return poll(&pfd, 1, 5000) == 1;
+}
+
+void test1() {
+	struct aug_proc_events pe;
+	struct events ev = {0, 0, 0, 0};
+	sigset_t set;
+
+	diag("++++test1++++");	
+	diag("signals come out of the fd");
+
+	sigemptyset(&set);
+	sigaddset(&set, SIGUSR1);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	if(proc_events_init(&pe, &set) != 0) {
+		skip(4, "no signalfd");
+		goto done;
+	}
+
+	proc_events_dispatch(&pe, on_signal, on_child_exit, &ev);
+	ok1(ev.n_usr1 == 0);
+
+	kill(getpid(), SIGUSR1);
+	ok1(wait_readable(proc_events_fd(&pe)) );
+	proc_events_dispatch(&pe, on_signal, on_child_exit, &ev);
+	ok1(ev.n_usr1 == 1);
+	ok1(ev.n_other == 0);
+
+	proc_events_free(&pe);
+done:
+	pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+#define TEST1AMT 4
+	diag("----test1----\n#");
+}
+
+void test2() {
+	struct aug_proc_events pe;
+	struct events ev = {0, 0, 0, 0};
+	sigset_t set;
+	pid_t pid;
+
+	diag("++++test2++++");	
+	diag("watched children are reaped when they exit");
+
+	sigemptyset(&set);
+	if(proc_events_init(&pe, &set) != 0 || pe.pidfds == 0) {
+		skip(5, "no pidfds");
+		return;
+	}
+
+	if( (pid = fork()) == 0)
+		_exit(3);
+	ok1(pid > 0);
+	ok1(proc_events_watch(&pe, pid) == 0);
+
+	ok1(wait_readable(proc_events_fd(&pe)) );
+	proc_events_dispatch(&pe, on_signal, on_child_exit, &ev);
+	ok1(ev.exited == pid);
+	ok1(WIFEXITED(ev.status) && WEXITSTATUS(ev.status) == 3);
+
+	proc_events_free(&pe);
+#define TEST2AMT 5
+	diag("----test2----\n#");
+}
+
+int main()
+{
+	int i, len, total_tests;
+#define TESTN(_num) {test##_num, TEST##_num##AMT}
+	struct aug_test tests[] = {
+		TESTN(1),
+		TESTN(2)
+	};
+
+	total_tests = 0;
+	len = AUG_ARRAY_SIZE(tests);
+	for(i = 0; i < len; i++) {
+		total_tests += tests[i].amt;
+	}
+
+	plan_tests(total_tests);
+
+	for(i = 0; i < len; i++) {
+		(*tests[i].fn)();
+	}
+
+	return exit_status();
+}
@@ -0,0 +1,244 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <ccan/tap/tap.h>
+
+#include "util.h"
+#include "record.h"
+
+struct aug_test {
+	void (*fn)();
+	int amt;
+};
+
+static void record_path(char *path, size_t size) {
+	snprintf(path, size, "/tmp/aug-record-test-%d", (int) getpid());
+}
+
+static int next_is(struct aug_record_reader *r, uint32_t type, 
+		const void *data, size_t len) {
+	struct aug_record_event ev;
+	const unsigned char *d;
+
+	return record_reader_next(r, &ev, &d) == 1 && ev.type == type 
+		&& ev.len == len && memcmp(d, data, len) == 0;
+}
+
+void test1() {
+	struct aug_recorder rec;
+	struct aug_record_reader r;
+	struct aug_record_event ev;
+	struct aug_record_keyframe kf;
+	struct aug_record_dims dims;
+	const struct aug_session_cell *cells;
+	const unsigned char *data;
+	char path[64];
+	uint32_t ch;
+	int fd;
+
+	diag("++++test1++++");
+	diag("events come back in the order they were recorded");
+	record_path(path, sizeof(path));
+	unlink(path);
+	ok1(record_start(&rec, path, 4, 10) == 0);
+	record_output(&rec, "hi", 2);
+	record_input(&rec, 'x');
+	record_resize(&rec, 4, 10); /* not a change */
+	record_resize(&rec, 5, 12);
+	record_output(&rec, "yo", 2);
+	record_stop(&rec);
+
+	ok1(record_reader_open(&r, path) == 0);
+	ok1(r.n_index == 1);
+	ok1(record_reader_next(&r, &ev, &data) == 1 && ev.type == AUG_RECORD_KEYFRAME);
+	memcpy(&kf, data, sizeof(kf));
+	cells = (const struct aug_session_cell *) (data + sizeof(kf));
+	ok1(kf.rows == 4 && kf.cols == 10 && kf.cursor_row == 0 && kf.cursor_col == 0);
+	ok1(ev.len == sizeof(kf) + 4*10*sizeof(*cells) && cells[0].ch == 0);
+	ok1(next_is(&r, AUG_RECORD_OUTPUT, "hi", 2));
+	ch = 'x';
+	ok1(next_is(&r, AUG_RECORD_INPUT, &ch, sizeof(ch)));
+	dims.rows = 5;
+	dims.cols = 12;
+	ok1(next_is(&r, AUG_RECORD_RESIZE, &dims, sizeof(dims)));
+	ok1(next_is(&r, AUG_RECORD_OUTPUT, "yo", 2));
+	ok1(record_reader_next(&r, &ev, &data) == 0);
+	record_reader_close(&r);
+
+	diag("an existing file is never recorded over");
+	ok1(record_start(&rec, path, 4, 10) != 0 && errno == EEXIST);
+	unlink(path);
+
+	diag("other files arent recordings");
+	fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+	ok1(fd >= 0 && write(fd, path, sizeof(path)) == sizeof(path));
+	close(fd);
+	ok1(record_reader_open(&r, path) != 0 && errno == EINVAL);
+	unlink(path);
+#define TEST1AMT 14
+	diag("----test1----\n#");
+}
+
+#define ROWS 10
+#define COLS 40
+/* enough output for several blocks, but not enough to fill the ring */
+#define LINES 40000
+
+static int same_cell(const struct aug_session_cell *a, const struct aug_session_cell *b) {
+	/* a restored screen has spaces where nothing was drawn */
+	return (a->ch == b->ch || (a->ch <= ' ' && b->ch <= ' ') ) 
+		&& a->attrs == b->attrs;
+}
+
+/* whether @a and @b show the same screen */
+static int same_screen(struct aug_term *a, struct aug_term *b) {
+	struct aug_session_cell ca, cb;
+	VTermScreenCell vcell;
+	VTermPos pos;
+
+	for(pos.row = 0; pos.row < ROWS; pos.row++) {
+		for(pos.col = 0; pos.col < COLS; pos.col++) {
+			vterm_screen_get_cell(vterm_obtain_screen(a->vt), pos, &vcell);
+			session_cell_from_vterm(&vcell, &ca);
+			vterm_screen_get_cell(vterm_obtain_screen(b->vt), pos, &vcell);
+			session_cell_from_vterm(&vcell, &cb);
+			if(!same_cell(&ca, &cb))
+				return 0;
+		}
+	}
+
+	return 1;
+}
+
+void test2() {
+	struct aug_recorder rec;
+	struct aug_record_reader r;
+	struct aug_record_event ev;
+	struct aug_record_keyframe kf;
+	struct aug_term replayed, restored;
+	const unsigned char *data;
+	char path[64], line[64];
+	struct aug_record_index_entry *index;
+	struct aug_record_block_hdr hdr;
+	size_t i, n_index, block;
+	int n, events, fd;
+
+	diag("++++test2++++");
+	record_path(path, sizeof(path));
+	unlink(path);
+	ok1(record_start(&rec, path, ROWS, COLS) == 0);
+	for(i = 0; i < LINES; i++) {
+		n = snprintf(line, sizeof(line), "\033[1mline\033[0m %zu\r\n", i);
+		record_output(&rec, line, n);
+	}
+	record_stop(&rec);
+	ok1(__atomic_load_n(&rec.lost, __ATOMIC_RELAXED) == 0);
+
+	diag("the output is split into blocks");
+	ok1(record_reader_open(&r, path) == 0);
+	n_index = r.n_index;
+	diag("%zu blocks, %lld bytes", n_index, (long long) lseek(r.fd, 0, SEEK_END));
+	ok1(n_index > 2);
+	ok1(record_reader_duration(&r) == r.index[n_index - 1].end_usec);
+
+	diag("a block's keyframe is the screen the events before it left");
+	term_init(&replayed, ROWS, COLS);
+	term_init(&restored, ROWS, COLS);
+	block = n_index/2;
+	events = 0;
+	while(record_reader_next(&r, &ev, &data) == 1 && r.block < block) {
+		if(ev.type == AUG_RECORD_OUTPUT)
+			vterm_push_bytes(replayed.vt, (const char *) data, ev.len);
+		events++;
+	}
+	ok1(events > 0 && ev.type == AUG_RECORD_KEYFRAME);
+	memcpy(&kf, data, sizeof(kf));
+	record_keyframe_restore(&restored, &kf, 
+		(const struct aug_session_cell *) (data + sizeof(kf)) );
+	ok1(same_screen(&replayed, &restored));
+
+	diag("seeking only decodes the block which holds the time");
+	ok1(record_reader_seek(&r, r.index[block].start_usec) == 0);
+	ok1(r.block == block || r.index[r.block].start_usec == r.index[block].start_usec);
+	ok1(record_reader_next(&r, &ev, &data) == 1 && ev.type == AUG_RECORD_KEYFRAME);
+	ok1(record_reader_seek(&r, 0) == 0 && r.block == 0);
+	ok1(record_reader_seek(&r, (uint64_t) -1) == 0 && r.block == n_index - 1);
+
+	diag("a recording which wasnt stopped cleanly is read up to its last whole block");
+	index = malloc(n_index*sizeof(*index));
+	memcpy(index, r.index, n_index*sizeof(*index));
+	record_reader_close(&r);
+	/* cut off right after the last events block, so only the 
+	 * index and trailer are missing */
+	ok1( (fd = open(path, O_RDONLY) ) >= 0);
+	ok1(pread(fd, &hdr, sizeof(hdr), index[n_index - 1].offset) == sizeof(hdr) );
+	close(fd);
+	ok1(truncate(path, index[n_index - 1].offset + sizeof(hdr) + hdr.comp_len) == 0);
+	ok1(record_reader_open(&r, path) == 0);
+	ok1(r.n_index == n_index);
+
+	diag("the index is rebuilt from the block headers, so seeking still works");
+	ok1(memcmp(r.index, index, n_index*sizeof(*index)) == 0);
+	ok1(record_reader_seek(&r, index[block].start_usec) == 0);
+	ok1(r.index[r.block].start_usec == index[block].start_usec);
+	ok1(record_reader_next(&r, &ev, &data) == 1 && ev.type == AUG_RECORD_KEYFRAME);
+	record_reader_close(&r);
+
+	diag("a block which was only partly written is left out");
+	ok1(truncate(path, index[n_index - 1].offset + sizeof(hdr) + 10) == 0);
+	ok1(record_reader_open(&r, path) == 0);
+	ok1(r.n_index == n_index - 1);
+	ok1(memcmp(r.index, index, r.n_index*sizeof(*index)) == 0);
+	record_reader_close(&r);
+	free(index);
+
+	term_free(&replayed);
+	term_free(&restored);
+	unlink(path);
+#define TEST2AMT 25
+	diag("----test2----\n#");
+}
+
+int main()
+{
+	int i, len, total_tests;
+#define TESTN(_num) {test##_num, TEST##_num##AMT}
+	struct aug_test tests[] = {
+		TESTN(1),
+		TESTN(2)
+	};
+
+	total_tests = 0;
+	len = AUG_ARRAY_SIZE(tests);
+	for(i = 0; i < len; i++) {
+		total_tests += tests[i].amt;
+	}
+
+	plan_tests(total_tests);
+
+	for(i = 0; i < len; i++) {
+		(*tests[i].fn)();
+	}
+
+	return exit_status();
+}
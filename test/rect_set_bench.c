@@ -0,0 +1,129 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "rect_set.h"
+
+/* one frame worth of damage: the rectangles are added and then
+ * popped until the set is empty. an iteration is one frame. */
+
+#define PATTERN_RECTS 64
+
+struct damage {
+	struct aug_rect_set rs;
+	struct aug_rect_set_rect rects[PATTERN_RECTS];
+	size_t n;
+};
+
+static const struct {
+	size_t cols, rows;
+} SIZES[] = {
+	{80, 24},
+	{160, 50},
+	{240, 72},
+	{400, 120}
+};
+
+static unsigned int g_seed;
+
+static unsigned int lcg() {
+	g_seed = g_seed*1103515245 + 12345;
+	return (g_seed >> 16) & 0x7fff;
+}
+
+static void add_rect(struct damage *d, size_t col, size_t row, size_t cols, size_t rows) {
+	struct aug_rect_set_rect *r;
+
+	r = &d->rects[d->n++];
+	r->col_start = col;
+	r->row_start = row;
+	r->col_end = (col + cols > d->rs.cols)? d->rs.cols : col + cols;
+	r->row_end = (row + rows > d->rs.rows)? d->rs.rows : row + rows;
+}
+
+/* a few characters typed here and there (a prompt, a status line) */
+static void pattern_sparse(struct damage *d) {
+	int i;
+
+	for(i = 0; i < 8; i++)
+		add_rect(d, lcg() % d->rs.cols, lcg() % d->rs.rows, 1 + lcg() % 3, 1);
+}
+
+/* most lines rewritten, like output scrolling by */
+static void pattern_dense(struct damage *d) {
+	size_t row;
+
+	for(row = 0; row < d->rs.rows && d->n < PATTERN_RECTS; row++)
+		if(lcg() % 4 != 0)
+			add_rect(d, 0, row, d->rs.cols - lcg() % (d->rs.cols/4), 1);
+}
+
+/* the whole screen, like a clear or a resize */
+static void pattern_full(struct damage *d) {
+	add_rect(d, 0, 0, d->rs.cols, d->rs.rows);
+}
+
+static void run(size_t n, void *user) {
+	struct damage *d;
+	struct aug_rect_set_rect rect;
+	size_t i, j;
+
+	d = user;
+	for(i = 0; i < n; i++) {
+		for(j = 0; j < d->n; j++)
+			rect_set_add(&d->rs, d->rects[j].col_start, d->rects[j].row_start, 
+				d->rects[j].col_end, d->rects[j].row_end);
+		while(rect_set_pop(&d->rs, &rect) == 0)
+			;
+	}
+}
+
+int main() {
+	static const struct {
+		const char *name;
+		void (*gen)(struct damage *);
+	} patterns[] = {
+		{"add_pop_sparse", pattern_sparse},
+		{"add_pop_dense", pattern_dense},
+		{"add_pop_full", pattern_full}
+	};
+	struct damage d;
+	char params[64];
+	size_t i, j, iters;
+	double ns;
+
+	for(i = 0; i < AUG_ARRAY_SIZE(SIZES); i++) {
+		for(j = 0; j < AUG_ARRAY_SIZE(patterns); j++) {
+			if(rect_set_init(&d.rs, SIZES[i].cols, SIZES[i].rows) != 0)
+				err_exit(0, "rect_set_init failed");
+			g_seed = 1;
+			d.n = 0;
+			(*patterns[j].gen)(&d);
+
+			ns = bench_ns_per_op(run, &d, &iters);
+			snprintf(params, sizeof(params), "\"cols\": %zu, \"rows\": %zu, \"rects\": %zu, ",
+				SIZES[i].cols, SIZES[i].rows, d.n);
+			bench_report(stdout, "rect_set", patterns[j].name, params, ns, iters);
+			rect_set_free(&d.rs);
+		}
+	}
+
+	return 0;
+}
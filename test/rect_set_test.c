@@ -468,6 +468,53 @@ void test7() {
 	rect_set_free(&rs);
 }
 
+void test8() {
+	struct aug_rect_set rs;
+	struct aug_rect_set_rect r;
+
+	diag("++++test8++++");	
+	diag("shift the set the way a window scrolls");
+	ok1(rect_set_init(&rs, 20, 10) == 0);
+
+	rect_set_add(&rs, 2, 3, 5, 6);
+	rect_set_shift(&rs, 2);
+	ok1(rect_set_pop(&rs, &r) == 0);
+	ok1(r.col_start == 2);
+	ok1(r.col_end == 5);
+	ok1(r.row_start == 1);
+	ok1(r.row_end == 4);
+	ok1(rect_set_pop(&rs, &r) != 0);
+
+	diag("points shifted off the top are dropped");
+	rect_set_add(&rs, 0, 0, 20, 4);
+	rect_set_shift(&rs, 3);
+	ok1(rect_set_pop(&rs, &r) == 0);
+	ok1(r.row_start == 0);
+	ok1(r.row_end == 1);
+	ok1(rect_set_pop(&rs, &r) != 0);
+
+	diag("shift down");
+	rect_set_add(&rs, 0, 8, 20, 10);
+	rect_set_add(&rs, 4, 0, 6, 1);
+	rect_set_shift(&rs, -1);
+	ok1(rect_set_pop(&rs, &r) == 0);
+	ok1(r.col_start == 4 && r.col_end == 6);
+	ok1(r.row_start == 1 && r.row_end == 2);
+	ok1(rect_set_pop(&rs, &r) == 0);
+	ok1(r.col_start == 0 && r.col_end == 20);
+	ok1(r.row_start == 9 && r.row_end == 10);
+	ok1(rect_set_pop(&rs, &r) != 0);
+
+	diag("shifting by the whole height clears the set");
+	rect_set_add(&rs, 0, 0, 20, 10);
+	rect_set_shift(&rs, -10);
+	ok1(rect_set_pop(&rs, &r) != 0);
+
+#define TEST8AMT 1 + 6 + 4 + 7 + 1
+	diag("----test8----\n#");
+	rect_set_free(&rs);
+}
+
 int main()
 {
 	int i, len, total_tests;
@@ -479,7 +526,8 @@ int main()
 		TESTN(4),
 		TESTN(5),
 		TESTN(6),
-		TESTN(7)
+		TESTN(7),
+		TESTN(8)
 	};
 
 	total_tests = 0;
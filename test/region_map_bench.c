@@ -0,0 +1,125 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "region_map.h"
+
+/* laying out 1 to 200 edge windows (spread over the four edges) 
+ * on a 120x400 screen. 
+ *   layout        region_map_layout with a different size each time,
+ *                 so the cached layout is never used
+ *   layout_cached region_map_layout at the same size
+ *   apply         region_map_apply into the same key_regs each time
+ *   delete_push   delete the first edge window and push it again, 
+ *                 as a plugin which toggles its window would */
+
+#define LINES 120
+#define COLUMNS 400
+
+static const int COUNTS[] = {1, 10, 50, 100, 200};
+/* only the addresses are used as keys */
+static char g_keys[200];
+
+static void run_layout(size_t n, void *user) {
+	struct aug_region primary;
+	size_t i;
+
+	(void)(user);
+	for(i = 0; i < n; i++)
+		if(region_map_layout(LINES + (i & 1), COLUMNS, &primary) != 0)
+			err_exit(0, "layout did not fit");
+}
+
+static void run_layout_cached(size_t n, void *user) {
+	struct aug_region primary;
+	size_t i;
+
+	(void)(user);
+	for(i = 0; i < n; i++)
+		if(region_map_layout(LINES, COLUMNS, &primary) != 0)
+			err_exit(0, "layout did not fit");
+}
+
+static void run_apply(size_t n, void *user) {
+	struct aug_region primary;
+	size_t i;
+
+	for(i = 0; i < n; i++)
+		if(region_map_apply(LINES + (i & 1), COLUMNS, (AVL *) user, &primary) != 0)
+			err_exit(0, "apply did not fit");
+}
+
+static void run_delete_push(size_t n, void *user) {
+	size_t i;
+
+	(void)(user);
+	for(i = 0; i < n; i++) {
+		if(region_map_delete(&g_keys[0], NULL) != 0)
+			err_exit(0, "edge window is missing");
+		region_map_push_top(&g_keys[0], NULL, NULL, 1);
+	}
+}
+
+int main() {
+	static const struct {
+		const char *name;
+		void (*fn)(size_t n, void *user);
+	} cases[] = {
+		{"layout", run_layout},
+		{"layout_cached", run_layout_cached},
+		{"apply", run_apply},
+		{"delete_push", run_delete_push}
+	};
+	AVL *key_regs;
+	char params[32];
+	size_t i, j, iters;
+	int k;
+	double ns;
+
+	for(i = 0; i < AUG_ARRAY_SIZE(COUNTS); i++) {
+		region_map_init();
+		for(k = 0; k < COUNTS[i]; k++) {
+			switch(k % 4) {
+			case 0:
+				region_map_push_top(&g_keys[k], NULL, NULL, 1);
+				break;
+			case 1:
+				region_map_push_bot(&g_keys[k], NULL, NULL, 1);
+				break;
+			case 2:
+				region_map_push_left(&g_keys[k], NULL, NULL, 1);
+				break;
+			default:
+				region_map_push_right(&g_keys[k], NULL, NULL, 1);
+			}
+		}
+
+		snprintf(params, sizeof(params), "\"windows\": %d, ", COUNTS[i]);
+		for(j = 0; j < AUG_ARRAY_SIZE(cases); j++) {
+			key_regs = region_map_key_regs_alloc();
+			ns = bench_ns_per_op(cases[j].fn, key_regs, &iters);
+			bench_report(stdout, "region_map", cases[j].name, params, ns, iters);
+			region_map_key_regs_free(key_regs);
+		}
+		region_map_free();
+	}
+
+	return 0;
+}
@@ -21,6 +21,7 @@
 #include <ccan/tap/tap.h>
 
 #include "util.h"
+#include "timer.h"
 #include "region_map.h"
 
 struct aug_test {
@@ -81,8 +82,8 @@ void test2() {
 	key_regs = region_map_key_regs_alloc();
 	ok1(key_regs != NULL);
 
-	region_map_push_top(k1, 3);
-	region_map_push_top(k2, 14);
+	region_map_push_top(k1, NULL, NULL, 3);
+	region_map_push_top(k2, NULL, NULL, 14);
 
 	ok1(region_map_apply(1, 1, key_regs, &primary) == 0);
 	ok1(avl_count(key_regs) == 2);
@@ -183,8 +184,8 @@ void test3() {
 	key_regs = region_map_key_regs_alloc();
 	ok1(key_regs != NULL);
 
-	region_map_push_top(k1, 3);
-	region_map_push_top(k2, 14);
+	region_map_push_top(k1, NULL, NULL, 3);
+	region_map_push_top(k2, NULL, NULL, 14);
 
 	ok1(region_map_apply(lines, columns, key_regs, &primary) == 0);
 	ok1(avl_count(key_regs) == 2);
@@ -208,7 +209,7 @@ void test3() {
 	
 	region_map_key_regs_clear(&key_regs);
 
-	region_map_push_top(k3, 9);
+	region_map_push_top(k3, NULL, NULL, 9);
 
 	ok1(region_map_apply(lines, columns, key_regs, &primary) == 0);
 	ok1(avl_count(key_regs) == 3);
@@ -238,9 +239,9 @@ void test3() {
 	
 	region_map_key_regs_clear(&key_regs);
 
-	ok1(region_map_delete((void *)5) == -1);
+	ok1(region_map_delete((void *)5, NULL) == -1);
 	ok1(region_map_top_size() == 3);
-	ok1(region_map_delete(k2) == 0);
+	ok1(region_map_delete(k2, NULL) == 0);
 	ok1(region_map_top_size() == 2);
 	ok1(avl_count(key_regs) == 0);
 
@@ -266,7 +267,7 @@ void test3() {
 	
 	region_map_key_regs_clear(&key_regs);
 
-	region_map_push_top(k2, 8);
+	region_map_push_top(k2, NULL, NULL, 8);
 	ok1(region_map_top_size() == 3);
 
 	ok1(region_map_apply(lines, columns, key_regs, &primary) == 0);
@@ -321,9 +322,9 @@ void test4() {
 	key_regs = region_map_key_regs_alloc();
 	ok1(key_regs != NULL);
 
-	region_map_push_top(k1, 3);
-	region_map_push_top(k2, 14);
-	region_map_push_top(k2, 7);
+	region_map_push_top(k1, NULL, NULL, 3);
+	region_map_push_top(k2, NULL, NULL, 14);
+	region_map_push_top(k2, NULL, NULL, 7);
 
 	ok1(region_map_apply(lines, columns, key_regs, &primary) == 0);
 	ok1(avl_count(key_regs) == 2);
@@ -370,9 +371,9 @@ void test5() {
 	key_regs = region_map_key_regs_alloc();
 	ok1(key_regs != NULL);
 
-	region_map_push_top(k1, 10);
-	region_map_push_top(k2, 15);
-	region_map_push_top(k3, 10);
+	region_map_push_top(k1, NULL, NULL, 10);
+	region_map_push_top(k2, NULL, NULL, 15);
+	region_map_push_top(k3, NULL, NULL, 10);
 
 	ok1(region_map_apply(lines, columns, key_regs, &primary) == 0);
 	ok1(avl_count(key_regs) == 3);
@@ -424,9 +425,9 @@ void test6() {
 	key_regs = region_map_key_regs_alloc();
 	ok1(key_regs != NULL);
 
-	region_map_push_top(k1, 10);
-	region_map_push_bot(k2, 15);
-	region_map_push_top(k3, 10);
+	region_map_push_top(k1, NULL, NULL, 10);
+	region_map_push_bot(k2, NULL, NULL, 15);
+	region_map_push_top(k3, NULL, NULL, 10);
 
 	ok1(region_map_apply(lines, columns, key_regs, &primary) == 0);
 	ok1(avl_count(key_regs) == 3);
@@ -478,9 +479,9 @@ void test7() {
 	key_regs = region_map_key_regs_alloc();
 	ok1(key_regs != NULL);
 
-	region_map_push_top(k1, 10);
-	region_map_push_bot(k2, 15);
-	region_map_push_top(k3, 1);
+	region_map_push_top(k1, NULL, NULL, 10);
+	region_map_push_bot(k2, NULL, NULL, 15);
+	region_map_push_top(k3, NULL, NULL, 1);
 
 	ok1(region_map_apply(lines, columns, key_regs, &primary) == 0);
 	ok1(avl_count(key_regs) == 3);
@@ -533,9 +534,9 @@ void test8() {
 	key_regs = region_map_key_regs_alloc();
 	ok1(key_regs != NULL);
 
-	region_map_push_bot(k1, 10);
-	region_map_push_bot(k2, 15);
-	region_map_push_bot(k3, 4);
+	region_map_push_bot(k1, NULL, NULL, 10);
+	region_map_push_bot(k2, NULL, NULL, 15);
+	region_map_push_bot(k3, NULL, NULL, 4);
 
 	ok1(region_map_apply(lines, columns, key_regs, &primary) == 0);
 	ok1(avl_count(key_regs) == 3);
@@ -589,11 +590,11 @@ void test9() {
 	key_regs = region_map_key_regs_alloc();
 	ok1(key_regs != NULL);
 
-	region_map_push_bot(k1, 10);
-	region_map_push_bot(k2, 9);
-	region_map_push_bot(k3, 4);
+	region_map_push_bot(k1, NULL, NULL, 10);
+	region_map_push_bot(k2, NULL, NULL, 9);
+	region_map_push_bot(k3, NULL, NULL, 4);
 
-	region_map_push_top(k4, 3);
+	region_map_push_top(k4, NULL, NULL, 3);
 
 	ok1(region_map_apply(lines, columns, key_regs, &primary) == 0);
 	ok1(avl_count(key_regs) == 4);
@@ -653,11 +654,11 @@ void test10() {
 	key_regs = region_map_key_regs_alloc();
 	ok1(key_regs != NULL);
 
-	region_map_push_bot(k1, 10);
-	region_map_push_bot(k2, 9);
-	region_map_push_left(k3, 4);
+	region_map_push_bot(k1, NULL, NULL, 10);
+	region_map_push_bot(k2, NULL, NULL, 9);
+	region_map_push_left(k3, NULL, NULL, 4);
 
-	region_map_push_top(k4, 3);
+	region_map_push_top(k4, NULL, NULL, 3);
 
 	ok1(region_map_apply(lines, columns, key_regs, &primary) == 0);
 	ok1(avl_count(key_regs) == 4);
@@ -720,15 +721,15 @@ void test11() {
 	key_regs = region_map_key_regs_alloc();
 	ok1(key_regs != NULL);
 
-	region_map_push_bot(k1, 5);
-	region_map_push_bot(k5, 5);
-	region_map_push_bot(k6, 5);
+	region_map_push_bot(k1, NULL, NULL, 5);
+	region_map_push_bot(k5, NULL, NULL, 5);
+	region_map_push_bot(k6, NULL, NULL, 5);
 
-	region_map_push_left(k2, 9);
-	region_map_push_left(k3, 4);
+	region_map_push_left(k2, NULL, NULL, 9);
+	region_map_push_left(k3, NULL, NULL, 4);
 
-	region_map_push_top(k4, 8);
-	region_map_push_top(k7, 7);
+	region_map_push_top(k4, NULL, NULL, 8);
+	region_map_push_top(k7, NULL, NULL, 7);
 
 	ok1(region_map_apply(lines, columns, key_regs, &primary) == 0);
 	ok1(avl_count(key_regs) == 7);
@@ -804,15 +805,15 @@ void test12() {
 	key_regs = region_map_key_regs_alloc();
 	ok1(key_regs != NULL);
 
-	region_map_push_bot(k1, 10);
+	region_map_push_bot(k1, NULL, NULL, 10);
 
-	region_map_push_left(k5, 10);
-	region_map_push_left(k6, 10);
-	region_map_push_left(k2, 10);
-	region_map_push_left(k3, 10);
-	region_map_push_left(k4, 4);
+	region_map_push_left(k5, NULL, NULL, 10);
+	region_map_push_left(k6, NULL, NULL, 10);
+	region_map_push_left(k2, NULL, NULL, 10);
+	region_map_push_left(k3, NULL, NULL, 10);
+	region_map_push_left(k4, NULL, NULL, 4);
 
-	region_map_push_top(k7, 5);
+	region_map_push_top(k7, NULL, NULL, 5);
 
 	ok1(region_map_apply(lines, columns, key_regs, &primary) == 0);
 	ok1(avl_count(key_regs) == 7);
@@ -898,16 +899,16 @@ void test13() {
 	key_regs = region_map_key_regs_alloc();
 	ok1(key_regs != NULL);
 
-	region_map_push_top(k1, 3);
-	region_map_push_bot(k2, 1);
-	region_map_push_bot(k3, 4);
-	region_map_push_left(k4, 1);
-	region_map_push_left(k5, 10);
-	region_map_push_left(k6, 3);
-	region_map_push_right(k7, 5);
-	region_map_push_right(k8, 2);
-	region_map_push_right(k9, 2);
-	region_map_push_right(k10, 1);
+	region_map_push_top(k1, NULL, NULL, 3);
+	region_map_push_bot(k2, NULL, NULL, 1);
+	region_map_push_bot(k3, NULL, NULL, 4);
+	region_map_push_left(k4, NULL, NULL, 1);
+	region_map_push_left(k5, NULL, NULL, 10);
+	region_map_push_left(k6, NULL, NULL, 3);
+	region_map_push_right(k7, NULL, NULL, 5);
+	region_map_push_right(k8, NULL, NULL, 2);
+	region_map_push_right(k9, NULL, NULL, 2);
+	region_map_push_right(k10, NULL, NULL, 1);
 
 	ok1(region_map_apply(lines, columns, key_regs, &primary) == 0);
 	ok1(avl_count(key_regs) == 10);
@@ -985,9 +986,9 @@ void test13() {
 
 	region_map_key_regs_clear(&key_regs);
 	
-	region_map_delete(k2);
-	region_map_delete(k5);
-	region_map_delete(k8);
+	region_map_delete(k2, NULL);
+	region_map_delete(k5, NULL);
+	region_map_delete(k8, NULL);
 
 	ok1(region_map_apply(lines, columns, key_regs, &primary) == 0);
 	ok1(avl_count(key_regs) == 7);
@@ -1051,6 +1052,206 @@ void test13() {
 	region_map_free();
 }
 
+/* returns the number of microseconds since @tmr was started */
+static long elapsed_usecs(struct aug_timer *tmr) {
+	struct timeval elapsed;
+
+	AUG_STATUS_EQUAL( timer_elapsed(tmr, &elapsed), 0 );
+	return elapsed.tv_sec*1000000L + elapsed.tv_usec;
+}
+
+#define TEST14_WINS 4000
+void test14() {
+	AVL *key_regs;
+	struct aug_region primary, cached;
+	struct aug_region *val;
+	const struct aug_region *reg;
+	struct aug_edgewin *ew;
+	struct aug_timer tmr;
+	long first, again;
+	int lines, columns, i, all_same, deleted;
+	
+	lines = 5000;
+	columns = 5000;
+
+	diag("++++test14++++");	
+	diag("lots of edge windows");
+	region_map_init();
+	
+	/* keys start at 1, NULL isnt a key */
+	for(i = 1; i <= TEST14_WINS; i++) {
+		switch(i % 4) {
+		case 0:
+			region_map_push_top( (void *) (intptr_t) i, NULL, NULL, 1);
+			break;
+		case 1:
+			region_map_push_bot( (void *) (intptr_t) i, NULL, NULL, 1);
+			break;
+		case 2:
+			region_map_push_left( (void *) (intptr_t) i, NULL, NULL, 1);
+			break;
+		default:
+			region_map_push_right( (void *) (intptr_t) i, NULL, NULL, 1);
+		}
+	}
+	ok1(region_map_count() == TEST14_WINS);
+	ok1(region_map_top_size() == TEST14_WINS/4);
+	ok1(region_map_right_size() == TEST14_WINS/4);
+
+	AUG_STATUS_EQUAL( timer_init(&tmr), 0 );
+	ok1(region_map_layout(lines, columns, &primary) == 0);
+	first = elapsed_usecs(&tmr);
+
+	AUG_STATUS_EQUAL( timer_init(&tmr), 0 );
+	for(i = 0; i < 1000; i++) 
+		region_map_layout(lines, columns, &cached);
+	again = elapsed_usecs(&tmr);
+	diag("layout of %d windows: %ld usecs, 1000 cached layouts: %ld usecs", 
+		TEST14_WINS, first, again);
+
+	ok1(primary.rows == lines - TEST14_WINS/2);
+	ok1(primary.cols == columns - TEST14_WINS/2);
+	ok1(primary.y == TEST14_WINS/4);
+	ok1(primary.x == TEST14_WINS/4);
+	ok1(cached.rows == primary.rows && cached.cols == primary.cols 
+		&& cached.y == primary.y && cached.x == primary.x);
+
+	ew = region_map_get(3);
+	reg = &ew->region;
+	ok1(ew->owner == (void *) 4);
+	ok1(region_map_lookup((void *) 4, NULL) == ew);
+	ok1(reg->rows == 1 && reg->cols == columns && reg->y == 0 && reg->x == 0);
+
+	diag("applying twice reuses the regions in key_regs");
+	key_regs = region_map_key_regs_alloc();
+	ok1(region_map_apply(lines, columns, key_regs, &primary) == 0);
+	ok1(avl_count(key_regs) == TEST14_WINS);
+	val = avl_lookup(key_regs, (void *) 3);
+	ok1(region_map_apply(lines, columns, key_regs, &primary) == 0);
+	ok1(avl_count(key_regs) == TEST14_WINS);
+	ok1(avl_lookup(key_regs, (void *) 3) == val);
+	ok1(val->cols == 1 && val->x == columns-1);
+
+	diag("deleting every other window");
+	AUG_STATUS_EQUAL( timer_init(&tmr), 0 );
+	deleted = 0;
+	for(i = 2; i <= TEST14_WINS; i += 2)
+		if(region_map_delete( (void *) (intptr_t) i, NULL) == 0)
+			deleted++;
+	diag("%d deletes: %ld usecs", TEST14_WINS/2, elapsed_usecs(&tmr) );
+	ok1(deleted == TEST14_WINS/2);
+	ok1(region_map_delete( (void *) 2, NULL) == -1);
+	ok1(region_map_lookup((void *) 2, NULL) == NULL);
+	ok1(region_map_count() == TEST14_WINS/2);
+	ok1(region_map_top_size() == 0);
+	ok1(region_map_left_size() == 0);
+	ok1(region_map_bot_size() == TEST14_WINS/4);
+
+	ok1(region_map_layout(lines, columns, &primary) == 0);
+	ok1(primary.rows == lines - TEST14_WINS/4);
+	ok1(primary.cols == columns - TEST14_WINS/4);
+	all_same = 1;
+	for(i = 0; i < (int) region_map_count(); i++) {
+		ew = region_map_get(i);
+		if( ( (intptr_t) ew->owner) % 2 != 1)
+			all_same = 0;
+	}
+	ok(all_same, "only odd keys are left");
+
+	region_map_key_regs_free(key_regs);
+#define TEST14AMT 3 + 1 + 5 + 3 + 6 + 1 + 6 + 3 + 1
+	diag("----test14----\n#");
+	region_map_free();
+}
+
+static void window_a(WINDOW *win, void *user) { (void)(win); (void)(user); }
+static void window_b(WINDOW *win, void *user) { (void)(win); (void)(user); }
+static void free_a(WINDOW *win, void *user) { (void)(win); (void)(user); }
+
+void test15() {
+	struct aug_edgewin *a, *b;
+	struct aug_region primary;
+	int owner1, owner2;
+
+	diag("++++test15++++");	
+	diag("edge windows are found by owner and window callback");
+	region_map_init();
+
+	region_map_push_top(&owner1, window_a, free_a, 2);
+	region_map_push_left(&owner1, window_b, NULL, 3);
+	region_map_push_bot(&owner2, window_a, NULL, 4);
+	ok1(region_map_layout(20, 30, &primary) == 0);
+
+	a = region_map_lookup(&owner1, window_a);
+	b = region_map_lookup(&owner1, window_b);
+	ok1(a != NULL && a->owner == &owner1 && a->free_fn == free_a);
+	ok1(a->region.rows == 2 && a->region.y == 0);
+	ok1(b != NULL && b->free_fn == NULL && b->region.cols == 3);
+	ok1(region_map_lookup(&owner2, window_a)->region.rows == 4);
+	ok1(region_map_lookup(&owner2, window_b) == NULL);
+
+	diag("deleting one leaves the others of the same owner");
+	ok1(region_map_delete(&owner1, window_a) == 0);
+	ok1(region_map_delete(&owner1, window_a) == -1);
+	ok1(region_map_lookup(&owner1, window_a) == NULL);
+	ok1(region_map_lookup(&owner1, window_b) != NULL);
+	ok1(region_map_lookup(&owner2, window_a) != NULL);
+	ok1(region_map_count() == 2);
+
+#define TEST15AMT 12
+	diag("----test15----\n#");
+	region_map_free();
+}
+
+void test16() {
+	struct aug_edgewin *ew;
+	struct aug_region primary;
+	int owners[11], i, in_order;
+
+	diag("++++test16++++");	
+	diag("removed edge windows keep their slot until the next layout");
+	region_map_init();
+
+	/* fills the array */
+	for(i = 0; i < 7; i++)
+		region_map_push_top(&owners[i], window_a, NULL, 1);
+	region_map_push_bot(&owners[3], window_a, NULL, 2);
+	ok1(region_map_top_size() == 7 && region_map_bot_size() == 1);
+
+	ew = region_map_lookup(&owners[2], window_a);
+	region_map_remove(ew);
+	ok1(region_map_lookup(&owners[2], window_a) == NULL);
+	ok1(ew->owner == &owners[2]);
+	ok1(region_map_top_size() == 6);
+
+	diag("deleting by key removes every window pushed with it");
+	ok1(region_map_delete(&owners[3], window_a) == 0);
+	ok1(region_map_lookup(&owners[3], window_a) == NULL);
+	ok1(region_map_top_size() == 5 && region_map_bot_size() == 0);
+
+	diag("pushing into a full array reuses the dead slots");
+	for(i = 7; i < 11; i++)
+		region_map_push_left(&owners[i], window_a, NULL, 1);
+	ok1(region_map_lookup(&owners[4], window_a) != NULL);
+	ok1(region_map_left_size() == 4);
+
+	ok1(region_map_layout(20, 30, &primary) == 0);
+	ok1(primary.rows == 20 - 5 && primary.cols == 30 - 4);
+	ok1(region_map_count() == 9);
+	in_order = 1;
+	for(i = 0; i < (int) region_map_count(); i++) {
+		ew = region_map_get(i);
+		if(ew->owner != &owners[(i < 2)? i : i + 2])
+			in_order = 0;
+	}
+	ok(in_order, "the rest are in the order they were pushed");
+	ok1(region_map_lookup(&owners[10], window_a) == region_map_get(8) );
+
+#define TEST16AMT 14
+	diag("----test16----\n#");
+	region_map_free();
+}
+
 int main()
 {
 	int i, len, total_tests;
@@ -1068,7 +1269,10 @@ int main()
 		TESTN(10),
 		TESTN(11),
 		TESTN(12),
-		TESTN(13)
+		TESTN(13),
+		TESTN(14),
+		TESTN(15),
+		TESTN(16)
 	};
 
 	total_tests = 0;
@@ -0,0 +1,147 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "bench_fixtures.h"
+
+#include "vterm.h"
+#include "term.h"
+#include "screen.h"
+#include "panel_stack.h"
+#include "child.h"
+
+/* replays each fixture through the terminal and screen the way 
+ * the main loop handles the primary terminal: the bytes are fed 
+ * to vterm one drain of the pty (AUG_CHILD_BUF_SIZE) at a time and each 
+ * read is followed by a frame. prints one line of JSON per fixture:
+ *   bytes, mb_per_sec        throughput of vterm_push_bytes alone
+ *   total_mb_per_sec         throughput including the frames
+ *   cells_painted            cells written to the curses window
+ *   frames, frame_usec_p50/p99  
+ *                            cost of a frame (damage flush, staging,
+ *                            painting, compositing and doupdate)
+ *   outer_bytes              approximate bytes sent to the outer terminal
+ */
+
+static void discard_term_output(struct aug_term *term) {
+	char buf[256];
+
+	while(vterm_output_get_buffer_current(term->vt) > 0)
+		vterm_output_bufferread(term->vt, buf, sizeof(buf) );
+}
+
+/* what child_refresh and the main loop do for the primary terminal */
+static void frame(struct aug_term *term) {
+	vterm_screen_flush_damage(vterm_obtain_screen(term->vt) );
+	(*term->io_callbacks.stage)(term->user);
+	(*term->io_callbacks.refresh)(term->user);
+	panel_stack_update();
+	screen_doupdate();
+}
+
+static void replay(FILE *out, struct aug_term *term, const char *name, 
+		const struct bench_buf *bb) {
+	static const char reset[] = "\033[m\033[r\033[H\033[2J";
+	struct bench_samples samples;
+	size_t off, n;
+	double t0, t1, t2, parse, total;
+	unsigned long painted;
+	unsigned long long outer;
+
+	vterm_push_bytes(term->vt, reset, sizeof(reset)-1);
+	frame(term);
+
+	bench_samples_init(&samples);
+	painted = screen_cells_painted();
+	outer = bench_pty_bytes();
+	parse = 0;
+	total = 0;
+	for(off = 0; off < bb->len; off += n) {
+		n = bb->len - off;
+		if(n > AUG_CHILD_BUF_SIZE)
+			n = AUG_CHILD_BUF_SIZE;
+
+		t0 = bench_now();
+		vterm_push_bytes(term->vt, bb->data + off, n);
+		t1 = bench_now();
+		frame(term);
+		t2 = bench_now();
+		discard_term_output(term);
+
+		parse += t1 - t0;
+		total += t2 - t0;
+		bench_samples_add(&samples, t2 - t1);
+	}
+
+	fprintf(out, "{\"bench\": \"replay\", \"fixture\": \"%s\", \"bytes\": %zu, "
+		"\"mb_per_sec\": %.2f, \"total_mb_per_sec\": %.2f, \"cells_painted\": %lu, "
+		"\"frames\": %zu, \"frame_usec_p50\": %.1f, \"frame_usec_p99\": %.1f, "
+		"\"outer_bytes\": %llu}\n",
+		name, bb->len, 
+		(parse > 0)? bb->len/parse/1e6 : 0, (total > 0)? bb->len/total/1e6 : 0,
+		screen_cells_painted() - painted, samples.n, 
+		bench_samples_pct(&samples, 50), bench_samples_pct(&samples, 99),
+		bench_pty_bytes() - outer);
+	fflush(out);
+
+	bench_samples_free(&samples);
+}
+
+/* usage: replay_bench [CAPTURE ...] 
+ * with no arguments the generated fixtures are replayed. */
+int main(int argc, char *argv[]) {
+	struct aug_term term;
+	struct bench_buf bb;
+	FILE *out;
+	size_t i;
+	int j;
+
+	out = bench_pty_init();
+
+	term_init(&term, 1, 1);
+	if(screen_init(&term) != 0)
+		err_exit(0, "screen_init failed");
+	if(screen_color_start() != 0)
+		err_warn(0, "failed to start color: %s", screen_err_msg(errno));
+
+	bench_buf_init(&bb);
+	if(argc > 1) {
+		for(j = 1; j < argc; j++) {
+			if(bench_buf_load(&bb, argv[j]) != 0)
+				err_exit(errno, "failed to read %s", argv[j]);
+			replay(out, &term, argv[j], &bb);
+			bb.len = 0;
+		}
+	}
+	else {
+		for(i = 0; i < AUG_ARRAY_SIZE(g_bench_fixtures); i++) {
+			bench_fixture_gen(&g_bench_fixtures[i], &bb);
+			replay(out, &term, g_bench_fixtures[i].name, &bb);
+			bb.len = 0;
+		}
+	}
+	bench_buf_free(&bb);
+
+	screen_free();
+	term_free(&term);
+	bench_pty_free();
+
+	return 0;
+}
@@ -0,0 +1,431 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <ccan/tap/tap.h>
+
+#include "util.h"
+#include "attr.h"
+#include "vterm_ansi_colors.h"
+#include "session.h"
+#include "session_test.h"
+
+struct aug_test {
+	void (*fn)();
+	int amt;
+};
+
+void test1() {
+	struct aug_session_queue q;
+	struct aug_session_reader r;
+	struct aug_session_view view;
+	struct aug_session_hdr hdr;
+	struct aug_session_screen scr;
+	struct aug_session_run run;
+	struct aug_session_cell cells[2];
+	const char *payload;
+	char buf[256], *full;
+	int fds[2];
+	size_t len;
+
+	diag("++++test1++++");	
+	diag("messages survive a trip through a socket");
+	AUG_STATUS_EQUAL( socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0 );
+	AUG_STATUS_EQUAL( set_nonblocking(fds[1]), 0 );
+	session_queue_init(&q);
+	session_reader_init(&r);
+	session_queue_msg(&q, AUG_SESSION_MSG_INPUT, "ls\r", 3);
+	session_queue_msg(&q, AUG_SESSION_MSG_INPUT, "", 0);
+	ok1(session_queue_flush(&q, fds[0]) == 0);
+	ok1(session_queue_pending(&q) == 0);
+	ok1(session_reader_fill(&r, fds[1]) == 0);
+	ok1(session_reader_next(&r, &hdr, &payload) == 1);
+	ok1(hdr.type == AUG_SESSION_MSG_INPUT && hdr.len == 3 && memcmp(payload, "ls\r", 3) == 0);
+	ok1(session_reader_next(&r, &hdr, &payload) == 1 && hdr.len == 0);
+	ok1(session_reader_next(&r, &hdr, &payload) == 0);
+
+	diag("half a message waits for the rest");
+	hdr.type = AUG_SESSION_MSG_INPUT;
+	hdr.len = 4;
+	memcpy(buf, &hdr, sizeof(hdr));
+	memcpy(buf + sizeof(hdr), "abcd", 4);
+	AUG_EQUAL( write(fds[0], buf, sizeof(hdr) + 2), (ssize_t) sizeof(hdr) + 2 );
+	ok1(session_reader_fill(&r, fds[1]) == 0);
+	ok1(session_reader_next(&r, &hdr, &payload) == 0);
+	AUG_EQUAL( write(fds[0], buf + sizeof(hdr) + 2, 2), 2 );
+	ok1(session_reader_fill(&r, fds[1]) == 0);
+	ok1(session_reader_next(&r, &hdr, &payload) == 1 && memcmp(payload, "abcd", 4) == 0);
+
+	diag("a hang up is the end of the stream");
+	close(fds[0]);
+	ok1(session_reader_fill(&r, fds[1]) == -1 && errno == 0);
+	close(fds[1]);
+	session_reader_free(&r);
+	session_queue_free(&q);
+
+	diag("a view takes full screens and diffs");
+	session_view_init(&view);
+	memset(g_screen, 0, sizeof(g_screen));
+	screen_put(1, 2, "hi");
+	scr.rows = ROWS;
+	scr.cols = COLS;
+	scr.cursor_row = 1;
+	scr.cursor_col = 4;
+	hdr.type = AUG_SESSION_MSG_FULL;
+	hdr.len = sizeof(scr) + sizeof(g_screen);
+	full = aug_malloc(hdr.len);
+	memcpy(full, &scr, sizeof(scr));
+	memcpy(full + sizeof(scr), g_screen, sizeof(g_screen));
+	ok1(session_view_apply(&view, &hdr, full) == 0);
+	free(full);
+	ok1(view.rows == ROWS && view.cols == COLS);
+	ok1(view.cursor_row == 1 && view.cursor_col == 4);
+	ok1(view_has(&view, 1, 2, "hi"));
+	ok1(dirty_cells(&view) == ROWS*COLS);
+
+	screen_put(3, 8, "yo");
+	run.row = 3;
+	run.col = 8;
+	run.len = 2;
+	run.pad = 0;
+	memcpy(cells, &g_screen[3][8], sizeof(cells));
+	len = 0;
+	memcpy(buf + len, &scr, sizeof(scr));
+	len += sizeof(scr);
+	memcpy(buf + len, &run, sizeof(run));
+	len += sizeof(run);
+	memcpy(buf + len, cells, sizeof(cells));
+	len += sizeof(cells);
+	hdr.type = AUG_SESSION_MSG_DIFF;
+	hdr.len = len;
+	ok1(session_view_apply(&view, &hdr, buf) == 0);
+	ok1(view_has(&view, 3, 8, "yo"));
+	ok1(dirty_cells(&view) == 2);
+
+	diag("diffs which dont fit the view are rejected");
+	run.col = 9;
+	memcpy(buf + sizeof(scr), &run, sizeof(run));
+	ok1(session_view_apply(&view, &hdr, buf) != 0);
+	hdr.len = len - 1;
+	ok1(session_view_apply(&view, &hdr, buf) != 0);
+
+	session_view_free(&view);
+#define TEST1AMT 22
+	diag("----test1----\n#");
+}
+
+static volatile int g_attached;
+static char g_input[64];
+static size_t g_input_len;
+
+static void on_input(const char *data, size_t len, void *user) {
+	(void)(user);
+
+	memcpy(g_input + g_input_len, data, len);
+	g_input_len += len;
+}
+
+static volatile int g_resized_rows, g_resized_cols;
+
+static void on_resize(int rows, int cols, void *user) {
+	(void)(user);
+
+	g_resized_cols = cols;
+	__atomic_store_n(&g_resized_rows, rows, __ATOMIC_SEQ_CST);
+}
+
+static void on_attach(void *user) {
+	(void)(user);
+
+	__atomic_store_n(&g_attached, 1, __ATOMIC_SEQ_CST);
+}
+
+static int connect_to(const char *path) {
+	struct sockaddr_un addr;
+	int fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path)-1);
+
+	if( (fd = socket(AF_UNIX, SOCK_STREAM, 0) ) < 0)
+		err_exit(errno, "socket failed");
+	if(connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0)
+		err_exit(errno, "connect failed");
+	AUG_STATUS_EQUAL( set_nonblocking(fd), 0 );
+	return fd;
+}
+
+/* apply every message which arrives within a moment. returns
+ * the number of messages or -1 if one was bad. */
+static int receive(int fd, struct aug_session_reader *r, 
+		struct aug_session_view *view, size_t *bytes) {
+	struct aug_session_hdr hdr;
+	const char *payload;
+	struct pollfd pfd;
+	int n;
+
+	n = 0;
+	*bytes = 0;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	while(poll(&pfd, 1, 100) > 0) {
+		if(session_reader_fill(r, fd) != 0)
+			break;
+		while(session_reader_next(r, &hdr, &payload) == 1) {
+			if(session_view_apply(view, &hdr, payload) != 0)
+				return -1;
+			*bytes += sizeof(hdr) + hdr.len;
+			n++;
+		}
+	}
+
+	return n;
+}
+
+static void wait_attached() {
+	int i;
+
+	for(i = 0; i < 100 && __atomic_load_n(&g_attached, __ATOMIC_SEQ_CST) == 0; i++)
+		usleep(10000);
+	g_attached = 0;
+}
+
+void test2() {
+	struct aug_session s, other;
+	struct aug_session_reader r;
+	struct aug_session_view view;
+	struct aug_session_queue q;
+	struct aug_session_dims dims;
+	char dir[] = "/tmp/aug_session_test.XXXXXX";
+	char path[128];
+	struct sockaddr_un addr;
+	struct stat st;
+	VTermRect rect;
+	size_t bytes;
+	uid_t uid;
+	int fd, i;
+
+	diag("++++test2++++");	
+	if(mkdtemp(dir) == NULL)
+		err_exit(errno, "mkdtemp failed");
+	snprintf(path, sizeof(path), "%s/session", dir);
+	memset(g_screen, 0, sizeof(g_screen));
+	screen_put(0, 0, "$ ");
+
+	diag("a client gets the whole screen when it attaches");
+	ok1(session_start(&s, path, on_input, on_resize, on_attach, NULL) == 0);
+	/* nobody is watching yet */
+	session_frame(&s, ROWS, COLS, 0, 2, screen_cell, NULL);
+	fd = connect_to(path);
+	session_reader_init(&r);
+	session_view_init(&view);
+	wait_attached();
+	session_frame(&s, ROWS, COLS, 0, 2, screen_cell, NULL);
+	ok1(receive(fd, &r, &view, &bytes) == 1);
+	ok1(view.rows == ROWS && view.cols == COLS);
+	ok1(view_has(&view, 0, 0, "$ "));
+	ok1(view.cursor_col == 2);
+	dirty_cells(&view);
+
+	diag("only the user can connect, and the socket isnt taken over while in use");
+	ok1(stat(path, &st) == 0 && (st.st_mode & (S_IRWXG | S_IRWXO)) == 0);
+	ok1(unix_peer_uid(fd, &uid) == 0 && uid == geteuid());
+	ok1(session_start(&other, path, on_input, on_resize, on_attach, NULL) != 0 
+		&& errno == EADDRINUSE);
+	ok1(access(path, F_OK) == 0);
+
+	diag("after that it only gets what changed");
+	screen_put(0, 2, "ls");
+	rect.start_row = 0;
+	rect.end_row = 1;
+	rect.start_col = 0;
+	rect.end_col = COLS;
+	session_damage(&s, rect);
+	session_frame(&s, ROWS, COLS, 0, 4, screen_cell, NULL);
+	ok1(receive(fd, &r, &view, &bytes) == 1);
+	ok1(view_has(&view, 0, 0, "$ ls"));
+	ok1(view.cursor_col == 4);
+	ok1(dirty_cells(&view) == 2);
+	ok1(bytes == sizeof(struct aug_session_hdr) + sizeof(struct aug_session_screen) 
+		+ sizeof(struct aug_session_run) + 2*sizeof(struct aug_session_cell) );
+
+	diag("damage which didnt change anything isnt sent");
+	session_damage(&s, rect);
+	session_frame(&s, ROWS, COLS, 0, 4, screen_cell, NULL);
+	ok1(receive(fd, &r, &view, &bytes) == 0);
+
+	diag("a resize sends the whole screen again");
+	session_frame(&s, ROWS-1, COLS, 0, 4, screen_cell, NULL);
+	ok1(receive(fd, &r, &view, &bytes) == 1);
+	ok1(view.rows == ROWS-1);
+
+	diag("what the client types comes back through on_input");
+	session_queue_init(&q);
+	session_queue_msg(&q, AUG_SESSION_MSG_INPUT, "ls", 2);
+	session_queue_msg(&q, AUG_SESSION_MSG_INPUT, "\r", 1);
+	ok1(session_queue_flush(&q, fd) == 0);
+	for(i = 0; i < 100 && g_input_len < 3; i++)
+		usleep(10000);
+	ok1(g_input_len == 3 && memcmp(g_input, "ls\r", 3) == 0);
+
+	diag("the size of the client's terminal comes back through on_resize");
+	dims.rows = 40;
+	dims.cols = 100;
+	session_queue_msg(&q, AUG_SESSION_MSG_RESIZE, &dims, sizeof(dims));
+	ok1(session_queue_flush(&q, fd) == 0);
+	for(i = 0; i < 100 && __atomic_load_n(&g_resized_rows, __ATOMIC_SEQ_CST) == 0; i++)
+		usleep(10000);
+	ok1(g_resized_rows == 40 && g_resized_cols == 100);
+
+	diag("a client which sends garbage is dropped");
+	session_queue_msg(&q, AUG_SESSION_MSG_FULL, "x", 1);
+	ok1(session_queue_flush(&q, fd) == 0);
+	ok1(receive(fd, &r, &view, &bytes) == 0);
+	ok1(session_reader_fill(&r, fd) == -1);
+	session_queue_free(&q);
+	close(fd);
+
+	diag("the socket is gone once the session stops");
+	session_stop(&s);
+	ok1(access(path, F_OK) != 0 && errno == ENOENT);
+
+	diag("a socket nobody listens on is replaced");
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path)-1);
+	if( (fd = socket(AF_UNIX, SOCK_STREAM, 0) ) < 0)
+		err_exit(errno, "socket failed");
+	ok1(bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0);
+	close(fd);
+	ok1(session_start(&s, path, on_input, on_resize, on_attach, NULL) == 0);
+	session_stop(&s);
+
+	session_view_free(&view);
+	session_reader_free(&r);
+	rmdir(dir);
+#define TEST2AMT 27
+	diag("----test2----\n#");
+}
+
+static void vterm_cell(VTermScreenCell *vcell, const uint32_t *chars, int fg) {
+	int i;
+
+	memset(vcell, 0, sizeof(*vcell));
+	for(i = 0; chars[i] != 0; i++)
+		vcell->chars[i] = chars[i];
+	vcell->width = 1;
+	vcell->fg = (fg < 0)? VTERM_DEFAULT_COLOR : vterm_ansi_colors[fg];
+	vcell->bg = VTERM_DEFAULT_COLOR;
+}
+
+void test3() {
+	static const uint32_t accented[] = {'e', 0x301, 0};
+	static const uint32_t plain[] = {'a', 0};
+	static const uint32_t empty[] = {0};
+	static const wchar_t drawn[] = {L'b', 0x301, 0};
+	struct aug_session_view view;
+	struct aug_session_cell cell;
+	VTermScreenCell vcell;
+	cchar_t cch;
+	char *out;
+	size_t len;
+	FILE *f;
+	int pair;
+
+	diag("++++test3++++");	
+	diag("combining characters go along with their cell");
+	vterm_cell(&vcell, accented, -1);
+	session_cell_from_vterm(&vcell, &cell);
+	ok1(cell.ch == 'e' && cell.combining[0] == 0x301 && cell.combining[1] == 0);
+	session_view_init(&view);
+	session_view_resize(&view, 1, 1);
+	view.cells[0] = cell;
+	view.cursor_row = view.cursor_col = 0;
+	rect_set_add(&view.dirty, 0, 0, 1, 1);
+	AUG_PTR_NON_NULL( f = open_memstream(&out, &len) );
+	session_view_render(f, &view);
+	fclose(f);
+	ok1(strstr(out, "e\xcc\x81") != NULL);
+	free(out);
+	session_view_free(&view);
+
+	diag("the cell takes on what the plugins drew");
+	/* curses only keeps combining characters in a locale 
+	 * which knows about them */
+	if(setlocale(LC_CTYPE, "C.UTF-8") == NULL)
+		setlocale(LC_CTYPE, "");
+	vterm_cell(&vcell, plain, VTERM_ANSI_RED);
+	session_cell_from_vterm(&vcell, &cell);
+	attr_curses_colors_to_curses_pair(COLOR_RED, COLOR_DEFAULT, &pair);
+	ok1(setcchar(&cch, drawn, A_UNDERLINE, pair, NULL) != ERR);
+	session_cell_apply_curses(&cell, &cch);
+	ok1(cell.ch == 'b' && cell.combining[0] == 0x301);
+	ok1(cell.attrs == (AUG_SESSION_UNDERLINE | AUG_SESSION_DEFAULT_BG) );
+	diag("but keeps the terminal's colors unless they were changed");
+	ok1(cell.fg[0] == vterm_ansi_colors[VTERM_ANSI_RED].red
+		&& cell.fg[1] == vterm_ansi_colors[VTERM_ANSI_RED].green);
+	attr_curses_colors_to_curses_pair(COLOR_GREEN, COLOR_BLUE, &pair);
+	ok1(setcchar(&cch, drawn, A_NORMAL, pair, NULL) != ERR);
+	session_cell_apply_curses(&cell, &cch);
+	ok1(cell.attrs == 0);
+	ok1(cell.fg[1] == vterm_ansi_colors[VTERM_ANSI_GREEN].green
+		&& cell.bg[2] == vterm_ansi_colors[VTERM_ANSI_BLUE].blue);
+
+	diag("an empty cell stays empty");
+	vterm_cell(&vcell, empty, -1);
+	session_cell_from_vterm(&vcell, &cell);
+	ok1(setcchar(&cch, L" ", A_NORMAL, 0, NULL) != ERR);
+	session_cell_apply_curses(&cell, &cch);
+	ok1(cell.ch == 0 && cell.attrs == (AUG_SESSION_DEFAULT_FG | AUG_SESSION_DEFAULT_BG) );
+#define TEST3AMT 11
+	diag("----test3----\n#");
+}
+
+int main()
+{
+	int i, len, total_tests;
+#define TESTN(_num) {test##_num, TEST##_num##AMT}
+	struct aug_test tests[] = {
+		TESTN(1),
+		TESTN(2),
+		TESTN(3)
+	};
+
+	total_tests = 0;
+	len = AUG_ARRAY_SIZE(tests);
+	for(i = 0; i < len; i++) {
+		total_tests += tests[i].amt;
+	}
+
+	plan_tests(total_tests);
+
+	for(i = 0; i < len; i++) {
+		(*tests[i].fn)();
+	}
+
+	return exit_status();
+}
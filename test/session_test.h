@@ -0,0 +1,66 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUG_SESSION_TEST_H
+#define AUG_SESSION_TEST_H
+
+/* a fake primary screen for the session and mirror tests, and
+ * helpers to check what a session view ended up with. */
+
+#include <string.h>
+
+#include "session.h"
+
+#define ROWS 4
+#define COLS 10
+
+static struct aug_session_cell g_screen[ROWS][COLS];
+
+static void screen_cell(int row, int col, struct aug_session_cell *cell, void *user) {
+	(void)(user);
+
+	*cell = g_screen[row][col];
+}
+
+static void screen_put(int row, int col, const char *str) {
+	for(; *str != '\0'; str++, col++) {
+		memset(&g_screen[row][col], 0, sizeof(g_screen[row][col]));
+		g_screen[row][col].ch = *str;
+		g_screen[row][col].width = 1;
+		g_screen[row][col].attrs = AUG_SESSION_DEFAULT_FG | AUG_SESSION_DEFAULT_BG;
+	}
+}
+
+static int view_has(const struct aug_session_view *view, int row, int col, const char *str) {
+	for(; *str != '\0'; str++, col++)
+		if(view->cells[row*view->cols + col].ch != (uint32_t) *str)
+			return 0;
+	return 1;
+}
+
+/* empties the dirty set of @view and returns how many cells were in it */
+static int dirty_cells(struct aug_session_view *view) {
+	struct aug_rect_set_rect rect;
+	int n;
+
+	n = 0;
+	while(rect_set_pop(&view->dirty, &rect) == 0)
+		n += (rect.row_end - rect.row_start)*(rect.col_end - rect.col_start);
+	return n;
+}
+
+#endif /* AUG_SESSION_TEST_H */
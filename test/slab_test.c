@@ -0,0 +1,135 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <ccan/tap/tap.h>
+
+#include "util.h"
+#include "slab.h"
+
+struct aug_test {
+	void (*fn)();
+	int amt;
+};
+
+struct obj {
+	int a;
+	double b;
+	char name[13];
+};
+
+void test1() {
+	struct aug_slab slab;
+	struct obj *objs[8];
+	size_t in_use, bytes, first_bytes;
+	int i, distinct;
+
+	diag("++++test1++++");	
+	diag("objects come out of shared pages");
+	
+	slab_init(&slab, sizeof(struct obj), 4);
+	for(i = 0; i < 4; i++) {
+		objs[i] = slab_alloc(&slab);
+		objs[i]->a = i;
+	}
+	slab_stats(&slab, &in_use, &first_bytes);
+	ok1(in_use == 4);
+	
+	for(i = 4; i < 8; i++) {
+		objs[i] = slab_alloc(&slab);
+		objs[i]->a = i;
+	}
+	slab_stats(&slab, &in_use, &bytes);
+	ok1(in_use == 8);
+	ok1(bytes == 2*first_bytes);
+
+	distinct = 1;
+	for(i = 0; i < 8; i++) {
+		if(objs[i]->a != i)
+			distinct = 0;
+		if( ((uintptr_t) objs[i]) % sizeof(double) != 0)
+			distinct = 0;
+	}
+	ok(distinct, "objects dont overlap and are aligned");
+
+	diag("an empty page is given back, the last one is kept");
+	for(i = 4; i < 8; i++)
+		slab_release(&slab, objs[i]);
+	slab_stats(&slab, &in_use, &bytes);
+	ok1(in_use == 4);
+	ok1(bytes == first_bytes);
+
+	for(i = 0; i < 4; i++)
+		slab_release(&slab, objs[i]);
+	slab_stats(&slab, &in_use, &bytes);
+	ok1(in_use == 0);
+	ok1(bytes == first_bytes);
+
+	slab_free(&slab);
+#define TEST1AMT 8
+	diag("----test1----\n#");
+}
+
+void test2() {
+	struct aug_slab slab;
+	void *a, *b, *c;
+	size_t in_use, bytes;
+
+	diag("++++test2++++");	
+	diag("released objects are reused before a new page is made");
+
+	slab_init(&slab, 1, 2);
+	a = slab_alloc(&slab);
+	b = slab_alloc(&slab);
+	slab_release(&slab, a);
+	c = slab_alloc(&slab);
+	ok1(c == a);
+	slab_stats(&slab, &in_use, &bytes);
+	ok1(in_use == 2);
+
+	slab_release(&slab, b);
+	slab_release(&slab, c);
+	slab_free(&slab);
+#define TEST2AMT 2
+	diag("----test2----\n#");
+}
+
+int main()
+{
+	int i, len, total_tests;
+#define TESTN(_num) {test##_num, TEST##_num##AMT}
+	struct aug_test tests[] = {
+		TESTN(1),
+		TESTN(2)
+	};
+
+	total_tests = 0;
+	len = AUG_ARRAY_SIZE(tests);
+	for(i = 0; i < len; i++) {
+		total_tests += tests[i].amt;
+	}
+
+	plan_tests(total_tests);
+
+	for(i = 0; i < len; i++) {
+		(*tests[i].fn)();
+	}
+
+	return exit_status();
+}
@@ -0,0 +1,150 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <ccan/tap/tap.h>
+
+#include "util.h"
+#include "err.h"
+#include "slab.h"
+#include "term.h"
+#include "child.h"
+
+struct aug_test {
+	void (*fn)();
+	int amt;
+};
+
+/* the parts of a plugin terminal that live in the aug process */
+struct tchild {
+	struct aug_term term;
+	struct aug_child child;
+};
+
+#define N_TERMINALS 200
+
+static void exec_cb() {}
+static void to_refresh(void *user) { (void) user; }
+
+/* resident set size in bytes, or 0 if it cant be read */
+static size_t rss() {
+	FILE *f;
+	unsigned long size, resident;
+
+	if( (f = fopen("/proc/self/statm", "r") ) == NULL)
+		return 0;
+	if(fscanf(f, "%lu %lu", &size, &resident) != 2)
+		resident = 0;
+	fclose(f);
+
+	return resident*sysconf(_SC_PAGESIZE);
+}
+
+void test1() {
+	static struct tchild *tchildren[N_TERMINALS];
+	char *const argv[] = {"/bin/cat", NULL};
+	struct aug_slab slab;
+	struct aug_buf_pool_stats stats;
+	size_t before, after, in_use, bytes;
+	int i, started, status, reaped;
+
+	diag("++++test1++++");	
+	diag("resident memory of %d idle terminals", N_TERMINALS);
+	
+	child_bufs_init();
+	slab_init(&slab, sizeof(struct tchild), 16);
+	before = rss();
+
+	started = 0;
+	for(i = 0; i < N_TERMINALS; i++) {
+		tchildren[i] = slab_alloc(&slab);
+		term_init(&tchildren[i]->term, 1, 1);
+		child_init(&tchildren[i]->child, &tchildren[i]->term, argv, exec_cb,
+			to_refresh, NULL, NULL, NULL, NULL, NULL, tchildren[i]);
+		if(tchildren[i]->child.pid > 0)
+			started++;
+	}
+	ok1(started == N_TERMINALS);
+
+	after = rss();
+	slab_stats(&slab, &in_use, &bytes);
+	diag("rss before: %zu bytes, after: %zu bytes", before, after);
+	diag("%zu bytes per terminal (%zu of that in the slab)", 
+		(after - before)/N_TERMINALS, bytes/N_TERMINALS);
+	ok1(in_use == N_TERMINALS);
+	ok(sizeof(struct aug_child) < AUG_CHILD_BUF_SIZE, 
+		"children dont carry their own io buffer");
+	/* each terminal used to carry an io buffer of this size on its own */
+	ok1(bytes/N_TERMINALS < AUG_CHILD_BUF_SIZE/8);
+
+	diag("draining every terminal borrows from the shared pool");
+	for(i = 0; i < N_TERMINALS; i++) {
+		term_push_char(&tchildren[i]->term, 'a');
+		child_process_term_output(&tchildren[i]->child);
+	}
+	child_bufs_stats(&stats);
+	ok1(stats.n_lent == 0);
+	ok1(stats.n_idle <= AUG_CHILD_IDLE_BUFS);
+	ok1(stats.bytes <= AUG_CHILD_IDLE_BUFS*AUG_CHILD_BUF_SIZE);
+
+	reaped = 0;
+	for(i = 0; i < N_TERMINALS; i++) {
+		kill(tchildren[i]->child.pid, SIGKILL);
+		if(waitpid(tchildren[i]->child.pid, &status, 0) == tchildren[i]->child.pid)
+			reaped++;
+		close(tchildren[i]->term.master);
+		child_free(&tchildren[i]->child);
+		term_free(&tchildren[i]->term);
+		slab_release(&slab, tchildren[i]);
+	}
+	ok1(reaped == N_TERMINALS);
+
+	slab_stats(&slab, &in_use, &bytes);
+	ok1(in_use == 0);
+	slab_free(&slab);
+	child_bufs_free();
+#define TEST1AMT 9
+	diag("----test1----\n#");
+}
+
+int main()
+{
+	int i, len, total_tests;
+#define TESTN(_num) {test##_num, TEST##_num##AMT}
+	struct aug_test tests[] = {
+		TESTN(1)
+	};
+
+	total_tests = 0;
+	len = AUG_ARRAY_SIZE(tests);
+	for(i = 0; i < len; i++) {
+		total_tests += tests[i].amt;
+	}
+
+	plan_tests(total_tests);
+
+	for(i = 0; i < len; i++) {
+		(*tests[i].fn)();
+	}
+
+	return exit_status();
+}
@@ -0,0 +1,270 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <ccan/tap/tap.h>
+
+#include "util.h"
+#include "lock.h"
+#include "trace.h"
+#include "counters.h"
+
+struct aug_test {
+	void (*fn)();
+	int amt;
+};
+
+static struct {
+	int val;
+	AUG_LOCK_MEMBERS;
+} g_a;
+
+/* dump the trace and count the lines containing 
+ * @needle (each event is on its own line) */
+static int count_in_dump(const char *needle) {
+	char line[1024];
+	FILE *f;
+	int n;
+
+	if( (f = tmpfile()) == NULL)
+		err_exit(errno, "tmpfile failed");
+	trace_dump(f);
+	rewind(f);
+
+	n = 0;
+	while(fgets(line, sizeof(line), f) != NULL)
+		if(strstr(line, needle) != NULL)
+			n++;
+
+	fclose(f);
+	return n;
+}
+
+static void record(enum aug_trace_type type, const char *name, uint32_t arg) {
+	trace_end(type, name, trace_begin(), arg);
+}
+
+void test1() {
+	struct aug_trace_stats stats;
+
+	diag("++++test1++++");	
+	diag("nothing is recorded while tracing is off");
+	record(AUG_TRACE_PTY_READ, NULL, 10);
+	ok1(trace_begin() == 0);
+	trace_stats(&stats);
+	ok1(stats.recorded == 0);
+	ok1(count_in_dump("\"ph\": \"X\"") == 0);
+
+	diag("events are written out in trace_event format");
+	trace_enable(1);
+	trace_thread_name("tester");
+	record(AUG_TRACE_PTY_READ, NULL, 4096);
+	record(AUG_TRACE_PLUGIN_CB, "cell_update", 0);
+	trace_stats(&stats);
+	ok1(stats.recorded == 2);
+	ok1(stats.threads == 1);
+	ok1(count_in_dump("\"ph\": \"X\"") == 2);
+	ok1(count_in_dump("\"name\": \"pty_read\", \"cat\": \"io\"") == 1);
+	ok1(count_in_dump("\"args\": {\"bytes\": 4096}") == 1);
+	ok1(count_in_dump("\"name\": \"cell_update\", \"cat\": \"plugin\"") == 1);
+	ok1(count_in_dump("\"args\": {\"name\": \"tester\"}") == 1);
+	ok1(count_in_dump("\"traceEvents\"") == 1);
+
+	trace_free();
+#define TEST1AMT 11
+	diag("----test1----\n#");
+}
+
+void test2() {
+	struct aug_trace_stats stats;
+	int i;
+
+	diag("++++test2++++");	
+	diag("a full ring keeps the newest events");
+	trace_enable(1);
+	for(i = 0; i < AUG_TRACE_RING_EVENTS + 10; i++)
+		record(AUG_TRACE_VTERM_PUSH, NULL, i);
+
+	trace_stats(&stats);
+	ok1(stats.recorded == AUG_TRACE_RING_EVENTS + 10);
+	ok1(stats.overwritten == 10);
+	/* the oldest slot could be in the middle of being 
+	 * rewritten, so it is never dumped */
+	ok1(count_in_dump("\"ph\": \"X\"") == AUG_TRACE_RING_EVENTS - 1);
+	ok1(count_in_dump("\"args\": {\"bytes\": 10}") == 0);
+	ok1(count_in_dump("\"args\": {\"bytes\": 11}") == 1);
+
+	diag("events from before tracing was last enabled are left out");
+	trace_enable(0);
+	record(AUG_TRACE_VTERM_PUSH, NULL, 0);
+	trace_enable(1);
+	record(AUG_TRACE_DOUPDATE, NULL, 0);
+	ok1(count_in_dump("\"ph\": \"X\"") == 1);
+
+	trace_free();
+#define TEST2AMT 6
+	diag("----test2----\n#");
+}
+
+static pthread_barrier_t g_held;
+
+/* takes the lock before main does and keeps it until main
+ * is waiting for it */
+static void *hold_a(void *user) {
+	uint64_t waits = *(uint64_t *) user;
+
+	trace_thread_name("holder");
+	AUG_LOCK(&g_a);
+	record(AUG_TRACE_PLUGIN_CB, "hold", 0);
+	pthread_barrier_wait(&g_held);
+	while(counters_get(AUG_COUNTER_LOCK_WAITS) == waits)
+		usleep(1000);
+	g_a.val++;
+	AUG_UNLOCK(&g_a);
+
+	return NULL;
+}
+
+static void *record_one(void *user) {
+	(void)(user);
+
+	record(AUG_TRACE_SIGNAL, "SIGWINCH", 28);
+	return NULL;
+}
+
+void test3() {
+	struct aug_trace_stats stats;
+	pthread_t tid;
+	uint64_t waits;
+
+	diag("++++test3++++");	
+	diag("waiting for a held lock is traced");
+	trace_enable(1);
+	/* get a ring before the other thread does, so that we
+	 * dont end up with its ring once it exits */
+	record(AUG_TRACE_FRAME, NULL, 1);
+	AUG_LOCK_INIT(&g_a);
+	waits = counters_get(AUG_COUNTER_LOCK_WAITS);
+	AUG_STATUS_EQUAL( pthread_barrier_init(&g_held, NULL, 2), 0 );
+	AUG_STATUS_EQUAL( pthread_create(&tid, NULL, hold_a, &waits), 0 );
+	pthread_barrier_wait(&g_held);
+	AUG_LOCK(&g_a);
+	g_a.val++;
+	AUG_UNLOCK(&g_a);
+	AUG_STATUS_EQUAL( pthread_join(tid, NULL), 0 );
+	AUG_STATUS_EQUAL( pthread_barrier_destroy(&g_held), 0 );
+
+	ok1(g_a.val == 2);
+	ok1(count_in_dump("\"name\": \"&g_a\", \"cat\": \"lock\"") == 1);
+	ok1(count_in_dump("\"args\": {\"name\": \"holder\"}") == 1);
+
+	diag("the ring of a thread which exited is reused");
+	trace_stats(&stats);
+	ok1(stats.threads == 2);
+	AUG_STATUS_EQUAL( pthread_create(&tid, NULL, record_one, NULL), 0 );
+	AUG_STATUS_EQUAL( pthread_join(tid, NULL), 0 );
+	trace_stats(&stats);
+	ok1(stats.threads == 2);
+	ok1(count_in_dump("\"name\": \"SIGWINCH\", \"cat\": \"signal\"") == 1);
+	ok1(count_in_dump("\"args\": {\"name\": \"holder\"}") == 0);
+
+	trace_free();
+	AUG_LOCK_FREE(&g_a);
+#define TEST3AMT 7
+	diag("----test3----\n#");
+}
+
+static pthread_key_t g_late_key;
+
+/* a destructor of another library which traces after the ring
+ * of its thread was handed back. it keeps the thread alive
+ * until main has had another thread trace. */
+static void record_late(void *user) {
+	(void)(user);
+
+	record(AUG_TRACE_SIGNAL, "late", 0);
+	pthread_barrier_wait(&g_held);
+	pthread_barrier_wait(&g_held);
+}
+
+static void *record_at_exit(void *user) {
+	record(AUG_TRACE_SIGNAL, "early", 0);
+	AUG_STATUS_EQUAL( pthread_setspecific(g_late_key, user), 0 );
+	return NULL;
+}
+
+void test4() {
+	struct aug_trace_stats stats;
+	pthread_t tid, other;
+
+	diag("++++test4++++");	
+	diag("a destructor which traces after the ring is handed back gets its own ring");
+	trace_enable(1);
+	record(AUG_TRACE_FRAME, NULL, 1);
+	AUG_STATUS_EQUAL( pthread_barrier_init(&g_held, NULL, 2), 0 );
+	AUG_STATUS_EQUAL( pthread_key_create(&g_late_key, record_late), 0 );
+	AUG_STATUS_EQUAL( pthread_create(&tid, NULL, record_at_exit, &stats), 0 );
+	pthread_barrier_wait(&g_held);
+	/* the thread is still in its destructor, so its ring
+	 * must not be given to this one */
+	AUG_STATUS_EQUAL( pthread_create(&other, NULL, record_one, NULL), 0 );
+	AUG_STATUS_EQUAL( pthread_join(other, NULL), 0 );
+	pthread_barrier_wait(&g_held);
+	AUG_STATUS_EQUAL( pthread_join(tid, NULL), 0 );
+	AUG_STATUS_EQUAL( pthread_barrier_destroy(&g_held), 0 );
+
+	trace_stats(&stats);
+	ok1(stats.threads == 3);
+	ok1(count_in_dump("\"name\": \"late\", \"cat\": \"signal\"") == 1);
+	ok1(count_in_dump("\"name\": \"SIGWINCH\", \"cat\": \"signal\"") == 1);
+
+	AUG_STATUS_EQUAL( pthread_key_delete(g_late_key), 0 );
+	trace_free();
+#define TEST4AMT 3
+	diag("----test4----\n#");
+}
+
+int main()
+{
+	int i, len, total_tests;
+#define TESTN(_num) {test##_num, TEST##_num##AMT}
+	struct aug_test tests[] = {
+		TESTN(1),
+		TESTN(2),
+		TESTN(3),
+		TESTN(4)
+	};
+
+	total_tests = 0;
+	len = AUG_ARRAY_SIZE(tests);
+	for(i = 0; i < len; i++) {
+		total_tests += tests[i].amt;
+	}
+
+	plan_tests(total_tests);
+
+	for(i = 0; i < len; i++) {
+		(*tests[i].fn)();
+	}
+
+	return exit_status();
+}
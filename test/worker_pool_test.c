@@ -0,0 +1,134 @@
+/* 
+ * Copyright 2013 anthony cantor
+ * This file is part of aug.
+ *
+ * aug is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * aug is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with aug.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <ccan/tap/tap.h>
+
+#include "util.h"
+#include "worker_pool.h"
+
+struct aug_test {
+	void (*fn)();
+	int amt;
+};
+
+#define ORDER_TASKS 64
+static int g_order[ORDER_TASKS];
+static int g_order_len;
+static pthread_mutex_t g_order_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static void record(void *user) {
+	pthread_mutex_lock(&g_order_mtx);
+	g_order[g_order_len++] = *(int *)user;
+	pthread_mutex_unlock(&g_order_mtx);
+}
+
+static void slow_record(void *user) {
+	usleep(1000);
+	record(user);
+}
+
+static void count(void *user) {
+	pthread_mutex_lock(&g_order_mtx);
+	(*(int *)user)++;
+	pthread_mutex_unlock(&g_order_mtx);
+}
+
+void test1() {
+	struct aug_worker_pool pool;
+	int ids[ORDER_TASKS];
+	int i, in_order;
+
+	diag("++++test1++++");	
+	diag("a single worker runs tasks in the order they were pushed");
+	
+	g_order_len = 0;
+	worker_pool_init(&pool, 1);
+	for(i = 0; i < ORDER_TASKS; i++) {
+		ids[i] = i;
+		worker_pool_push(&pool, (i % 2)? slow_record : record, &ids[i]);
+	}
+	worker_pool_wait(&pool);
+
+	ok1(g_order_len == ORDER_TASKS);
+	in_order = 1;
+	for(i = 0; i < g_order_len; i++)
+		if(g_order[i] != i)
+			in_order = 0;
+	ok1(in_order == 1);
+
+	diag("wait returns immediately on an idle pool");
+	worker_pool_wait(&pool);
+	ok1(g_order_len == ORDER_TASKS);
+
+	worker_pool_free(&pool);
+
+#define TEST1AMT 2 + 1
+	diag("----test1----\n#");
+}
+
+void test2() {
+	struct aug_worker_pool pool;
+	int i, total;
+
+	diag("++++test2++++");	
+	diag("several workers run every task exactly once");
+	
+	total = 0;
+	worker_pool_init(&pool, 4);
+	for(i = 0; i < 1000; i++) 
+		worker_pool_push(&pool, count, &total);
+	worker_pool_wait(&pool);
+	ok1(total == 1000);
+
+	diag("free runs tasks which are still queued");
+	for(i = 0; i < 100; i++) 
+		worker_pool_push(&pool, count, &total);
+	worker_pool_free(&pool);
+	ok1(total == 1100);
+
+#define TEST2AMT 2
+	diag("----test2----\n#");
+}
+
+int main()
+{
+	int i, len, total_tests;
+#define TESTN(_num) {test##_num, TEST##_num##AMT}
+	struct aug_test tests[] = {
+		TESTN(1),
+		TESTN(2)
+	};
+
+	total_tests = 0;
+	len = AUG_ARRAY_SIZE(tests);
+	for(i = 0; i < len; i++) {
+		total_tests += tests[i].amt;
+	}
+
+	plan_tests(total_tests);
+
+	for(i = 0; i < len; i++) {
+		(*tests[i].fn)();
+	}
+
+	return exit_status();
+}
+